@@ -0,0 +1,308 @@
+#include "abi_fingerprint_generator.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "names.h"
+
+namespace fidl {
+
+namespace {
+
+template <typename ValueType>
+uint64_t NumericBits(const flat::ConstantValue& value) {
+    ValueType number = static_cast<const flat::NumericConstantValue<ValueType>&>(value).value;
+    uint64_t bits = 0u;
+    memcpy(&bits, &number, sizeof(number));
+    return bits;
+}
+
+} // namespace
+
+// Every value is added with its size, or as 8 bytes, so that the pieces of
+// the digest cannot run into each other.
+void AbiFingerprintGenerator::Add(StringView value) {
+    Add(static_cast<uint64_t>(value.size()));
+    hash_.Update(value);
+}
+
+void AbiFingerprintGenerator::Add(uint64_t value) {
+    hash_.Update(&value, sizeof(value));
+}
+
+void AbiFingerprintGenerator::AddAttributes(const raw::AttributeList* attributes) {
+    std::vector<const raw::Attribute*> kept;
+    if (attributes != nullptr) {
+        for (const auto& attribute : attributes->attributes) {
+            if (attribute->name != "Doc")
+                kept.push_back(attribute.get());
+        }
+    }
+    Add(kept.size());
+    for (const raw::Attribute* attribute : kept) {
+        Add(attribute->name);
+        Add(attribute->value);
+    }
+}
+
+void AbiFingerprintGenerator::AddShape(const TypeShape& typeshape) {
+    Add(typeshape.Size());
+    Add(typeshape.Alignment());
+    Add(typeshape.Depth());
+    Add(typeshape.MaxHandles());
+    Add(typeshape.MaxOutOfLine());
+    Add(typeshape.HasPadding() ? 1u : 0u);
+}
+
+void AbiFingerprintGenerator::AddShape(const FieldShape& fieldshape) {
+    AddShape(fieldshape.Typeshape());
+    Add(fieldshape.Offset());
+    Add(fieldshape.Padding());
+}
+
+void AbiFingerprintGenerator::AddConstant(const flat::Constant* constant) {
+    // Only the value counts, not whether it was written as a literal or by
+    // naming another constant.
+    if (constant == nullptr || !constant->IsResolved()) {
+        Add("none");
+        return;
+    }
+    const flat::ConstantValue& value = constant->Value();
+    Add(static_cast<uint64_t>(value.kind));
+    switch (value.kind) {
+    case flat::ConstantValue::Kind::kInt8:
+        Add(NumericBits<int8_t>(value));
+        break;
+    case flat::ConstantValue::Kind::kInt16:
+        Add(NumericBits<int16_t>(value));
+        break;
+    case flat::ConstantValue::Kind::kInt32:
+        Add(NumericBits<int32_t>(value));
+        break;
+    case flat::ConstantValue::Kind::kInt64:
+        Add(NumericBits<int64_t>(value));
+        break;
+    case flat::ConstantValue::Kind::kUint8:
+        Add(NumericBits<uint8_t>(value));
+        break;
+    case flat::ConstantValue::Kind::kUint16:
+        Add(NumericBits<uint16_t>(value));
+        break;
+    case flat::ConstantValue::Kind::kUint32:
+        Add(NumericBits<uint32_t>(value));
+        break;
+    case flat::ConstantValue::Kind::kUint64:
+        Add(NumericBits<uint64_t>(value));
+        break;
+    case flat::ConstantValue::Kind::kFloat32:
+        Add(NumericBits<float>(value));
+        break;
+    case flat::ConstantValue::Kind::kFloat64:
+        Add(NumericBits<double>(value));
+        break;
+    case flat::ConstantValue::Kind::kBool:
+        Add(static_cast<const flat::BoolConstantValue&>(value).value ? 1u : 0u);
+        break;
+    case flat::ConstantValue::Kind::kString:
+        Add(static_cast<const flat::StringConstantValue&>(value).value);
+        break;
+    }
+}
+
+void AbiFingerprintGenerator::AddType(const flat::Type* type) {
+    if (type == nullptr) {
+        Add("none");
+        return;
+    }
+    Add(static_cast<uint64_t>(type->kind));
+    Add(type->nullability == types::Nullability::kNullable ? 1u : 0u);
+    // The shape also stands for the layout of declarations of other
+    // libraries, so that the fingerprint changes with them.
+    AddShape(type->shape);
+    switch (type->kind) {
+    case flat::Type::Kind::kArray: {
+        auto array_type = static_cast<const flat::ArrayType*>(type);
+        AddType(array_type->element_type);
+        Add(array_type->element_count->value);
+        break;
+    }
+    case flat::Type::Kind::kVector: {
+        auto vector_type = static_cast<const flat::VectorType*>(type);
+        AddType(vector_type->element_type);
+        Add(vector_type->element_count->value);
+        break;
+    }
+    case flat::Type::Kind::kString:
+        Add(static_cast<const flat::StringType*>(type)->max_size->value);
+        break;
+    case flat::Type::Kind::kHandle:
+        break;
+    case flat::Type::Kind::kPrimitive:
+        Add(static_cast<uint64_t>(static_cast<const flat::PrimitiveType*>(type)->subtype));
+        break;
+    case flat::Type::Kind::kIdentifier: {
+        auto identifier_type = static_cast<const flat::IdentifierType*>(type);
+        Add(static_cast<uint64_t>(identifier_type->type_decl->kind));
+        Add(NameName(identifier_type->name, ".", "/"));
+        break;
+    }
+    }
+}
+
+// Messages are anonymous structs, whose names depend on the order in which
+// they were compiled, so they are added with their methods rather than by
+// name.
+void AbiFingerprintGenerator::AddMessage(const flat::Struct* message) {
+    if (message == nullptr) {
+        Add("none");
+        return;
+    }
+    AddShape(message->typeshape);
+    Add(message->members.size());
+    for (const auto& member : message->members) {
+        Add(member.name.data());
+        AddAttributes(member.attributes.get());
+        AddType(member.type_ctor->type);
+        AddShape(member.fieldshape);
+    }
+}
+
+void AbiFingerprintGenerator::AddDecl(const flat::Decl* decl) {
+    Add(static_cast<uint64_t>(decl->kind));
+    Add(decl->name.name_part());
+    AddAttributes(decl->attributes.get());
+
+    if (decl->kind == flat::Decl::Kind::kConst) {
+        auto const_decl = static_cast<const flat::Const*>(decl);
+        AddType(const_decl->type_ctor->type);
+        AddConstant(const_decl->value.get());
+        return;
+    }
+    auto type_decl = static_cast<const flat::TypeDecl*>(decl);
+    AddShape(type_decl->typeshape);
+    Add(type_decl->recursive ? 1u : 0u);
+
+    switch (decl->kind) {
+    case flat::Decl::Kind::kBits: {
+        auto bits_decl = static_cast<const flat::Bits*>(decl);
+        AddType(bits_decl->subtype_ctor->type);
+        Add(bits_decl->mask);
+        Add(bits_decl->members.size());
+        for (const auto& member : bits_decl->members) {
+            Add(member.name.data());
+            AddAttributes(member.attributes.get());
+            AddConstant(member.value.get());
+        }
+        break;
+    }
+    case flat::Decl::Kind::kEnum: {
+        auto enum_decl = static_cast<const flat::Enum*>(decl);
+        AddType(enum_decl->type);
+        Add(enum_decl->members.size());
+        for (const auto& member : enum_decl->members) {
+            Add(member.name.data());
+            AddAttributes(member.attributes.get());
+            AddConstant(member.value.get());
+        }
+        break;
+    }
+    case flat::Decl::Kind::kInterface: {
+        auto interface_decl = static_cast<const flat::Interface*>(decl);
+        Add(interface_decl->superinterfaces.size());
+        for (const auto& superinterface : interface_decl->superinterfaces)
+            Add(NameName(superinterface, ".", "/"));
+        Add(interface_decl->all_methods.size());
+        for (const flat::Interface::Method* method : interface_decl->all_methods) {
+            Add(method->name.data());
+            AddAttributes(method->attributes.get());
+            Add(method->ordinal->value);
+            Add(method->generated_ordinal->value);
+            Add(NameName(method->owning_interface->name, ".", "/"));
+            AddMessage(method->maybe_request);
+            AddMessage(method->maybe_response);
+        }
+        break;
+    }
+    case flat::Decl::Kind::kStruct: {
+        auto struct_decl = static_cast<const flat::Struct*>(decl);
+        Add(struct_decl->members.size());
+        for (const auto& member : struct_decl->members) {
+            Add(member.name.data());
+            AddAttributes(member.attributes.get());
+            AddType(member.type_ctor->type);
+            AddConstant(member.maybe_default_value.get());
+            AddShape(member.fieldshape);
+        }
+        break;
+    }
+    case flat::Decl::Kind::kTable: {
+        auto table_decl = static_cast<const flat::Table*>(decl);
+        Add(table_decl->members.size());
+        for (const auto& member : table_decl->members) {
+            Add(member.ordinal->value);
+            if (!member.maybe_used) {
+                Add("reserved");
+                continue;
+            }
+            const auto& used = *member.maybe_used;
+            Add(used.name.data());
+            AddAttributes(used.attributes.get());
+            AddType(used.type_ctor->type);
+            AddConstant(used.maybe_default_value.get());
+        }
+        break;
+    }
+    case flat::Decl::Kind::kUnion: {
+        auto union_decl = static_cast<const flat::Union*>(decl);
+        AddShape(union_decl->membershape);
+        Add(union_decl->members.size());
+        for (const auto& member : union_decl->members) {
+            Add(member.name.data());
+            AddAttributes(member.attributes.get());
+            AddType(member.type_ctor->type);
+            AddShape(member.fieldshape);
+        }
+        break;
+    }
+    case flat::Decl::Kind::kXUnion: {
+        auto xunion_decl = static_cast<const flat::XUnion*>(decl);
+        Add(xunion_decl->members.size());
+        for (const auto& member : xunion_decl->members) {
+            Add(member.ordinal->value);
+            Add(member.name.data());
+            AddAttributes(member.attributes.get());
+            AddType(member.type_ctor->type);
+            AddShape(member.fieldshape);
+        }
+        break;
+    }
+    case flat::Decl::Kind::kConst:
+        break;
+    }
+}
+
+void AbiFingerprintGenerator::Produce(OutputSink* file) {
+    Add(LibraryName(library_, "."));
+    AddAttributes(library_->attributes());
+
+    std::vector<const flat::Decl*> decls;
+    for (const flat::Decl* decl : library_->declaration_order_) {
+        if (decl->name.library() != library_)
+            continue;
+        if (decl->kind == flat::Decl::Kind::kStruct &&
+            static_cast<const flat::Struct*>(decl)->anonymous)
+            continue;
+        decls.push_back(decl);
+    }
+    std::sort(decls.begin(), decls.end(), [](const flat::Decl* a, const flat::Decl* b) {
+        return a->name.name_part() < b->name.name_part();
+    });
+    for (const flat::Decl* decl : decls)
+        AddDecl(decl);
+
+    *file << hash_.HexDigest() << '\n';
+}
+
+} // namespace fidl
@@ -0,0 +1,45 @@
+#ifndef ABI_FINGERPRINT_GENERATOR_H_
+#define ABI_FINGERPRINT_GENERATOR_H_
+
+#include <stdint.h>
+
+#include "flat_ast.h"
+#include "output_sink.h"
+#include "sha256.h"
+#include "string_view.h"
+
+namespace fidl {
+
+// Writes the ABI fingerprint of a library: the SHA-256 digest of what the
+// libraries and bindings that depend on it are compiled against. That is the
+// names of its declarations and members, their types, shapes, ordinals and
+// constant values, and their attributes other than doc comments. Neither doc
+// comments nor where anything is in the source, nor the order in which
+// declarations are written, change the fingerprint.
+class AbiFingerprintGenerator {
+public:
+    explicit AbiFingerprintGenerator(const flat::Library* library)
+        : library_(library) {}
+
+    ~AbiFingerprintGenerator() = default;
+
+    void Produce(OutputSink* file);
+
+private:
+    void Add(StringView value);
+    void Add(uint64_t value);
+    void AddAttributes(const raw::AttributeList* attributes);
+    void AddShape(const TypeShape& typeshape);
+    void AddShape(const FieldShape& fieldshape);
+    void AddConstant(const flat::Constant* constant);
+    void AddType(const flat::Type* type);
+    void AddMessage(const flat::Struct* message);
+    void AddDecl(const flat::Decl* decl);
+
+    const flat::Library* library_;
+    Sha256 hash_;
+};
+
+} // namespace fidl
+
+#endif // ABI_FINGERPRINT_GENERATOR_H_
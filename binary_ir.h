@@ -0,0 +1,260 @@
+#ifndef BINARY_IR_H_
+#define BINARY_IR_H_
+
+#include <stdint.h>
+
+namespace fidl {
+namespace ir {
+
+// The binary intermediate representation of a library, as written by
+// --binary-ir. It holds the same library as the JSON IR, as tables of
+// fixed-size little-endian records that refer to each other by index, so
+// that it can be mapped into memory and read in place.
+//
+// The file starts with a Header, which locates each table. The records of
+// each table are 8-byte aligned. Records refer to the records of another
+// table by a Range of them, or by the index of one of them. Strings are
+// stored once each in the string table, followed by a NUL.
+//
+// Readers must check |version|, which changes whenever the layout of any
+// record does.
+
+// "FIR\0".
+constexpr uint32_t kMagic = 0x00524946u;
+constexpr uint32_t kVersion = 1u;
+
+// An index that refers to nothing.
+constexpr uint32_t kNone = UINT32_MAX;
+
+// |size| bytes at |offset| in the string table.
+struct String {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// |count| records of a table, from the one at index |first|. In the header,
+// |first| is instead the offset of the table in the file.
+struct Range {
+    uint32_t first;
+    uint32_t count;
+};
+
+struct TypeShape {
+    uint32_t size;
+    uint32_t alignment;
+    uint32_t depth;
+    uint32_t max_handles;
+    uint32_t max_out_of_line;
+    uint32_t has_padding;
+};
+
+struct FieldShape {
+    TypeShape typeshape;
+    uint32_t offset;
+    uint32_t padding;
+};
+
+struct Attribute {
+    String name;
+    String value;
+};
+
+// The kind of a declaration, as flat::Decl::Kind.
+enum class DeclKind : uint32_t {
+    kConst,
+    kBits,
+    kEnum,
+    kInterface,
+    kStruct,
+    kTable,
+    kUnion,
+    kXUnion,
+};
+
+// The kind of a type, as flat::Type::Kind.
+enum class TypeKind : uint32_t {
+    kArray,
+    kVector,
+    kString,
+    kHandle,
+    kPrimitive,
+    kIdentifier,
+};
+
+// How a constant is written in the source.
+enum class ConstantKind : uint32_t {
+    // No constant, such as the default of a member that has none.
+    kNone,
+    // A reference to a const, or to a member of an enum.
+    kIdentifier,
+    kLiteral,
+    // A value that fidlc made up.
+    kSynthesized,
+};
+
+// The kind of a constant's value, as flat::ConstantValue::Kind.
+enum class ValueKind : uint32_t {
+    kInt8,
+    kInt16,
+    kInt32,
+    kInt64,
+    kUint8,
+    kUint16,
+    kUint32,
+    kUint64,
+    kFloat32,
+    kFloat64,
+    kBool,
+    kString,
+};
+
+struct Constant {
+    uint32_t kind; // ConstantKind
+    uint32_t value_kind; // ValueKind
+    // The value of numbers and bools: signed integers as int64_t, unsigned
+    // ones as uint64_t, floats as the bits of a double, and bools as 0 or 1.
+    uint64_t value;
+    // The value of strings, with their quotes, as written in the source.
+    String string;
+    // For identifiers, the name they refer to, as "library.name/NAME" or
+    // "library.name/Enum.MEMBER". For literals, their text.
+    String expression;
+    // For literals, their raw::Literal::Kind.
+    uint32_t literal_kind;
+    uint32_t reserved;
+};
+
+struct Type {
+    uint32_t kind; // TypeKind
+    uint32_t nullable;
+    TypeShape shape;
+    // For arrays and vectors, the index of the type of their elements.
+    uint32_t element_type;
+    // For arrays, their element count. For vectors and strings, their bound,
+    // or UINT32_MAX if they have none.
+    uint32_t element_count;
+    // For primitives, their types::PrimitiveSubtype.
+    uint32_t subtype;
+    // For identifiers, the DeclKind of the declaration they name.
+    uint32_t decl_kind;
+    // For identifiers, the name of the declaration, as "library.name/Name".
+    String identifier;
+};
+
+// A member of a bits, enum, struct, table, union or extensible union.
+struct Member {
+    String name;
+    Range attributes;
+    // The index of the member's type, or kNone for the members of bits and
+    // enums and for reserved table members.
+    uint32_t type;
+    // For tables and extensible unions.
+    uint32_t ordinal;
+    // Whether a table member is reserved.
+    uint32_t reserved;
+    uint32_t padding;
+    // The value of a member of bits or an enum, or the default of a struct
+    // member.
+    Constant value;
+    // The member's shape, which for tables is that of its type, at offset 0.
+    FieldShape fieldshape;
+};
+
+enum MethodFlags : uint32_t {
+    kMethodHasRequest = 1u << 0,
+    kMethodHasResponse = 1u << 1,
+};
+
+struct Method {
+    String name;
+    Range attributes;
+    uint32_t ordinal;
+    uint32_t generated_ordinal;
+    uint32_t flags; // MethodFlags
+    // The indices of the anonymous structs of the request and response, if
+    // the method has them and they are declared by this library, or kNone.
+    uint32_t request;
+    uint32_t response;
+    uint32_t reserved;
+    // The protocol that declares the method, as "library.name/Name", which
+    // is not this one for methods it composes.
+    String owner;
+};
+
+enum DeclFlags : uint32_t {
+    kDeclAnonymous = 1u << 0,
+    kDeclRecursive = 1u << 1,
+};
+
+struct Decl {
+    uint32_t kind; // DeclKind
+    uint32_t flags; // DeclFlags
+    // Not qualified with the library's name.
+    String name;
+    Range attributes;
+    // Of every declaration but consts.
+    TypeShape typeshape;
+    // The index of the type of a const, or of the subtype of bits or an enum,
+    // or kNone.
+    uint32_t type;
+    // The position of the declaration among those of its kind in the
+    // source, which is the order in which the JSON IR lists them.
+    uint32_t source_index;
+    // The value of a const.
+    Constant value;
+    // The mask of bits.
+    uint64_t mask;
+    // Members, or for protocols, Methods: all of them, including those that
+    // they compose.
+    Range members;
+    // For protocols, the names of those that they compose, as
+    // "library.name/Name".
+    Range superinterfaces;
+    // For unions, the shape of the members after the tag.
+    FieldShape membershape;
+};
+
+// An entry of the index of declarations, which is sorted by the size of
+// |name| and then by its bytes.
+struct IndexEntry {
+    String name;
+    uint32_t decl;
+    uint32_t reserved;
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    // Of the whole file.
+    uint32_t size;
+    uint32_t reserved;
+    // The library's name, as "library.name".
+    String name;
+    // The names of the libraries it depends on, in |names|.
+    Range dependencies;
+    // The library's attributes, in |attributes|.
+    Range library_attributes;
+
+    // The tables, by offset in the file and number of records. |strings|
+    // holds a number of bytes rather than of records.
+    Range decls; // Decl, in declaration order.
+    Range index; // IndexEntry
+    Range types; // Type
+    Range members; // Member
+    Range methods; // Method
+    Range attributes; // Attribute
+    Range names; // String
+    Range strings; // char
+};
+
+static_assert(sizeof(Constant) == 40u, "Constant must not have implicit padding");
+static_assert(sizeof(Type) == 56u, "Type must not have implicit padding");
+static_assert(sizeof(Member) == 104u, "Member must not have implicit padding");
+static_assert(sizeof(Method) == 48u, "Method must not have implicit padding");
+static_assert(sizeof(Decl) == 152u, "Decl must not have implicit padding");
+static_assert(sizeof(Header) == 104u, "Header must not have implicit padding");
+
+} // namespace ir
+} // namespace fidl
+
+#endif // BINARY_IR_H_
@@ -0,0 +1,450 @@
+#include "binary_ir_generator.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <type_traits>
+
+#include "names.h"
+
+namespace fidl {
+
+namespace {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "the binary IR is written in the host's byte order, which must be little-endian");
+
+static_assert(static_cast<uint32_t>(flat::Decl::Kind::kXUnion) ==
+                  static_cast<uint32_t>(ir::DeclKind::kXUnion),
+              "ir::DeclKind must match flat::Decl::Kind");
+static_assert(static_cast<uint32_t>(flat::Type::Kind::kIdentifier) ==
+                  static_cast<uint32_t>(ir::TypeKind::kIdentifier),
+              "ir::TypeKind must match flat::Type::Kind");
+static_assert(static_cast<uint32_t>(flat::ConstantValue::Kind::kString) ==
+                  static_cast<uint32_t>(ir::ValueKind::kString),
+              "ir::ValueKind must match flat::ConstantValue::Kind");
+
+constexpr uint32_t kAlignment = 8u;
+
+uint32_t Align(uint32_t offset) {
+    return (offset + kAlignment - 1u) & ~(kAlignment - 1u);
+}
+
+template <typename ValueType>
+uint64_t NumericValue(const flat::ConstantValue& value) {
+    ValueType number = static_cast<const flat::NumericConstantValue<ValueType>&>(value).value;
+    if (std::is_floating_point<ValueType>::value) {
+        double as_double = static_cast<double>(number);
+        uint64_t bits;
+        memcpy(&bits, &as_double, sizeof(bits));
+        return bits;
+    }
+    if (std::is_signed<ValueType>::value)
+        return static_cast<uint64_t>(static_cast<int64_t>(number));
+    return static_cast<uint64_t>(number);
+}
+
+// Appends |records| to |contents| at the next aligned offset, and returns
+// where they are.
+template <typename Record>
+ir::Range AppendTable(const std::vector<Record>& records, std::string* contents) {
+    contents->resize(Align(static_cast<uint32_t>(contents->size())), '\0');
+    ir::Range range{static_cast<uint32_t>(contents->size()),
+                    static_cast<uint32_t>(records.size())};
+    contents->append(reinterpret_cast<const char*>(records.data()),
+                     records.size() * sizeof(Record));
+    return range;
+}
+
+} // namespace
+
+ir::String BinaryIRGenerator::String(StringView value) {
+    std::string key(value);
+    auto iter = string_offsets_.find(key);
+    if (iter != string_offsets_.end())
+        return iter->second;
+    ir::String string{static_cast<uint32_t>(strings_.size()), static_cast<uint32_t>(value.size())};
+    strings_.append(value.data(), value.size());
+    strings_.push_back('\0');
+    string_offsets_.emplace(std::move(key), string);
+    return string;
+}
+
+ir::Range BinaryIRGenerator::Attributes(const raw::AttributeList* attributes) {
+    ir::Range range{static_cast<uint32_t>(attributes_.size()), 0u};
+    if (attributes == nullptr)
+        return range;
+    for (const auto& attribute : attributes->attributes) {
+        attributes_.push_back(ir::Attribute{String(attribute->name), String(attribute->value)});
+        ++range.count;
+    }
+    return range;
+}
+
+ir::TypeShape BinaryIRGenerator::Shape(const TypeShape& typeshape) {
+    return ir::TypeShape{
+        typeshape.Size(),
+        typeshape.Alignment(),
+        typeshape.Depth(),
+        typeshape.MaxHandles(),
+        typeshape.MaxOutOfLine(),
+        typeshape.HasPadding() ? 1u : 0u,
+    };
+}
+
+ir::FieldShape BinaryIRGenerator::Shape(const FieldShape& fieldshape) {
+    return ir::FieldShape{Shape(fieldshape.Typeshape()), fieldshape.Offset(), fieldshape.Padding()};
+}
+
+ir::Constant BinaryIRGenerator::Constant(const flat::Constant* constant) {
+    ir::Constant result = {};
+    if (constant == nullptr)
+        return result;
+
+    switch (constant->kind) {
+    case flat::Constant::Kind::kIdentifier: {
+        auto identifier = static_cast<const flat::IdentifierConstant*>(constant);
+        result.kind = static_cast<uint32_t>(ir::ConstantKind::kIdentifier);
+        result.expression = String(NameName(identifier->name, ".", "/"));
+        break;
+    }
+    case flat::Constant::Kind::kLiteral: {
+        auto literal = static_cast<const flat::LiteralConstant*>(constant);
+        result.kind = static_cast<uint32_t>(ir::ConstantKind::kLiteral);
+        result.expression = String(literal->literal->location().data());
+        result.literal_kind = static_cast<uint32_t>(literal->literal->kind);
+        break;
+    }
+    case flat::Constant::Kind::kSynthesized:
+        result.kind = static_cast<uint32_t>(ir::ConstantKind::kSynthesized);
+        break;
+    }
+
+    if (!constant->IsResolved())
+        return result;
+    const flat::ConstantValue& value = constant->Value();
+    result.value_kind = static_cast<uint32_t>(value.kind);
+    switch (value.kind) {
+    case flat::ConstantValue::Kind::kInt8:
+        result.value = NumericValue<int8_t>(value);
+        break;
+    case flat::ConstantValue::Kind::kInt16:
+        result.value = NumericValue<int16_t>(value);
+        break;
+    case flat::ConstantValue::Kind::kInt32:
+        result.value = NumericValue<int32_t>(value);
+        break;
+    case flat::ConstantValue::Kind::kInt64:
+        result.value = NumericValue<int64_t>(value);
+        break;
+    case flat::ConstantValue::Kind::kUint8:
+        result.value = NumericValue<uint8_t>(value);
+        break;
+    case flat::ConstantValue::Kind::kUint16:
+        result.value = NumericValue<uint16_t>(value);
+        break;
+    case flat::ConstantValue::Kind::kUint32:
+        result.value = NumericValue<uint32_t>(value);
+        break;
+    case flat::ConstantValue::Kind::kUint64:
+        result.value = NumericValue<uint64_t>(value);
+        break;
+    case flat::ConstantValue::Kind::kFloat32:
+        result.value = NumericValue<float>(value);
+        break;
+    case flat::ConstantValue::Kind::kFloat64:
+        result.value = NumericValue<double>(value);
+        break;
+    case flat::ConstantValue::Kind::kBool:
+        result.value = static_cast<const flat::BoolConstantValue&>(value).value ? 1u : 0u;
+        break;
+    case flat::ConstantValue::Kind::kString:
+        result.string = String(static_cast<const flat::StringConstantValue&>(value).value);
+        break;
+    }
+    return result;
+}
+
+uint32_t BinaryIRGenerator::Type(const flat::Type* type) {
+    if (type == nullptr)
+        return ir::kNone;
+    auto iter = type_indices_.find(type);
+    if (iter != type_indices_.end())
+        return iter->second;
+
+    ir::Type result = {};
+    result.kind = static_cast<uint32_t>(type->kind);
+    result.nullable = type->nullability == types::Nullability::kNullable ? 1u : 0u;
+    result.shape = Shape(type->shape);
+    result.element_type = ir::kNone;
+    result.element_count = ir::kNone;
+    switch (type->kind) {
+    case flat::Type::Kind::kArray: {
+        auto array_type = static_cast<const flat::ArrayType*>(type);
+        result.element_type = Type(array_type->element_type);
+        result.element_count = array_type->element_count->value;
+        break;
+    }
+    case flat::Type::Kind::kVector: {
+        auto vector_type = static_cast<const flat::VectorType*>(type);
+        result.element_type = Type(vector_type->element_type);
+        result.element_count = vector_type->element_count->value;
+        break;
+    }
+    case flat::Type::Kind::kString: {
+        auto string_type = static_cast<const flat::StringType*>(type);
+        result.element_count = string_type->max_size->value;
+        break;
+    }
+    case flat::Type::Kind::kHandle:
+        break;
+    case flat::Type::Kind::kPrimitive: {
+        auto primitive_type = static_cast<const flat::PrimitiveType*>(type);
+        result.subtype = static_cast<uint32_t>(primitive_type->subtype);
+        break;
+    }
+    case flat::Type::Kind::kIdentifier: {
+        auto identifier_type = static_cast<const flat::IdentifierType*>(type);
+        result.decl_kind = static_cast<uint32_t>(identifier_type->type_decl->kind);
+        result.identifier = String(NameName(identifier_type->name, ".", "/"));
+        break;
+    }
+    }
+
+    // After the type of its elements, which was added above.
+    uint32_t index = static_cast<uint32_t>(types_.size());
+    types_.push_back(result);
+    type_indices_.emplace(type, index);
+    return index;
+}
+
+ir::Member BinaryIRGenerator::Member(StringView name, const raw::AttributeList* attributes,
+                                     const flat::Type* type) {
+    ir::Member result = {};
+    result.name = String(name);
+    result.attributes = Attributes(attributes);
+    result.type = Type(type);
+    return result;
+}
+
+ir::Range BinaryIRGenerator::Members(const flat::Decl* decl) {
+    // Members add attributes and types of their own, so they are all built
+    // before any is added, to keep them together.
+    std::vector<ir::Member> members;
+    switch (decl->kind) {
+    case flat::Decl::Kind::kBits:
+        for (const auto& member : static_cast<const flat::Bits*>(decl)->members) {
+            members.push_back(Member(member.name.data(), member.attributes.get(), nullptr));
+            members.back().value = Constant(member.value.get());
+        }
+        break;
+    case flat::Decl::Kind::kEnum:
+        for (const auto& member : static_cast<const flat::Enum*>(decl)->members) {
+            members.push_back(Member(member.name.data(), member.attributes.get(), nullptr));
+            members.back().value = Constant(member.value.get());
+        }
+        break;
+    case flat::Decl::Kind::kStruct:
+        for (const auto& member : static_cast<const flat::Struct*>(decl)->members) {
+            members.push_back(Member(member.name.data(), member.attributes.get(),
+                                     member.type_ctor->type));
+            members.back().value = Constant(member.maybe_default_value.get());
+            members.back().fieldshape = Shape(member.fieldshape);
+        }
+        break;
+    case flat::Decl::Kind::kTable:
+        for (const auto& member : static_cast<const flat::Table*>(decl)->members) {
+            if (member.maybe_used) {
+                const auto& used = *member.maybe_used;
+                members.push_back(Member(used.name.data(), used.attributes.get(),
+                                         used.type_ctor->type));
+                members.back().value = Constant(used.maybe_default_value.get());
+                members.back().fieldshape = Shape(FieldShape(used.typeshape));
+            } else {
+                members.push_back(Member(StringView(), nullptr, nullptr));
+                members.back().reserved = 1u;
+            }
+            members.back().ordinal = member.ordinal->value;
+        }
+        break;
+    case flat::Decl::Kind::kUnion:
+        for (const auto& member : static_cast<const flat::Union*>(decl)->members) {
+            members.push_back(Member(member.name.data(), member.attributes.get(),
+                                     member.type_ctor->type));
+            members.back().fieldshape = Shape(member.fieldshape);
+        }
+        break;
+    case flat::Decl::Kind::kXUnion:
+        for (const auto& member : static_cast<const flat::XUnion*>(decl)->members) {
+            members.push_back(Member(member.name.data(), member.attributes.get(),
+                                     member.type_ctor->type));
+            members.back().ordinal = member.ordinal->value;
+            members.back().fieldshape = Shape(member.fieldshape);
+        }
+        break;
+    case flat::Decl::Kind::kConst:
+    case flat::Decl::Kind::kInterface:
+        break;
+    }
+
+    ir::Range range{static_cast<uint32_t>(members_.size()), static_cast<uint32_t>(members.size())};
+    members_.insert(members_.end(), members.begin(), members.end());
+    return range;
+}
+
+ir::Range BinaryIRGenerator::Methods(const flat::Interface& interface) {
+    std::vector<ir::Method> methods;
+    for (const flat::Interface::Method* method : interface.all_methods) {
+        ir::Method result = {};
+        result.name = String(method->name.data());
+        result.attributes = Attributes(method->attributes.get());
+        result.ordinal = method->ordinal->value;
+        result.generated_ordinal = method->generated_ordinal->value;
+        result.request = ir::kNone;
+        result.response = ir::kNone;
+        if (method->maybe_request != nullptr) {
+            result.flags |= ir::kMethodHasRequest;
+            auto iter = decl_indices_.find(method->maybe_request);
+            if (iter != decl_indices_.end())
+                result.request = iter->second;
+        }
+        if (method->maybe_response != nullptr) {
+            result.flags |= ir::kMethodHasResponse;
+            auto iter = decl_indices_.find(method->maybe_response);
+            if (iter != decl_indices_.end())
+                result.response = iter->second;
+        }
+        result.owner = String(NameName(method->owning_interface->name, ".", "/"));
+        methods.push_back(result);
+    }
+
+    ir::Range range{static_cast<uint32_t>(methods_.size()), static_cast<uint32_t>(methods.size())};
+    methods_.insert(methods_.end(), methods.begin(), methods.end());
+    return range;
+}
+
+ir::Decl BinaryIRGenerator::Decl(const flat::Decl* decl) {
+    ir::Decl result = {};
+    result.kind = static_cast<uint32_t>(decl->kind);
+    result.name = String(decl->name.name_part());
+    result.attributes = Attributes(decl->attributes.get());
+    result.type = ir::kNone;
+
+    if (decl->kind == flat::Decl::Kind::kConst) {
+        auto const_decl = static_cast<const flat::Const*>(decl);
+        result.type = Type(const_decl->type_ctor->type);
+        result.value = Constant(const_decl->value.get());
+        return result;
+    }
+
+    auto type_decl = static_cast<const flat::TypeDecl*>(decl);
+    result.typeshape = Shape(type_decl->typeshape);
+    if (type_decl->recursive)
+        result.flags |= ir::kDeclRecursive;
+
+    switch (decl->kind) {
+    case flat::Decl::Kind::kBits: {
+        auto bits_decl = static_cast<const flat::Bits*>(decl);
+        result.type = Type(bits_decl->subtype_ctor->type);
+        result.mask = bits_decl->mask;
+        break;
+    }
+    case flat::Decl::Kind::kEnum:
+        result.type = Type(static_cast<const flat::Enum*>(decl)->type);
+        break;
+    case flat::Decl::Kind::kInterface: {
+        auto interface_decl = static_cast<const flat::Interface*>(decl);
+        result.members = Methods(*interface_decl);
+        result.superinterfaces.first = static_cast<uint32_t>(names_.size());
+        for (const auto& superinterface : interface_decl->superinterfaces) {
+            names_.push_back(String(NameName(superinterface, ".", "/")));
+            ++result.superinterfaces.count;
+        }
+        return result;
+    }
+    case flat::Decl::Kind::kStruct:
+        if (static_cast<const flat::Struct*>(decl)->anonymous)
+            result.flags |= ir::kDeclAnonymous;
+        break;
+    case flat::Decl::Kind::kUnion:
+        result.membershape = Shape(static_cast<const flat::Union*>(decl)->membershape);
+        break;
+    case flat::Decl::Kind::kConst:
+    case flat::Decl::Kind::kTable:
+    case flat::Decl::Kind::kXUnion:
+        break;
+    }
+    result.members = Members(decl);
+    return result;
+}
+
+void BinaryIRGenerator::Produce(OutputSink* file) {
+    ir::Header header = {};
+    header.magic = ir::kMagic;
+    header.version = ir::kVersion;
+    header.name = String(LibraryName(library_, "."));
+
+    header.dependencies.first = static_cast<uint32_t>(names_.size());
+    for (const flat::Library* dependency : library_->dependencies()) {
+        names_.push_back(String(LibraryName(dependency, ".")));
+        ++header.dependencies.count;
+    }
+    header.library_attributes = Attributes(library_->attributes());
+
+    // Methods refer to their messages by index, so every declaration is
+    // numbered before any is written.
+    std::vector<const flat::Decl*> decls;
+    for (const flat::Decl* decl : library_->declaration_order_) {
+        if (decl->name.library() != library_)
+            continue;
+        decl_indices_.emplace(decl, static_cast<uint32_t>(decls.size()));
+        decls.push_back(decl);
+    }
+    std::map<const flat::Decl*, uint32_t> source_indices;
+    auto number = [&source_indices](const auto& declarations) {
+        uint32_t source_index = 0u;
+        for (const auto& decl : declarations)
+            source_indices.emplace(decl.get(), source_index++);
+    };
+    number(library_->bits_declarations_);
+    number(library_->const_declarations_);
+    number(library_->enum_declarations_);
+    number(library_->interface_declarations_);
+    number(library_->struct_declarations_);
+    number(library_->table_declarations_);
+    number(library_->union_declarations_);
+    number(library_->xunion_declarations_);
+    for (const flat::Decl* decl : decls) {
+        decls_.push_back(Decl(decl));
+        decls_.back().source_index = source_indices[decl];
+    }
+
+    std::vector<ir::IndexEntry> index;
+    for (uint32_t i = 0; i < decls_.size(); ++i)
+        index.push_back(ir::IndexEntry{decls_[i].name, i, 0u});
+    auto name = [this](const ir::String& string) {
+        return StringView(strings_.data() + string.offset, string.size);
+    };
+    std::sort(index.begin(), index.end(),
+              [&name](const ir::IndexEntry& a, const ir::IndexEntry& b) {
+                  return name(a.name) < name(b.name);
+              });
+
+    std::string contents(sizeof(ir::Header), '\0');
+    header.decls = AppendTable(decls_, &contents);
+    header.index = AppendTable(index, &contents);
+    header.types = AppendTable(types_, &contents);
+    header.members = AppendTable(members_, &contents);
+    header.methods = AppendTable(methods_, &contents);
+    header.attributes = AppendTable(attributes_, &contents);
+    header.names = AppendTable(names_, &contents);
+    header.strings = AppendTable(std::vector<char>(strings_.begin(), strings_.end()), &contents);
+    contents.resize(Align(static_cast<uint32_t>(contents.size())), '\0');
+    header.size = static_cast<uint32_t>(contents.size());
+    memcpy(&contents[0], &header, sizeof(header));
+
+    file->Append(contents.data(), contents.size());
+}
+
+} // namespace fidl
@@ -0,0 +1,58 @@
+#ifndef BINARY_IR_GENERATOR_H_
+#define BINARY_IR_GENERATOR_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "binary_ir.h"
+#include "flat_ast.h"
+#include "output_sink.h"
+#include "string_view.h"
+
+namespace fidl {
+
+// Writes a library in the binary intermediate representation of
+// binary_ir.h, from the same declarations as JSONGenerator.
+class BinaryIRGenerator {
+public:
+    explicit BinaryIRGenerator(const flat::Library* library)
+        : library_(library) {}
+
+    ~BinaryIRGenerator() = default;
+
+    void Produce(OutputSink* file);
+
+private:
+    ir::String String(StringView value);
+    ir::Range Attributes(const raw::AttributeList* attributes);
+    ir::TypeShape Shape(const TypeShape& typeshape);
+    ir::FieldShape Shape(const FieldShape& fieldshape);
+    ir::Constant Constant(const flat::Constant* constant);
+    uint32_t Type(const flat::Type* type);
+
+    ir::Member Member(StringView name, const raw::AttributeList* attributes,
+                      const flat::Type* type);
+    ir::Range Members(const flat::Decl* decl);
+    ir::Range Methods(const flat::Interface& interface);
+    ir::Decl Decl(const flat::Decl* decl);
+
+    const flat::Library* library_;
+
+    // The tables, in the order that records are added to them.
+    std::vector<ir::Decl> decls_;
+    std::vector<ir::Type> types_;
+    std::vector<ir::Member> members_;
+    std::vector<ir::Method> methods_;
+    std::vector<ir::Attribute> attributes_;
+    std::vector<ir::String> names_;
+    std::string strings_;
+
+    std::map<std::string, ir::String> string_offsets_;
+    std::map<const flat::Type*, uint32_t> type_indices_;
+    std::map<const flat::Decl*, uint32_t> decl_indices_;
+};
+
+} // namespace fidl
+
+#endif // BINARY_IR_GENERATOR_H_
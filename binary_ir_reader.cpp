@@ -0,0 +1,173 @@
+#include "binary_ir_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace fidl {
+namespace ir {
+
+namespace {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "the binary IR is read in the host's byte order, which must be little-endian");
+
+// Whether the |table| of |record_size| byte records lies within |size| bytes
+// of a file, at an aligned offset.
+bool TableFits(Range table, size_t record_size, size_t size) {
+    if (table.first % 8u != 0u || table.first > size)
+        return false;
+    return table.count <= (size - table.first) / record_size;
+}
+
+} // namespace
+
+Reader::~Reader() {
+    if (mapping_ != nullptr)
+        munmap(mapping_, mapping_size_);
+}
+
+bool Reader::Open(const std::string& path, std::string* out_error) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        *out_error = "Couldn't open " + path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        *out_error = "Couldn't stat " + path + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(Header)) {
+        *out_error = path + " is too small to be a binary IR";
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        *out_error = "Couldn't map " + path + ": " + strerror(errno);
+        return false;
+    }
+    if (mapping_ != nullptr)
+        munmap(mapping_, mapping_size_);
+    mapping_ = mapping;
+    mapping_size_ = size;
+    if (!Init(mapping, size, out_error)) {
+        *out_error = path + ": " + *out_error;
+        return false;
+    }
+    return true;
+}
+
+bool Reader::Init(const void* data, size_t size, std::string* out_error) {
+    header_ = nullptr;
+    if (reinterpret_cast<uintptr_t>(data) % 8u != 0u) {
+        *out_error = "binary IR is not aligned";
+        return false;
+    }
+    if (size < sizeof(Header)) {
+        *out_error = "binary IR is truncated";
+        return false;
+    }
+    auto header = static_cast<const Header*>(data);
+    if (header->magic != kMagic) {
+        *out_error = "not a binary IR";
+        return false;
+    }
+    if (header->version != kVersion) {
+        *out_error = "unsupported binary IR version " + std::to_string(header->version);
+        return false;
+    }
+    if (header->size > size) {
+        *out_error = "binary IR is truncated";
+        return false;
+    }
+    size = header->size;
+    if (!TableFits(header->decls, sizeof(Decl), size) ||
+        !TableFits(header->index, sizeof(IndexEntry), size) ||
+        !TableFits(header->types, sizeof(Type), size) ||
+        !TableFits(header->members, sizeof(Member), size) ||
+        !TableFits(header->methods, sizeof(Method), size) ||
+        !TableFits(header->attributes, sizeof(Attribute), size) ||
+        !TableFits(header->names, sizeof(String), size) ||
+        !TableFits(header->strings, 1u, size)) {
+        *out_error = "binary IR has a table out of bounds";
+        return false;
+    }
+
+    data_ = static_cast<const char*>(data);
+    size_ = size;
+    header_ = header;
+    return true;
+}
+
+StringView Reader::GetString(String string) const {
+    const Range& strings = header_->strings;
+    // Each string is followed by a NUL, which must be in bounds too.
+    if (string.offset >= strings.count || string.size >= strings.count - string.offset)
+        return StringView();
+    const char* data = data_ + strings.first + string.offset;
+    if (data[string.size] != '\0')
+        return StringView();
+    return StringView(data, string.size);
+}
+
+const Decl* Reader::FindDecl(StringView name) const {
+    Span<IndexEntry> index = Table<IndexEntry>(header_->index);
+    auto entry = std::lower_bound(
+        index.begin(), index.end(), name,
+        [this](const IndexEntry& entry, StringView name) { return GetString(entry.name) < name; });
+    if (entry == index.end() || GetString(entry->name) != name)
+        return nullptr;
+    return GetDecl(entry->decl);
+}
+
+const Decl* Reader::GetDecl(uint32_t index) const {
+    Span<Decl> all = decls();
+    if (index >= all.size())
+        return nullptr;
+    return &all[index];
+}
+
+const Type* Reader::GetType(uint32_t index) const {
+    Span<Type> types = Table<Type>(header_->types);
+    if (index >= types.size())
+        return nullptr;
+    return &types[index];
+}
+
+Span<Member> Reader::GetMembers(const Decl& decl) const {
+    switch (static_cast<DeclKind>(decl.kind)) {
+    case DeclKind::kConst:
+    case DeclKind::kInterface:
+        return Span<Member>();
+    default:
+        return Slice<Member>(header_->members, decl.members);
+    }
+}
+
+Span<Method> Reader::GetMethods(const Decl& decl) const {
+    if (static_cast<DeclKind>(decl.kind) != DeclKind::kInterface)
+        return Span<Method>();
+    return Slice<Method>(header_->methods, decl.members);
+}
+
+Span<Attribute> Reader::GetAttributes(Range range) const {
+    return Slice<Attribute>(header_->attributes, range);
+}
+
+Span<String> Reader::GetNames(Range range) const {
+    return Slice<String>(header_->names, range);
+}
+
+} // namespace ir
+} // namespace fidl
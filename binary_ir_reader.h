@@ -0,0 +1,105 @@
+#ifndef BINARY_IR_READER_H_
+#define BINARY_IR_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "binary_ir.h"
+#include "string_view.h"
+
+namespace fidl {
+namespace ir {
+
+// |count| records of a table, read in place.
+template <typename Record>
+class Span {
+public:
+    Span() = default;
+    Span(const Record* data, uint32_t count)
+        : data_(data), count_(count) {}
+
+    const Record* begin() const { return data_; }
+    const Record* end() const { return data_ + count_; }
+    uint32_t size() const { return count_; }
+    bool empty() const { return count_ == 0u; }
+    const Record& operator[](uint32_t index) const { return data_[index]; }
+
+private:
+    const Record* data_ = nullptr;
+    uint32_t count_ = 0u;
+};
+
+// Reads a library in the binary intermediate representation, in place,
+// from a file that it maps into memory or from a buffer. Only the header and
+// the bounds of the tables are checked up front; every other record is
+// checked when it is looked up, and is never looked at otherwise, so opening
+// a library costs the same however large it is. Lookups of records that are
+// out of bounds return nothing, as if the records were empty.
+class Reader {
+public:
+    Reader() = default;
+    ~Reader();
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // Maps the file at |path| into memory and reads it. Returns false and
+    // sets |out_error| if it cannot, or if it is not a binary IR of a
+    // version that this reader understands.
+    bool Open(const std::string& path, std::string* out_error);
+    // Reads |size| bytes at |data|, which must outlive the reader and be
+    // 8-byte aligned.
+    bool Init(const void* data, size_t size, std::string* out_error);
+
+    StringView GetString(String string) const;
+
+    // As "library.name".
+    StringView library_name() const { return GetString(header_->name); }
+    Span<String> dependencies() const { return GetNames(header_->dependencies); }
+    Span<Attribute> library_attributes() const { return GetAttributes(header_->library_attributes); }
+
+    // In declaration order.
+    Span<Decl> decls() const { return Table<Decl>(header_->decls); }
+    // Returns the declaration named |name|, not qualified with the library's
+    // name, or null if there is none. Looks it up in the index, without
+    // reading any other declaration.
+    const Decl* FindDecl(StringView name) const;
+    // Returns the declaration at |index|, or null if there is none.
+    const Decl* GetDecl(uint32_t index) const;
+
+    // Returns the type at |index|, or null if there is none, as for kNone.
+    const Type* GetType(uint32_t index) const;
+    // Of bits, enums, structs, tables, unions and extensible unions.
+    Span<Member> GetMembers(const Decl& decl) const;
+    // Of protocols.
+    Span<Method> GetMethods(const Decl& decl) const;
+    Span<Attribute> GetAttributes(Range range) const;
+    Span<String> GetNames(Range range) const;
+
+private:
+    template <typename Record>
+    Span<Record> Table(Range table) const {
+        return Span<Record>(reinterpret_cast<const Record*>(data_ + table.first), table.count);
+    }
+
+    template <typename Record>
+    Span<Record> Slice(Range table, Range range) const {
+        if (range.first > table.count || range.count > table.count - range.first)
+            return Span<Record>();
+        return Span<Record>(Table<Record>(table).begin() + range.first, range.count);
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0u;
+    const Header* header_ = nullptr;
+    // Set when the reader mapped |data_| itself.
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0u;
+};
+
+} // namespace ir
+} // namespace fidl
+
+#endif // BINARY_IR_READER_H_
@@ -1,26 +1,46 @@
 #include "c_generator.h"
 
+#include <algorithm>
+#include <sstream>
+#include <string>
+
 #include "names.h"
+#include "utils.h"
 
 namespace fidl {
 
 namespace {
 
-class IOFlagsGuard {
-public:
-    explicit IOFlagsGuard(std::ostream* stream)
-        : stream_(stream), flags_(stream_->flags()) {}
-    ~IOFlagsGuard() {
-        stream_->setf(flags_);
-    }
-
-private:
-    std::ostream* stream_;
-    std::ios::fmtflags flags_;
-};
-
 constexpr const char* kIndent = "    ";
 
+// The size of fidl_message_header_t, which the typeshape of a message leaves
+// out.
+constexpr uint32_t kMessageHeaderSize = 16u;
+
+// The most out-of-line objects a request can have for the server to validate
+// it with a generated decoder when the bindings otherwise use coding tables.
+// Beyond that, the code size of a decoder outgrows the cost of walking the
+// table. The --c-coding help in main.cpp quotes this value.
+constexpr size_t kMaxInlineDecodedObjects = 4u;
+
+// The benchmarks of --c-bench fill vectors and strings to their bound, or
+// with this many elements when they have none, but with no more than
+// kBenchMaxOutOfLineBytes bytes of out-of-line objects in all.
+constexpr uint32_t kBenchUnboundedCount = 256u;
+constexpr uint32_t kBenchMaxOutOfLineBytes = 32768u;
+
+// Returns the size of the inline part of a message with |parameters|, which
+// sizeof() of its C struct agrees with: the message header, followed by the
+// parameters padded to 8 bytes. The typeshape of a message without parameters
+// has a size of 1, for the byte of an empty struct, which the message leaves
+// out.
+uint32_t MessageInlineSize(const std::vector<flat::Struct::Member>& parameters,
+                           const TypeShape& typeshape) {
+    if (parameters.empty())
+        return kMessageHeaderSize;
+    return (kMessageHeaderSize + typeshape.Size() + 7u) & ~7u;
+}
+
 CGenerator::Member MessageHeader() {
     return {
         flat::Type::Kind::kIdentifier,
@@ -53,31 +73,31 @@ CGenerator::Transport ParseTransport(StringView view) {
     return CGenerator::Transport::Channel;
 }
 
-void EmitFileComment(std::ostream* file) {
+void EmitFileComment(OutputSink* file) {
     *file << "// WARNING: This file is machine generated by fidlc.\n\n";
 }
 
-void EmitHeaderGuard(std::ostream* file) {
+void EmitHeaderGuard(OutputSink* file) {
     *file << "#pragma once\n";
 }
 
-void EmitIncludeHeader(std::ostream* file, StringView header) {
+void EmitIncludeHeader(OutputSink* file, StringView header) {
     *file << "#include " << std::string(header) << "\n";
 }
 
-void EmitBeginExternC(std::ostream* file) {
+void EmitBeginExternC(OutputSink* file) {
     *file << "#if defined(__cplusplus)\nextern \"C\" {\n#endif\n";
 }
 
-void EmitEndExternC(std::ostream* file) {
+void EmitEndExternC(OutputSink* file) {
     *file << "#if defined(__cplusplus)\n}\n#endif\n";
 }
 
-void EmitBlank(std::ostream* file) {
+void EmitBlank(OutputSink* file) {
     *file << "\n";
 }
 
-void EmitMethodInParamDecl(std::ostream* file, const CGenerator::Member& member) {
+void EmitMethodInParamDecl(OutputSink* file, const CGenerator::Member& member) {
     switch (member.kind) {
     case flat::Type::Kind::kArray:
         *file << "const " << member.type << " " << member.name;
@@ -87,11 +107,11 @@ void EmitMethodInParamDecl(std::ostream* file, const CGenerator::Member& member)
         break;
     case flat::Type::Kind::kVector:
         *file << "const " << member.element_type << "* " << member.name << "_data, "
-              << "size_t" << member.name << "_count";
+              << "size_t " << member.name << "_count";
         break;
     case flat::Type::Kind::kString:
         *file << "const char* " << member.name << "_data, "
-              << "size_t" << member.name << "_size";
+              << "size_t " << member.name << "_size";
         break;
     case flat::Type::Kind::kHandle:
     case flat::Type::Kind::kPrimitive:
@@ -107,10 +127,13 @@ void EmitMethodInParamDecl(std::ostream* file, const CGenerator::Member& member)
         case flat::Decl::Kind::kInterface:
             *file << member.type << " " << member.name;
             break;
-        case flat::Decl::Kind::kStruct:
         case flat::Decl::Kind::kTable:
-        case flat::Decl::Kind::kUnion:
         case flat::Decl::Kind::kXUnion:
+            // A null extensible union is absent.
+            *file << "const " << NameName(member.type_decl->name, "_", "_") << "* " << member.name;
+            break;
+        case flat::Decl::Kind::kStruct:
+        case flat::Decl::Kind::kUnion:
             switch (member.nullability) {
             case types::Nullability::kNullable:
                 *file << "const " << member.type << " " << member.name;
@@ -127,7 +150,7 @@ void EmitMethodInParamDecl(std::ostream* file, const CGenerator::Member& member)
 
 // prefixes the name with out_, except for vectors/strings, which instead of
 // having a data pointer + count, have a buffer pointer, _capacity, and out_count
-void EmitMethodOutParamDecl(std::ostream* file, const CGenerator::Member& member) {
+void EmitMethodOutParamDecl(OutputSink* file, const CGenerator::Member& member) {
     switch (member.kind) {
     case flat::Type::Kind::kArray:
         *file << member.type << " out_" << member.name;
@@ -159,10 +182,13 @@ void EmitMethodOutParamDecl(std::ostream* file, const CGenerator::Member& member
         case flat::Decl::Kind::kInterface:
             *file << member.type << "* out_" << member.name;
             break;
-        case flat::Decl::Kind::kStruct:
         case flat::Decl::Kind::kTable:
-        case flat::Decl::Kind::kUnion:
         case flat::Decl::Kind::kXUnion:
+            // An absent extensible union is copied out with a tag of 0.
+            *file << NameName(member.type_decl->name, "_", "_") << "* out_" << member.name;
+            break;
+        case flat::Decl::Kind::kStruct:
+        case flat::Decl::Kind::kUnion:
             switch (member.nullability) {
             case types::Nullability::kNullable:
                 *file << member.type << " out_" << member.name;
@@ -177,7 +203,7 @@ void EmitMethodOutParamDecl(std::ostream* file, const CGenerator::Member& member
     }
 }
 
-void EmitClientMethodDecl(std::ostream* file,
+void EmitClientMethodDecl(OutputSink* file,
                           StringView method_name,
                           const std::vector<CGenerator::Member>& request,
                           const std::vector<CGenerator::Member>& response) {
@@ -193,7 +219,107 @@ void EmitClientMethodDecl(std::ostream* file,
     *file << ")";
 }
 
-void EmitServerMethodDecl(std::ostream* file,
+// Declares the caller-allocating flavor of a client method, which builds the
+// request, and receives the response, in |_bytes| and |_handles| instead of
+// on the stack. The buffers can be reused from call to call.
+void EmitClientCallerAllocMethodDecl(OutputSink* file,
+                                     StringView method_name,
+                                     const std::vector<CGenerator::Member>& request,
+                                     const std::vector<CGenerator::Member>& response) {
+    *file << "zx_status_t " << std::string(method_name) << "_caller_alloc(zx_handle_t _channel"
+          << ", void* _bytes, uint32_t _bytes_capacity"
+          << ", zx_handle_t* _handles, uint32_t _handles_capacity";
+    for (const auto& member : request) {
+        *file << ", ";
+        EmitMethodInParamDecl(file, member);
+    }
+    for (auto member : response) {
+        *file << ", ";
+        EmitMethodOutParamDecl(file, member);
+    }
+    *file << ")";
+}
+
+// Declares the view-returning flavor of a client method, which decodes the
+// response in place in |_bytes| and points |out_response| at it, so that its
+// vectors and strings are read where they were received rather than copied
+// out.
+void EmitClientViewMethodDecl(OutputSink* file,
+                              StringView method_name,
+                              const std::vector<CGenerator::Member>& request,
+                              StringView response_name) {
+    *file << "zx_status_t " << std::string(method_name) << "_view(zx_handle_t _channel"
+          << ", void* _bytes, uint32_t _bytes_capacity"
+          << ", zx_handle_t* _handles, uint32_t _handles_capacity";
+    for (const auto& member : request) {
+        *file << ", ";
+        EmitMethodInParamDecl(file, member);
+    }
+    *file << ", " << std::string(response_name) << "** out_response)";
+}
+
+// Declares the asynchronous flavor of a two-way client method, which sends
+// the request with the transaction id |_txid| and returns without waiting for
+// the response, which the interface's _dispatch_responses function delivers.
+void EmitClientBeginMethodDecl(OutputSink* file,
+                               StringView method_name,
+                               const std::vector<CGenerator::Member>& request) {
+    *file << "zx_status_t " << std::string(method_name) << "_begin(zx_handle_t _channel"
+          << ", zx_txid_t _txid"
+          << ", void* _bytes, uint32_t _bytes_capacity"
+          << ", zx_handle_t* _handles, uint32_t _handles_capacity";
+    for (const auto& member : request) {
+        *file << ", ";
+        EmitMethodInParamDecl(file, member);
+    }
+    *file << ")";
+}
+
+// Declares the function that reads up to |max_responses| responses and events
+// from |_channel|, stopping early when none is left to read, and passes each
+// one, decoded in place in |_bytes|, to its method's callback.
+void EmitClientDispatchResponsesDecl(OutputSink* file, StringView interface_name) {
+    *file << "zx_status_t " << std::string(interface_name)
+          << "_dispatch_responses(zx_handle_t _channel"
+          << ", void* _bytes, uint32_t _bytes_capacity"
+          << ", zx_handle_t* _handles, uint32_t _handles_capacity"
+          << ", size_t max_responses, const " << std::string(interface_name)
+          << "_callbacks_t* callbacks, void* ctx, size_t* out_num_responses)";
+}
+
+// Emits the names of the parameters that EmitMethodInParamDecl() declares.
+void EmitMethodInParamNames(OutputSink* file, const CGenerator::Member& member) {
+    switch (member.kind) {
+    case flat::Type::Kind::kVector:
+        *file << member.name << "_data, " << member.name << "_count";
+        break;
+    case flat::Type::Kind::kString:
+        *file << member.name << "_data, " << member.name << "_size";
+        break;
+    default:
+        *file << member.name;
+        break;
+    }
+}
+
+// Emits the names of the parameters that EmitMethodOutParamDecl() declares.
+void EmitMethodOutParamNames(OutputSink* file, const CGenerator::Member& member) {
+    switch (member.kind) {
+    case flat::Type::Kind::kVector:
+        *file << member.name << "_buffer, " << member.name << "_capacity, out_"
+              << member.name << "_count";
+        break;
+    case flat::Type::Kind::kString:
+        *file << member.name << "_buffer, " << member.name << "_capacity, out_"
+              << member.name << "_size";
+        break;
+    default:
+        *file << "out_" << member.name;
+        break;
+    }
+}
+
+void EmitServerMethodDecl(OutputSink* file,
                           StringView method_name,
                           const std::vector<CGenerator::Member>& request,
                           bool has_response) {
@@ -208,19 +334,19 @@ void EmitServerMethodDecl(std::ostream* file,
     *file << ")";
 }
 
-void EmitServerDispatchDecl(std::ostream* file, StringView interface_name) {
+void EmitServerDispatchDecl(OutputSink* file, StringView interface_name) {
     *file << "zx_status_t " << std::string(interface_name)
           << "_dispatch(void* ctx, fidl_txn_t* txn, fidl_msg_t* msg, const "
           << std::string(interface_name) << "_ops_t* ops)";
 }
 
-void EmitServerTryDispatchDecl(std::ostream* file, StringView interface_name) {
+void EmitServerTryDispatchDecl(OutputSink* file, StringView interface_name) {
     *file << "zx_status_t " << std::string(interface_name)
           << "_try_dispatch(void* ctx, fidl_txn_t* txn, fidl_msg_t* msg, const "
           << std::string(interface_name) << "_ops_t* ops)";
 }
 
-void EmitServerReplyDecl(std::ostream* file,
+void EmitServerReplyDecl(OutputSink* file,
                          StringView method_name,
                          const std::vector<CGenerator::Member>& response) {
     *file << "zx_status_t " << std::string(method_name) << "_reply(fidl_txn_t* _txn";
@@ -231,6 +357,100 @@ void EmitServerReplyDecl(std::ostream* file,
     *file << ")";
 }
 
+// Whether |member| is a table or an extensible union, which messages carry
+// in envelopes, and method parameters as the C structs that the header
+// declares for them.
+bool IsEnvelopeContainer(const CGenerator::Member& member) {
+    return member.kind == flat::Type::Kind::kIdentifier &&
+           (member.decl_kind == flat::Decl::Kind::kTable ||
+            member.decl_kind == flat::Decl::Kind::kXUnion);
+}
+
+// A member of a table or extensible union that the simple bindings carry,
+// and which therefore has no out-of-line objects of its own.
+struct EnvelopeMember {
+    uint32_t ordinal;
+    std::string name;
+    const flat::Type* type;
+    uint32_t size;
+    // The size of the envelope's contents: the member padded to 8 bytes.
+    uint32_t num_bytes;
+    // What identifies the member in the C struct: the presence bit of a
+    // table member, or the tag of an extensible union member.
+    std::string selector;
+};
+
+std::string PresenceBit(uint32_t ordinal) {
+    return "((uint64_t)1u << " + std::to_string(ordinal - 1u) + ")";
+}
+
+std::vector<EnvelopeMember> EnvelopeMembers(const flat::TypeDecl* decl) {
+    std::vector<EnvelopeMember> members;
+    auto add = [&members](uint32_t ordinal, const SourceLocation& name, const flat::Type* type,
+                          const TypeShape& typeshape, std::string selector) {
+        members.push_back(EnvelopeMember{
+            ordinal,
+            NameIdentifier(name),
+            type,
+            typeshape.Size(),
+            (typeshape.Size() + 7u) & ~7u,
+            std::move(selector),
+        });
+    };
+    switch (decl->kind) {
+    case flat::Decl::Kind::kTable:
+        for (const auto& member : static_cast<const flat::Table*>(decl)->members) {
+            if (!member.maybe_used)
+                continue;
+            const auto& used = *member.maybe_used;
+            add(member.ordinal->value, used.name, used.type_ctor->type, used.typeshape,
+                PresenceBit(member.ordinal->value));
+        }
+        break;
+    case flat::Decl::Kind::kXUnion: {
+        std::string xunion_name = NameName(decl->name, "_", "_");
+        for (const auto& member : static_cast<const flat::XUnion*>(decl)->members) {
+            add(member.ordinal->value, member.name, member.type_ctor->type,
+                member.fieldshape.Typeshape(), NameXUnionTag(xunion_name, member));
+        }
+        break;
+    }
+    default:
+        assert(false && "only tables and extensible unions have envelopes");
+        break;
+    }
+    return members;
+}
+
+// The bits of the presence bitmap of a table that stand for its members.
+std::string PresenceMask(const std::vector<EnvelopeMember>& members) {
+    uint64_t mask = 0u;
+    for (const auto& member : members)
+        mask |= uint64_t(1u) << (member.ordinal - 1u);
+    std::ostringstream literal;
+    literal << "UINT64_C(0x" << std::hex << mask << ")";
+    return literal.str();
+}
+
+// The most out-of-line bytes that a table or extensible union takes up: an
+// envelope for each ordinal of a table up to the highest, and the contents
+// of all its members, or of an extensible union's largest.
+uint32_t MaxEnvelopesSize(const flat::TypeDecl* decl) {
+    uint32_t size = 0u;
+    if (decl->kind == flat::Decl::Kind::kTable) {
+        uint32_t max_ordinal = 0u;
+        for (const auto& member : static_cast<const flat::Table*>(decl)->members)
+            max_ordinal = std::max(max_ordinal, member.ordinal->value);
+        size = max_ordinal * 16u;
+        for (const auto& member : EnvelopeMembers(decl))
+            size += member.num_bytes;
+    } else {
+        for (const auto& member : EnvelopeMembers(decl))
+            size = std::max(size, member.num_bytes);
+    }
+    return size;
+}
+
 bool IsStoredOutOfLine(const CGenerator::Member& member) {
     if (member.kind == flat::Type::Kind::kVector ||
         member.kind == flat::Type::Kind::kString)
@@ -246,19 +466,47 @@ bool IsStoredOutOfLine(const CGenerator::Member& member) {
     return false;
 }
 
-void EmitMeasureInParams(std::ostream* file,
+// Emits the size of the out-of-line objects of the table or extensible union
+// |member|: the envelopes of a table up to its highest present member, and
+// the contents of those that are present.
+void EmitMeasureEnvelopes(OutputSink* file, const CGenerator::Member& member) {
+    const auto& name = member.name;
+    auto members = EnvelopeMembers(member.type_decl);
+    if (member.decl_kind == flat::Decl::Kind::kTable) {
+        std::string present = "(" + name + "->_present & " + PresenceMask(members) + ")";
+        *file << " + (" << present << " ? sizeof(fidl_envelope_t) * (64u - __builtin_clzll("
+              << present << ")) : 0u)";
+        for (const auto& envelope_member : members) {
+            *file << " + ((" << name << "->_present & " << envelope_member.selector << ") ? "
+                  << envelope_member.num_bytes << "u : 0u)";
+        }
+        return;
+    }
+    *file << " + (";
+    if (member.nullability == types::Nullability::kNullable)
+        *file << name << " == NULL ? 0u : ";
+    for (const auto& envelope_member : members) {
+        *file << name << "->tag == " << envelope_member.selector << " ? "
+              << envelope_member.num_bytes << "u : ";
+    }
+    *file << "0u)";
+}
+
+void EmitMeasureInParams(OutputSink* file,
                          const std::vector<CGenerator::Member>& params) {
     for (const auto& member : params) {
         if (member.kind == flat::Type::Kind::kVector)
             *file << " + FIDL_ALIGN(sizeof(*" << member.name << "_data) * " << member.name << "_count)";
         else if (member.kind == flat::Type::Kind::kString)
             *file << " + FIDL_ALIGN(" << member.name << "_size)";
+        else if (IsEnvelopeContainer(member))
+            EmitMeasureEnvelopes(file, member);
         else if (IsStoredOutOfLine(member))
             *file << " + (" << member.name << " ? FIDL_ALIGN(sizeof(*" << member.name << ")) : 0u)";
     }
 }
 
-void EmitParameterSizeValidation(std::ostream* file,
+void EmitParameterSizeValidation(OutputSink* file,
                                  const std::vector<CGenerator::Member>& params) {
     for (const auto& member : params) {
         if (member.max_num_elements == std::numeric_limits<uint32_t>::max())
@@ -278,19 +526,21 @@ void EmitParameterSizeValidation(std::ostream* file,
     }
 }
 
-void EmitMeasureOutParams(std::ostream* file,
+void EmitMeasureOutParams(OutputSink* file,
                           const std::vector<CGenerator::Member>& params) {
     for (const auto& member : params) {
         if (member.kind == flat::Type::Kind::kVector)
             *file << " + FIDL_ALIGN(sizeof(*" << member.name << "_buffer) * " << member.name << "_capacity)";
         else if (member.kind == flat::Type::Kind::kString)
             *file << " + FIDL_ALIGN(" << member.name << "_capacity)";
+        else if (IsEnvelopeContainer(member))
+            *file << " + " << MaxEnvelopesSize(member.type_decl) << "u";
         else if (IsStoredOutOfLine(member))
             *file << " + (out_" << member.name << " ? FIDL_ALIGN(sizeof(*out_" << member.name << ")) : 0u)";
     }
 }
 
-void EmitArraySizeOf(std::ostream* file,
+void EmitArraySizeOf(OutputSink* file,
                      const CGenerator::Member& member) {
     for (const auto c : member.array_counts) {
         *file << c;
@@ -310,10 +560,135 @@ size_t CountSecondaryObjects(const std::vector<CGenerator::Member>& params) {
     return count;
 }
 
-void EmitLinearizeMessage(std::ostream* file,
+// whether a message must go through fidl_encode()/fidl_decode(), as opposed
+// to being sent or received as plain bytes
+bool NeedsCoding(const std::vector<CGenerator::Member>& params,
+                 size_t hcount,
+                 const TypeShape& typeshape) {
+    return CountSecondaryObjects(params) > 0 || hcount > 0 || typeshape.HasPadding();
+}
+
+// Copies the member at |source| of a table or extensible union into the
+// next out-of-line object of the message at |bytes|, and points |envelope| at
+// it.
+void EmitCopyIntoEnvelope(OutputSink* file, const std::string& indent, const std::string& bytes,
+                          const std::string& envelope, const std::string& source,
+                          const EnvelopeMember& envelope_member, bool zero_padding) {
+    *file << indent << envelope << "num_bytes = " << envelope_member.num_bytes << "u;\n";
+    *file << indent << envelope << "data = &" << bytes << "[_next];\n";
+    *file << indent << "memcpy(" << envelope << "data, &" << source << ", sizeof(" << source
+          << "));\n";
+    if (zero_padding && envelope_member.num_bytes > envelope_member.size) {
+        *file << indent << "memset(&" << bytes << "[_next + " << envelope_member.size << "], 0, "
+              << envelope_member.num_bytes - envelope_member.size << ");\n";
+    }
+    *file << indent << "_next += " << envelope_member.num_bytes << "u;\n";
+}
+
+// Copies the C struct of the table or extensible union |member| into the
+// message, as envelopes that point at their contents. Only the members that
+// a table's presence bitmap has bits for are visited, and its envelopes are
+// counted from the highest one.
+void EmitLinearizeEnvelopes(OutputSink* file,
+                            const std::string& receiver,
+                            const std::string& bytes,
+                            const CGenerator::Member& member,
+                            bool zero_padding) {
+    const auto& name = member.name;
+    std::string wire = receiver + "->" + name;
+    auto members = EnvelopeMembers(member.type_decl);
+    if (member.decl_kind == flat::Decl::Kind::kTable) {
+        std::string present = "_" + name + "_present";
+        *file << kIndent << "uint64_t " << present << " = " << name << "->_present & "
+              << PresenceMask(members) << ";\n";
+        *file << kIndent << wire << ".count = " << present << " ? 64u - __builtin_clzll("
+              << present << ") : 0u;\n";
+        *file << kIndent << wire << ".envelopes = (fidl_envelope_t*)&" << bytes << "[_next];\n";
+        *file << kIndent << "memset(" << wire << ".envelopes, 0, sizeof(fidl_envelope_t) * "
+              << wire << ".count);\n";
+        *file << kIndent << "_next += (uint32_t)(sizeof(fidl_envelope_t) * " << wire
+              << ".count);\n";
+        for (const auto& envelope_member : members) {
+            *file << kIndent << "if (" << present << " & " << envelope_member.selector << ") {\n";
+            EmitCopyIntoEnvelope(file, std::string(kIndent) + kIndent, bytes,
+                                 wire + ".envelopes[" +
+                                     std::to_string(envelope_member.ordinal - 1u) + "].",
+                                 name + "->" + envelope_member.name, envelope_member,
+                                 zero_padding);
+            *file << kIndent << "}\n";
+        }
+        return;
+    }
+
+    std::string indent = kIndent;
+    if (member.nullability == types::Nullability::kNullable) {
+        *file << kIndent << "if (" << name << ") {\n";
+        indent += kIndent;
+    }
+    *file << indent << wire << ".tag = " << name << "->tag;\n";
+    *file << indent << wire << ".padding = 0u;\n";
+    *file << indent << wire << ".envelope.num_handles = 0u;\n";
+    *file << indent << "switch (" << name << "->tag) {\n";
+    for (const auto& envelope_member : members) {
+        *file << indent << "case " << envelope_member.selector << ":\n";
+        EmitCopyIntoEnvelope(file, indent + kIndent, bytes, wire + ".envelope.",
+                             name + "->" + envelope_member.name, envelope_member,
+                             zero_padding);
+        *file << indent << kIndent << "break;\n";
+    }
+    *file << indent << "default:\n";
+    *file << indent << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
+    *file << indent << "}\n";
+    if (member.nullability == types::Nullability::kNullable) {
+        *file << kIndent << "} else {\n";
+        *file << kIndent << kIndent << "memset(&" << wire << ", 0, sizeof(" << wire << "));\n";
+        *file << kIndent << "}\n";
+    }
+}
+
+// Copies the table or extensible union |member| out of the decoded message
+// |wire| into the C struct whose members |value| prefixes. Envelopes that the
+// C struct has no member for are never looked at.
+void EmitUnpackEnvelopes(OutputSink* file,
+                         const std::string& indent,
+                         const std::string& wire,
+                         const std::string& value,
+                         const CGenerator::Member& member) {
+    auto members = EnvelopeMembers(member.type_decl);
+    if (member.decl_kind == flat::Decl::Kind::kTable) {
+        *file << indent << value << "_present = 0u;\n";
+        for (const auto& envelope_member : members) {
+            std::string envelope =
+                wire + ".envelopes[" + std::to_string(envelope_member.ordinal - 1u) + "]";
+            *file << indent << "if (" << wire << ".count >= " << envelope_member.ordinal
+                  << "u && " << envelope << ".data != NULL) {\n";
+            *file << indent << kIndent << "memcpy(&" << value << envelope_member.name << ", "
+                  << envelope << ".data, sizeof(" << value << envelope_member.name << "));\n";
+            *file << indent << kIndent << value << "_present |= " << envelope_member.selector
+                  << ";\n";
+            *file << indent << "}\n";
+        }
+        return;
+    }
+    *file << indent << value << "tag = " << wire << ".tag;\n";
+    *file << indent << "switch (" << wire << ".tag) {\n";
+    for (const auto& envelope_member : members) {
+        *file << indent << "case " << envelope_member.selector << ":\n";
+        *file << indent << kIndent << "memcpy(&" << value << envelope_member.name << ", " << wire
+              << ".envelope.data, sizeof(" << value << envelope_member.name << "));\n";
+        *file << indent << kIndent << "break;\n";
+    }
+    *file << indent << "}\n";
+}
+
+// Copies |request| into the message at |bytes|. Unless |zero_padding| is set,
+// the message must have been zeroed beforehand; if it is, the padding that
+// aligns each out-of-line object is zeroed as the object is copied.
+void EmitLinearizeMessage(OutputSink* file,
                           std::string receiver,
                           std::string bytes,
-                          const std::vector<CGenerator::Member>& request) {
+                          const std::vector<CGenerator::Member>& request,
+                          bool zero_padding) {
     if (CountSecondaryObjects(request) > 0)
         *file << kIndent << "uint32_t _next = sizeof(*" << receiver << ");\n";
     for (const auto& member : request) {
@@ -329,11 +704,19 @@ void EmitLinearizeMessage(std::ostream* file,
             *file << kIndent << receiver << "->" << name << ".data = &" << bytes << "[_next];\n";
             *file << kIndent << receiver << "->" << name << ".count = " << name << "_count;\n";
             *file << kIndent << "memcpy(" << receiver << "->" << name << ".data, " << name << "_data, sizeof(*" << name << "_data) * " << name << "_count);\n";
+            if (zero_padding) {
+                *file << kIndent << "memset(&" << bytes << "[_next + sizeof(*" << name << "_data) * " << name << "_count], 0, "
+                      << "FIDL_ALIGN(sizeof(*" << name << "_data) * " << name << "_count) - sizeof(*" << name << "_data) * " << name << "_count);\n";
+            }
             *file << kIndent << "_next += FIDL_ALIGN(sizeof(*" << name << "_data) * " << name << "_count);\n";
             break;
         case flat::Type::Kind::kString:
             *file << kIndent << receiver << "->" << name << ".data = &" << bytes << "[_next];\n";
             *file << kIndent << receiver << "->" << name << ".size = " << name << "_size;\n";
+            if (zero_padding) {
+                *file << kIndent << "memset(&" << bytes << "[_next + " << name << "_size], 0, FIDL_ALIGN("
+                      << name << "_size) - " << name << "_size);\n";
+            }
             *file << kIndent << "_next += FIDL_ALIGN(" << name << "_size);\n";
             *file << kIndent << "if (" << name << "_data) {\n";
             *file << kIndent << kIndent << "memcpy(" << receiver << "->" << name << ".data, " << name << "_data, " << name << "_size);\n";
@@ -361,10 +744,8 @@ void EmitLinearizeMessage(std::ostream* file,
                 *file << kIndent << receiver << "->" << name << " = " << name << ";\n";
                 break;
             case flat::Decl::Kind::kTable:
-                assert(false && "c-codegen for tables not yet implemented");
-                break;
             case flat::Decl::Kind::kXUnion:
-                assert(false && "c-codegen for extensible unions not yet implemented");
+                EmitLinearizeEnvelopes(file, receiver, bytes, member, zero_padding);
                 break;
             case flat::Decl::Kind::kStruct:
             case flat::Decl::Kind::kUnion:
@@ -373,7 +754,11 @@ void EmitLinearizeMessage(std::ostream* file,
                     *file << kIndent << "if (" << name << ") {\n";
                     *file << kIndent << kIndent << receiver << "->" << name << " = (void*)&" << bytes << "[_next];\n";
                     *file << kIndent << kIndent << "memcpy(" << receiver << "->" << name << ", " << name << ", sizeof(*" << name << "));\n";
-                    *file << kIndent << kIndent << "_next += sizeof(*" << name << ");\n";
+                    if (zero_padding) {
+                        *file << kIndent << kIndent << "memset(&" << bytes << "[_next + sizeof(*" << name << ")], 0, FIDL_ALIGN(sizeof(*"
+                              << name << ")) - sizeof(*" << name << "));\n";
+                    }
+                    *file << kIndent << kIndent << "_next += FIDL_ALIGN(sizeof(*" << name << "));\n";
                     *file << kIndent << "} else {\n";
                     *file << kIndent << kIndent << receiver << "->" << name << " = NULL;\n";
                     *file << kIndent << "}\n";
@@ -388,7 +773,991 @@ void EmitLinearizeMessage(std::ostream* file,
     }
 }
 
-void EmitMemberDecl(std::ostream* file, const CGenerator::Member& member) {
+// Copies the parameters |params| of the decoded message at |receiver| out to
+// the out parameters that EmitMethodOutParamDecl() declares for them.
+void EmitCopyOutMessage(OutputSink* file, const std::string& receiver,
+                        const std::vector<CGenerator::Member>& params) {
+    for (const auto& member : params) {
+        const auto& name = member.name;
+        switch (member.kind) {
+        case flat::Type::Kind::kArray:
+            *file << kIndent << "memcpy(out_" << name << ", " << receiver << "->" << name << ", ";
+            EmitArraySizeOf(file, member);
+            *file << ");\n";
+            break;
+        case flat::Type::Kind::kVector:
+            *file << kIndent << "memcpy(" << name << "_buffer, " << receiver << "->" << name << ".data, sizeof(*" << name << "_buffer) * " << receiver << "->" << name << ".count);\n";
+            *file << kIndent << "*out_" << name << "_count = " << receiver << "->" << name << ".count;\n";
+            break;
+        case flat::Type::Kind::kString:
+            *file << kIndent << "memcpy(" << name << "_buffer, " << receiver << "->" << name << ".data, " << receiver << "->" << name << ".size);\n";
+            *file << kIndent << "*out_" << name << "_size = " << receiver << "->" << name << ".size;\n";
+            break;
+        case flat::Type::Kind::kHandle:
+        case flat::Type::Kind::kPrimitive:
+            *file << kIndent << "*out_" << name << " = " << receiver << "->" << name << ";\n";
+            break;
+        case flat::Type::Kind::kIdentifier:
+            switch (member.decl_kind) {
+            case flat::Decl::Kind::kConst:
+                assert(false && "bad decl kind for member");
+                break;
+            case flat::Decl::Kind::kBits:
+            case flat::Decl::Kind::kEnum:
+            case flat::Decl::Kind::kInterface:
+                *file << kIndent << "*out_" << name << " = " << receiver << "->" << name << ";\n";
+                break;
+            case flat::Decl::Kind::kTable:
+            case flat::Decl::Kind::kXUnion:
+                EmitUnpackEnvelopes(file, kIndent, receiver + "->" + name,
+                                    "out_" + name + "->", member);
+                break;
+            case flat::Decl::Kind::kStruct:
+            case flat::Decl::Kind::kUnion:
+                switch (member.nullability) {
+                case types::Nullability::kNullable:
+                    *file << kIndent << "if (" << receiver << "->" << name << ") {\n";
+                    *file << kIndent << kIndent << "*out_" << name << " = *(" << receiver << "->" << name << ");\n";
+                    *file << kIndent << "} else {\n";
+                    // We don't have a great way of signaling that the optional response member
+                    // was not in the message. That means these bindings aren't particularly
+                    // useful when the client needs to extract that bit. The best we can do is
+                    // zero out the value to make sure the client has defined behavior.
+                    //
+                    // In many cases, the response contains other information (e.g., a status code)
+                    // that lets the client do something reasonable.
+                    *file << kIndent << kIndent << "memset(out_" << name << ", 0, sizeof(*out_" << name << "));\n";
+                    *file << kIndent << "}\n";
+                    break;
+                case types::Nullability::kNonnullable:
+                    *file << kIndent << "*out_" << name << " = " << receiver << "->" << name << ";\n";
+                    break;
+                }
+                break;
+            }
+            break;
+        }
+    }
+}
+
+// Zeroes the header of the message at |bytes|, and the padding between and
+// after its parameters, which together are the inline bytes of the message
+// that copying its parameters in leaves alone.
+void EmitZeroMessagePadding(OutputSink* file,
+                            StringView bytes,
+                            const std::vector<flat::Struct::Member>& parameters,
+                            const TypeShape& typeshape) {
+    *file << kIndent << "memset(" << bytes << ", 0, sizeof(fidl_message_header_t));\n";
+    uint32_t inline_size = MessageInlineSize(parameters, typeshape);
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        const auto& fieldshape = parameters[i].fieldshape;
+        uint32_t start = kMessageHeaderSize + fieldshape.Offset() + fieldshape.Size();
+        // The padding of the last parameter ends with the parameters, which
+        // the message pads further to 8 bytes.
+        uint32_t end = start + fieldshape.Padding();
+        if (i + 1 == parameters.size())
+            end = inline_size;
+        if (end > start) {
+            *file << kIndent << "memset(&" << bytes << "[" << start << "], 0, "
+                  << end - start << ");\n";
+        }
+    }
+}
+
+// Emits the descriptor of |message| that the routines of <lib/fidl/stubs.h>
+// walk when the bindings are generated for CGenerator::Codegen::kSize, with
+// a reference to the message's coding table if it is |coded|:
+//
+//     static const fidl_c_message_t example_EchoGetResponse_message = {...};
+void EmitStubMessage(OutputSink* file, const CGenerator::NamedMessage& message,
+                     size_t hcount, bool coded) {
+    const auto& members = message.members;
+    if (!members.empty()) {
+        *file << "static const fidl_c_param_t " << message.c_name << "_params[] = {\n";
+        for (size_t i = 0; i < members.size(); ++i) {
+            const auto& member = members[i];
+            const auto& parameter = message.parameters[i];
+            const flat::Type* type = parameter.type_ctor->type;
+            const char* kind = "FIDL_C_PARAM_INLINE";
+            uint32_t size = parameter.fieldshape.Size();
+            std::string max_count = "0u";
+            switch (member.kind) {
+            case flat::Type::Kind::kVector:
+                kind = "FIDL_C_PARAM_VECTOR";
+                size = static_cast<const flat::VectorType*>(type)->element_type->shape.Size();
+                break;
+            case flat::Type::Kind::kString:
+                kind = "FIDL_C_PARAM_STRING";
+                size = 1u;
+                break;
+            default:
+                if (IsStoredOutOfLine(member)) {
+                    kind = "FIDL_C_PARAM_POINTER";
+                    size = member.type_decl->typeshape.Size();
+                }
+                break;
+            }
+            if (member.kind == flat::Type::Kind::kVector || member.kind == flat::Type::Kind::kString) {
+                max_count = member.max_num_elements == std::numeric_limits<uint32_t>::max()
+                    ? "FIDL_MAX_SIZE" : std::to_string(member.max_num_elements) + "u";
+            }
+            bool nullable = type->nullability == types::Nullability::kNullable;
+            *file << kIndent << "{" << kind << ", " << (nullable ? "1u" : "0u") << ", 0u, "
+                  << kMessageHeaderSize + parameter.fieldshape.Offset() << "u, " << size << "u, "
+                  << max_count << "}, // " << member.name << "\n";
+        }
+        *file << "};\n";
+    }
+    *file << "static const fidl_c_message_t " << message.c_name << "_message = {\n";
+    if (coded) {
+        *file << kIndent << ".type = &" << message.coded_name << ",\n";
+    } else {
+        *file << kIndent << ".type = NULL,\n";
+    }
+    if (members.empty()) {
+        *file << kIndent << ".params = NULL,\n";
+    } else {
+        *file << kIndent << ".params = " << message.c_name << "_params,\n";
+    }
+    *file << kIndent << ".num_params = " << members.size() << "u,\n";
+    *file << kIndent << ".size = " << MessageInlineSize(message.parameters, message.typeshape) << "u,\n";
+    *file << kIndent << ".max_handles = " << hcount << "u,\n";
+    *file << "};\n\n";
+}
+
+// Emits |name|, the array of pointers to the arguments of a method that the
+// routines of <lib/fidl/stubs.h> take for its parameters |params|, and
+// returns its name, or "NULL" if |params| is empty.
+std::string EmitStubInArgs(OutputSink* file, const std::vector<CGenerator::Member>& params,
+                           const std::string& name) {
+    if (params.empty())
+        return "NULL";
+    *file << kIndent << "const void* " << name << "[] = {";
+    for (size_t i = 0; i < params.size(); ++i) {
+        const auto& member = params[i];
+        if (i > 0u)
+            *file << ", ";
+        switch (member.kind) {
+        case flat::Type::Kind::kVector:
+            *file << member.name << "_data, &" << member.name << "_count";
+            break;
+        case flat::Type::Kind::kString:
+            *file << member.name << "_data, &" << member.name << "_size";
+            break;
+        case flat::Type::Kind::kArray:
+            *file << member.name;
+            break;
+        case flat::Type::Kind::kHandle:
+        case flat::Type::Kind::kPrimitive:
+            *file << "&" << member.name;
+            break;
+        case flat::Type::Kind::kIdentifier:
+            // Structs and unions are already passed by pointer.
+            if (member.decl_kind == flat::Decl::Kind::kStruct ||
+                member.decl_kind == flat::Decl::Kind::kUnion) {
+                *file << member.name;
+            } else {
+                *file << "&" << member.name;
+            }
+            break;
+        }
+    }
+    *file << "};\n";
+    return name;
+}
+
+// Emits _out, the array of pointers to the out parameters of a client method
+// for the response members |params|, and returns its name, or "NULL" if
+// |params| is empty.
+std::string EmitStubOutArgs(OutputSink* file, const std::vector<CGenerator::Member>& params) {
+    if (params.empty())
+        return "NULL";
+    *file << kIndent << "void* _out[] = {";
+    for (size_t i = 0; i < params.size(); ++i) {
+        const auto& member = params[i];
+        if (i > 0u)
+            *file << ", ";
+        switch (member.kind) {
+        case flat::Type::Kind::kVector:
+            *file << member.name << "_buffer, &" << member.name << "_capacity, out_"
+                  << member.name << "_count";
+            break;
+        case flat::Type::Kind::kString:
+            *file << member.name << "_buffer, &" << member.name << "_capacity, out_"
+                  << member.name << "_size";
+            break;
+        default:
+            *file << "out_" << member.name;
+            break;
+        }
+    }
+    *file << "};\n";
+    return "_out";
+}
+
+// Emits the buffer, statistics and reporting that every benchmark of
+// CGenerator::ProduceBench() shares.
+void EmitBenchRuntime(OutputSink* file) {
+    *file << "// The message that is being benchmarked.\n";
+    *file << "static FIDL_ALIGNDECL char bench_bytes[ZX_CHANNEL_MAX_MSG_BYTES];\n";
+    *file << "// The cost of reading the clock, which is taken off every sample.\n";
+    *file << "static zx_time_t bench_clock_overhead;\n\n";
+
+    *file << "static void bench_fail(const char* message, zx_status_t status) {\n";
+    *file << kIndent << "fprintf(stderr, \"%s: error %d\\n\", message, (int)status);\n";
+    *file << kIndent << "exit(1);\n";
+    *file << "}\n\n";
+
+    *file << "static int bench_compare(const void* a, const void* b) {\n";
+    *file << kIndent << "zx_time_t x = *(const zx_time_t*)a;\n";
+    *file << kIndent << "zx_time_t y = *(const zx_time_t*)b;\n";
+    *file << kIndent << "return x < y ? -1 : x > y;\n";
+    *file << "}\n\n";
+
+    *file << "// Records how long each of the four phases of iteration |i| took, from the\n";
+    *file << "// five times in |t|.\n";
+    *file << "static void bench_record(zx_time_t* samples, size_t iterations, size_t i, const zx_time_t* t) {\n";
+    *file << kIndent << "for (size_t phase = 0u; phase < 4u; ++phase) {\n";
+    *file << kIndent << kIndent << "zx_time_t elapsed = t[phase + 1u] - t[phase] - bench_clock_overhead;\n";
+    *file << kIndent << kIndent << "samples[phase * iterations + i] = elapsed > 0 ? elapsed : 0;\n";
+    *file << kIndent << "}\n";
+    *file << "}\n\n";
+
+    *file << "// Prints the minimum, median, mean and 99th percentile of the samples of\n";
+    *file << "// each phase, in nanoseconds, or - for the phases that the message skips.\n";
+    *file << "static void bench_report(const char* message, zx_time_t* samples, size_t iterations,\n";
+    *file << "                         bool encodes, bool decodes) {\n";
+    *file << kIndent << "static const char* const kPhases[] = {\"linearize\", \"encode\", \"decode\", \"copy-out\"};\n";
+    *file << kIndent << "for (size_t phase = 0u; phase < 4u; ++phase) {\n";
+    *file << kIndent << kIndent << "if ((phase == 1u && !encodes) || (phase == 2u && !decodes)) {\n";
+    *file << kIndent << kIndent << kIndent << "printf(\"%-48s %-10s %10s\\n\", message, kPhases[phase], \"-\");\n";
+    *file << kIndent << kIndent << kIndent << "continue;\n";
+    *file << kIndent << kIndent << "}\n";
+    *file << kIndent << kIndent << "zx_time_t* phase_samples = &samples[phase * iterations];\n";
+    *file << kIndent << kIndent << "qsort(phase_samples, iterations, sizeof(zx_time_t), bench_compare);\n";
+    *file << kIndent << kIndent << "zx_time_t sum = 0;\n";
+    *file << kIndent << kIndent << "for (size_t i = 0u; i < iterations; ++i)\n";
+    *file << kIndent << kIndent << kIndent << "sum += phase_samples[i];\n";
+    *file << kIndent << kIndent << "printf(\"%-48s %-10s %10lld %10lld %10lld %10lld\\n\", message, kPhases[phase],\n";
+    *file << kIndent << kIndent << "       (long long)phase_samples[0], (long long)phase_samples[iterations / 2u],\n";
+    *file << kIndent << kIndent << "       (long long)(sum / (zx_time_t)iterations),\n";
+    *file << kIndent << kIndent << "       (long long)phase_samples[iterations * 99u / 100u]);\n";
+    *file << kIndent << "}\n";
+    *file << "}\n\n";
+}
+
+// Emits a function that encodes or decodes one message in place, as
+// fidl_encode() and fidl_decode() would with the message's coding table, but
+// with the offsets of its members, and the bounds of its vectors and strings,
+// written into the code:
+//
+//     static zx_status_t example_EchoSendRequest_encode(
+//         char* _bytes, zx_handle_t* _handles, uint32_t _max_handles,
+//         uint32_t* _out_num_handles);
+//     static zx_status_t example_EchoSendRequest_decode(
+//         char* _bytes, uint32_t _num_bytes, const zx_handle_t* _handles,
+//         uint32_t _num_handles);
+//
+// Encoding moves handles out of the message, replaces pointers with presence
+// markers, and zeroes the padding of structs and unions that the message
+// copied from the caller. Decoding checks the size of the message and the
+// bounds of every out-of-line object, and patches pointers and handles back
+// in. Both close the handles they hold when the message is invalid.
+//
+// Only messages of interfaces with the simple layout have C bindings, so the
+// members handled are the ones such messages can contain.
+class InlineCodingEmitter {
+public:
+    enum class Direction {
+        kEncode,
+        kDecode,
+    };
+
+    InlineCodingEmitter(OutputSink* file, Direction direction)
+        : file_(file), direction_(direction) {}
+
+    // Returns false, having emitted nothing, for an encoder that would have
+    // nothing to do, such as for a message whose only padding lies between
+    // its own members, which the caller zeroes along with the whole message.
+    bool EmitFunction(StringView message_name,
+                      const std::vector<flat::Struct::Member>& parameters,
+                      const TypeShape& typeshape);
+
+private:
+    // Whether values of |type| need anything done to them.
+    bool NeedsWork(const flat::Type* type) const;
+    bool HasHandles(const flat::Type* type) const;
+
+    void EmitIndent(size_t depth);
+    void EmitFail(size_t depth);
+
+    void EmitType(const flat::Type* type, const std::string& base, uint32_t offset, size_t depth);
+    void EmitStruct(const flat::Struct& struct_decl, const std::string& base, uint32_t offset,
+                    size_t depth);
+    void EmitUnion(const flat::Union& union_decl, const std::string& base, uint32_t offset,
+                   size_t depth);
+    void EmitHandle(types::Nullability nullability, const std::string& address, size_t depth);
+    void EmitPointer(const flat::TypeDecl* decl, const std::string& address, size_t depth);
+    void EmitVector(const flat::Type* element_type, uint32_t element_count,
+                    types::Nullability nullability, const std::string& base, uint32_t offset,
+                    size_t depth);
+    void EmitEnvelope(const std::vector<EnvelopeMember>& members, const std::string& envelope,
+                      const std::string& ordinal, size_t depth);
+    void EmitTable(const flat::Table& table_decl, const std::string& address, size_t depth);
+    void EmitXUnion(const flat::XUnion& xunion_decl, types::Nullability nullability,
+                    const std::string& address, size_t depth);
+
+    OutputSink* file_;
+    const Direction direction_;
+    // The generated code jumps to the _fail label on errors.
+    bool fails_ = false;
+    // The generated encoder moves handles out of the message.
+    bool moves_handles_ = false;
+    // The generated decoder skips the envelopes of unknown members, and
+    // closes their handles once the message is decoded.
+    bool skips_unknown_ = false;
+    // Counts the local variables of the generated code, to name them uniquely.
+    uint32_t next_variable_ = 0u;
+};
+
+std::string Address(const std::string& base, uint32_t offset) {
+    if (offset == 0u)
+        return base;
+    return base + " + " + std::to_string(offset);
+}
+
+bool InlineCodingEmitter::HasHandles(const flat::Type* type) const {
+    switch (type->kind) {
+    case flat::Type::Kind::kHandle:
+        return true;
+    case flat::Type::Kind::kPrimitive:
+    case flat::Type::Kind::kString:
+        return false;
+    case flat::Type::Kind::kArray:
+        return HasHandles(static_cast<const flat::ArrayType*>(type)->element_type);
+    case flat::Type::Kind::kVector:
+        return HasHandles(static_cast<const flat::VectorType*>(type)->element_type);
+    case flat::Type::Kind::kIdentifier: {
+        auto decl = static_cast<const flat::IdentifierType*>(type)->type_decl;
+        switch (decl->kind) {
+        case flat::Decl::Kind::kBits:
+        case flat::Decl::Kind::kConst:
+        case flat::Decl::Kind::kEnum:
+            return false;
+        case flat::Decl::Kind::kInterface:
+            return true;
+        case flat::Decl::Kind::kStruct:
+            for (const auto& member : static_cast<const flat::Struct*>(decl)->members) {
+                if (HasHandles(member.type_ctor->type))
+                    return true;
+            }
+            return false;
+        case flat::Decl::Kind::kUnion:
+            for (const auto& member : static_cast<const flat::Union*>(decl)->members) {
+                if (HasHandles(member.type_ctor->type))
+                    return true;
+            }
+            return false;
+        case flat::Decl::Kind::kTable:
+        case flat::Decl::Kind::kXUnion:
+            return decl->typeshape.MaxHandles() > 0u;
+        }
+    }
+    }
+    assert(false && "unknown type kind");
+    return true;
+}
+
+bool InlineCodingEmitter::NeedsWork(const flat::Type* type) const {
+    switch (type->kind) {
+    case flat::Type::Kind::kHandle:
+    case flat::Type::Kind::kString:
+    case flat::Type::Kind::kVector:
+        return true;
+    case flat::Type::Kind::kPrimitive:
+        return false;
+    case flat::Type::Kind::kArray:
+        return NeedsWork(static_cast<const flat::ArrayType*>(type)->element_type);
+    case flat::Type::Kind::kIdentifier: {
+        if (type->nullability == types::Nullability::kNullable)
+            return true;
+        auto decl = static_cast<const flat::IdentifierType*>(type)->type_decl;
+        switch (decl->kind) {
+        case flat::Decl::Kind::kBits:
+        case flat::Decl::Kind::kConst:
+        case flat::Decl::Kind::kEnum:
+            return false;
+        case flat::Decl::Kind::kStruct:
+            if (direction_ == Direction::kEncode && decl->typeshape.HasPadding())
+                return true;
+            return HasHandles(type);
+        case flat::Decl::Kind::kInterface:
+        case flat::Decl::Kind::kTable:
+        case flat::Decl::Kind::kUnion:
+        case flat::Decl::Kind::kXUnion:
+            return true;
+        }
+    }
+    }
+    assert(false && "unknown type kind");
+    return true;
+}
+
+void InlineCodingEmitter::EmitIndent(size_t depth) {
+    for (size_t i = 0; i < depth; ++i) {
+        *file_ << kIndent;
+    }
+}
+
+void InlineCodingEmitter::EmitFail(size_t depth) {
+    fails_ = true;
+    EmitIndent(depth);
+    *file_ << "goto _fail;\n";
+}
+
+void InlineCodingEmitter::EmitHandle(types::Nullability nullability, const std::string& address,
+                                     size_t depth) {
+    std::string handle = "*(zx_handle_t*)(" + address + ")";
+    switch (direction_) {
+    case Direction::kEncode:
+        moves_handles_ = true;
+        EmitIndent(depth);
+        *file_ << "if (" << handle << " != ZX_HANDLE_INVALID) {\n";
+        EmitIndent(depth + 1);
+        *file_ << "if (_num_handles == _max_handles)\n";
+        EmitFail(depth + 2);
+        EmitIndent(depth + 1);
+        *file_ << "_handles[_num_handles++] = " << handle << ";\n";
+        EmitIndent(depth + 1);
+        *file_ << handle << " = FIDL_HANDLE_PRESENT;\n";
+        break;
+    case Direction::kDecode:
+        EmitIndent(depth);
+        *file_ << "if (" << handle << " == FIDL_HANDLE_PRESENT) {\n";
+        EmitIndent(depth + 1);
+        *file_ << "if (_handle_index == _num_handles)\n";
+        EmitFail(depth + 2);
+        EmitIndent(depth + 1);
+        *file_ << handle << " = _handles[_handle_index++];\n";
+        if (nullability == types::Nullability::kNullable) {
+            // An absent handle is already ZX_HANDLE_INVALID.
+            EmitIndent(depth);
+            *file_ << "} else if (" << handle << " != FIDL_HANDLE_ABSENT) {\n";
+            EmitFail(depth + 1);
+        }
+        break;
+    }
+    if (nullability == types::Nullability::kNonnullable) {
+        EmitIndent(depth);
+        *file_ << "} else {\n";
+        EmitFail(depth + 1);
+    }
+    EmitIndent(depth);
+    *file_ << "}\n";
+}
+
+void InlineCodingEmitter::EmitPointer(const flat::TypeDecl* decl, const std::string& address,
+                                      size_t depth) {
+    std::string object = "_object" + std::to_string(next_variable_++);
+    switch (direction_) {
+    case Direction::kEncode:
+        EmitIndent(depth);
+        *file_ << "if (*(char**)(" << address << ") != NULL) {\n";
+        EmitIndent(depth + 1);
+        *file_ << "char* " << object << " = *(char**)(" << address << ");\n";
+        break;
+    case Direction::kDecode: {
+        uint32_t size = (decl->typeshape.Size() + 7u) & ~7u;
+        EmitIndent(depth);
+        *file_ << "if (*(uintptr_t*)(" << address << ") == FIDL_ALLOC_PRESENT) {\n";
+        EmitIndent(depth + 1);
+        *file_ << "if (_num_bytes - _next < " << size << "u)\n";
+        EmitFail(depth + 2);
+        EmitIndent(depth + 1);
+        *file_ << "char* " << object << " = _bytes + _next;\n";
+        EmitIndent(depth + 1);
+        *file_ << "*(char**)(" << address << ") = " << object << ";\n";
+        EmitIndent(depth + 1);
+        *file_ << "_next += " << size << "u;\n";
+        break;
+    }
+    }
+    switch (decl->kind) {
+    case flat::Decl::Kind::kStruct:
+        EmitStruct(*static_cast<const flat::Struct*>(decl), object, 0u, depth + 1);
+        break;
+    case flat::Decl::Kind::kUnion:
+        EmitUnion(*static_cast<const flat::Union*>(decl), object, 0u, depth + 1);
+        break;
+    default:
+        assert(false && "only structs and unions are stored behind pointers");
+        break;
+    }
+    switch (direction_) {
+    case Direction::kEncode:
+        EmitIndent(depth + 1);
+        *file_ << "*(uintptr_t*)(" << address << ") = FIDL_ALLOC_PRESENT;\n";
+        break;
+    case Direction::kDecode:
+        EmitIndent(depth);
+        *file_ << "} else if (*(uintptr_t*)(" << address << ") != FIDL_ALLOC_ABSENT) {\n";
+        EmitFail(depth + 1);
+        break;
+    }
+    EmitIndent(depth);
+    *file_ << "}\n";
+}
+
+// Strings are vectors of one byte elements that are not handles.
+void InlineCodingEmitter::EmitVector(const flat::Type* element_type, uint32_t element_count,
+                                     types::Nullability nullability, const std::string& base,
+                                     uint32_t offset, size_t depth) {
+    std::string count = "*(uint64_t*)(" + Address(base, offset) + ")";
+    std::string data = "*(char**)(" + Address(base, offset + 8u) + ")";
+    std::string presence = "*(uintptr_t*)(" + Address(base, offset + 8u) + ")";
+    uint32_t element_size = element_type == nullptr ? 1u : element_type->shape.Size();
+    bool has_handles = element_type != nullptr && HasHandles(element_type);
+    std::string elements = "_data" + std::to_string(next_variable_++);
+
+    switch (direction_) {
+    case Direction::kEncode:
+        EmitIndent(depth);
+        *file_ << "if (" << data << " != NULL) {\n";
+        if (has_handles) {
+            EmitIndent(depth + 1);
+            *file_ << "char* " << elements << " = " << data << ";\n";
+        }
+        break;
+    case Direction::kDecode: {
+        std::string size = "_size" + std::to_string(next_variable_++);
+        EmitIndent(depth);
+        *file_ << "if (" << presence << " == FIDL_ALLOC_PRESENT) {\n";
+        EmitIndent(depth + 1);
+        *file_ << "if (" << count << " > " << element_count << "u)\n";
+        EmitFail(depth + 2);
+        EmitIndent(depth + 1);
+        *file_ << "uint64_t " << size << " = FIDL_ALIGN(" << count;
+        if (element_size != 1u)
+            *file_ << " * " << element_size << "u";
+        *file_ << ");\n";
+        EmitIndent(depth + 1);
+        *file_ << "if (" << size << " > _num_bytes - _next)\n";
+        EmitFail(depth + 2);
+        if (has_handles) {
+            EmitIndent(depth + 1);
+            *file_ << "char* " << elements << " = _bytes + _next;\n";
+        }
+        EmitIndent(depth + 1);
+        *file_ << data << " = _bytes + _next;\n";
+        EmitIndent(depth + 1);
+        *file_ << "_next += (uint32_t)" << size << ";\n";
+        break;
+    }
+    }
+    if (has_handles) {
+        std::string index = "_i" + std::to_string(next_variable_++);
+        EmitIndent(depth + 1);
+        *file_ << "for (uint64_t " << index << " = 0u; " << index << " < " << count << "; ++"
+               << index << ") {\n";
+        EmitType(element_type, elements + " + " + index + " * " + std::to_string(element_size),
+                 0u, depth + 2);
+        EmitIndent(depth + 1);
+        *file_ << "}\n";
+    }
+    switch (direction_) {
+    case Direction::kEncode:
+        EmitIndent(depth + 1);
+        *file_ << presence << " = FIDL_ALLOC_PRESENT;\n";
+        if (nullability == types::Nullability::kNonnullable) {
+            EmitIndent(depth);
+            *file_ << "} else {\n";
+            EmitFail(depth + 1);
+        }
+        break;
+    case Direction::kDecode:
+        EmitIndent(depth);
+        switch (nullability) {
+        case types::Nullability::kNullable:
+            *file_ << "} else if (" << presence << " != FIDL_ALLOC_ABSENT || " << count
+                   << " != 0u) {\n";
+            break;
+        case types::Nullability::kNonnullable:
+            *file_ << "} else {\n";
+            break;
+        }
+        EmitFail(depth + 1);
+        break;
+    }
+    EmitIndent(depth);
+    *file_ << "}\n";
+}
+
+// Visits the contents of |envelope|, a fidl_envelope_t*, which hold the
+// member of |members| whose ordinal is |ordinal|. The members have no
+// out-of-line objects, so the contents of a known member are exactly its
+// padded size, and the decoder skips those of an unknown member by their
+// byte count without visiting them.
+void InlineCodingEmitter::EmitEnvelope(const std::vector<EnvelopeMember>& members,
+                                       const std::string& envelope, const std::string& ordinal,
+                                       size_t depth) {
+    bool needs_work = false;
+    bool has_handles = false;
+    for (const auto& member : members) {
+        needs_work |= NeedsWork(member.type);
+        has_handles |= HasHandles(member.type);
+    }
+    std::string object = "_object" + std::to_string(next_variable_++);
+    std::string first_handle = "_first_handle" + std::to_string(next_variable_++);
+
+    switch (direction_) {
+    case Direction::kEncode:
+        EmitIndent(depth);
+        *file_ << "if (" << envelope << "->data != NULL) {\n";
+        if (needs_work) {
+            EmitIndent(depth + 1);
+            *file_ << "char* " << object << " = (char*)" << envelope << "->data;\n";
+            if (has_handles) {
+                EmitIndent(depth + 1);
+                *file_ << "uint32_t " << first_handle << " = _num_handles;\n";
+            }
+            EmitIndent(depth + 1);
+            *file_ << "switch (" << ordinal << ") {\n";
+            for (const auto& member : members) {
+                if (!NeedsWork(member.type))
+                    continue;
+                EmitIndent(depth + 1);
+                *file_ << "case " << member.ordinal << "u:\n";
+                EmitType(member.type, object, 0u, depth + 2);
+                EmitIndent(depth + 2);
+                *file_ << "break;\n";
+            }
+            EmitIndent(depth + 1);
+            *file_ << "}\n";
+            if (has_handles) {
+                EmitIndent(depth + 1);
+                *file_ << envelope << "->num_handles = _num_handles - " << first_handle << ";\n";
+            }
+        }
+        EmitIndent(depth + 1);
+        *file_ << envelope << "->data = (void*)FIDL_ALLOC_PRESENT;\n";
+        EmitIndent(depth);
+        *file_ << "}\n";
+        break;
+    case Direction::kDecode:
+        skips_unknown_ = true;
+        EmitIndent(depth);
+        *file_ << "if (" << envelope << "->data == NULL) {\n";
+        EmitIndent(depth + 1);
+        *file_ << "if (" << envelope << "->num_bytes != 0u || " << envelope
+               << "->num_handles != 0u)\n";
+        EmitFail(depth + 2);
+        EmitIndent(depth);
+        *file_ << "} else {\n";
+        EmitIndent(depth + 1);
+        *file_ << "if ((uintptr_t)" << envelope << "->data != FIDL_ALLOC_PRESENT || " << envelope
+               << "->num_bytes % 8u != 0u ||\n";
+        EmitIndent(depth + 2);
+        *file_ << envelope << "->num_bytes > _num_bytes - _next || " << envelope
+               << "->num_handles > _num_handles - _handle_index)\n";
+        EmitFail(depth + 2);
+        if (needs_work) {
+            EmitIndent(depth + 1);
+            *file_ << "char* " << object << " = _bytes + _next;\n";
+        }
+        if (has_handles) {
+            EmitIndent(depth + 1);
+            *file_ << "uint32_t " << first_handle << " = _handle_index;\n";
+        }
+        EmitIndent(depth + 1);
+        *file_ << envelope << "->data = _bytes + _next;\n";
+        EmitIndent(depth + 1);
+        *file_ << "switch (" << ordinal << ") {\n";
+        for (const auto& member : members) {
+            bool member_has_handles = HasHandles(member.type);
+            EmitIndent(depth + 1);
+            *file_ << "case " << member.ordinal << "u:\n";
+            EmitIndent(depth + 2);
+            *file_ << "if (" << envelope << "->num_bytes != " << member.num_bytes << "u";
+            if (!member_has_handles)
+                *file_ << " || " << envelope << "->num_handles != 0u";
+            *file_ << ")\n";
+            EmitFail(depth + 3);
+            EmitType(member.type, object, 0u, depth + 2);
+            if (member_has_handles) {
+                EmitIndent(depth + 2);
+                *file_ << "if (_handle_index - " << first_handle << " != " << envelope
+                       << "->num_handles)\n";
+                EmitFail(depth + 3);
+            }
+            EmitIndent(depth + 2);
+            *file_ << "break;\n";
+        }
+        EmitIndent(depth + 1);
+        *file_ << "default:\n";
+        // The handles are tracked in a 64-bit mask, which is as many as a
+        // channel message can carry.
+        EmitIndent(depth + 2);
+        *file_ << "if (_handle_index + " << envelope << "->num_handles > 64u)\n";
+        EmitFail(depth + 3);
+        EmitIndent(depth + 2);
+        *file_ << "if (" << envelope << "->num_handles != 0u)\n";
+        EmitIndent(depth + 3);
+        *file_ << "_unknown_handles |= (UINT64_MAX >> (64u - " << envelope
+               << "->num_handles)) << _handle_index;\n";
+        EmitIndent(depth + 2);
+        *file_ << "_handle_index += " << envelope << "->num_handles;\n";
+        EmitIndent(depth + 2);
+        *file_ << "break;\n";
+        EmitIndent(depth + 1);
+        *file_ << "}\n";
+        EmitIndent(depth + 1);
+        *file_ << "_next += " << envelope << "->num_bytes;\n";
+        EmitIndent(depth);
+        *file_ << "}\n";
+        break;
+    }
+}
+
+void InlineCodingEmitter::EmitTable(const flat::Table& table_decl, const std::string& address,
+                                    size_t depth) {
+    std::string table = "_table" + std::to_string(next_variable_++);
+    std::string index = "_i" + std::to_string(next_variable_++);
+    std::string envelope = "_envelope" + std::to_string(next_variable_++);
+    EmitIndent(depth);
+    *file_ << "fidl_table_t* " << table << " = (fidl_table_t*)(" << address << ");\n";
+    if (direction_ == Direction::kDecode) {
+        EmitIndent(depth);
+        *file_ << "if ((uintptr_t)" << table << "->envelopes != FIDL_ALLOC_PRESENT ||\n";
+        EmitIndent(depth + 1);
+        *file_ << table << "->count > (_num_bytes - _next) / sizeof(fidl_envelope_t))\n";
+        EmitFail(depth + 1);
+        EmitIndent(depth);
+        *file_ << table << "->envelopes = (fidl_envelope_t*)(_bytes + _next);\n";
+        EmitIndent(depth);
+        *file_ << "_next += (uint32_t)(sizeof(fidl_envelope_t) * " << table << "->count);\n";
+    }
+    EmitIndent(depth);
+    *file_ << "for (uint64_t " << index << " = 0u; " << index << " < " << table << "->count; ++"
+           << index << ") {\n";
+    EmitIndent(depth + 1);
+    *file_ << "fidl_envelope_t* " << envelope << " = &" << table << "->envelopes[" << index
+           << "];\n";
+    EmitEnvelope(EnvelopeMembers(&table_decl), envelope, index + " + 1u", depth + 1);
+    EmitIndent(depth);
+    *file_ << "}\n";
+    if (direction_ == Direction::kEncode) {
+        EmitIndent(depth);
+        *file_ << table << "->envelopes = (fidl_envelope_t*)FIDL_ALLOC_PRESENT;\n";
+    }
+}
+
+// An extensible union is absent when it has no tag, and only then.
+void InlineCodingEmitter::EmitXUnion(const flat::XUnion& xunion_decl,
+                                     types::Nullability nullability, const std::string& address,
+                                     size_t depth) {
+    std::string xunion = "_xunion" + std::to_string(next_variable_++);
+    std::string envelope = "_envelope" + std::to_string(next_variable_++);
+    EmitIndent(depth);
+    *file_ << "fidl_xunion_t* " << xunion << " = (fidl_xunion_t*)(" << address << ");\n";
+    EmitIndent(depth);
+    *file_ << "fidl_envelope_t* " << envelope << " = &" << xunion << "->envelope;\n";
+    EmitIndent(depth);
+    switch (nullability) {
+    case types::Nullability::kNullable:
+        *file_ << "if ((" << xunion << "->tag == 0u) != (" << envelope << "->data == NULL))\n";
+        break;
+    case types::Nullability::kNonnullable:
+        *file_ << "if (" << xunion << "->tag == 0u || " << envelope << "->data == NULL)\n";
+        break;
+    }
+    EmitFail(depth + 1);
+    EmitEnvelope(EnvelopeMembers(&xunion_decl), envelope, xunion + "->tag", depth);
+}
+
+void InlineCodingEmitter::EmitStruct(const flat::Struct& struct_decl, const std::string& base,
+                                     uint32_t offset, size_t depth) {
+    for (const auto& member : struct_decl.members) {
+        const auto& fieldshape = member.fieldshape;
+        uint32_t member_offset = offset + fieldshape.Offset();
+        EmitType(member.type_ctor->type, base, member_offset, depth);
+        if (direction_ == Direction::kEncode && fieldshape.Padding() > 0u) {
+            EmitIndent(depth);
+            *file_ << "memset(" << Address(base, member_offset + fieldshape.Size()) << ", 0, "
+                   << fieldshape.Padding() << ");\n";
+        }
+    }
+}
+
+void InlineCodingEmitter::EmitUnion(const flat::Union& union_decl, const std::string& base,
+                                    uint32_t offset, size_t depth) {
+    uint32_t member_offset = offset + union_decl.membershape.Offset();
+    if (direction_ == Direction::kEncode && union_decl.membershape.Offset() > 4u) {
+        EmitIndent(depth);
+        *file_ << "memset(" << Address(base, offset + 4u) << ", 0, "
+               << union_decl.membershape.Offset() - 4u << ");\n";
+    }
+    EmitIndent(depth);
+    *file_ << "switch (*(fidl_union_tag_t*)(" << Address(base, offset) << ")) {\n";
+    uint32_t tag = 0u;
+    for (const auto& member : union_decl.members) {
+        const auto& fieldshape = member.fieldshape;
+        EmitIndent(depth);
+        *file_ << "case " << tag++ << "u:\n";
+        EmitType(member.type_ctor->type, base, member_offset, depth + 1);
+        if (direction_ == Direction::kEncode && fieldshape.Padding() > 0u) {
+            EmitIndent(depth + 1);
+            *file_ << "memset(" << Address(base, member_offset + fieldshape.Size()) << ", 0, "
+                   << fieldshape.Padding() << ");\n";
+        }
+        EmitIndent(depth + 1);
+        *file_ << "break;\n";
+    }
+    EmitIndent(depth);
+    *file_ << "default:\n";
+    EmitFail(depth + 1);
+    EmitIndent(depth);
+    *file_ << "}\n";
+}
+
+void InlineCodingEmitter::EmitType(const flat::Type* type, const std::string& base,
+                                   uint32_t offset, size_t depth) {
+    if (!NeedsWork(type))
+        return;
+    switch (type->kind) {
+    case flat::Type::Kind::kPrimitive:
+        break;
+    case flat::Type::Kind::kHandle:
+        EmitHandle(type->nullability, Address(base, offset), depth);
+        break;
+    case flat::Type::Kind::kArray: {
+        auto array_type = static_cast<const flat::ArrayType*>(type);
+        std::string index = "_i" + std::to_string(next_variable_++);
+        EmitIndent(depth);
+        *file_ << "for (uint32_t " << index << " = 0u; " << index << " < "
+               << array_type->element_count->value << "u; ++" << index << ") {\n";
+        EmitType(array_type->element_type,
+                 Address(base, offset) + " + " + index + " * " +
+                     std::to_string(array_type->element_type->shape.Size()),
+                 0u, depth + 1);
+        EmitIndent(depth);
+        *file_ << "}\n";
+        break;
+    }
+    case flat::Type::Kind::kVector: {
+        auto vector_type = static_cast<const flat::VectorType*>(type);
+        EmitVector(vector_type->element_type, vector_type->element_count->value,
+                   vector_type->nullability, base, offset, depth);
+        break;
+    }
+    case flat::Type::Kind::kString: {
+        auto string_type = static_cast<const flat::StringType*>(type);
+        EmitVector(nullptr, string_type->max_size->value, string_type->nullability,
+                   base, offset, depth);
+        break;
+    }
+    case flat::Type::Kind::kIdentifier: {
+        auto decl = static_cast<const flat::IdentifierType*>(type)->type_decl;
+        switch (decl->kind) {
+        case flat::Decl::Kind::kBits:
+        case flat::Decl::Kind::kConst:
+        case flat::Decl::Kind::kEnum:
+            break;
+        case flat::Decl::Kind::kInterface:
+            EmitHandle(type->nullability, Address(base, offset), depth);
+            break;
+        case flat::Decl::Kind::kStruct:
+        case flat::Decl::Kind::kUnion:
+            if (type->nullability == types::Nullability::kNullable) {
+                EmitPointer(decl, Address(base, offset), depth);
+            } else if (decl->kind == flat::Decl::Kind::kStruct) {
+                EmitStruct(*static_cast<const flat::Struct*>(decl), base, offset, depth);
+            } else {
+                EmitUnion(*static_cast<const flat::Union*>(decl), base, offset, depth);
+            }
+            break;
+        case flat::Decl::Kind::kTable:
+            EmitTable(*static_cast<const flat::Table*>(decl), Address(base, offset), depth);
+            break;
+        case flat::Decl::Kind::kXUnion:
+            EmitXUnion(*static_cast<const flat::XUnion*>(decl), type->nullability,
+                       Address(base, offset), depth);
+            break;
+        }
+        break;
+    }
+    }
+}
+
+bool InlineCodingEmitter::EmitFunction(StringView message_name,
+                                       const std::vector<flat::Struct::Member>& parameters,
+                                       const TypeShape& typeshape) {
+    // The body is generated first, to find out whether it can fail.
+    OutputSink body;
+    OutputSink* file = file_;
+    file_ = &body;
+    for (const auto& parameter : parameters) {
+        assert(kMessageHeaderSize + parameter.fieldshape.Offset() + parameter.fieldshape.Size() <=
+                   MessageInlineSize(parameters, typeshape) &&
+               "parameter outside of the message");
+        EmitType(parameter.type_ctor->type, "_bytes",
+                 kMessageHeaderSize + parameter.fieldshape.Offset(), 1u);
+    }
+    file_ = file;
+    std::string statements = body.TakeContents();
+    if (direction_ == Direction::kEncode && statements.empty())
+        return false;
+
+    switch (direction_) {
+    case Direction::kEncode:
+        *file_ << "static zx_status_t " << message_name << "_encode(char* _bytes, "
+               << "zx_handle_t* _handles, uint32_t _max_handles, uint32_t* _out_num_handles) {\n";
+        // Messages without handles keep the same signature, so that callers
+        // need not tell them apart.
+        if (!fails_)
+            *file_ << kIndent << "(void)_handles;\n";
+        if (!moves_handles_)
+            *file_ << kIndent << "(void)_max_handles;\n";
+        *file_ << kIndent << "uint32_t _num_handles = 0u;\n";
+        *file_ << statements;
+        *file_ << kIndent << "*_out_num_handles = _num_handles;\n";
+        break;
+    case Direction::kDecode: {
+        uint32_t inline_size = MessageInlineSize(parameters, typeshape);
+        *file_ << "static zx_status_t " << message_name << "_decode(char* _bytes, "
+               << "uint32_t _num_bytes, const zx_handle_t* _handles, uint32_t _num_handles) {\n";
+        // Plain-data messages only have their size checked.
+        if (statements.empty())
+            *file_ << kIndent << "(void)_bytes;\n";
+        *file_ << kIndent << "uint32_t _next = " << inline_size << "u;\n";
+        *file_ << kIndent << "uint32_t _handle_index = 0u;\n";
+        if (skips_unknown_)
+            *file_ << kIndent << "uint64_t _unknown_handles = 0u;\n";
+        *file_ << kIndent << "if (_num_bytes < _next)\n";
+        *file_ << kIndent << kIndent << "goto _fail;\n";
+        *file_ << statements;
+        *file_ << kIndent << "if (_next != _num_bytes || _handle_index != _num_handles)\n";
+        *file_ << kIndent << kIndent << "goto _fail;\n";
+        if (skips_unknown_) {
+            *file_ << kIndent << "while (_unknown_handles != 0u) {\n";
+            *file_ << kIndent << kIndent << "zx_handle_close(_handles[__builtin_ctzll(_unknown_handles)]);\n";
+            *file_ << kIndent << kIndent << "_unknown_handles &= _unknown_handles - 1u;\n";
+            *file_ << kIndent << "}\n";
+        }
+        fails_ = true;
+        break;
+    }
+    }
+    *file_ << kIndent << "return ZX_OK;\n";
+    if (fails_) {
+        *file_ << "_fail:\n";
+        *file_ << kIndent << "zx_handle_close_many(_handles, _num_handles);\n";
+        *file_ << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
+    }
+    *file_ << "}\n\n";
+    return true;
+}
+
+void EmitMemberDecl(OutputSink* file, const CGenerator::Member& member) {
     *file << member.type << " " << member.name;
     for (uint32_t array_count : member.array_counts) {
         *file << "[" << array_count << "]";
@@ -491,6 +1860,60 @@ void EnumValue(const flat::Constant* constant, std::string* out_value) {
     *out_value = member_value.str();
 }
 
+bool IsSignedSubtype(types::PrimitiveSubtype subtype) {
+    switch (subtype) {
+    case types::PrimitiveSubtype::kInt8:
+    case types::PrimitiveSubtype::kInt16:
+    case types::PrimitiveSubtype::kInt32:
+    case types::PrimitiveSubtype::kInt64:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// A member of an enum or bits, with its value as C converts it to uint64_t:
+// negative values wrap around.
+struct NumberedMember {
+    uint64_t bits;
+    std::string name;
+    std::string value;
+};
+
+// The members of an enum or bits whose subtype is |subtype|, in order of
+// value.
+template <typename Decl>
+std::vector<NumberedMember> NumberMembers(const Decl& decl, types::PrimitiveSubtype subtype) {
+    bool is_signed = IsSignedSubtype(subtype);
+    std::vector<NumberedMember> members;
+    for (const auto& member : decl.members) {
+        std::unique_ptr<flat::ConstantValue> value;
+        uint64_t bits = 0u;
+        if (is_signed) {
+            if (!member.value->Value().Convert(flat::ConstantValue::Kind::kInt64, &value))
+                assert(false && "enum member does not fit int64");
+            bits = static_cast<uint64_t>(
+                static_cast<const flat::NumericConstantValue<int64_t>&>(*value).value);
+        } else {
+            if (!member.value->Value().Convert(flat::ConstantValue::Kind::kUint64, &value))
+                assert(false && "enum member does not fit uint64");
+            bits = static_cast<const flat::NumericConstantValue<uint64_t>&>(*value).value;
+        }
+        std::string literal;
+        EnumValue(member.value.get(), &literal);
+        members.push_back(NumberedMember{
+            bits, NameIdentifier(member.name),
+            NamePrimitiveIntegerCConstantMacro(subtype) + "(" + literal + ")"});
+    }
+    std::sort(members.begin(), members.end(),
+              [is_signed](const NumberedMember& a, const NumberedMember& b) {
+                  if (is_signed)
+                      return static_cast<int64_t>(a.bits) < static_cast<int64_t>(b.bits);
+                  return a.bits < b.bits;
+              });
+    return members;
+}
+
 flat::Decl::Kind GetDeclKind(const flat::Library* library, const flat::Type* type) {
     if (type->kind != flat::Type::Kind::kIdentifier)
         return flat::Decl::Kind::kConst;
@@ -533,6 +1956,7 @@ CGenerator::Member CreateMember(const flat::Library* library, const T& decl) {
     std::vector<uint32_t> array_counts;
     types::Nullability nullability = types::Nullability::kNonnullable;
     uint32_t max_num_elements = std::numeric_limits<uint32_t>::max();
+    const flat::TypeDecl* type_decl = nullptr;
     switch(type->kind) {
     case flat::Type::Kind::kArray: {
         ArrayCountsAndElementTypeName(
@@ -549,6 +1973,7 @@ CGenerator::Member CreateMember(const flat::Library* library, const T& decl) {
     case flat::Type::Kind::kIdentifier: {
         auto identifier_type = static_cast<const flat::IdentifierType*>(type);
         nullability = identifier_type->nullability;
+        type_decl = identifier_type->type_decl;
         break;
     }
     case flat::Type::Kind::kString: {
@@ -575,6 +2000,7 @@ CGenerator::Member CreateMember(const flat::Library* library, const T& decl) {
         std::move(array_counts),
         nullability,
         max_num_elements,
+        type_decl,
     };
 }
 
@@ -600,23 +2026,22 @@ GenerateMembers(const flat::Library* library,
     return members;
 }
 
-void GetMethodParameters(const flat::Library* library,
-                         const CGenerator::NamedMethod& method_info,
-                         std::vector<CGenerator::Member>* request,
-                         std::vector<CGenerator::Member>* response) {
-    if (request) {
-        request->reserve(method_info.request->parameters.size());
-        for (const auto& parameter : method_info.request->parameters) {
-            request->push_back(CreateMember(library, parameter));
-        }
+std::vector<CGenerator::Member>
+GenerateMembers(const flat::Library* library,
+                const std::vector<flat::Struct::Member>& struct_members) {
+    std::vector<CGenerator::Member> members;
+    members.reserve(struct_members.size());
+    for (const auto& struct_member : struct_members) {
+        members.push_back(CreateMember(library, struct_member));
     }
+    return members;
+}
 
-    if (response && method_info.response) {
-        response->reserve(method_info.response->parameters.size());
-        for (const auto& parameter : method_info.response->parameters) {
-            response->push_back(CreateMember(library, parameter));
-        }
-    }
+// The parameters of |message|, or none if the method has no such message.
+const std::vector<CGenerator::Member>&
+MessageMembers(const std::unique_ptr<CGenerator::NamedMessage>& message) {
+    static const std::vector<CGenerator::Member> kNoMembers;
+    return message ? message->members : kNoMembers;
 }
 
 } // namespace
@@ -633,17 +2058,84 @@ uint32_t CGenerator::GetMaxHandlesFor(Transport transport,
     return 0u;
 }
 
-void CGenerator::GeneratePrologues() {
-    EmitFileComment(&file_);
-    EmitHeaderGuard(&file_);
-    EmitIncludeHeader(&file_, "<stdalign.h>");
-    EmitIncludeHeader(&file_, "<stdbool.h>");
-    EmitIncludeHeader(&file_, "<stdint.h>");
-    EmitIncludeHeader(&file_, "<zircon/fidl.h>");
-    EmitIncludeHeader(&file_, "<zircon/syscalls/object.h>");
-    EmitIncludeHeader(&file_, "<zircon/types.h>");
+CGenerator::CGenerator(const flat::Library* library)
+    : library_(library), owned_model_(BuildModel(library)), model_(owned_model_.get()) {}
+
+CGenerator::~CGenerator() = default;
+
+std::unique_ptr<const CGenerator::Model> CGenerator::BuildModel(const flat::Library* library) {
+    auto model = std::make_unique<Model>();
+    model->named_bits = NameBits(library->bits_declarations_);
+    model->named_consts = NameConsts(library->const_declarations_);
+    model->named_enums = NameEnums(library->enum_declarations_);
+    model->named_interfaces = NameInterfaces(library, library->interface_declarations_);
+    model->named_structs = NameStructs(library, library->struct_declarations_);
+    model->named_tables = NameTables(library, library->table_declarations_);
+    model->named_unions = NameUnions(library, library->union_declarations_);
+    model->named_xunions = NameXUnions(library, library->xunion_declarations_);
+    return model;
+}
+
+bool CGenerator::IsPODMessage(const flat::Library* library,
+                              const flat::Interface& interface,
+                              const flat::Struct& message) {
+    std::vector<Member> params = GenerateMembers(library, message.members);
+    Transport transport = ParseTransport(interface.GetAttribute("Transport"));
+    return !NeedsCoding(params, GetMaxHandlesFor(transport, message.typeshape), message.typeshape);
+}
+
+bool CGenerator::ParseMethodProfile(StringView contents, MethodProfile* out_profile,
+                                    std::string* out_error) {
+    std::istringstream lines{std::string(contents)};
+    std::string line;
+    for (size_t line_number = 1; std::getline(lines, line); ++line_number) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string method;
+        std::string count;
+        std::string extra;
+        if (!(fields >> method))
+            continue;
+        // The method's name follows the last '.' after the library's name.
+        size_t library_end = method.find('/');
+        size_t dot = method.rfind('.');
+        bool has_method = dot != std::string::npos && dot + 1 < method.size() &&
+                          (library_end == std::string::npos || dot > library_end + 1);
+        uint64_t value;
+        if (!has_method || !(fields >> count) || fields >> extra ||
+            utils::ParseNumeric(count, &value) != utils::ParseNumericResult::kSuccess) {
+            *out_error = "line " + std::to_string(line_number) +
+                         ": expected \"Protocol.Method count\"";
+            return false;
+        }
+        (*out_profile)[method] += value;
+    }
+    return true;
+}
+
+void CGenerator::GeneratePrologues(const std::set<std::string>& includes) {
+    EmitFileComment(file_);
+    EmitHeaderGuard(file_);
+    EmitIncludeHeader(file_, "<stdalign.h>");
+    EmitIncludeHeader(file_, "<stdbool.h>");
+    EmitIncludeHeader(file_, "<stdint.h>");
+    // The setters of tables copy arrays with memcpy().
+    for (const auto& named_table : model_->named_tables) {
+        if (!HasSimpleEnvelopes(named_table.first))
+            continue;
+        const auto& members = named_table.second.members;
+        if (std::any_of(members.begin(), members.end(), [](const Member& member) {
+                return member.kind == flat::Type::Kind::kArray;
+            })) {
+            EmitIncludeHeader(file_, "<string.h>");
+            break;
+        }
+    }
+    EmitIncludeHeader(file_, "<zircon/fidl.h>");
+    EmitIncludeHeader(file_, "<zircon/syscalls/object.h>");
+    EmitIncludeHeader(file_, "<zircon/types.h>");
 
-    std::set<std::string> add_includes;
+    std::set<std::string> add_includes = includes;
     for (const auto& dep_library : library_->dependencies()) {
         if (dep_library == library_)
             continue;
@@ -652,20 +2144,20 @@ void CGenerator::GeneratePrologues() {
         add_includes.insert(NameLibraryCHeader(dep_library->name()));
     }
     for (const auto& include : add_includes) {
-        EmitIncludeHeader(&file_, "<" + include + ">");
+        EmitIncludeHeader(file_, "<" + include + ">");
     }
-    EmitBlank(&file_);
-    EmitBeginExternC(&file_);
-    EmitBlank(&file_);
+    EmitBlank(file_);
+    EmitBeginExternC(file_);
+    EmitBlank(file_);
 }
 
 void CGenerator::GenerateEpilogues() {
-    EmitEndExternC(&file_);
+    EmitEndExternC(file_);
 }
 
 void CGenerator::GenerateIntegerDefine(StringView name, types::PrimitiveSubtype subtype, StringView value) {
     std::string literal_macro = NamePrimitiveIntegerCConstantMacro(subtype);
-    file_ << "#define " << std::string(name) << " " << literal_macro << "(" << std::string(value) << ")\n";
+    *file_ << "#define " << std::string(name) << " " << literal_macro << "(" << std::string(value) << ")\n";
 }
 
 void CGenerator::GeneratePrimitiveDefine(StringView name, types::PrimitiveSubtype subtype,
@@ -680,14 +2172,14 @@ void CGenerator::GeneratePrimitiveDefine(StringView name, types::PrimitiveSubtyp
     case types::PrimitiveSubtype::kUint32:
     case types::PrimitiveSubtype::kUint64: {
         std::string literal_macro = NamePrimitiveIntegerCConstantMacro(subtype);
-        file_ << "#define " << std::string(name) << " " << std::string(literal_macro) << "(" << std::string(value) << ")\n";
+        *file_ << "#define " << std::string(name) << " " << std::string(literal_macro) << "(" << std::string(value) << ")\n";
         break;
     }
     case types::PrimitiveSubtype::kBool:
     case types::PrimitiveSubtype::kFloat32:
     case types::PrimitiveSubtype::kFloat64: {
-        file_ << "#define " << std::string(name) << " "
-              << "(" << std::string(value) << ")\n";
+        *file_ << "#define " << std::string(name) << " "
+               << "(" << std::string(value) << ")\n";
         break;
     }
     default:
@@ -696,29 +2188,29 @@ void CGenerator::GeneratePrimitiveDefine(StringView name, types::PrimitiveSubtyp
 }
 
 void CGenerator::GenerateStringDefine(StringView name, StringView value) {
-    file_ << "#define " << std::string(name) << " " << std::string(value) << "\n";
+    *file_ << "#define " << std::string(name) << " " << std::string(value) << "\n";
 }
 
 void CGenerator::GenerateIntegerTypedef(types::PrimitiveSubtype subtype, StringView name) {
     std::string underlying_type = NamePrimitiveCType(subtype);
-    file_ << "typedef " << underlying_type << " " << std::string(name) << ";\n";
+    *file_ << "typedef " << underlying_type << " " << std::string(name) << ";\n";
 }
 
 void CGenerator::GenerateStructTypedef(StringView name) {
-    file_ << "typedef struct " << std::string(name) << " " << std::string(name) << ";\n";
+    *file_ << "typedef struct " << std::string(name) << " " << std::string(name) << ";\n";
 }
 
 void CGenerator::GenerateStructDeclaration(StringView name, const std::vector<Member>& members, StructKind kind) {
-    file_ << "struct " << std::string(name) << " {\n";
+    *file_ << "struct " << std::string(name) << " {\n";
     if (kind == StructKind::kMessage) {
         // ensure the message is FIDL aligned
-        file_ << kIndent << "FIDL_ALIGNDECL\n";
+        *file_ << kIndent << "FIDL_ALIGNDECL\n";
     }
 
     auto emit_member = [this](const Member& member) {
-        file_ << kIndent;
-        EmitMemberDecl(&file_, member);
-        file_ << ";\n";
+        *file_ << kIndent;
+        EmitMemberDecl(file_, member);
+        *file_ << ";\n";
     };
 
     for (const auto& member : members) {
@@ -729,25 +2221,141 @@ void CGenerator::GenerateStructDeclaration(StringView name, const std::vector<Me
         emit_member(EmptyStructMember());
     }
 
-    file_ << "};\n";
+    *file_ << "};\n";
 }
 
 void CGenerator::GenerateTaggedUnionDeclaration(StringView name, const std::vector<Member>& members) {
-    file_ << "struct " << std::string(name) << " {\n";
-    file_ << kIndent << "fidl_union_tag_t tag;\n";
-    file_ << kIndent << "union {\n";
+    *file_ << "struct " << std::string(name) << " {\n";
+    *file_ << kIndent << "fidl_union_tag_t tag;\n";
+    *file_ << kIndent << "union {\n";
+    for (const auto& member : members) {
+        *file_ << kIndent << kIndent;
+        EmitMemberDecl(file_, member);
+        *file_ << ";\n";
+    }
+    *file_ << kIndent << "};\n";
+    *file_ << "};\n";
+}
+
+void CGenerator::GenerateTaggedXUnionDeclaration(StringView name,
+                                                 const std::vector<Member>& members) {
+    *file_ << "struct " << std::string(name) << " {\n";
+    *file_ << kIndent << "fidl_xunion_tag_t tag;\n";
+    *file_ << kIndent << "union {\n";
     for (const auto& member : members) {
-        file_ << kIndent << kIndent;
-        EmitMemberDecl(&file_, member);
-        file_ << ";\n";
+        *file_ << kIndent << kIndent;
+        EmitMemberDecl(file_, member);
+        *file_ << ";\n";
+    }
+    *file_ << kIndent << "};\n";
+    *file_ << "};\n";
+}
+
+// Emits <name>_is_valid() and <name>_name() for the enum |named_enum|, both
+// of which find the value's member through <name>_index(). How it does is
+// chosen from the member values: an offset from the smallest one if they
+// are dense, a 64-bit map of the values present if they span fewer than 64,
+// and otherwise a binary search of the sorted values. The names are a table
+// in the same order as the values.
+void CGenerator::GenerateEnumLookups(const NamedEnum& named_enum) {
+    const std::string& name = named_enum.name;
+    types::PrimitiveSubtype subtype = named_enum.enum_info.type->subtype;
+    auto members = NumberMembers(named_enum.enum_info, subtype);
+    size_t count = members.size();
+
+    *file_ << "static inline int " << name << "_index(" << name << " value) {\n";
+    if (count == 0u) {
+        *file_ << kIndent << "return -1;\n";
+    } else {
+        uint64_t min = members.front().bits;
+        uint64_t span = members.back().bits - min;
+        if (span == count - 1u) {
+            *file_ << kIndent << "uint64_t offset = (uint64_t)value - UINT64_C(0x" << Hex(min)
+                   << ");\n";
+            *file_ << kIndent << "return offset < " << count << "u ? (int)offset : -1;\n";
+        } else if (span < 64u) {
+            uint64_t map = 0u;
+            for (const auto& member : members)
+                map |= uint64_t(1u) << (member.bits - min);
+            std::ostringstream map_stream;
+            map_stream << "UINT64_C(0x" << std::hex << std::uppercase << map << ")";
+            std::string map_literal = map_stream.str();
+            *file_ << kIndent << "uint64_t offset = (uint64_t)value - UINT64_C(0x" << Hex(min)
+                   << ");\n";
+            *file_ << kIndent << "if (offset >= 64u || ((" << map_literal
+                   << " >> offset) & 1u) == 0u)\n";
+            *file_ << kIndent << kIndent << "return -1;\n";
+            *file_ << kIndent << "return __builtin_popcountll(" << map_literal
+                   << " & ((UINT64_C(1) << offset) - 1u));\n";
+        } else {
+            *file_ << kIndent << "static const " << name << " kValues[" << count << "] = {";
+            for (size_t i = 0; i < count; ++i)
+                *file_ << (i == 0 ? "" : ", ") << members[i].value;
+            *file_ << "};\n";
+            *file_ << kIndent << "int low = 0;\n";
+            *file_ << kIndent << "int high = " << count << ";\n";
+            *file_ << kIndent << "while (low < high) {\n";
+            *file_ << kIndent << kIndent << "int middle = low + (high - low) / 2;\n";
+            *file_ << kIndent << kIndent << "if (kValues[middle] < value)\n";
+            *file_ << kIndent << kIndent << kIndent << "low = middle + 1;\n";
+            *file_ << kIndent << kIndent << "else\n";
+            *file_ << kIndent << kIndent << kIndent << "high = middle;\n";
+            *file_ << kIndent << "}\n";
+            *file_ << kIndent << "return low < " << count
+                   << " && kValues[low] == value ? low : -1;\n";
+        }
+    }
+    *file_ << "}\n";
+
+    *file_ << "static inline bool " << name << "_is_valid(" << name << " value) {\n";
+    *file_ << kIndent << "return " << name << "_index(value) >= 0;\n";
+    *file_ << "}\n";
+
+    *file_ << "static inline const char* " << name << "_name(" << name << " value) {\n";
+    if (count == 0u) {
+        *file_ << kIndent << "return NULL;\n";
+    } else {
+        *file_ << kIndent << "static const char* const kNames[" << count << "] = {";
+        for (size_t i = 0; i < count; ++i)
+            *file_ << (i == 0 ? "" : ", ") << "\"" << members[i].name << "\"";
+        *file_ << "};\n";
+        *file_ << kIndent << "int index = " << name << "_index(value);\n";
+        *file_ << kIndent << "return index >= 0 ? kNames[index] : NULL;\n";
     }
-    file_ << kIndent << "};\n";
-    file_ << "};\n";
+    *file_ << "}\n";
 }
 
-void CGenerator::GenerateTaggedXUnionDeclaration(StringView name,
-                                                 const std::vector<Member>& members) {
-    // XUnions are (intentionally) unimplemented for C bindings.
+// Emits <name>_MASK and <name>_is_valid() for the bits |named_bits|, and
+// <name>_name(), which names a single member from a table indexed by its
+// bit.
+void CGenerator::GenerateBitsLookups(const NamedBits& named_bits) {
+    const std::string& name = named_bits.name;
+    const auto& bits_info = named_bits.bits_info;
+    auto subtype = static_cast<const flat::PrimitiveType*>(bits_info.subtype_ctor->type)->subtype;
+    std::string mask_name = name + "_MASK";
+    GenerateIntegerDefine(mask_name, subtype, std::to_string(bits_info.mask));
+
+    *file_ << "static inline bool " << name << "_is_valid(" << name << " value) {\n";
+    *file_ << kIndent << "return ((uint64_t)value & ~(uint64_t)" << mask_name << ") == 0u;\n";
+    *file_ << "}\n";
+
+    *file_ << "static inline const char* " << name << "_name(" << name << " value) {\n";
+    if (bits_info.mask == 0u) {
+        *file_ << kIndent << "return NULL;\n";
+    } else {
+        std::vector<std::string> names(64u - __builtin_clzll(bits_info.mask));
+        for (const auto& member : NumberMembers(bits_info, subtype))
+            names[__builtin_ctzll(member.bits)] = "\"" + member.name + "\"";
+        *file_ << kIndent << "static const char* const kNames[" << names.size() << "] = {";
+        for (size_t i = 0; i < names.size(); ++i)
+            *file_ << (i == 0 ? "" : ", ") << (names[i].empty() ? "NULL" : names[i]);
+        *file_ << "};\n";
+        *file_ << kIndent << "if (((uint64_t)value & (uint64_t)" << mask_name
+               << ") == 0u || (value & (value - 1u)) != 0u)\n";
+        *file_ << kIndent << kIndent << "return NULL;\n";
+        *file_ << kIndent << "return kNames[__builtin_ctzll(value)];\n";
+    }
+    *file_ << "}\n";
 }
 
 std::map<const flat::Decl*, CGenerator::NamedBits>
@@ -780,11 +2388,13 @@ CGenerator::NameEnums(const std::vector<std::unique_ptr<flat::Enum>>& enum_infos
 }
 
 std::map<const flat::Decl*, CGenerator::NamedInterface>
-CGenerator::NameInterfaces(const std::vector<std::unique_ptr<flat::Interface>>& interface_infos) {
+CGenerator::NameInterfaces(const flat::Library* library,
+                           const std::vector<std::unique_ptr<flat::Interface>>& interface_infos) {
     std::map<const flat::Decl*, NamedInterface> named_interfaces;
     for (const auto& interface_info : interface_infos) {
         NamedInterface named_interface;
         named_interface.c_name = NameInterface(*interface_info);
+        named_interface.qualified_name = NameName(interface_info->name, ".", "/");
         if (interface_info->HasAttribute("Discoverable")) {
             named_interface.discoverable_name = NameDiscoverable(*interface_info);
         }
@@ -810,6 +2420,7 @@ CGenerator::NameInterfaces(const std::vector<std::unique_ptr<flat::Interface>>&
                         std::move(coded_name),
                         method.maybe_request->members,
                         method.maybe_request->typeshape,
+                        GenerateMembers(library, method.maybe_request->members),
                     });
             }
             if (method.maybe_response != nullptr) {
@@ -825,6 +2436,7 @@ CGenerator::NameInterfaces(const std::vector<std::unique_ptr<flat::Interface>>&
                         std::move(coded_name),
                         method.maybe_response->members,
                         method.maybe_response->typeshape,
+                        GenerateMembers(library, method.maybe_response->members),
                     });
             }
             named_interface.methods.push_back(std::move(named_method));
@@ -837,7 +2449,8 @@ CGenerator::NameInterfaces(const std::vector<std::unique_ptr<flat::Interface>>&
 }
 
 std::map<const flat::Decl*, CGenerator::NamedStruct>
-CGenerator::NameStructs(const std::vector<std::unique_ptr<flat::Struct>>& struct_infos) {
+CGenerator::NameStructs(const flat::Library* library,
+                        const std::vector<std::unique_ptr<flat::Struct>>& struct_infos) {
     std::map<const flat::Decl*, NamedStruct> named_structs;
     for (const auto& struct_info : struct_infos) {
         if (struct_info->anonymous)
@@ -849,26 +2462,35 @@ CGenerator::NameStructs(const std::vector<std::unique_ptr<flat::Struct>>& struct
             NamedStruct{
                 std::move(c_name),
                 std::move(coded_name),
-                *struct_info
+                *struct_info,
+                GenerateMembers(library, struct_info->members),
             });
     }
     return named_structs;
 }
 
 std::map<const flat::Decl*, CGenerator::NamedTable>
-CGenerator::NameTables(const std::vector<std::unique_ptr<flat::Table>>& table_infos) {
+CGenerator::NameTables(const flat::Library* library,
+                       const std::vector<std::unique_ptr<flat::Table>>& table_infos) {
     std::map<const flat::Decl*, NamedTable> named_tables;
     for (const auto& table_info : table_infos) {
         std::string c_name = NameName(table_info->name, "_", "_");
         std::string coded_name = c_name + "Coded";
+        std::vector<Member> members;
+        for (const auto& member : table_info->members) {
+            if (member.maybe_used)
+                members.push_back(CreateMember(library, *member.maybe_used));
+        }
         named_tables.emplace(table_info.get(),
-                             NamedTable{std::move(c_name), std::move(coded_name), *table_info});
+                             NamedTable{std::move(c_name), std::move(coded_name), *table_info,
+                                        std::move(members)});
     }
     return named_tables;
 }
 
 std::map<const flat::Decl*, CGenerator::NamedUnion>
-CGenerator::NameUnions(const std::vector<std::unique_ptr<flat::Union>>& union_infos) {
+CGenerator::NameUnions(const flat::Library* library,
+                       const std::vector<std::unique_ptr<flat::Union>>& union_infos) {
     std::map<const flat::Decl*, NamedUnion> named_unions;
     for (const auto& union_info : union_infos) {
         std::string union_name = NameName(union_info->name, "_", "_");
@@ -876,18 +2498,26 @@ CGenerator::NameUnions(const std::vector<std::unique_ptr<flat::Union>>& union_in
             union_info.get(),
             NamedUnion{
                 std::move(union_name),
-                *union_info
+                *union_info,
+                GenerateMembers(library, union_info->members),
             });
     }
     return named_unions;
 }
 
 std::map<const flat::Decl*, CGenerator::NamedXUnion>
-CGenerator::NameXUnions(const std::vector<std::unique_ptr<flat::XUnion>>& xunion_infos) {
+CGenerator::NameXUnions(const flat::Library* library,
+                        const std::vector<std::unique_ptr<flat::XUnion>>& xunion_infos) {
     std::map<const flat::Decl*, NamedXUnion> named_xunions;
     for (const auto& xunion_info : xunion_infos) {
         std::string xunion_name = NameName(xunion_info->name, "_", "_");
-        named_xunions.emplace(xunion_info.get(), NamedXUnion{std::move(xunion_name), *xunion_info});
+        named_xunions.emplace(
+            xunion_info.get(),
+            NamedXUnion{
+                std::move(xunion_name),
+                *xunion_info,
+                GenerateMembers(library, xunion_info->members),
+            });
     }
     return named_xunions;
 }
@@ -901,7 +2531,8 @@ void CGenerator::ProduceBitsForwardDeclaration(const NamedBits& named_bits) {
         BitsValue(member.value.get(), &member_value);
         GenerateIntegerDefine(member_name, subtype, std::move(member_value));
     }
-    EmitBlank(&file_);
+    GenerateBitsLookups(named_bits);
+    EmitBlank(file_);
 }
 
 void CGenerator::ProduceConstForwardDeclaration(const NamedConst& named_const) {
@@ -917,21 +2548,19 @@ void CGenerator::ProduceEnumForwardDeclaration(const NamedEnum& named_enum) {
         EnumValue(member.value.get(), &member_value);
         GenerateIntegerDefine(member_name, subtype, std::move(member_value));
     }
-    EmitBlank(&file_);
+    GenerateEnumLookups(named_enum);
+    EmitBlank(file_);
 }
 
 void CGenerator::ProduceInterfaceForwardDeclaration(const NamedInterface& named_interface) {
     if (!named_interface.discoverable_name.empty()) {
-        file_ << "#define " << named_interface.c_name << "_Name \"" << named_interface.discoverable_name << "\"\n";
+        *file_ << "#define " << named_interface.c_name << "_Name \"" << named_interface.discoverable_name << "\"\n";
     }
     for (const auto& method_info : named_interface.methods) {
-        {
-            IOFlagsGuard reset_flags(&file_);
-            file_ << "#define " << method_info.ordinal_name << " ((uint32_t)0x"
-                  << std::uppercase << std::hex << method_info.ordinal << std::dec << ")\n";
-            file_ << "#define " << method_info.generated_ordinal_name << " ((uint32_t)0x"
-                  << std::uppercase << std::hex << method_info.generated_ordinal << std::dec << ")\n";
-        }
+        *file_ << "#define " << method_info.ordinal_name << " ((uint32_t)0x"
+               << Hex(method_info.ordinal) << ")\n";
+        *file_ << "#define " << method_info.generated_ordinal_name << " ((uint32_t)0x"
+               << Hex(method_info.generated_ordinal) << ")\n";
         if (method_info.request)
             GenerateStructTypedef(method_info.request->c_name);
         if (method_info.response)
@@ -958,9 +2587,9 @@ void CGenerator::ProduceXUnionForwardDeclaration(const NamedXUnion& named_xunion
 void CGenerator::ProduceInterfaceExternDeclaration(const NamedInterface& named_interface) {
     for (const auto& method_info : named_interface.methods) {
         if (method_info.request)
-            file_ << "extern const fidl_type_t " << method_info.request->coded_name << ";\n";
+            *file_ << "extern const fidl_type_t " << method_info.request->coded_name << ";\n";
         if (method_info.response)
-            file_ << "extern const fidl_type_t " << method_info.response->coded_name << ";\n";
+            *file_ << "extern const fidl_type_t " << method_info.response->coded_name << ";\n";
     }
 }
 
@@ -987,47 +2616,52 @@ void CGenerator::ProduceConstDeclaration(const NamedConst& named_const) {
         break;
     }
 
-    EmitBlank(&file_);
+    EmitBlank(file_);
 }
 
-void CGenerator::ProduceMessageDeclaration(const NamedMessage& named_message) {
+void CGenerator::ProduceMessageDeclaration(const NamedMessage& named_message,
+                                           Transport transport) {
     std::vector<CGenerator::Member> members;
-    members.reserve(1 + named_message.parameters.size());
+    members.reserve(1 + named_message.members.size());
     members.push_back(MessageHeader());
-    for (const auto& parameter : named_message.parameters) {
-        members.push_back(CreateMember(library_, parameter));
-    }
+    members.insert(members.end(), named_message.members.begin(), named_message.members.end());
 
     GenerateStructDeclaration(named_message.c_name, members, StructKind::kMessage);
 
-    EmitBlank(&file_);
+    // The most bytes and handles the message can take up, with which callers
+    // can size the buffers they pass to the caller-allocating client methods.
+    uint64_t max_num_bytes = static_cast<uint64_t>(
+        MessageInlineSize(named_message.parameters, named_message.typeshape)) +
+        named_message.typeshape.MaxOutOfLine();
+    max_num_bytes = std::min(max_num_bytes, static_cast<uint64_t>(ZX_CHANNEL_MAX_MSG_BYTES));
+    uint32_t max_num_handles = GetMaxHandlesFor(transport, named_message.typeshape);
+    GenerateIntegerDefine(named_message.c_name + "_MAX_NUM_BYTES",
+                          types::PrimitiveSubtype::kUint32,
+                          std::to_string(max_num_bytes));
+    GenerateIntegerDefine(named_message.c_name + "_MAX_NUM_HANDLES",
+                          types::PrimitiveSubtype::kUint32,
+                          std::to_string(max_num_handles));
+
+    EmitBlank(file_);
 }
 
 void CGenerator::ProduceInterfaceDeclaration(const NamedInterface& named_interface) {
     for (const auto& method_info : named_interface.methods) {
         if (method_info.request)
-            ProduceMessageDeclaration(*method_info.request);
+            ProduceMessageDeclaration(*method_info.request, named_interface.transport);
         if (method_info.response)
-            ProduceMessageDeclaration(*method_info.response);
+            ProduceMessageDeclaration(*method_info.response, named_interface.transport);
     }
 }
 
 void CGenerator::ProduceStructDeclaration(const NamedStruct& named_struct) {
-    std::vector<CGenerator::Member> members;
-    members.reserve(named_struct.struct_info.members.size());
-    for (const auto& struct_member : named_struct.struct_info.members) {
-        members.push_back(CreateMember(library_, struct_member));
-    }
-
-    GenerateStructDeclaration(named_struct.c_name, members, StructKind::kNonmessage);
+    GenerateStructDeclaration(named_struct.c_name, named_struct.members, StructKind::kNonmessage);
 
-    EmitBlank(&file_);
+    EmitBlank(file_);
 }
 
 void CGenerator::ProduceUnionDeclaration(const NamedUnion& named_union) {
-    std::vector<CGenerator::Member> members =
-        GenerateMembers(library_, named_union.union_info.members);
-    GenerateTaggedUnionDeclaration(named_union.name, members);
+    GenerateTaggedUnionDeclaration(named_union.name, named_union.members);
 
     uint32_t tag = 0u;
     for (const auto& member : named_union.union_info.members) {
@@ -1041,52 +2675,142 @@ void CGenerator::ProduceUnionDeclaration(const NamedUnion& named_union) {
         ++tag;
     }
 
-    EmitBlank(&file_);
+    EmitBlank(file_);
+}
+
+void CGenerator::ProduceTableDeclaration(const NamedTable& named_table) {
+    // Only tables that the simple bindings can pass have a body; the others
+    // are only ever seen in their wire format.
+    if (!HasSimpleEnvelopes(&named_table.table_info))
+        return;
+
+    // _present has the bit (1 << (ordinal - 1)) set for each member that is
+    // present, which is all that encoding a table looks at.
+    *file_ << "struct " << named_table.c_name << " {\n";
+    *file_ << kIndent << "uint64_t _present;\n";
+    for (const auto& member : named_table.members) {
+        *file_ << kIndent;
+        EmitMemberDecl(file_, member);
+        *file_ << ";\n";
+    }
+    *file_ << "};\n";
+    EmitBlank(file_);
+
+    size_t index = 0u;
+    for (const auto& table_member : named_table.table_info.members) {
+        if (!table_member.maybe_used)
+            continue;
+        const auto& member = named_table.members[index++];
+        std::string prefix = named_table.c_name + "_";
+        std::string bit = PresenceBit(table_member.ordinal->value);
+
+        *file_ << "static inline void " << prefix << "set_" << member.name << "("
+               << named_table.c_name << "* _table, ";
+        EmitMethodInParamDecl(file_, member);
+        *file_ << ") {\n";
+        *file_ << kIndent;
+        if (member.kind == flat::Type::Kind::kArray) {
+            *file_ << "memcpy(_table->" << member.name << ", " << member.name
+                   << ", sizeof(_table->" << member.name << "));\n";
+        } else if (member.decl_kind == flat::Decl::Kind::kStruct ||
+                   member.decl_kind == flat::Decl::Kind::kUnion) {
+            *file_ << "_table->" << member.name << " = *" << member.name << ";\n";
+        } else {
+            *file_ << "_table->" << member.name << " = " << member.name << ";\n";
+        }
+        *file_ << kIndent << "_table->_present |= " << bit << ";\n";
+        *file_ << "}\n";
+
+        *file_ << "static inline bool " << prefix << "has_" << member.name << "(const "
+               << named_table.c_name << "* _table) {\n";
+        *file_ << kIndent << "return (_table->_present & " << bit << ") != 0u;\n";
+        *file_ << "}\n";
+
+        *file_ << "static inline void " << prefix << "clear_" << member.name << "("
+               << named_table.c_name << "* _table) {\n";
+        *file_ << kIndent << "_table->_present &= ~" << bit << ";\n";
+        *file_ << "}\n";
+    }
+
+    EmitBlank(file_);
 }
 
 void CGenerator::ProduceXUnionDeclaration(const NamedXUnion& named_xunion) {
-    std::vector<CGenerator::Member> members =
-        GenerateMembers(library_, named_xunion.xunion_info.members);
-    GenerateTaggedXUnionDeclaration(named_xunion.name, members);
+    // As with tables, only extensible unions that the simple bindings can
+    // pass have a body. A tag of 0 means that no member is set.
+    if (!named_xunion.members.empty() && HasSimpleEnvelopes(&named_xunion.xunion_info))
+        GenerateTaggedXUnionDeclaration(named_xunion.name, named_xunion.members);
 
-    uint32_t tag = 0u;
+    // The tags are the members' ordinals, which is what the wire format
+    // carries.
     for (const auto& member : named_xunion.xunion_info.members) {
         std::string tag_name = NameXUnionTag(named_xunion.name, member);
-        std::ostringstream value;
-        value << tag;
         GenerateIntegerDefine(
             std::move(tag_name),
             types::PrimitiveSubtype::kUint32,
-            value.str());
-        ++tag;
+            std::to_string(member.ordinal->value));
     }
 
-    EmitBlank(&file_);
+    EmitBlank(file_);
 }
 
 void CGenerator::ProduceInterfaceClientDeclaration(const NamedInterface& named_interface) {
     for (const auto& method_info : named_interface.methods) {
         if (!method_info.request)
             continue;
-        std::vector<Member> request;
-        std::vector<Member> response;
-        GetMethodParameters(library_, method_info, &request, &response);
-        EmitClientMethodDecl(&file_, method_info.c_name, request, response);
-        file_ << ";\n";
+        const auto& request = method_info.request->members;
+        const auto& response = MessageMembers(method_info.response);
+        EmitClientMethodDecl(file_, method_info.c_name, request, response);
+        *file_ << ";\n";
+        EmitClientCallerAllocMethodDecl(file_, method_info.c_name, request, response);
+        *file_ << ";\n";
+        if (!response.empty()) {
+            EmitClientViewMethodDecl(file_, method_info.c_name, request,
+                                     method_info.response->c_name);
+            *file_ << ";\n";
+        }
+        if (method_info.response) {
+            EmitClientBeginMethodDecl(file_, method_info.c_name, request);
+            *file_ << ";\n";
+        }
+    }
+    EmitBlank(file_);
+
+    // The responses to _begin calls, and events, are delivered to callbacks
+    // along with their transaction ids. The response is decoded in place in
+    // the buffer passed to _dispatch_responses, and only valid during the
+    // call, but handles in it belong to the callback. Protocols without
+    // responses or events have nothing to dispatch, and C has no empty
+    // structs.
+    if (!HasResponses(named_interface)) {
+        EmitBlank(file_);
+        return;
+    }
+    *file_ << "typedef struct " << named_interface.c_name << "_callbacks {\n";
+    for (const auto& method_info : named_interface.methods) {
+        if (!method_info.response)
+            continue;
+        *file_ << kIndent << "void (*" << method_info.identifier << ")(void* ctx, zx_txid_t txid, "
+               << method_info.response->c_name << "* response);\n";
     }
+    *file_ << "} " << named_interface.c_name << "_callbacks_t;\n\n";
+    EmitClientDispatchResponsesDecl(file_, named_interface.c_name);
+    *file_ << ";\n";
 
-    EmitBlank(&file_);
+    EmitBlank(file_);
 }
 
 void CGenerator::ProduceInterfaceClientImplementation(const NamedInterface& named_interface) {
+    // The statements that send a request and receive and decode its response
+    // are the same in the caller-allocating and the view-returning flavors of
+    // a method, so they are generated once and emitted into both.
+    OutputSink statements;
     for (const auto& method_info : named_interface.methods) {
         if (!method_info.request)
             continue;
-        std::vector<Member> request;
-        std::vector<Member> response;
-        GetMethodParameters(library_, method_info, &request, &response);
+        const auto& request = method_info.request->members;
+        const auto& response = MessageMembers(method_info.response);
 
-        size_t count = CountSecondaryObjects(request);
         size_t request_hcount = GetMaxHandlesFor(named_interface.transport,
                                                  method_info.request->typeshape);
         size_t response_hcount = 0;
@@ -1096,289 +2820,608 @@ void CGenerator::ProduceInterfaceClientImplementation(const NamedInterface& name
         }
         size_t max_hcount = std::max(request_hcount, response_hcount);
 
-        bool has_padding = method_info.request->typeshape.HasPadding();
-        bool encode_request = (count > 0) || (request_hcount > 0) || has_padding;
-
-        EmitClientMethodDecl(&file_, method_info.c_name, request, response);
-        file_ << " {\n";
-        EmitParameterSizeValidation(&file_, request);
-        file_ << kIndent << "uint32_t _wr_num_bytes = sizeof(" << method_info.request->c_name << ")";
-        EmitMeasureInParams(&file_, request);
-        file_ << ";\n";
-        file_ << kIndent << "FIDL_ALIGNDECL char _wr_bytes[_wr_num_bytes];\n";
-        file_ << kIndent << method_info.request->c_name << "* _request = (" << method_info.request->c_name << "*)_wr_bytes;\n";
-        file_ << kIndent << "memset(_wr_bytes, 0, sizeof(_wr_bytes));\n";
-        file_ << kIndent << "_request->hdr.ordinal = " << method_info.ordinal_name << ";\n";
-        EmitLinearizeMessage(&file_, "_request", "_wr_bytes", request);
-        const char* handles_value = "NULL";
-        if (max_hcount > 0) {
-            file_ << kIndent << "zx_handle_t _handles[" << max_hcount << "];\n";
-            handles_value = "_handles";
+        bool encode_request = NeedsCoding(request, request_hcount, method_info.request->typeshape);
+        bool decode_response = method_info.response &&
+            NeedsCoding(response, response_hcount, method_info.response->typeshape);
+
+        // For Codegen::kSize, every flavor of the method passes pointers to
+        // its arguments, and the descriptors of its messages, to the shared
+        // routines that build, send, receive and copy out messages.
+        if (UsesStubs(named_interface, method_info)) {
+            assert(coding_ == Coding::kTables);
+            EmitStubMessage(file_, *method_info.request, request_hcount, encode_request);
+            if (method_info.response)
+                EmitStubMessage(file_, *method_info.response, response_hcount, decode_response);
+            std::string method_name = method_info.c_name + "_method";
+            *file_ << "static const fidl_c_method_t " << method_name << " = {\n";
+            *file_ << kIndent << ".ordinal = " << method_info.ordinal_name << ",\n";
+            *file_ << kIndent << ".request = &" << method_info.request->c_name << "_message,\n";
+            if (method_info.response) {
+                *file_ << kIndent << ".response = &" << method_info.response->c_name << "_message,\n";
+            } else {
+                *file_ << kIndent << ".response = NULL,\n";
+            }
+            *file_ << "};\n\n";
+
+            EmitClientCallerAllocMethodDecl(file_, method_info.c_name, request, response);
+            *file_ << " {\n";
+            std::string in_args = EmitStubInArgs(file_, request, "_in");
+            std::string out_args = EmitStubOutArgs(file_, response);
+            *file_ << kIndent << "return fidl_c_call(_channel, &" << method_name
+                   << ", _bytes, _bytes_capacity, _handles, _handles_capacity, " << in_args
+                   << ", " << out_args << ", NULL);\n";
+            *file_ << "}\n\n";
+
+            // The runtime sizes the stack buffers of the original flavor.
+            EmitClientMethodDecl(file_, method_info.c_name, request, response);
+            *file_ << " {\n";
+            EmitStubInArgs(file_, request, "_in");
+            EmitStubOutArgs(file_, response);
+            *file_ << kIndent << "return fidl_c_call(_channel, &" << method_name
+                   << ", NULL, 0u, NULL, 0u, " << in_args << ", " << out_args << ", NULL);\n";
+            *file_ << "}\n\n";
+
+            if (!response.empty()) {
+                EmitClientViewMethodDecl(file_, method_info.c_name, request,
+                                         method_info.response->c_name);
+                *file_ << " {\n";
+                EmitStubInArgs(file_, request, "_in");
+                *file_ << kIndent << "return fidl_c_call(_channel, &" << method_name
+                       << ", _bytes, _bytes_capacity, _handles, _handles_capacity, " << in_args
+                       << ", NULL, (void**)out_response);\n";
+                *file_ << "}\n\n";
+            }
+
+            if (method_info.response) {
+                EmitClientBeginMethodDecl(file_, method_info.c_name, request);
+                *file_ << " {\n";
+                EmitStubInArgs(file_, request, "_in");
+                *file_ << kIndent << "return fidl_c_begin(_channel, &" << method_name
+                       << ", _txid, _bytes, _bytes_capacity, _handles, _handles_capacity, "
+                       << in_args << ");\n";
+                *file_ << "}\n\n";
+            }
+            continue;
         }
-        if (encode_request) {
-            file_ << kIndent << "uint32_t _wr_num_handles = 0u;\n";
-            file_ << kIndent << "zx_status_t _status = fidl_encode(&" << method_info.request->coded_name
-                  << ", _wr_bytes, _wr_num_bytes, " << handles_value << ", " << request_hcount
-                  << ", &_wr_num_handles, NULL);\n";
-            file_ << kIndent << "if (_status != ZX_OK)\n";
-            file_ << kIndent << kIndent << "return _status;\n";
-        } else {
-            file_ << kIndent << "// OPTIMIZED AWAY fidl_encode() of POD-only request\n";
+
+        if (coding_ == Coding::kInline) {
+            if (encode_request) {
+                InlineCodingEmitter encoder(file_, InlineCodingEmitter::Direction::kEncode);
+                encode_request = encoder.EmitFunction(method_info.request->c_name,
+                                                      method_info.request->parameters,
+                                                      method_info.request->typeshape);
+            }
+            if (decode_response) {
+                InlineCodingEmitter decoder(file_, InlineCodingEmitter::Direction::kDecode);
+                decoder.EmitFunction(method_info.response->c_name, method_info.response->parameters,
+                                     method_info.response->typeshape);
+            }
         }
-        if (!method_info.response) {
-            switch (named_interface.transport) {
-            case Transport::Channel:
-                if (encode_request) {
-                    file_ << kIndent << "return zx_channel_write(_channel, 0u, _wr_bytes, _wr_num_bytes, " << handles_value << ", _wr_num_handles);\n";
-                } else {
-                    file_ << kIndent << "return zx_channel_write(_channel, 0u, _wr_bytes, _wr_num_bytes, NULL, 0);\n";
-                }
+
+        // The caller-allocating flavor builds the request in the caller's
+        // buffer, zeroing only its padding, and receives the response into
+        // the same buffer.
+        EmitClientCallerAllocMethodDecl(file_, method_info.c_name, request, response);
+        *file_ << " {\n";
+        OutputSink* file = file_;
+        file_ = &statements;
+        if (max_hcount == 0) {
+            *file_ << kIndent << "(void)_handles;\n";
+            *file_ << kIndent << "(void)_handles_capacity;\n";
+        }
+        EmitParameterSizeValidation(file_, request);
+        *file_ << kIndent << "uint32_t _wr_num_bytes = sizeof(" << method_info.request->c_name << ")";
+        EmitMeasureInParams(file_, request);
+        *file_ << ";\n";
+        *file_ << kIndent << "if (_wr_num_bytes > _bytes_capacity";
+        if (max_hcount > 0)
+            *file_ << " || _handles_capacity < " << max_hcount;
+        *file_ << ")\n";
+        *file_ << kIndent << kIndent << "return ZX_ERR_BUFFER_TOO_SMALL;\n";
+        *file_ << kIndent << "char* _wr_bytes = (char*)_bytes;\n";
+        *file_ << kIndent << method_info.request->c_name << "* _request = (" << method_info.request->c_name << "*)_wr_bytes;\n";
+        EmitZeroMessagePadding(file_, "_wr_bytes", method_info.request->parameters,
+                               method_info.request->typeshape);
+        *file_ << kIndent << "_request->hdr.ordinal = " << method_info.ordinal_name << ";\n";
+        EmitLinearizeMessage(file_, "_request", "_wr_bytes", request, true);
+        const char* handles_value = max_hcount > 0 ? "_handles" : "NULL";
+        if (encode_request) {
+            *file_ << kIndent << "uint32_t _wr_num_handles = 0u;\n";
+            switch (coding_) {
+            case Coding::kTables:
+                *file_ << kIndent << "zx_status_t _status = fidl_encode(&" << method_info.request->coded_name
+                       << ", _wr_bytes, _wr_num_bytes, " << handles_value << ", " << request_hcount
+                       << ", &_wr_num_handles, NULL);\n";
                 break;
-            case Transport::SocketControl:
-                file_ << kIndent << "return fidl_socket_write_control(_channel, _wr_bytes, _wr_num_bytes);\n";
+            case Coding::kInline:
+                *file_ << kIndent << "zx_status_t _status = " << method_info.request->c_name
+                       << "_encode(_wr_bytes, " << handles_value << ", " << request_hcount
+                       << ", &_wr_num_handles);\n";
                 break;
             }
+            *file_ << kIndent << "if (_status != ZX_OK)\n";
+            *file_ << kIndent << kIndent << "return _status;\n";
+        } else {
+            *file_ << kIndent << "// OPTIMIZED AWAY fidl_encode() of POD-only request\n";
+        }
+        std::string request_statements = statements.TakeContents();
+        // One-way methods, and the _begin flavor of two-way methods, send the
+        // request without waiting for a response.
+        switch (named_interface.transport) {
+        case Transport::Channel:
+            if (encode_request) {
+                *file_ << kIndent << "return zx_channel_write(_channel, 0u, _wr_bytes, _wr_num_bytes, " << handles_value << ", _wr_num_handles);\n";
+            } else {
+                *file_ << kIndent << "return zx_channel_write(_channel, 0u, _wr_bytes, _wr_num_bytes, NULL, 0);\n";
+            }
+            break;
+        case Transport::SocketControl:
+            *file_ << kIndent << "return fidl_socket_write_control(_channel, _wr_bytes, _wr_num_bytes);\n";
+            break;
+        }
+        std::string write_statements = statements.TakeContents();
+        if (!method_info.response) {
+            *file_ << write_statements;
         } else {
-            file_ << kIndent << "uint32_t _rd_num_bytes = sizeof(" << method_info.response->c_name << ")";
-            EmitMeasureOutParams(&file_, response);
-            file_ << ";\n";
-            file_ << kIndent << "FIDL_ALIGNDECL char _rd_bytes[_rd_num_bytes];\n";
+            *file_ << kIndent << "char* _rd_bytes = _wr_bytes;\n";
+            *file_ << kIndent << "uint32_t _rd_num_bytes = _bytes_capacity;\n";
             if (!response.empty())
-                file_ << kIndent << method_info.response->c_name << "* _response = (" << method_info.response->c_name << "*)_rd_bytes;\n";
+                *file_ << kIndent << method_info.response->c_name << "* _response = (" << method_info.response->c_name << "*)_rd_bytes;\n";
             switch (named_interface.transport) {
             case Transport::Channel:
-                file_ << kIndent << "zx_channel_call_args_t _args = {\n";
-                file_ << kIndent << kIndent << ".wr_bytes = _wr_bytes,\n";
-                file_ << kIndent << kIndent << ".wr_handles = " << handles_value << ",\n";
-                file_ << kIndent << kIndent << ".rd_bytes = _rd_bytes,\n";
-                file_ << kIndent << kIndent << ".rd_handles = " << handles_value << ",\n";
-                file_ << kIndent << kIndent << ".wr_num_bytes = _wr_num_bytes,\n";
+                *file_ << kIndent << "zx_channel_call_args_t _args = {\n";
+                *file_ << kIndent << kIndent << ".wr_bytes = _wr_bytes,\n";
+                *file_ << kIndent << kIndent << ".wr_handles = " << handles_value << ",\n";
+                *file_ << kIndent << kIndent << ".rd_bytes = _rd_bytes,\n";
+                *file_ << kIndent << kIndent << ".rd_handles = " << handles_value << ",\n";
+                *file_ << kIndent << kIndent << ".wr_num_bytes = _wr_num_bytes,\n";
                 if (encode_request) {
-                    file_ << kIndent << kIndent << ".wr_num_handles = _wr_num_handles,\n";
+                    *file_ << kIndent << kIndent << ".wr_num_handles = _wr_num_handles,\n";
                 } else {
-                    file_ << kIndent << kIndent << ".wr_num_handles = 0,\n";
+                    *file_ << kIndent << kIndent << ".wr_num_handles = 0,\n";
                 }
-                file_ << kIndent << kIndent << ".rd_num_bytes = _rd_num_bytes,\n";
-                file_ << kIndent << kIndent << ".rd_num_handles = " << response_hcount << ",\n";
-                file_ << kIndent << "};\n";
+                *file_ << kIndent << kIndent << ".rd_num_bytes = _rd_num_bytes,\n";
+                *file_ << kIndent << kIndent << ".rd_num_handles = " << response_hcount << ",\n";
+                *file_ << kIndent << "};\n";
 
-                file_ << kIndent << "uint32_t _actual_num_bytes = 0u;\n";
-                file_ << kIndent << "uint32_t _actual_num_handles = 0u;\n";
+                *file_ << kIndent << "uint32_t _actual_num_bytes = 0u;\n";
+                *file_ << kIndent << "uint32_t _actual_num_handles = 0u;\n";
                 if (encode_request) {
-                    file_ << kIndent;
+                    *file_ << kIndent;
                 } else {
-                    file_ << kIndent << "zx_status_t ";
+                    *file_ << kIndent << "zx_status_t ";
                 }
-                file_ << "_status = zx_channel_call(_channel, 0u, ZX_TIME_INFINITE, &_args, &_actual_num_bytes, &_actual_num_handles);\n";
+                *file_ << "_status = zx_channel_call(_channel, 0u, ZX_TIME_INFINITE, &_args, &_actual_num_bytes, &_actual_num_handles);\n";
                 break;
             case Transport::SocketControl:
-                file_ << kIndent << "size_t _actual_num_bytes = 0u;\n";
+                *file_ << kIndent << "size_t _actual_num_bytes = 0u;\n";
                 if (encode_request) {
-                    file_ << kIndent;
+                    *file_ << kIndent;
                 } else {
-                    file_ << kIndent << "zx_status_t ";
+                    *file_ << kIndent << "zx_status_t ";
                 }
-                file_ << "_status = fidl_socket_call_control(_channel, _wr_bytes, _wr_num_bytes, _rd_bytes, _rd_num_bytes, &_actual_num_bytes);\n";
+                *file_ << "_status = fidl_socket_call_control(_channel, _wr_bytes, _wr_num_bytes, _rd_bytes, _rd_num_bytes, &_actual_num_bytes);\n";
                 break;
             }
-            file_ << kIndent << "if (_status != ZX_OK)\n";
-            file_ << kIndent << kIndent << "return _status;\n";
+            *file_ << kIndent << "if (_status != ZX_OK)\n";
+            *file_ << kIndent << kIndent << "return _status;\n";
+        }
+        file_ = file;
+        std::string call_statements = request_statements + statements.TakeContents();
+        *file_ << call_statements;
 
+        std::string decode_statements;
+        if (method_info.response) {
             // We check that we have enough capacity to copy out the parameters
             // before decoding the message so that we can close the handles
             // using |_handles| rather than trying to find them in the decoded
             // message.
-            count = CountSecondaryObjects(response);
-            has_padding = method_info.response->typeshape.HasPadding();
-            bool decode_response = (count > 0) || (response_hcount > 0) || has_padding;
+            // The members of tables and extensible unions are copied into
+            // structs of fixed size, which always have room for them.
+            size_t count = std::count_if(response.begin(), response.end(), [](const Member& member) {
+                return IsStoredOutOfLine(member) && !IsEnvelopeContainer(member);
+            });
             if (count > 0u) {
-                file_ << kIndent << "if ";
+                *file_ << kIndent << "if ";
                 if (count > 1u)
-                    file_ << "(";
+                    *file_ << "(";
                 size_t i = 0;
                 for (const auto& member : response) {
                     if (member.kind == flat::Type::Kind::kVector) {
                         if (i++ > 0u)
-                            file_ << " || ";
-                        file_ << "(_response->" << member.name << ".count > " << member.name << "_capacity)";
+                            *file_ << " || ";
+                        *file_ << "(_response->" << member.name << ".count > " << member.name << "_capacity)";
                     } else if (member.kind == flat::Type::Kind::kString) {
                         if (i++ > 0u)
-                            file_ << " || ";
-                        file_ << "(_response->" << member.name << ".size > " << member.name << "_capacity)";
-                    } else if (IsStoredOutOfLine(member)) {
+                            *file_ << " || ";
+                        *file_ << "(_response->" << member.name << ".size > " << member.name << "_capacity)";
+                    } else if (IsStoredOutOfLine(member) && !IsEnvelopeContainer(member)) {
                         if (i++ > 0u)
-                            file_ << " || ";
-                        file_ << "((uintptr_t)_response->" << member.name << " == FIDL_ALLOC_PRESENT && out_" << member.name << " == NULL)";
+                            *file_ << " || ";
+                        *file_ << "((uintptr_t)_response->" << member.name << " == FIDL_ALLOC_PRESENT && out_" << member.name << " == NULL)";
                     }
                 }
                 if (count > 1u)
-                    file_ << ")";
-                file_ << " {\n";
+                    *file_ << ")";
+                *file_ << " {\n";
                 if (response_hcount > 0) {
-                    file_ << kIndent << kIndent << "zx_handle_close_many(_handles, _actual_num_handles);\n";
+                    *file_ << kIndent << kIndent << "zx_handle_close_many(_handles, _actual_num_handles);\n";
                 }
-                file_ << kIndent << kIndent << "return ZX_ERR_BUFFER_TOO_SMALL;\n";
-                file_ << kIndent << "}\n";
+                *file_ << kIndent << kIndent << "return ZX_ERR_BUFFER_TOO_SMALL;\n";
+                *file_ << kIndent << "}\n";
             }
 
+            file_ = &statements;
             if (decode_response) {
                 // TODO(FIDL-162): Validate the response ordinal. C++ bindings also need to do that.
+                std::string handles_args;
                 switch (named_interface.transport) {
                 case Transport::Channel:
-                    file_ << kIndent << "_status = fidl_decode(&" << method_info.response->coded_name
-                          << ", _rd_bytes, _actual_num_bytes, " << handles_value << ", _actual_num_handles, NULL);\n";
+                    handles_args = std::string(handles_value) + ", _actual_num_handles";
                     break;
                 case Transport::SocketControl:
-                    file_ << kIndent << "_status = fidl_decode(&" << method_info.response->coded_name
-                          << ", _rd_bytes, _actual_num_bytes, NULL, 0, NULL);\n";
+                    handles_args = "NULL, 0";
                     break;
                 }
-                file_ << kIndent << "if (_status != ZX_OK)\n";
-                file_ << kIndent << kIndent << "return _status;\n";
-            } else {
-                file_ << kIndent << "// OPTIMIZED AWAY fidl_decode() of POD-only response\n";
-            }
-            for (const auto& member : response) {
-                const auto& name = member.name;
-                switch (member.kind) {
-                case flat::Type::Kind::kArray:
-                    file_ << kIndent << "memcpy(out_" << name << ", _response->" << name << ", ";
-                    EmitArraySizeOf(&file_, member);
-                    file_ << ");\n";
-                    break;
-                case flat::Type::Kind::kVector:
-                    file_ << kIndent << "memcpy(" << name << "_buffer, _response->" << name << ".data, sizeof(*" << name << "_buffer) * _response->" << name << ".count);\n";
-                    file_ << kIndent << "*out_" << name << "_count = _response->" << name << ".count;\n";
-                    break;
-                case flat::Type::Kind::kString:
-                    file_ << kIndent << "memcpy(" << name << "_buffer, _response->" << name << ".data, _response->" << name << ".size);\n";
-                    file_ << kIndent << "*out_" << name << "_size = _response->" << name << ".size;\n";
-                    break;
-                case flat::Type::Kind::kHandle:
-                case flat::Type::Kind::kPrimitive:
-                    file_ << kIndent << "*out_" << name << " = _response->" << name << ";\n";
+                switch (coding_) {
+                case Coding::kTables:
+                    *file_ << kIndent << "_status = fidl_decode(&" << method_info.response->coded_name
+                           << ", _rd_bytes, _actual_num_bytes, " << handles_args << ", NULL);\n";
                     break;
-                case flat::Type::Kind::kIdentifier:
-                    switch (member.decl_kind) {
-                    case flat::Decl::Kind::kConst:
-                        assert(false && "bad decl kind for member");
-                        break;
-                    case flat::Decl::Kind::kBits:
-                    case flat::Decl::Kind::kEnum:
-                    case flat::Decl::Kind::kInterface:
-                        file_ << kIndent << "*out_" << name << " = _response->" << name << ";\n";
-                        break;
-                    case flat::Decl::Kind::kTable:
-                        assert(false && "c-codegen for tables not yet implemented");
-                        break;
-                    case flat::Decl::Kind::kXUnion:
-                        assert(false && "c-codegen for extensible unions not yet implemented");
-                        break;
-                    case flat::Decl::Kind::kStruct:
-                    case flat::Decl::Kind::kUnion:
-                        switch (member.nullability) {
-                        case types::Nullability::kNullable:
-                            file_ << kIndent << "if (_response->" << name << ") {\n";
-                            file_ << kIndent << kIndent << "*out_" << name << " = *(_response->" << name << ");\n";
-                            file_ << kIndent << "} else {\n";
-                            // We don't have a great way of signaling that the optional response member
-                            // was not in the message. That means these bindings aren't particularly
-                            // useful when the client needs to extract that bit. The best we can do is
-                            // zero out the value to make sure the client has defined behavior.
-                            //
-                            // In many cases, the response contains other information (e.g., a status code)
-                            // that lets the client do something reasonable.
-                            file_ << kIndent << kIndent << "memset(out_" << name << ", 0, sizeof(*out_" << name << "));\n";
-                            file_ << kIndent << "}\n";
-                            break;
-                        case types::Nullability::kNonnullable:
-                            file_ << kIndent << "*out_" << name << " = _response->" << name << ";\n";
-                            break;
-                        }
-                        break;
-                    }
+                case Coding::kInline:
+                    *file_ << kIndent << "_status = " << method_info.response->c_name
+                           << "_decode(_rd_bytes, _actual_num_bytes, " << handles_args << ");\n";
                     break;
                 }
+                *file_ << kIndent << "if (_status != ZX_OK)\n";
+                *file_ << kIndent << kIndent << "return _status;\n";
+            } else {
+                *file_ << kIndent << "// OPTIMIZED AWAY fidl_decode() of POD-only response\n";
             }
+            file_ = file;
+            decode_statements = statements.TakeContents();
+            *file_ << decode_statements;
+            EmitCopyOutMessage(file_, "_response", response);
+            *file_ << kIndent << "return ZX_OK;\n";
+        }
+        *file_ << "}\n\n";
+
+        // The original flavor allocates the buffers on the stack, sized for
+        // this call's parameters.
+        EmitClientMethodDecl(file_, method_info.c_name, request, response);
+        *file_ << " {\n";
+        EmitParameterSizeValidation(file_, request);
+        *file_ << kIndent << "uint32_t _wr_num_bytes = sizeof(" << method_info.request->c_name << ")";
+        EmitMeasureInParams(file_, request);
+        *file_ << ";\n";
+        if (method_info.response) {
+            *file_ << kIndent << "uint32_t _rd_num_bytes = sizeof(" << method_info.response->c_name << ")";
+            EmitMeasureOutParams(file_, response);
+            *file_ << ";\n";
+            *file_ << kIndent << "FIDL_ALIGNDECL char _bytes[_wr_num_bytes > _rd_num_bytes ? _wr_num_bytes : _rd_num_bytes];\n";
+        } else {
+            *file_ << kIndent << "FIDL_ALIGNDECL char _bytes[_wr_num_bytes];\n";
+        }
+        if (max_hcount > 0)
+            *file_ << kIndent << "zx_handle_t _handles[" << max_hcount << "];\n";
+        *file_ << kIndent << "return " << method_info.c_name << "_caller_alloc(_channel, _bytes, sizeof(_bytes), "
+               << handles_value << ", " << max_hcount;
+        for (const auto& member : request) {
+            *file_ << ", ";
+            EmitMethodInParamNames(file_, member);
+        }
+        for (const auto& member : response) {
+            *file_ << ", ";
+            EmitMethodOutParamNames(file_, member);
+        }
+        *file_ << ");\n";
+        *file_ << "}\n\n";
+
+        if (!response.empty()) {
+            EmitClientViewMethodDecl(file_, method_info.c_name, request,
+                                     method_info.response->c_name);
+            *file_ << " {\n";
+            *file_ << call_statements;
+            *file_ << decode_statements;
+            *file_ << kIndent << "*out_response = _response;\n";
+            *file_ << kIndent << "return ZX_OK;\n";
+            *file_ << "}\n\n";
+        }
+
+        if (method_info.response) {
+            EmitClientBeginMethodDecl(file_, method_info.c_name, request);
+            *file_ << " {\n";
+            *file_ << request_statements;
+            *file_ << kIndent << "_request->hdr.txid = _txid;\n";
+            *file_ << write_statements;
+            *file_ << "}\n\n";
+        }
+    }
+
+    ProduceInterfaceClientDispatchResponses(named_interface);
+}
+
+bool CGenerator::HasResponses(const NamedInterface& named_interface) {
+    for (const auto& method_info : named_interface.methods) {
+        if (method_info.response)
+            return true;
+    }
+    return false;
+}
+
+bool CGenerator::UsesStubs(const NamedInterface& named_interface,
+                           const NamedMethod& method_info) const {
+    if (codegen_ != Codegen::kSize || named_interface.transport != Transport::Channel)
+        return false;
+    for (const auto* message : {method_info.request.get(), method_info.response.get()}) {
+        if (message != nullptr &&
+            std::any_of(message->members.begin(), message->members.end(), IsEnvelopeContainer))
+            return false;
+    }
+    return true;
+}
+
+void CGenerator::ProduceInterfaceClientDispatchResponses(const NamedInterface& named_interface) {
+    if (!HasResponses(named_interface))
+        return;
+
+    // Events have no client method to emit their decoders along with.
+    if (coding_ == Coding::kInline) {
+        for (const auto& method_info : named_interface.methods) {
+            if (method_info.request || !method_info.response)
+                continue;
+            size_t hcount = GetMaxHandlesFor(named_interface.transport,
+                                             method_info.response->typeshape);
+            if (!NeedsCoding(method_info.response->members, hcount, method_info.response->typeshape))
+                continue;
+            InlineCodingEmitter decoder(file_, InlineCodingEmitter::Direction::kDecode);
+            decoder.EmitFunction(method_info.response->c_name, method_info.response->parameters,
+                                 method_info.response->typeshape);
+        }
+    }
 
-            file_ << kIndent << "return ZX_OK;\n";
+    EmitClientDispatchResponsesDecl(file_, named_interface.c_name);
+    *file_ << " {\n";
+    *file_ << kIndent << "size_t _num_responses = 0u;\n";
+    *file_ << kIndent << "zx_status_t _status = ZX_OK;\n";
+    *file_ << kIndent << "while (_num_responses < max_responses) {\n";
+    switch (named_interface.transport) {
+    case Transport::Channel:
+        *file_ << kIndent << kIndent << "uint32_t _actual_num_bytes = 0u;\n";
+        *file_ << kIndent << kIndent << "uint32_t _actual_num_handles = 0u;\n";
+        *file_ << kIndent << kIndent << "_status = zx_channel_read(_channel, 0u, _bytes, _handles, _bytes_capacity, "
+               << "_handles_capacity, &_actual_num_bytes, &_actual_num_handles);\n";
+        break;
+    case Transport::SocketControl:
+        *file_ << kIndent << kIndent << "size_t _actual_num_bytes = 0u;\n";
+        *file_ << kIndent << kIndent << "uint32_t _actual_num_handles = 0u;\n";
+        *file_ << kIndent << kIndent << "_status = fidl_socket_read_control(_channel, _bytes, _bytes_capacity, "
+               << "&_actual_num_bytes);\n";
+        break;
+    }
+    *file_ << kIndent << kIndent << "if (_status == ZX_ERR_SHOULD_WAIT) {\n";
+    *file_ << kIndent << kIndent << kIndent << "_status = ZX_OK;\n";
+    *file_ << kIndent << kIndent << kIndent << "break;\n";
+    *file_ << kIndent << kIndent << "}\n";
+    *file_ << kIndent << kIndent << "if (_status != ZX_OK)\n";
+    *file_ << kIndent << kIndent << kIndent << "break;\n";
+    *file_ << kIndent << kIndent << "++_num_responses;\n";
+    *file_ << kIndent << kIndent << "if (_actual_num_bytes < sizeof(fidl_message_header_t)) {\n";
+    *file_ << kIndent << kIndent << kIndent << "zx_handle_close_many(_handles, _actual_num_handles);\n";
+    *file_ << kIndent << kIndent << kIndent << "_status = ZX_ERR_INVALID_ARGS;\n";
+    *file_ << kIndent << kIndent << kIndent << "break;\n";
+    *file_ << kIndent << kIndent << "}\n";
+    *file_ << kIndent << kIndent << "fidl_message_header_t* _hdr = (fidl_message_header_t*)_bytes;\n";
+    *file_ << kIndent << kIndent << "switch (_hdr->ordinal) {\n";
+    for (const auto& method_info : named_interface.methods) {
+        if (!method_info.response)
+            continue;
+        const auto& response = method_info.response->members;
+        size_t hcount = GetMaxHandlesFor(named_interface.transport, method_info.response->typeshape);
+        if (method_info.ordinal != method_info.generated_ordinal)
+            *file_ << kIndent << kIndent << "case " << method_info.generated_ordinal_name << ":\n";
+        *file_ << kIndent << kIndent << "case " << method_info.ordinal_name << ":\n";
+        // Unwanted responses are dropped before decoding, while their
+        // handles are still all in |_handles|.
+        *file_ << kIndent << kIndent << kIndent << "if (callbacks->" << method_info.identifier << " == NULL) {\n";
+        *file_ << kIndent << kIndent << kIndent << kIndent << "zx_handle_close_many(_handles, _actual_num_handles);\n";
+        *file_ << kIndent << kIndent << kIndent << kIndent << "continue;\n";
+        *file_ << kIndent << kIndent << kIndent << "}\n";
+        if (NeedsCoding(response, hcount, method_info.response->typeshape)) {
+            switch (coding_) {
+            case Coding::kTables:
+                *file_ << kIndent << kIndent << kIndent << "_status = fidl_decode(&" << method_info.response->coded_name
+                       << ", _bytes, _actual_num_bytes, _handles, _actual_num_handles, NULL);\n";
+                break;
+            case Coding::kInline:
+                *file_ << kIndent << kIndent << kIndent << "_status = " << method_info.response->c_name
+                       << "_decode(_bytes, _actual_num_bytes, _handles, _actual_num_handles);\n";
+                break;
+            }
+            *file_ << kIndent << kIndent << kIndent << "if (_status != ZX_OK)\n";
+            *file_ << kIndent << kIndent << kIndent << kIndent << "break;\n";
+        } else {
+            *file_ << kIndent << kIndent << kIndent << "// OPTIMIZED AWAY fidl_decode() of POD-only response\n";
+            *file_ << kIndent << kIndent << kIndent << "if (_actual_num_bytes != sizeof(" << method_info.response->c_name
+                   << ") || _actual_num_handles != 0u) {\n";
+            *file_ << kIndent << kIndent << kIndent << kIndent << "zx_handle_close_many(_handles, _actual_num_handles);\n";
+            *file_ << kIndent << kIndent << kIndent << kIndent << "_status = ZX_ERR_INVALID_ARGS;\n";
+            *file_ << kIndent << kIndent << kIndent << kIndent << "break;\n";
+            *file_ << kIndent << kIndent << kIndent << "}\n";
         }
-        file_ << "}\n\n";
+        *file_ << kIndent << kIndent << kIndent << "(*callbacks->" << method_info.identifier << ")(ctx, _hdr->txid, ("
+               << method_info.response->c_name << "*)_bytes);\n";
+        *file_ << kIndent << kIndent << kIndent << "continue;\n";
     }
-} 
+    *file_ << kIndent << kIndent << "default:\n";
+    *file_ << kIndent << kIndent << kIndent << "zx_handle_close_many(_handles, _actual_num_handles);\n";
+    *file_ << kIndent << kIndent << kIndent << "_status = ZX_ERR_NOT_SUPPORTED;\n";
+    *file_ << kIndent << kIndent << kIndent << "break;\n";
+    *file_ << kIndent << kIndent << "}\n";
+    *file_ << kIndent << kIndent << "break;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "if (out_num_responses)\n";
+    *file_ << kIndent << kIndent << "*out_num_responses = _num_responses;\n";
+    *file_ << kIndent << "return _status;\n";
+    *file_ << "}\n\n";
+}
 
 void CGenerator::ProduceInterfaceServerDeclaration(const NamedInterface& named_interface) {
-    file_ << "typedef struct " << named_interface.c_name << "_ops {\n";
+    *file_ << "typedef struct " << named_interface.c_name << "_ops {\n";
     for (const auto& method_info : named_interface.methods) {
         if (!method_info.request)
             continue;
-        std::vector<Member> request;
-        GetMethodParameters(library_, method_info, &request, nullptr);
+        const auto& request = method_info.request->members;
         bool has_response = method_info.response != nullptr;
 
-        file_ << kIndent;
-        EmitServerMethodDecl(&file_, method_info.identifier, request, has_response);
-        file_ << ";\n";
+        *file_ << kIndent;
+        EmitServerMethodDecl(file_, method_info.identifier, request, has_response);
+        *file_ << ";\n";
     }
-    file_ << "} " << named_interface.c_name << "_ops_t;\n\n";
+    *file_ << "} " << named_interface.c_name << "_ops_t;\n\n";
 
-    EmitServerDispatchDecl(&file_, named_interface.c_name);
-    file_ << ";\n";
-    EmitServerTryDispatchDecl(&file_, named_interface.c_name);
-    file_ << ";\n\n";
+    EmitServerDispatchDecl(file_, named_interface.c_name);
+    *file_ << ";\n";
+    EmitServerTryDispatchDecl(file_, named_interface.c_name);
+    *file_ << ";\n\n";
 
     for (const auto& method_info : named_interface.methods) {
         if (!method_info.request || !method_info.response)
             continue;
-        std::vector<Member> response;
-        GetMethodParameters(library_, method_info, nullptr, &response);
-        EmitServerReplyDecl(&file_, method_info.c_name, response);
-        file_ << ";\n";
+        const auto& response = method_info.response->members;
+        EmitServerReplyDecl(file_, method_info.c_name, response);
+        *file_ << ";\n";
     }
 
-    EmitBlank(&file_);
+    EmitBlank(file_);
 }
 
 void CGenerator::ProduceInterfaceServerImplementation(const NamedInterface& named_interface) {
-    EmitServerTryDispatchDecl(&file_, named_interface.c_name);
-    file_ << " {\n";
-    file_ << kIndent << "if (msg->num_bytes < sizeof(fidl_message_header_t)) {\n";
-    file_ << kIndent << kIndent << "zx_handle_close_many(msg->handles, msg->num_handles);\n";
-    file_ << kIndent << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
-    file_ << kIndent << "}\n";
-    file_ << kIndent << "fidl_message_header_t* hdr = (fidl_message_header_t*)msg->bytes;\n";
-    file_ << kIndent << "zx_status_t status = ZX_OK;\n";
-    file_ << kIndent << "switch (hdr->ordinal) {\n";
-
+    // How each request is validated and decoded: POD-only requests, which
+    // most traffic is, only have their size and handle count checked, and
+    // requests with few out-of-line objects get a generated decoder even when
+    // the bindings otherwise use coding tables.
+    enum class RequestDecoding {
+        kNone,
+        kInline,
+        kTables,
+    };
+    std::vector<RequestDecoding> request_decodings;
     for (const auto& method_info : named_interface.methods) {
-        if (!method_info.request)
+        if (!method_info.request) {
+            request_decodings.push_back(RequestDecoding::kNone);
             continue;
-        if (method_info.ordinal != method_info.generated_ordinal) {
-            file_ << kIndent << "case " << method_info.generated_ordinal_name << ":\n";
-        }
-        file_ << kIndent << "case " << method_info.ordinal_name << ": {\n";
-        file_ << kIndent << kIndent << "status = fidl_decode_msg(&" << method_info.request->coded_name << ", msg, NULL);\n";
-        file_ << kIndent << kIndent << "if (status != ZX_OK)\n";
-        file_ << kIndent << kIndent << kIndent << "break;\n";
-        std::vector<Member> request;
-        GetMethodParameters(library_, method_info, &request, nullptr);
+        }
+        const auto& request = method_info.request->members;
+        size_t hcount = GetMaxHandlesFor(named_interface.transport, method_info.request->typeshape);
+        RequestDecoding decoding = RequestDecoding::kTables;
+        if (!NeedsCoding(request, hcount, method_info.request->typeshape)) {
+            decoding = RequestDecoding::kNone;
+        } else if (coding_ == Coding::kInline ||
+                   (codegen_ == Codegen::kSpeed &&
+                    CountSecondaryObjects(request) <= kMaxInlineDecodedObjects)) {
+            decoding = RequestDecoding::kInline;
+            InlineCodingEmitter decoder(file_, InlineCodingEmitter::Direction::kDecode);
+            decoder.EmitFunction(method_info.request->c_name, method_info.request->parameters,
+                                 method_info.request->typeshape);
+        }
+        request_decodings.push_back(decoding);
+    }
+
+    // With a method profile, the server checks for the protocol's hottest
+    // methods first, and the handlers of those called less than once for
+    // every kColdCallRatio calls of the hottest one are moved out of
+    // |_try_dispatch|, which keeps the hot handlers together in it.
+    constexpr uint64_t kColdCallRatio = 100u;
+    std::vector<uint64_t> call_counts(named_interface.methods.size(), 0u);
+    bool profiled = false;
+    uint64_t hottest = 0u;
+    if (method_profile_ != nullptr) {
+        for (size_t i = 0; i < named_interface.methods.size(); ++i) {
+            const std::string& identifier = named_interface.methods[i].identifier;
+            std::string name = named_interface.qualified_name + "." + identifier;
+            auto iter = method_profile_->find(name);
+            if (iter == method_profile_->end())
+                iter = method_profile_->find(name.substr(name.find('/') + 1));
+            if (iter == method_profile_->end())
+                continue;
+            profiled = true;
+            call_counts[i] = iter->second;
+            hottest = std::max(hottest, iter->second);
+        }
+    }
+    std::vector<size_t> dispatch_order(named_interface.methods.size());
+    for (size_t i = 0; i < dispatch_order.size(); ++i)
+        dispatch_order[i] = i;
+    std::stable_sort(dispatch_order.begin(), dispatch_order.end(), [&](size_t a, size_t b) {
+        return call_counts[a] > call_counts[b];
+    });
+    auto is_cold = [&](size_t i) {
+        return profiled && hottest > 0u &&
+               (call_counts[i] == 0u || call_counts[i] < hottest / kColdCallRatio);
+    };
+    // Error checks are only marked unlikely in profiled servers, so that
+    // the output does not otherwise change.
+    auto unlikely = [&](const std::string& condition) {
+        return profiled ? "__builtin_expect(" + condition + ", 0)" : condition;
+    };
+
+    // Emits the statements that decode the request of method |i| and call
+    // its handler, with |exit| leaving them when the request is invalid.
+    auto emit_handler = [&](size_t i, const std::string& indent, const char* exit) {
+        const auto& method_info = named_interface.methods[i];
+        switch (request_decodings[i]) {
+        case RequestDecoding::kNone:
+            *file_ << indent << "// OPTIMIZED AWAY fidl_decode_msg() of POD-only request\n";
+            *file_ << indent << "if ("
+                   << unlikely("msg->num_bytes != sizeof(" + method_info.request->c_name +
+                               ") || msg->num_handles != 0u")
+                   << ") {\n";
+            *file_ << indent << kIndent << "zx_handle_close_many(msg->handles, msg->num_handles);\n";
+            *file_ << indent << kIndent << "status = ZX_ERR_INVALID_ARGS;\n";
+            *file_ << indent << kIndent << exit << ";\n";
+            *file_ << indent << "}\n";
+            break;
+        case RequestDecoding::kInline:
+            *file_ << indent << "status = " << method_info.request->c_name
+                   << "_decode(msg->bytes, msg->num_bytes, msg->handles, msg->num_handles);\n";
+            *file_ << indent << "if (" << unlikely("status != ZX_OK") << ")\n";
+            *file_ << indent << kIndent << exit << ";\n";
+            break;
+        case RequestDecoding::kTables:
+            *file_ << indent << "status = fidl_decode_msg(&" << method_info.request->coded_name << ", msg, NULL);\n";
+            *file_ << indent << "if (" << unlikely("status != ZX_OK") << ")\n";
+            *file_ << indent << kIndent << exit << ";\n";
+            break;
+        }
+        const auto& request = method_info.request->members;
         if (!request.empty())
-            file_ << kIndent << kIndent << method_info.request->c_name << "* request = (" << method_info.request->c_name << "*)msg->bytes;\n";
-        file_ << kIndent << kIndent << "status = (*ops->" << method_info.identifier << ")(ctx";
+            *file_ << indent << method_info.request->c_name << "* request = (" << method_info.request->c_name << "*)msg->bytes;\n";
+        // Tables and extensible unions are passed to the server as their C
+        // structs, which are copied out of the decoded request.
+        for (const auto& member : request) {
+            if (!IsEnvelopeContainer(member))
+                continue;
+            *file_ << indent << NameName(member.type_decl->name, "_", "_") << " _"
+                   << member.name << ";\n";
+            EmitUnpackEnvelopes(file_, indent, "request->" + member.name,
+                                "_" + member.name + ".", member);
+        }
+        *file_ << indent << "status = (*ops->" << method_info.identifier << ")(ctx";
         for (const auto& member : request) {
             switch (member.kind) {
             case flat::Type::Kind::kArray:
             case flat::Type::Kind::kHandle:
             case flat::Type::Kind::kPrimitive:
-                file_ << ", request->" << member.name;
+                *file_ << ", request->" << member.name;
                 break;
             case flat::Type::Kind::kVector:
-                file_ << ", (" << member.element_type << "*)request->" << member.name << ".data"
-                      << ", request->" << member.name << ".count";
+                *file_ << ", (" << member.element_type << "*)request->" << member.name << ".data"
+                       << ", request->" << member.name << ".count";
                 break;
             case flat::Type::Kind::kString:
-                file_ << ", request->" << member.name << ".data"
-                      << ", request->" << member.name << ".size";
+                *file_ << ", request->" << member.name << ".data"
+                       << ", request->" << member.name << ".size";
                 break;
             case flat::Type::Kind::kIdentifier:
                 switch (member.decl_kind) {
@@ -1388,22 +3431,30 @@ void CGenerator::ProduceInterfaceServerImplementation(const NamedInterface& name
                 case flat::Decl::Kind::kBits:
                 case flat::Decl::Kind::kEnum:
                 case flat::Decl::Kind::kInterface:
-                    file_ << ", request->" << member.name;
+                    *file_ << ", request->" << member.name;
                     break;
                 case flat::Decl::Kind::kTable:
-                    assert(false && "c-codegen for tables not yet implemented");
+                    *file_ << ", &_" << member.name;
                     break;
                 case flat::Decl::Kind::kXUnion:
-                    assert(false && "c-codegen for extensible unions not yet implemented");
+                    switch (member.nullability) {
+                    case types::Nullability::kNullable:
+                        *file_ << ", (request->" << member.name << ".tag != 0u ? &_"
+                               << member.name << " : NULL)";
+                        break;
+                    case types::Nullability::kNonnullable:
+                        *file_ << ", &_" << member.name;
+                        break;
+                    }
                     break;
                 case flat::Decl::Kind::kStruct:
                 case flat::Decl::Kind::kUnion:
                     switch (member.nullability) {
                     case types::Nullability::kNullable:
-                        file_ << ", request->" << member.name;
+                        *file_ << ", request->" << member.name;
                         break;
                     case types::Nullability::kNonnullable:
-                        file_ << ", &(request->" << member.name << ")";
+                        *file_ << ", &(request->" << member.name << ")";
                         break;
                     }
                     break;
@@ -1411,98 +3462,167 @@ void CGenerator::ProduceInterfaceServerImplementation(const NamedInterface& name
             }
         }
         if (method_info.response != nullptr)
-            file_ << ", txn";
-        file_ << ");\n";
-        file_ << kIndent << kIndent << "break;\n";
-        file_ << kIndent << "}\n";
-    }
-    file_ << kIndent << "default: {\n";
-    file_ << kIndent << kIndent << "return ZX_ERR_NOT_SUPPORTED;\n";
-    file_ << kIndent << "}\n";
-    file_ << kIndent << "}\n";
-    file_ << kIndent << "if ("
-          << "status != ZX_OK && "
-          << "status != ZX_ERR_STOP && "
-          << "status != ZX_ERR_NEXT && "
-          << "status != ZX_ERR_ASYNC) {\n";
-    file_ << kIndent << kIndent << "return ZX_ERR_INTERNAL;\n";
-    file_ << kIndent << "} else {\n";
-    file_ << kIndent << kIndent << "return status;\n";
-    file_ << kIndent << "}\n";
-    file_ << "}\n\n";
-
-    EmitServerDispatchDecl(&file_, named_interface.c_name);
-    file_ << " {\n";
-    file_ << kIndent << "zx_status_t status = "
-          << named_interface.c_name << "_try_dispatch(ctx, txn, msg, ops);\n";
-    file_ << kIndent << "if (status == ZX_ERR_NOT_SUPPORTED)\n";
-    file_ << kIndent << kIndent << "zx_handle_close_many(msg->handles, msg->num_handles);\n";
-    file_ << kIndent << "return status;\n";
-    file_ << "}\n\n";
+            *file_ << ", txn";
+        *file_ << ");\n";
+    };
 
-    for (const auto& method_info : named_interface.methods) {
+    for (size_t i : dispatch_order) {
+        const auto& method_info = named_interface.methods[i];
+        if (!method_info.request || !is_cold(i))
+            continue;
+        *file_ << "static __attribute__((cold, noinline)) zx_status_t " << method_info.c_name
+               << "_dispatch(void* ctx, fidl_txn_t* txn, fidl_msg_t* msg, const "
+               << named_interface.c_name << "_ops_t* ops) {\n";
+        *file_ << kIndent << "zx_status_t status = ZX_OK;\n";
+        emit_handler(i, kIndent, "return status");
+        *file_ << kIndent << "return status;\n";
+        *file_ << "}\n\n";
+    }
+
+    EmitServerTryDispatchDecl(file_, named_interface.c_name);
+    *file_ << " {\n";
+    *file_ << kIndent << "if (" << unlikely("msg->num_bytes < sizeof(fidl_message_header_t)") << ") {\n";
+    *file_ << kIndent << kIndent << "zx_handle_close_many(msg->handles, msg->num_handles);\n";
+    *file_ << kIndent << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "fidl_message_header_t* hdr = (fidl_message_header_t*)msg->bytes;\n";
+    *file_ << kIndent << "zx_status_t status = ZX_OK;\n";
+    *file_ << kIndent << "switch (hdr->ordinal) {\n";
+
+    for (size_t i : dispatch_order) {
+        const auto& method_info = named_interface.methods[i];
+        if (!method_info.request)
+            continue;
+        if (method_info.ordinal != method_info.generated_ordinal) {
+            *file_ << kIndent << "case " << method_info.generated_ordinal_name << ":\n";
+        }
+        *file_ << kIndent << "case " << method_info.ordinal_name << ": {\n";
+        if (is_cold(i)) {
+            *file_ << kIndent << kIndent << "status = " << method_info.c_name
+                   << "_dispatch(ctx, txn, msg, ops);\n";
+        } else {
+            emit_handler(i, std::string(kIndent) + kIndent, "break");
+        }
+        *file_ << kIndent << kIndent << "break;\n";
+        *file_ << kIndent << "}\n";
+    }
+    *file_ << kIndent << "default: {\n";
+    *file_ << kIndent << kIndent << "return ZX_ERR_NOT_SUPPORTED;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "if ("
+           << unlikely("status != ZX_OK && "
+                       "status != ZX_ERR_STOP && "
+                       "status != ZX_ERR_NEXT && "
+                       "status != ZX_ERR_ASYNC")
+           << ") {\n";
+    *file_ << kIndent << kIndent << "return ZX_ERR_INTERNAL;\n";
+    *file_ << kIndent << "} else {\n";
+    *file_ << kIndent << kIndent << "return status;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << "}\n\n";
+
+    EmitServerDispatchDecl(file_, named_interface.c_name);
+    *file_ << " {\n";
+    *file_ << kIndent << "zx_status_t status = "
+           << named_interface.c_name << "_try_dispatch(ctx, txn, msg, ops);\n";
+    *file_ << kIndent << "if (status == ZX_ERR_NOT_SUPPORTED)\n";
+    *file_ << kIndent << kIndent << "zx_handle_close_many(msg->handles, msg->num_handles);\n";
+    *file_ << kIndent << "return status;\n";
+    *file_ << "}\n\n";
+
+    // The replies of profiled methods are likewise kept with the hot or the
+    // cold code, in .text.hot or .text.unlikely.
+    for (size_t i : dispatch_order) {
+        const auto& method_info = named_interface.methods[i];
         if (!method_info.request || !method_info.response)
             continue;
-        std::vector<Member> response;
-        GetMethodParameters(library_, method_info, nullptr, &response);
+        const auto& response = method_info.response->members;
 
         size_t hcount = GetMaxHandlesFor(named_interface.transport, method_info.response->typeshape);
+        bool encode_response = NeedsCoding(response, hcount, method_info.response->typeshape);
+
+        if (coding_ == Coding::kInline && encode_response) {
+            InlineCodingEmitter encoder(file_, InlineCodingEmitter::Direction::kEncode);
+            encode_response = encoder.EmitFunction(method_info.response->c_name,
+                                                   method_info.response->parameters,
+                                                   method_info.response->typeshape);
+        }
 
-        EmitServerReplyDecl(&file_, method_info.c_name, response);
-        file_ << " {\n";
-        file_ << kIndent << "uint32_t _wr_num_bytes = sizeof(" << method_info.response->c_name << ")";
-        EmitMeasureInParams(&file_, response);
-        file_ << ";\n";
-        file_ << kIndent << "char _wr_bytes[_wr_num_bytes];\n";
-        file_ << kIndent << method_info.response->c_name << "* _response = (" << method_info.response->c_name << "*)_wr_bytes;\n";
-        file_ << kIndent << "memset(_wr_bytes, 0, sizeof(_wr_bytes));\n";
-        file_ << kIndent << "_response->hdr.ordinal = " << method_info.ordinal_name << ";\n";
-        EmitLinearizeMessage(&file_, "_response", "_wr_bytes", response);
+        if (UsesStubs(named_interface, method_info))
+            EmitStubMessage(file_, *method_info.response, hcount, encode_response);
+        if (profiled)
+            *file_ << (is_cold(i) ? "__attribute__((cold)) " : "__attribute__((hot)) ");
+        EmitServerReplyDecl(file_, method_info.c_name, response);
+        *file_ << " {\n";
+        if (UsesStubs(named_interface, method_info)) {
+            std::string args = EmitStubInArgs(file_, response, "_args");
+            *file_ << kIndent << "return fidl_c_reply(_txn, " << method_info.ordinal_name << ", &"
+                   << method_info.response->c_name << "_message, " << args << ");\n";
+            *file_ << "}\n\n";
+            continue;
+        }
+        *file_ << kIndent << "uint32_t _wr_num_bytes = sizeof(" << method_info.response->c_name << ")";
+        EmitMeasureInParams(file_, response);
+        *file_ << ";\n";
+        *file_ << kIndent << "char _wr_bytes[_wr_num_bytes];\n";
+        *file_ << kIndent << method_info.response->c_name << "* _response = (" << method_info.response->c_name << "*)_wr_bytes;\n";
+        *file_ << kIndent << "memset(_wr_bytes, 0, sizeof(_wr_bytes));\n";
+        *file_ << kIndent << "_response->hdr.ordinal = " << method_info.ordinal_name << ";\n";
+        EmitLinearizeMessage(file_, "_response", "_wr_bytes", response, false);
         const char* handle_value = "NULL";
         if (hcount > 0) {
-            file_ << kIndent << "zx_handle_t _handles[" << hcount << "];\n";
+            *file_ << kIndent << "zx_handle_t _handles[" << hcount << "];\n";
             handle_value = "_handles";
         }
-        file_ << kIndent << "fidl_msg_t _msg = {\n";
-        file_ << kIndent << kIndent << ".bytes = _wr_bytes,\n";
-        file_ << kIndent << kIndent << ".handles = " << handle_value << ",\n";
-        file_ << kIndent << kIndent << ".num_bytes = _wr_num_bytes,\n";
-        file_ << kIndent << kIndent << ".num_handles = " << hcount << ",\n";
-        file_ << kIndent << "};\n";
-        bool has_padding = method_info.response->typeshape.HasPadding();
-        bool encode_response = (hcount > 0) || CountSecondaryObjects(response) > 0 || has_padding;
+        *file_ << kIndent << "fidl_msg_t _msg = {\n";
+        *file_ << kIndent << kIndent << ".bytes = _wr_bytes,\n";
+        *file_ << kIndent << kIndent << ".handles = " << handle_value << ",\n";
+        *file_ << kIndent << kIndent << ".num_bytes = _wr_num_bytes,\n";
+        *file_ << kIndent << kIndent << ".num_handles = " << hcount << ",\n";
+        *file_ << kIndent << "};\n";
         if (encode_response) {
-            file_ << kIndent << "zx_status_t _status = fidl_encode_msg(&"
-                  << method_info.response->coded_name << ", &_msg, &_msg.num_handles, NULL);\n";
-            file_ << kIndent << "if (_status != ZX_OK)\n";
-            file_ << kIndent << kIndent << "return _status;\n";
+            switch (coding_) {
+            case Coding::kTables:
+                *file_ << kIndent << "zx_status_t _status = fidl_encode_msg(&"
+                       << method_info.response->coded_name << ", &_msg, &_msg.num_handles, NULL);\n";
+                break;
+            case Coding::kInline:
+                *file_ << kIndent << "zx_status_t _status = " << method_info.response->c_name
+                       << "_encode(_wr_bytes, " << handle_value << ", " << hcount
+                       << ", &_msg.num_handles);\n";
+                break;
+            }
+            *file_ << kIndent << "if (_status != ZX_OK)\n";
+            *file_ << kIndent << kIndent << "return _status;\n";
         } else {
-            file_ << kIndent << "// OPTIMIZED AWAY fidl_encode() of POD-only reply\n";
+            *file_ << kIndent << "// OPTIMIZED AWAY fidl_encode() of POD-only reply\n";
         }
-        file_ << kIndent << "return _txn->reply(_txn, &_msg);\n";
-        file_ << "}\n\n";
+        *file_ << kIndent << "return _txn->reply(_txn, &_msg);\n";
+        *file_ << "}\n\n";
     }
 }
 
-std::ostringstream CGenerator::ProduceHeader() {
+void CGenerator::ProduceHeader(OutputSink* file) {
+    file_ = file;
     GeneratePrologues();
+    ProduceDeclarations(std::vector<const flat::Decl*>(library_->declaration_order_.begin(),
+                                                       library_->declaration_order_.end()));
+    GenerateEpilogues();
+}
 
-    std::map<const flat::Decl*, NamedBits> named_bits = NameBits(library_->bits_declarations_);
-    std::map<const flat::Decl*, NamedConst> named_consts =
-        NameConsts(library_->const_declarations_);
-    std::map<const flat::Decl*, NamedEnum> named_enums = NameEnums(library_->enum_declarations_);
-    std::map<const flat::Decl*, NamedInterface> named_interfaces =
-        NameInterfaces(library_->interface_declarations_);
-    std::map<const flat::Decl*, NamedStruct> named_structs = NameStructs(library_->struct_declarations_);
-    std::map<const flat::Decl*, NamedTable> named_tables = NameTables(
-        library_->table_declarations_);
-    std::map<const flat::Decl*, NamedUnion> named_unions =
-        NameUnions(library_->union_declarations_);
-    std::map<const flat::Decl*, NamedXUnion> named_xunions =
-        NameXUnions(library_->xunion_declarations_);
-
-    file_ << "\n// Forward declarations\n\n";
-    for (const auto* decl : library_->declaration_order_) {
+void CGenerator::ProduceDeclarations(const std::vector<const flat::Decl*>& decls) {
+    const auto& named_bits = model_->named_bits;
+    const auto& named_consts = model_->named_consts;
+    const auto& named_enums = model_->named_enums;
+    const auto& named_interfaces = model_->named_interfaces;
+    const auto& named_structs = model_->named_structs;
+    const auto& named_tables = model_->named_tables;
+    const auto& named_unions = model_->named_unions;
+    const auto& named_xunions = model_->named_xunions;
+
+    *file_ << "\n// Forward declarations\n\n";
+    for (const auto* decl : decls) {
         switch (decl->kind) {
         case flat::Decl::Kind::kBits: {
             auto iter = named_bits.find(decl);
@@ -1566,8 +3686,8 @@ std::ostringstream CGenerator::ProduceHeader() {
     }
 
 
-    file_ << "\n// Extern declarations\n\n";
-    for (const auto* decl : library_->declaration_order_) {
+    *file_ << "\n// Extern declarations\n\n";
+    for (const auto* decl : decls) {
         switch (decl->kind) {
         case flat::Decl::Kind::kBits:
         case flat::Decl::Kind::kConst:
@@ -1590,8 +3710,8 @@ std::ostringstream CGenerator::ProduceHeader() {
         }
     }
 
-    file_ << "\n// Declarations\n\n";
-    for (const auto* decl : library_->declaration_order_) {
+    *file_ << "\n// Declarations\n\n";
+    for (const auto* decl : decls) {
         switch (decl->kind) {
         case flat::Decl::Kind::kBits:
             // Bits can be entirely forward declared, as they have no
@@ -1622,11 +3742,14 @@ std::ostringstream CGenerator::ProduceHeader() {
             }
             break;
         }
-        case flat::Decl::Kind::kTable:
-            // Tables are entirely forward declared, and their body is defined only in
-            // implementation files.
+        case flat::Decl::Kind::kTable: {
+            auto iter = named_tables.find(decl);
+            if (iter != named_tables.end()) {
+                ProduceTableDeclaration(iter->second);
+            }
             break;
-            case flat::Decl::Kind::kUnion: {
+        }
+        case flat::Decl::Kind::kUnion: {
             auto iter = named_unions.find(decl);
             if (iter != named_unions.end()) {
                 ProduceUnionDeclaration(iter->second);
@@ -1645,8 +3768,8 @@ std::ostringstream CGenerator::ProduceHeader() {
         }
     }
 
-    file_ << "\n// Simple bindings \n\n";
-    for (const auto* decl : library_->declaration_order_) {
+    *file_ << "\n// Simple bindings \n\n";
+    for (const auto* decl : decls) {
         switch (decl->kind) {
         case flat::Decl::Kind::kBits:
         case flat::Decl::Kind::kConst:
@@ -1671,23 +3794,119 @@ std::ostringstream CGenerator::ProduceHeader() {
             abort();
         }
     }
+}
 
-    GenerateEpilogues();
+void CGenerator::ProduceSplitHeaders(std::map<std::string, std::string>* out_headers) {
+    // Finds the protocols that use each declaration: those whose messages,
+    // or those of the protocols they compose, reach it. Handles to other
+    // protocols are plain handles in C, so they do not make protocols use
+    // each other's declarations.
+    std::map<const flat::Decl*, std::set<std::string>> users;
+    for (const auto* decl : library_->declaration_order_) {
+        if (decl->kind != flat::Decl::Kind::kInterface)
+            continue;
+        std::string protocol_name = decl->name.name_part();
+        std::set<const flat::Decl*> visited = {decl};
+        std::vector<const flat::Decl*> pending = {decl};
+        while (!pending.empty()) {
+            const flat::Decl* user = pending.back();
+            pending.pop_back();
+            for (const auto* reference : library_->DeclReferences(user)) {
+                if (reference->kind == flat::Decl::Kind::kInterface &&
+                    user->kind != flat::Decl::Kind::kInterface)
+                    continue;
+                if (!visited.insert(reference).second)
+                    continue;
+                if (reference->kind != flat::Decl::Kind::kInterface)
+                    users[reference].insert(protocol_name);
+                pending.push_back(reference);
+            }
+        }
+    }
+
+    // Types that only one protocol uses are declared in its header, and
+    // those that several share are grouped by the protocols that use them,
+    // under a name that only changes when that set of protocols does.
+    auto header_of = [&users](const flat::Decl* decl) -> std::string {
+        if (decl->kind == flat::Decl::Kind::kInterface)
+            return std::string(decl->name.name_part()) + ".h";
+        auto iter = users.find(decl);
+        if (iter == users.end())
+            return "types.h";
+        if (iter->second.size() == 1u)
+            return *iter->second.begin() + ".h";
+        // FNV-1a.
+        uint32_t hash = 2166136261u;
+        for (const auto& user : iter->second) {
+            for (char c : user + ",") {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 16777619u;
+            }
+        }
+        std::ostringstream name;
+        name << "types_" << std::hex << std::uppercase << hash << ".h";
+        return name.str();
+    };
+
+    std::string header_path = NameLibraryCHeader(library_->name());
+    std::string directory = header_path.substr(0, header_path.rfind('/') + 1u);
+    std::map<std::string, std::vector<const flat::Decl*>> header_decls;
+    std::map<std::string, std::set<std::string>> header_includes;
+    for (const auto* decl : library_->declaration_order_) {
+        std::string header = header_of(decl);
+        header_decls[header].push_back(decl);
+        auto& includes = header_includes[header];
+        for (const auto* reference : library_->DeclReferences(decl)) {
+            if (reference->kind == flat::Decl::Kind::kInterface)
+                continue;
+            std::string include = header_of(reference);
+            if (include != header)
+                includes.insert(directory + include);
+        }
+    }
 
-    return std::move(file_);
+    OutputSink umbrella;
+    EmitFileComment(&umbrella);
+    EmitHeaderGuard(&umbrella);
+    for (const auto& header : header_decls) {
+        OutputSink file;
+        file_ = &file;
+        GeneratePrologues(header_includes[header.first]);
+        const auto& decls = header.second;
+        if (decls.front()->kind != flat::Decl::Kind::kInterface) {
+            auto iter = users.find(decls.front());
+            if (iter != users.end() && iter->second.size() > 1u) {
+                *file_ << "// Types shared by";
+                const char* separator = " ";
+                for (const auto& user : iter->second) {
+                    *file_ << separator << user;
+                    separator = ", ";
+                }
+                *file_ << ".\n";
+            }
+        }
+        ProduceDeclarations(decls);
+        GenerateEpilogues();
+        file_ = nullptr;
+        (*out_headers)[header.first] = file.TakeContents();
+        EmitIncludeHeader(&umbrella, "<" + directory + header.first + ">");
+    }
+    (*out_headers)["fidl.h"] = umbrella.TakeContents();
 }
 
-std::ostringstream CGenerator::ProduceClient() {
-    EmitFileComment(&file_);
-    EmitIncludeHeader(&file_, "<lib/fidl/coding.h>");
-    EmitIncludeHeader(&file_, "<lib/fidl/transport.h>");
-    EmitIncludeHeader(&file_, "<string.h>");
-    EmitIncludeHeader(&file_, "<zircon/syscalls.h>");
-    EmitIncludeHeader(&file_, "<" + NameLibraryCHeader(library_->name()) + ">"); 
-    EmitBlank(&file_);
+void CGenerator::ProduceClient(OutputSink* file) {
+    file_ = file;
+    EmitFileComment(file_);
+    EmitIncludeHeader(file_, "<lib/fidl/coding.h>");
+    if (codegen_ == Codegen::kSize)
+        EmitIncludeHeader(file_, "<lib/fidl/stubs.h>");
+    EmitIncludeHeader(file_, "<lib/fidl/transport.h>");
+    EmitIncludeHeader(file_, "<string.h>");
+    EmitIncludeHeader(file_, "<zircon/syscalls.h>");
+    EmitIncludeHeader(file_, "<" + NameLibraryCHeader(library_->name()) + ">"); 
+    EmitBlank(file_);
 
-    std::map<const flat::Decl*, NamedInterface> named_interfaces =
-        NameInterfaces(library_->interface_declarations_);
+    const auto& named_interfaces = model_->named_interfaces;
 
     for (const auto* decl : library_->declaration_order_) {
         switch (decl->kind) {
@@ -1713,20 +3932,20 @@ std::ostringstream CGenerator::ProduceClient() {
             abort();
         }
     }
-
-    return std::move(file_);
 }
 
-std::ostringstream CGenerator::ProduceServer() {
-    EmitFileComment(&file_);
-    EmitIncludeHeader(&file_, "<lib/fidl/coding.h>");
-    EmitIncludeHeader(&file_, "<string.h>");
-    EmitIncludeHeader(&file_, "<zircon/syscalls.h>");
-    EmitIncludeHeader(&file_, "<" + NameLibraryCHeader(library_->name()) + ">");
-    EmitBlank(&file_);
+void CGenerator::ProduceServer(OutputSink* file) {
+    file_ = file;
+    EmitFileComment(file_);
+    EmitIncludeHeader(file_, "<lib/fidl/coding.h>");
+    if (codegen_ == Codegen::kSize)
+        EmitIncludeHeader(file_, "<lib/fidl/stubs.h>");
+    EmitIncludeHeader(file_, "<string.h>");
+    EmitIncludeHeader(file_, "<zircon/syscalls.h>");
+    EmitIncludeHeader(file_, "<" + NameLibraryCHeader(library_->name()) + ">");
+    EmitBlank(file_);
 
-    std::map<const flat::Decl*, NamedInterface> named_interfaces =
-        NameInterfaces(library_->interface_declarations_);
+    const auto& named_interfaces = model_->named_interfaces;
 
     for (const auto* decl : library_->declaration_order_) {
         switch (decl->kind) {
@@ -1752,8 +3971,299 @@ std::ostringstream CGenerator::ProduceServer() {
             abort();
         }
     }
+}
+
+
+std::string CGenerator::ProduceMessageBench(const NamedInterface& named_interface,
+                                            const NamedMethod& method_info,
+                                            const NamedMessage& named_message) {
+    const auto& members = named_message.members;
+    const std::string& c_name = named_message.c_name;
+    size_t hcount = GetMaxHandlesFor(named_interface.transport, named_message.typeshape);
+
+    // The benchmark fills structs, unions and arrays with zeroes, which
+    // only leaves handles valid if they are absent, and does not fill tables
+    // or extensible unions.
+    size_t num_handle_members = 0u;
+    size_t num_out_of_line_members = 0u;
+    for (const auto& member : members) {
+        if (IsEnvelopeContainer(member)) {
+            *file_ << "// " << c_name << " is not benchmarked: it carries a table or an extensible union.\n\n";
+            return "";
+        }
+        if (member.kind == flat::Type::Kind::kHandle ||
+            (member.kind == flat::Type::Kind::kIdentifier &&
+             member.decl_kind == flat::Decl::Kind::kInterface))
+            ++num_handle_members;
+        if (member.kind == flat::Type::Kind::kVector || member.kind == flat::Type::Kind::kString)
+            ++num_out_of_line_members;
+    }
+    if (num_handle_members != hcount) {
+        *file_ << "// " << c_name << " is not benchmarked: it carries handles in structs, unions, arrays or vectors.\n\n";
+        return "";
+    }
+
+    bool encodes = NeedsCoding(members, hcount, named_message.typeshape);
+    bool decodes = encodes;
+    if (encodes && coding_ == Coding::kInline) {
+        InlineCodingEmitter encoder(file_, InlineCodingEmitter::Direction::kEncode);
+        encodes = encoder.EmitFunction(c_name, named_message.parameters, named_message.typeshape);
+        InlineCodingEmitter decoder(file_, InlineCodingEmitter::Direction::kDecode);
+        decoder.EmitFunction(c_name, named_message.parameters, named_message.typeshape);
+    }
+
+    // Builds the message from the parameters of a client method or reply.
+    *file_ << "static zx_status_t " << c_name << "_linearize(char* _bytes, uint32_t* _out_num_bytes";
+    for (const auto& member : members) {
+        *file_ << ", ";
+        EmitMethodInParamDecl(file_, member);
+    }
+    *file_ << ") {\n";
+    *file_ << kIndent << "uint32_t _wr_num_bytes = sizeof(" << c_name << ")";
+    EmitMeasureInParams(file_, members);
+    *file_ << ";\n";
+    *file_ << kIndent << c_name << "* _message = (" << c_name << "*)_bytes;\n";
+    EmitZeroMessagePadding(file_, "_bytes", named_message.parameters, named_message.typeshape);
+    *file_ << kIndent << "_message->hdr.ordinal = " << method_info.ordinal_name << ";\n";
+    EmitLinearizeMessage(file_, "_message", "_bytes", members, true);
+    *file_ << kIndent << "*_out_num_bytes = _wr_num_bytes;\n";
+    *file_ << kIndent << "return ZX_OK;\n";
+    *file_ << "}\n\n";
+
+    // Copies the decoded message out to the out parameters of a client method.
+    *file_ << "static void " << c_name << "_copy_out(const " << c_name << "* _message";
+    for (const auto& member : members) {
+        *file_ << ", ";
+        EmitMethodOutParamDecl(file_, member);
+    }
+    *file_ << ") {\n";
+    EmitCopyOutMessage(file_, "_message", members);
+    *file_ << "}\n\n";
+
+    // Nullable members are present on even iterations, and absent on odd
+    // ones.
+    auto absent = [](const Member& member, const std::string& value, const std::string& absent_value) {
+        if (member.nullability != types::Nullability::kNullable)
+            return value;
+        return "(_i & 1u) ? " + absent_value + " : " + value;
+    };
+    auto is_handle = [](const Member& member) {
+        return member.kind == flat::Type::Kind::kHandle ||
+               (member.kind == flat::Type::Kind::kIdentifier &&
+                member.decl_kind == flat::Decl::Kind::kInterface);
+    };
+
+    std::string bench_name = c_name + "_bench";
+    *file_ << "static void " << bench_name << "(size_t _iterations, zx_time_t* _samples) {\n";
+    std::vector<std::string> in_args;
+    std::vector<std::string> out_args;
+    for (size_t i = 0; i < members.size(); ++i) {
+        const auto& member = members[i];
+        const auto& name = member.name;
+        std::string dimensions;
+        for (uint32_t array_count : member.array_counts)
+            dimensions += "[" + std::to_string(array_count) + "]";
+        switch (member.kind) {
+        case flat::Type::Kind::kArray:
+            *file_ << kIndent << "static " << member.type << " " << name << dimensions << ";\n";
+            *file_ << kIndent << "static " << member.type << " out_" << name << dimensions << ";\n";
+            in_args.push_back(name);
+            out_args.push_back("out_" + name);
+            break;
+        case flat::Type::Kind::kVector:
+        case flat::Type::Kind::kString: {
+            bool is_vector = member.kind == flat::Type::Kind::kVector;
+            const flat::Type* type = named_message.parameters[i].type_ctor->type;
+            uint32_t element_size = is_vector
+                ? static_cast<const flat::VectorType*>(type)->element_type->shape.Size() : 1u;
+            uint32_t count = member.max_num_elements == std::numeric_limits<uint32_t>::max()
+                ? kBenchUnboundedCount : member.max_num_elements;
+            count = std::min<uint32_t>(
+                count, kBenchMaxOutOfLineBytes / num_out_of_line_members / std::max(element_size, 1u));
+            std::string element_type = is_vector ? member.element_type : "char";
+            std::string length = name + (is_vector ? "_count" : "_size");
+            // C has no arrays of zero elements.
+            std::string storage = "[" + std::to_string(std::max(count, 1u)) + "]";
+            *file_ << kIndent << "static " << element_type << " " << name << "_data" << storage << ";\n";
+            *file_ << kIndent << "size_t " << length << " = " << count << "u;\n";
+            if (!is_vector) {
+                *file_ << kIndent << "memset(" << name << "_data, 'x', sizeof(" << name << "_data));\n";
+            } else if (element_type == "bool") {
+                *file_ << kIndent << "memset(" << name << "_data, 1, sizeof(" << name << "_data));\n";
+            } else if (static_cast<const flat::VectorType*>(type)->element_type->kind ==
+                       flat::Type::Kind::kPrimitive) {
+                *file_ << kIndent << "memset(" << name << "_data, 0x5A, sizeof(" << name << "_data));\n";
+            }
+            *file_ << kIndent << "static " << element_type << " " << name << "_buffer" << storage << ";\n";
+            *file_ << kIndent << "size_t out_" << length << " = 0u;\n";
+            in_args.push_back(absent(member, name + "_data", "NULL") + ", " +
+                              absent(member, length, "0u"));
+            out_args.push_back(name + "_buffer, " + std::to_string(count) + "u, &out_" + length);
+            break;
+        }
+        case flat::Type::Kind::kHandle:
+        case flat::Type::Kind::kPrimitive:
+        case flat::Type::Kind::kIdentifier:
+            if (is_handle(member)) {
+                *file_ << kIndent << member.type << " " << name << " = ZX_HANDLE_INVALID;\n";
+                *file_ << kIndent << "zx_handle_t " << name << "_peer = ZX_HANDLE_INVALID;\n";
+                *file_ << kIndent << member.type << " out_" << name << " = ZX_HANDLE_INVALID;\n";
+                in_args.push_back(name);
+                out_args.push_back("&out_" + name);
+            } else if (member.kind == flat::Type::Kind::kIdentifier &&
+                       (member.decl_kind == flat::Decl::Kind::kStruct ||
+                        member.decl_kind == flat::Decl::Kind::kUnion)) {
+                std::string decl_name = NameName(member.type_decl->name, "_", "_");
+                *file_ << kIndent << "static " << decl_name << " " << name << ";\n";
+                *file_ << kIndent << "static " << decl_name << " out_" << name << ";\n";
+                in_args.push_back(absent(member, "&" + name, "NULL"));
+                out_args.push_back("&out_" + name);
+            } else {
+                *file_ << kIndent << member.type << " " << name << " = (" << member.type << ")0x5A;\n";
+                *file_ << kIndent << member.type << " out_" << name << ";\n";
+                in_args.push_back(name);
+                out_args.push_back("&out_" + name);
+            }
+            break;
+        }
+    }
+    if (decodes) {
+        *file_ << kIndent << "zx_handle_t _handles[" << std::max<size_t>(hcount, 1u) << "];\n";
+        *file_ << kIndent << "uint32_t _num_handles = 0u;\n";
+    }
+    *file_ << kIndent << "uint32_t _num_bytes = 0u;\n";
+    *file_ << kIndent << "zx_time_t _t[5];\n";
+    *file_ << kIndent << "for (size_t _i = 0u; _i < _iterations; ++_i) {\n";
+    for (const auto& member : members) {
+        if (!is_handle(member))
+            continue;
+        std::string create = "zx_channel_create(0u, &" + member.name + ", &" + member.name + "_peer)";
+        if (member.nullability == types::Nullability::kNullable) {
+            *file_ << kIndent << kIndent << member.name << " = ZX_HANDLE_INVALID;\n";
+            *file_ << kIndent << kIndent << member.name << "_peer = ZX_HANDLE_INVALID;\n";
+            *file_ << kIndent << kIndent << "if ((_i & 1u) == 0u && " << create << " != ZX_OK)\n";
+        } else {
+            *file_ << kIndent << kIndent << "if (" << create << " != ZX_OK)\n";
+        }
+        *file_ << kIndent << kIndent << kIndent << "bench_fail(\"zx_channel_create\", ZX_ERR_NO_RESOURCES);\n";
+    }
+    if (decodes)
+        *file_ << kIndent << kIndent << "_num_handles = 0u;\n";
+    *file_ << kIndent << kIndent << "_t[0] = zx_clock_get_monotonic();\n";
+    *file_ << kIndent << kIndent << "zx_status_t _status = " << c_name << "_linearize(bench_bytes, &_num_bytes";
+    for (const auto& arg : in_args)
+        *file_ << ", " << arg;
+    *file_ << ");\n";
+    *file_ << kIndent << kIndent << "_t[1] = zx_clock_get_monotonic();\n";
+    if (encodes) {
+        *file_ << kIndent << kIndent << "if (_status == ZX_OK)\n";
+        switch (coding_) {
+        case Coding::kTables:
+            *file_ << kIndent << kIndent << kIndent << "_status = fidl_encode(&" << named_message.coded_name
+                   << ", bench_bytes, _num_bytes, _handles, " << hcount << ", &_num_handles, NULL);\n";
+            break;
+        case Coding::kInline:
+            *file_ << kIndent << kIndent << kIndent << "_status = " << c_name
+                   << "_encode(bench_bytes, _handles, " << hcount << ", &_num_handles);\n";
+            break;
+        }
+    }
+    *file_ << kIndent << kIndent << "_t[2] = zx_clock_get_monotonic();\n";
+    if (decodes) {
+        *file_ << kIndent << kIndent << "if (_status == ZX_OK)\n";
+        switch (coding_) {
+        case Coding::kTables:
+            *file_ << kIndent << kIndent << kIndent << "_status = fidl_decode(&" << named_message.coded_name
+                   << ", bench_bytes, _num_bytes, _handles, _num_handles, NULL);\n";
+            break;
+        case Coding::kInline:
+            *file_ << kIndent << kIndent << kIndent << "_status = " << c_name
+                   << "_decode(bench_bytes, _num_bytes, _handles, _num_handles);\n";
+            break;
+        }
+    }
+    *file_ << kIndent << kIndent << "if (_status != ZX_OK)\n";
+    *file_ << kIndent << kIndent << kIndent << "bench_fail(\"" << c_name << "\", _status);\n";
+    *file_ << kIndent << kIndent << "_t[3] = zx_clock_get_monotonic();\n";
+    *file_ << kIndent << kIndent << c_name << "_copy_out((const " << c_name << "*)bench_bytes";
+    for (const auto& arg : out_args)
+        *file_ << ", " << arg;
+    *file_ << ");\n";
+    *file_ << kIndent << kIndent << "_t[4] = zx_clock_get_monotonic();\n";
+    *file_ << kIndent << kIndent << "bench_record(_samples, _iterations, _i, _t);\n";
+    if (hcount > 0u) {
+        *file_ << kIndent << kIndent << "zx_handle_close_many(_handles, _num_handles);\n";
+        for (const auto& member : members) {
+            if (!is_handle(member))
+                continue;
+            *file_ << kIndent << kIndent << "if (" << member.name << "_peer != ZX_HANDLE_INVALID)\n";
+            *file_ << kIndent << kIndent << kIndent << "zx_handle_close(" << member.name << "_peer);\n";
+        }
+    }
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "bench_report(\"" << c_name << "\", _samples, _iterations, "
+           << (encodes ? "true" : "false") << ", " << (decodes ? "true" : "false") << ");\n";
+    *file_ << "}\n\n";
+    return bench_name;
+}
+
+void CGenerator::ProduceBench(OutputSink* file) {
+    file_ = file;
+    EmitFileComment(file_);
+    *file_ << "// Times building, encoding, decoding and copying out each message of the\n";
+    *file_ << "// library's simple protocols, as the C client and server do, filled with\n";
+    *file_ << "// vectors and strings of their bounded size, and with nullable members\n";
+    *file_ << "// present on every other iteration. Link it with the --tables output.\n";
+    *file_ << "//\n";
+    *file_ << "// Usage: bench [iterations]\n\n";
+    EmitIncludeHeader(file_, "<lib/fidl/coding.h>");
+    EmitIncludeHeader(file_, "<stdio.h>");
+    EmitIncludeHeader(file_, "<stdlib.h>");
+    EmitIncludeHeader(file_, "<string.h>");
+    EmitIncludeHeader(file_, "<zircon/syscalls.h>");
+    EmitIncludeHeader(file_, "<" + NameLibraryCHeader(library_->name()) + ">");
+    EmitBlank(file_);
+    EmitBenchRuntime(file_);
+
+    std::vector<std::string> benches;
+    for (const auto* decl : library_->declaration_order_) {
+        if (decl->kind != flat::Decl::Kind::kInterface || !HasSimpleLayout(decl))
+            continue;
+        auto iter = model_->named_interfaces.find(decl);
+        if (iter == model_->named_interfaces.end())
+            continue;
+        for (const auto& method_info : iter->second.methods) {
+            for (const auto* message : {method_info.request.get(), method_info.response.get()}) {
+                if (message == nullptr)
+                    continue;
+                std::string bench = ProduceMessageBench(iter->second, method_info, *message);
+                if (!bench.empty())
+                    benches.push_back(std::move(bench));
+            }
+        }
+    }
 
-    return std::move(file_);
+    *file_ << "int main(int argc, char** argv) {\n";
+    *file_ << kIndent << "size_t iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000u;\n";
+    *file_ << kIndent << "if (iterations == 0u)\n";
+    *file_ << kIndent << kIndent << "iterations = 1u;\n";
+    *file_ << kIndent << "zx_time_t* samples = malloc(4u * iterations * sizeof(zx_time_t));\n";
+    *file_ << kIndent << "if (samples == NULL)\n";
+    *file_ << kIndent << kIndent << "bench_fail(\"malloc\", ZX_ERR_NO_MEMORY);\n";
+    *file_ << kIndent << "bench_clock_overhead = INT64_MAX;\n";
+    *file_ << kIndent << "for (int i = 0; i < 1000; ++i) {\n";
+    *file_ << kIndent << kIndent << "zx_time_t start = zx_clock_get_monotonic();\n";
+    *file_ << kIndent << kIndent << "zx_time_t elapsed = zx_clock_get_monotonic() - start;\n";
+    *file_ << kIndent << kIndent << "if (elapsed < bench_clock_overhead)\n";
+    *file_ << kIndent << kIndent << kIndent << "bench_clock_overhead = elapsed;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "printf(\"%-48s %-10s %10s %10s %10s %10s\\n\", \"message\", \"phase\", \"min (ns)\", "
+              "\"median\", \"mean\", \"p99\");\n";
+    for (const auto& bench : benches)
+        *file_ << kIndent << bench << "(iterations, samples);\n";
+    *file_ << kIndent << "free(samples);\n";
+    *file_ << kIndent << "return 0;\n";
+    *file_ << "}\n";
 }
 
 } // namespace fidl
@@ -1,25 +1,92 @@
 #ifndef C_GENERATOR_H_
 #define C_GENERATOR_H_
 
-#include <sstream>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "flat_ast.h"
+#include "output_sink.h"
 #include "string_view.h"
 
 namespace fidl {
 
 class CGenerator {
 public:
-    explicit CGenerator(const flat::Library* library)
-        : library_(library) {}
+    struct Model;
+
+    // How the generated client and server encode and decode the messages that
+    // they cannot send or receive as plain bytes.
+    enum class Coding {
+        // By calling fidl_encode() and fidl_decode() with the message's coding
+        // table.
+        kTables,
+        // By calling encode and decode functions generated for each message,
+        // which visit its handles and out-of-line objects at offsets known
+        // when generating them.
+        kInline,
+    };
 
-    ~CGenerator() = default;
+    // How the generated client methods and server replies build, send and
+    // receive their messages.
+    enum class Codegen {
+        // With code generated for each method.
+        kSpeed,
+        // By passing descriptors of their messages, and pointers to their
+        // arguments, to the routines of <lib/fidl/stubs.h>. Only protocols
+        // over channels whose messages carry no tables or extensible unions
+        // are generated this way, and their messages are encoded and decoded
+        // with coding tables.
+        kSize,
+    };
 
-    std::ostringstream ProduceHeader();
-    std::ostringstream ProduceClient();
-    std::ostringstream ProduceServer();
+    // How many times each method was called, keyed by its protocol's name and
+    // its own, as in "Echo.EchoString". The protocol's name may be qualified
+    // with its library's, as in "fidl.examples.echo/Echo.EchoString".
+    using MethodProfile = std::map<std::string, uint64_t>;
+
+    // Parses a method profile, which has one "Protocol.Method count" line per
+    // method; the counts of repeated methods are added up. Blank lines and
+    // everything after a '#' are ignored. Returns false and sets |out_error|
+    // if a line is malformed.
+    static bool ParseMethodProfile(StringView contents, MethodProfile* out_profile,
+                                   std::string* out_error);
+
+    // Computes the names and members of |library|'s declarations, which
+    // generators for the same library can then share.
+    static std::unique_ptr<const Model> BuildModel(const flat::Library* library);
+
+    // Generates code from |model|, which was built from |library| and must
+    // outlive the generator. If |method_profile| is not null, the server
+    // dispatches the methods of each protocol that it covers hottest first,
+    // and moves those that are rarely called out of the dispatch function.
+    CGenerator(const flat::Library* library, const Model* model,
+               Coding coding = Coding::kTables,
+               const MethodProfile* method_profile = nullptr,
+               Codegen codegen = Codegen::kSpeed)
+        : library_(library), model_(model), coding_(coding),
+          method_profile_(method_profile), codegen_(codegen) {}
+
+    explicit CGenerator(const flat::Library* library);
+
+    ~CGenerator();
+
+    void ProduceHeader(OutputSink* file);
+    // Produces the same declarations as ProduceHeader(), split into headers
+    // keyed by their file names in the directory of the library's C header:
+    // one per protocol, with its messages, bindings and the types that only
+    // it uses; one per group of types that the same protocols share; and
+    // "types.h" for the types that no protocol uses. Each header includes
+    // those that declare the types it uses, and "fidl.h" includes them all.
+    void ProduceSplitHeaders(std::map<std::string, std::string>* out_headers);
+    void ProduceClient(OutputSink* file);
+    void ProduceServer(OutputSink* file);
+    // Produces a program that times building, encoding, decoding and copying
+    // out every request and response of the library's simple protocols, as
+    // the client and server do, filled with representative data.
+    void ProduceBench(OutputSink* file);
 
     enum class Transport {
         Channel,
@@ -42,6 +109,10 @@ public:
         // When there is no limit, its value is UINT32_MAX.
         // Method parameters are pre-validated against this bound at the beginning of a FIDL call.
         uint32_t max_num_elements;
+        // The declaration that an identifier type names. Method parameters
+        // pass tables and extensible unions as their C structs, which differ
+        // from the wire format that messages carry them in.
+        const flat::TypeDecl* type_decl = nullptr;
     };
 
     struct NamedMessage {
@@ -49,6 +120,8 @@ public:
         std::string coded_name;
         const std::vector<flat::Struct::Member>& parameters;
         const TypeShape& typeshape;
+        // The parameters, not including the message header.
+        std::vector<Member> members;
     };
     
     struct NamedMethod {
@@ -62,6 +135,14 @@ public:
         std::unique_ptr<NamedMessage> response;
     };
 
+    // Returns whether the simple C bindings copy |message|, a request or
+    // response of |interface|, as-is rather than calling fidl_encode() and
+    // fidl_decode() on it, i.e. whether it has no out-of-line objects, no
+    // handles and no padding.
+    static bool IsPODMessage(const flat::Library* library,
+                             const flat::Interface& interface,
+                             const flat::Struct& message);
+
 private:
     struct NamedBits {
         std::string name;
@@ -81,6 +162,8 @@ private:
     struct NamedInterface {
         std::string c_name;
         std::string discoverable_name;
+        // "library.name/Protocol", which method profiles refer to it by.
+        std::string qualified_name;
         Transport transport;
         std::vector<NamedMethod> methods;
     };
@@ -89,22 +172,27 @@ private:
         std::string c_name;
         std::string coded_name;
         const flat::Struct& struct_info;
+        std::vector<Member> members;
     };
 
     struct NamedTable {
         std::string c_name;
         std::string coded_name;
         const flat::Table& table_info;
+        // The members that are not reserved.
+        std::vector<Member> members;
     };
 
     struct NamedUnion {
         std::string name;
         const flat::Union& union_info;
+        std::vector<Member> members;
     };
 
     struct NamedXUnion {
         std::string name;
         const flat::XUnion& xunion_info;
+        std::vector<Member> members;
     };
 
     enum class StructKind {
@@ -112,9 +200,15 @@ private:
         kNonmessage,
     };
 
-    uint32_t GetMaxHandlesFor(Transport transport, const TypeShape& typeshape);
+    static uint32_t GetMaxHandlesFor(Transport transport, const TypeShape& typeshape);
+    // Whether any method of |named_interface| has a response or is an event.
+    static bool HasResponses(const NamedInterface& named_interface);
+    // Whether the client and the replies of |method_info| are generated for
+    // Codegen::kSize.
+    bool UsesStubs(const NamedInterface& named_interface, const NamedMethod& method_info) const;
 
-    void GeneratePrologues();
+    // Also includes |includes|, given as paths like the library's own C header.
+    void GeneratePrologues(const std::set<std::string>& includes = {});
     void GenerateEpilogues();
 
     void GenerateIntegerDefine(StringView name, types::PrimitiveSubtype subtype, StringView value);
@@ -126,23 +220,34 @@ private:
     void GenerateStructDeclaration(StringView name, const std::vector<Member>& members, StructKind kind);
     void GenerateTaggedUnionDeclaration(StringView name, const std::vector<Member>& members);
     void GenerateTaggedXUnionDeclaration(StringView name, const std::vector<Member>& members);
+    void GenerateEnumLookups(const NamedEnum& named_enum);
+    void GenerateBitsLookups(const NamedBits& named_bits);
 
-    std::map<const flat::Decl*, NamedBits>
+    static std::map<const flat::Decl*, NamedBits>
     NameBits(const std::vector<std::unique_ptr<flat::Bits>>& bits_infos);
-    std::map<const flat::Decl*, NamedConst>
+    static std::map<const flat::Decl*, NamedConst>
     NameConsts(const std::vector<std::unique_ptr<flat::Const>>& const_infos);
-    std::map<const flat::Decl*, NamedEnum>
+    static std::map<const flat::Decl*, NamedEnum>
     NameEnums(const std::vector<std::unique_ptr<flat::Enum>>& enum_infos);
-    std::map<const flat::Decl*, NamedInterface>
-    NameInterfaces(const std::vector<std::unique_ptr<flat::Interface>>& interface_infos);
-    std::map<const flat::Decl*, NamedStruct>
-    NameStructs(const std::vector<std::unique_ptr<flat::Struct>>& struct_infos);
-    std::map<const flat::Decl*, NamedTable>
-    NameTables(const std::vector<std::unique_ptr<flat::Table>>& table_infos);
-    std::map<const flat::Decl*, NamedUnion>
-    NameUnions(const std::vector<std::unique_ptr<flat::Union>>& union_infos);
-    std::map<const flat::Decl*, NamedXUnion>
-    NameXUnions(const std::vector<std::unique_ptr<flat::XUnion>>& xunion_infos);
+    static std::map<const flat::Decl*, NamedInterface>
+    NameInterfaces(const flat::Library* library,
+                   const std::vector<std::unique_ptr<flat::Interface>>& interface_infos);
+    static std::map<const flat::Decl*, NamedStruct>
+    NameStructs(const flat::Library* library,
+                const std::vector<std::unique_ptr<flat::Struct>>& struct_infos);
+    static std::map<const flat::Decl*, NamedTable>
+    NameTables(const flat::Library* library,
+               const std::vector<std::unique_ptr<flat::Table>>& table_infos);
+    static std::map<const flat::Decl*, NamedUnion>
+    NameUnions(const flat::Library* library,
+               const std::vector<std::unique_ptr<flat::Union>>& union_infos);
+    static std::map<const flat::Decl*, NamedXUnion>
+    NameXUnions(const flat::Library* library,
+                const std::vector<std::unique_ptr<flat::XUnion>>& xunion_infos);
+
+    // Produces the forward declarations, extern declarations, declarations and
+    // simple bindings of |decls|, which are in declaration order.
+    void ProduceDeclarations(const std::vector<const flat::Decl*>& decls);
 
     void ProduceBitsForwardDeclaration(const NamedBits& named_bits);
     void ProduceConstForwardDeclaration(const NamedConst& named_const);
@@ -156,20 +261,48 @@ private:
     void ProduceInterfaceExternDeclaration(const NamedInterface& named_interface);
 
     void ProduceConstDeclaration(const NamedConst& named_const);
-    void ProduceMessageDeclaration(const NamedMessage& named_message);
+    void ProduceMessageDeclaration(const NamedMessage& named_message, Transport transport);
     void ProduceInterfaceDeclaration(const NamedInterface& named_interface);
     void ProduceStructDeclaration(const NamedStruct& named_struct);
+    void ProduceTableDeclaration(const NamedTable& named_table);
     void ProduceUnionDeclaration(const NamedUnion& named_union);
     void ProduceXUnionDeclaration(const NamedXUnion& named_xunion);
 
     void ProduceInterfaceClientDeclaration(const NamedInterface& named_interface);
     void ProduceInterfaceClientImplementation(const NamedInterface& named_interface);
+    void ProduceInterfaceClientDispatchResponses(const NamedInterface& named_interface);
 
     void ProduceInterfaceServerDeclaration(const NamedInterface& named_interface);
     void ProduceInterfaceServerImplementation(const NamedInterface& named_interface);
 
+    // Returns the name of the function that benchmarks |named_message|, or
+    // an empty string if the message is not benchmarked.
+    std::string ProduceMessageBench(const NamedInterface& named_interface,
+                                    const NamedMethod& method_info,
+                                    const NamedMessage& named_message);
+
     const flat::Library* library_;
-    std::ostringstream file_;
+    // Set when the generator built its own model.
+    std::unique_ptr<const Model> owned_model_;
+    const Model* model_;
+    Coding coding_ = Coding::kTables;
+    const MethodProfile* method_profile_ = nullptr;
+    Codegen codegen_ = Codegen::kSpeed;
+    OutputSink* file_ = nullptr;
+};
+
+// The names and members of everything in a library that the C bindings
+// refer to. It is never modified once built, so one model can be shared by
+// generators running on different threads.
+struct CGenerator::Model {
+    std::map<const flat::Decl*, NamedBits> named_bits;
+    std::map<const flat::Decl*, NamedConst> named_consts;
+    std::map<const flat::Decl*, NamedEnum> named_enums;
+    std::map<const flat::Decl*, NamedInterface> named_interfaces;
+    std::map<const flat::Decl*, NamedStruct> named_structs;
+    std::map<const flat::Decl*, NamedTable> named_tables;
+    std::map<const flat::Decl*, NamedUnion> named_unions;
+    std::map<const flat::Decl*, NamedXUnion> named_xunions;
 };
 
 } // namespace fidl
@@ -0,0 +1,243 @@
+#include "compile_server.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fidl {
+
+namespace {
+
+// Requests are the size of their payload, sent along with the client's
+// stdout and stderr, and then the payload: the working directory and each
+// argument, each followed by a NUL. The status is sent back as an int32_t.
+constexpr uint32_t kMaxRequestSize = 64u * 1024u * 1024u;
+// Requests carry the most descriptors of any message.
+constexpr size_t kMaxDescriptors = 2u;
+
+bool SocketAddress(const std::string& path, struct sockaddr_un* out_address) {
+    memset(out_address, 0, sizeof(*out_address));
+    out_address->sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(out_address->sun_path))
+        return false;
+    memcpy(out_address->sun_path, path.data(), path.size());
+    return true;
+}
+
+bool WriteAll(int fd, const char* data, size_t size) {
+    while (size > 0u) {
+        ssize_t count = write(fd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        data += count;
+        size -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool ReadAll(int fd, char* data, size_t size) {
+    while (size > 0u) {
+        ssize_t count = read(fd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        data += count;
+        size -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// Sends the |size| bytes at |data|, along with the |num_fds| descriptors in
+// |fds|, which the sender still owns.
+bool SendWithDescriptors(int socket, const void* data, size_t size, const int* fds,
+                         size_t num_fds) {
+    assert(num_fds <= kMaxDescriptors);
+    struct iovec iov = {const_cast<void*>(data), size};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxDescriptors)];
+    struct msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+    memcpy(CMSG_DATA(header), fds, sizeof(int) * num_fds);
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket, &message, 0);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(size);
+}
+
+// Receives |size| bytes into |data|, and the |num_fds| descriptors sent along
+// with them into |fds|, which the receiver then owns. Returns false, having
+// closed whatever descriptors did arrive, unless all of it did.
+bool ReceiveWithDescriptors(int socket, void* data, size_t size, int* fds, size_t num_fds) {
+    assert(num_fds <= kMaxDescriptors);
+    struct iovec iov = {data, size};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxDescriptors)];
+    struct msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+    ssize_t received;
+    do {
+        received = recvmsg(socket, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0)
+        return false;
+
+    size_t num_received = 0u;
+    for (struct cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr;
+         header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t count = (header->cmsg_len - CMSG_LEN(0u)) / sizeof(int);
+        for (size_t i = 0u; i < count; ++i) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+            if (num_received < num_fds) {
+                fds[num_received++] = fd;
+            } else {
+                close(fd);
+            }
+        }
+    }
+    if (received != static_cast<ssize_t>(size) || num_received != num_fds ||
+        (message.msg_flags & MSG_CTRUNC) != 0) {
+        for (size_t i = 0u; i < num_received; ++i) {
+            close(fds[i]);
+        }
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int ListenOnSocket(const std::string& path, std::string* out_error) {
+    struct sockaddr_un address;
+    if (!SocketAddress(path, &address)) {
+        *out_error = "Invalid socket path: " + path;
+        return -1;
+    }
+    int probe = ConnectToSocket(path);
+    if (probe >= 0) {
+        close(probe);
+        *out_error = "A server is already listening on " + path;
+        return -1;
+    }
+    // What is left at |path| is the socket of a server that is gone.
+    unlink(path.data());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        *out_error = std::string("Could not create a socket: ") + strerror(errno);
+        return -1;
+    }
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        *out_error = "Could not listen on " + path + ": " + strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ConnectToSocket(const std::string& path) {
+    struct sockaddr_un address;
+    if (!SocketAddress(path, &address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool SendRequest(int socket, const CompileRequest& request) {
+    std::string payload(request.working_directory);
+    payload.push_back('\0');
+    for (const auto& argument : request.arguments) {
+        payload.append(argument);
+        payload.push_back('\0');
+    }
+    if (payload.size() > kMaxRequestSize)
+        return false;
+    uint32_t size = static_cast<uint32_t>(payload.size());
+
+    int fds[2] = {request.stdout_fd, request.stderr_fd};
+    if (!SendWithDescriptors(socket, &size, sizeof(size), fds, 2u))
+        return false;
+    return WriteAll(socket, payload.data(), payload.size());
+}
+
+bool ReceiveRequest(int socket, CompileRequest* out_request) {
+    uint32_t size;
+    int fds[2];
+    if (!ReceiveWithDescriptors(socket, &size, sizeof(size), fds, 2u))
+        return false;
+
+    std::string payload;
+    if (size <= kMaxRequestSize) {
+        payload.resize(size);
+        if (ReadAll(socket, &payload[0], payload.size()) && !payload.empty() &&
+            payload.back() == '\0') {
+            out_request->stdout_fd = fds[0];
+            out_request->stderr_fd = fds[1];
+            size_t start = 0u;
+            size_t end = payload.find('\0');
+            out_request->working_directory = payload.substr(0u, end);
+            out_request->arguments.clear();
+            for (start = end + 1u; start < payload.size(); start = end + 1u) {
+                end = payload.find('\0', start);
+                out_request->arguments.push_back(payload.substr(start, end - start));
+            }
+            return true;
+        }
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+}
+
+bool SendDescriptor(int socket, int fd) {
+    char byte = 0;
+    return SendWithDescriptors(socket, &byte, sizeof(byte), &fd, 1u);
+}
+
+int ReceiveDescriptor(int socket) {
+    char byte;
+    int fd;
+    if (!ReceiveWithDescriptors(socket, &byte, sizeof(byte), &fd, 1u))
+        return -1;
+    return fd;
+}
+
+bool SendStatus(int socket, int status) {
+    int32_t value = status;
+    return WriteAll(socket, reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool ReceiveStatus(int socket, int* out_status) {
+    int32_t value;
+    if (!ReadAll(socket, reinterpret_cast<char*>(&value), sizeof(value)))
+        return false;
+    *out_status = value;
+    return true;
+}
+
+} // namespace fidl
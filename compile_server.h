@@ -0,0 +1,49 @@
+#ifndef COMPILE_SERVER_H_
+#define COMPILE_SERVER_H_
+
+#include <string>
+#include <vector>
+
+namespace fidl {
+
+// How `fidlc --connect` hands an invocation to a `fidlc --server` over a Unix
+// socket, and gets back its exit status. The server writes the outputs and
+// prints the diagnostics itself, straight to the client's files.
+
+// An invocation of fidlc, as the server runs it on behalf of a client.
+struct CompileRequest {
+    // The client's, which relative paths in |arguments| are relative to.
+    std::string working_directory;
+    // Without the program name.
+    std::vector<std::string> arguments;
+    // The client's stdout and stderr. Received ones are owned by the
+    // receiver.
+    int stdout_fd = -1;
+    int stderr_fd = -1;
+};
+
+// Creates a socket listening at |path|, which must not be in use by a server
+// that is running, and returns it. Returns -1 and sets |out_error| if it
+// cannot.
+int ListenOnSocket(const std::string& path, std::string* out_error);
+
+// Returns a socket connected to the server listening at |path|, or -1 if
+// there is none.
+int ConnectToSocket(const std::string& path);
+
+bool SendRequest(int socket, const CompileRequest& request);
+// Returns false, owning none of the descriptors that came with it, if the
+// peer goes away or times out before a whole request arrives.
+bool ReceiveRequest(int socket, CompileRequest* out_request);
+
+// Passes |fd|, which the sender still owns, to the process at the other end
+// of |socket|, and returns it there, or -1 once the sender is gone.
+bool SendDescriptor(int socket, int fd);
+int ReceiveDescriptor(int socket);
+
+bool SendStatus(int socket, int status);
+bool ReceiveStatus(int socket, int* out_status);
+
+} // namespace fidl
+
+#endif // COMPILE_SERVER_H_
@@ -0,0 +1,1285 @@
+#include "cpp_generator.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "names.h"
+
+namespace fidl {
+
+namespace {
+
+constexpr const char* kIndent = "    ";
+
+// The size of fidl_message_header_t, which the typeshape of a message leaves
+// out.
+constexpr uint32_t kMessageHeaderSize = 16u;
+
+// The most bytes the elements of a bounded string or vector take up on the
+// wire for its natural type to store them inline. Larger bounds, and
+// unbounded strings and vectors, are stored on the heap.
+constexpr uint64_t kMaxInlineStorage = 4096u;
+
+// Returns the size of the inline part of a message: the message header,
+// followed by the parameters padded to 8 bytes. The typeshape of a message
+// without parameters has a size of 1, for the byte of an empty struct, which
+// the message leaves out.
+uint32_t MessageInlineSize(const flat::Struct& message) {
+    if (message.members.empty())
+        return kMessageHeaderSize;
+    return (kMessageHeaderSize + message.typeshape.Size() + 7u) & ~7u;
+}
+
+// Returns the most bytes that |message| takes up on a channel.
+uint32_t MessageMaxNumBytes(const flat::Struct& message) {
+    uint64_t max_num_bytes = static_cast<uint64_t>(MessageInlineSize(message)) +
+                             message.typeshape.MaxOutOfLine();
+    return static_cast<uint32_t>(
+        std::min(max_num_bytes, static_cast<uint64_t>(ZX_CHANNEL_MAX_MSG_BYTES)));
+}
+
+void EmitFileComment(OutputSink* file) {
+    *file << "// WARNING: This file is machine generated by fidlc.\n\n";
+}
+
+void EmitBlank(OutputSink* file) {
+    *file << "\n";
+}
+
+void EmitIndent(OutputSink* file, size_t depth) {
+    for (size_t i = 0; i < depth; i++)
+        *file << kIndent;
+}
+
+std::string NameNamespace(const std::vector<StringView>& library_name) {
+    return StringJoin(library_name, "::");
+}
+
+// The name of a declaration from anywhere in the generated code.
+std::string NameQualified(const flat::Name& name) {
+    return "::" + NameName(name, "::", "::");
+}
+
+// The enumerator of a union or xunion's Tag for |member_name|: foo_bar
+// becomes kFooBar.
+std::string NameTag(SourceLocation member_name) {
+    std::string name = NameIdentifier(member_name);
+    std::string tag = "k";
+    bool upper = true;
+    for (char c : name) {
+        if (c == '_') {
+            upper = true;
+            continue;
+        }
+        tag += upper ? static_cast<char>(toupper(static_cast<unsigned char>(c))) : c;
+        upper = false;
+    }
+    return tag;
+}
+
+template <typename T>
+std::string FormatNumber(const flat::ConstantValue& value) {
+    T number = static_cast<const flat::NumericConstantValue<T>&>(value).value;
+    std::ostringstream formatted;
+    if constexpr (std::is_floating_point<T>::value) {
+        // The shortest digits that read back as the same number.
+        for (int precision = std::numeric_limits<T>::digits10;; precision++) {
+            formatted.str("");
+            formatted << std::setprecision(precision) << number;
+            std::istringstream parsed(formatted.str());
+            T round_tripped;
+            parsed >> round_tripped;
+            if (round_tripped == number || precision == std::numeric_limits<T>::max_digits10)
+                break;
+        }
+        std::string digits = formatted.str();
+        if (digits.find_first_of(".en") == std::string::npos)
+            digits += ".0";
+        if (std::is_same<T, float>::value)
+            digits += "f";
+        return digits;
+    } else if constexpr (std::is_same<T, int64_t>::value) {
+        // The negation of a literal, so spell the one value whose
+        // magnitude does not fit in an int64_t another way.
+        if (number == std::numeric_limits<int64_t>::min())
+            return "INT64_MIN";
+        formatted << number;
+        return formatted.str();
+    } else {
+        formatted << static_cast<const flat::NumericConstantValue<T>&>(value);
+        if (std::is_unsigned<T>::value)
+            formatted << "u";
+        return formatted.str();
+    }
+}
+
+// Returns |value| as a C++ literal.
+std::string ConstantValueLiteral(const flat::ConstantValue& value) {
+    switch (value.kind) {
+    case flat::ConstantValue::Kind::kInt8:
+        return FormatNumber<int8_t>(value);
+    case flat::ConstantValue::Kind::kInt16:
+        return FormatNumber<int16_t>(value);
+    case flat::ConstantValue::Kind::kInt32:
+        return FormatNumber<int32_t>(value);
+    case flat::ConstantValue::Kind::kInt64:
+        return FormatNumber<int64_t>(value);
+    case flat::ConstantValue::Kind::kUint8:
+        return FormatNumber<uint8_t>(value);
+    case flat::ConstantValue::Kind::kUint16:
+        return FormatNumber<uint16_t>(value);
+    case flat::ConstantValue::Kind::kUint32:
+        return FormatNumber<uint32_t>(value);
+    case flat::ConstantValue::Kind::kUint64:
+        return FormatNumber<uint64_t>(value);
+    case flat::ConstantValue::Kind::kFloat32:
+        return FormatNumber<float>(value);
+    case flat::ConstantValue::Kind::kFloat64:
+        return FormatNumber<double>(value);
+    case flat::ConstantValue::Kind::kBool:
+        return static_cast<const flat::BoolConstantValue&>(value).value ? "true" : "false";
+    case flat::ConstantValue::Kind::kString:
+        // The value is the string literal from the source, quotes and all.
+        return std::string(static_cast<const flat::StringConstantValue&>(value).value);
+    }
+    assert(false && "unknown constant kind");
+    return "";
+}
+
+const flat::TypeDecl* IdentifierDecl(const flat::Type* type) {
+    if (type->kind != flat::Type::Kind::kIdentifier)
+        return nullptr;
+    return static_cast<const flat::IdentifierType*>(type)->type_decl;
+}
+
+// Whether |type| has the same bytes in memory as on the wire, so that a
+// vector of it is passed as a fidl::Span viewing the message.
+bool IsViewElement(const flat::Type* type) {
+    if (type->kind == flat::Type::Kind::kPrimitive)
+        return static_cast<const flat::PrimitiveType*>(type)->subtype !=
+               types::PrimitiveSubtype::kBool;
+    const flat::TypeDecl* decl = IdentifierDecl(type);
+    return decl != nullptr &&
+           (decl->kind == flat::Decl::Kind::kEnum || decl->kind == flat::Decl::Kind::kBits);
+}
+
+bool IsNullable(const flat::Type* type) {
+    return type->nullability == types::Nullability::kNullable;
+}
+
+std::string Optional(const flat::Type* type, std::string name) {
+    if (IsNullable(type))
+        return "std::optional<" + name + ">";
+    return name;
+}
+
+std::string BoundArgument(uint32_t bound) {
+    if (bound == std::numeric_limits<uint32_t>::max())
+        return "";
+    return ", " + std::to_string(bound) + "u";
+}
+
+std::string NaturalType(const flat::Type* type);
+
+// Whether the elements of a string or vector of at most |bound| elements of
+// |element| are stored inline in its natural type. A nullable vector of
+// structs, unions, tables or xunions is always on the heap, since the
+// elements' declarations may come after it.
+bool StoresInline(const flat::Type* type, uint32_t bound, const flat::Type* element) {
+    if (bound == std::numeric_limits<uint32_t>::max())
+        return false;
+    if (element != nullptr) {
+        const flat::TypeDecl* decl = IdentifierDecl(element);
+        if (decl != nullptr && decl->kind != flat::Decl::Kind::kEnum &&
+            decl->kind != flat::Decl::Kind::kBits &&
+            decl->kind != flat::Decl::Kind::kInterface && (decl->recursive || IsNullable(type)))
+            return false;
+    }
+    uint64_t element_size = element == nullptr ? 1u : element->shape.Size();
+    return static_cast<uint64_t>(bound) * element_size <= kMaxInlineStorage;
+}
+
+// The type that stores a value of |type| in structs, tables and unions.
+std::string NaturalType(const flat::Type* type) {
+    switch (type->kind) {
+    case flat::Type::Kind::kArray: {
+        auto array_type = static_cast<const flat::ArrayType*>(type);
+        return "std::array<" + NaturalType(array_type->element_type) + ", " +
+               std::to_string(array_type->element_count->value) + "u>";
+    }
+    case flat::Type::Kind::kVector: {
+        auto vector_type = static_cast<const flat::VectorType*>(type);
+        uint32_t bound = vector_type->element_count->value;
+        std::string element = NaturalType(vector_type->element_type);
+        if (StoresInline(type, bound, vector_type->element_type))
+            return Optional(type, "::fidl::InlineVector<" + element + BoundArgument(bound) + ">");
+        return Optional(type, "::fidl::Vector<" + element + BoundArgument(bound) + ">");
+    }
+    case flat::Type::Kind::kString: {
+        auto string_type = static_cast<const flat::StringType*>(type);
+        uint32_t bound = string_type->max_size->value;
+        if (StoresInline(type, bound, nullptr))
+            return Optional(type, "::fidl::InlineString<" + std::to_string(bound) + "u>");
+        if (bound == std::numeric_limits<uint32_t>::max())
+            return Optional(type, "::fidl::String<>");
+        return Optional(type, "::fidl::String<" + std::to_string(bound) + "u>");
+    }
+    case flat::Type::Kind::kHandle:
+        return Optional(type, "::fidl::Handle");
+    case flat::Type::Kind::kPrimitive:
+        return NamePrimitiveCType(static_cast<const flat::PrimitiveType*>(type)->subtype);
+    case flat::Type::Kind::kIdentifier: {
+        const flat::TypeDecl* decl = IdentifierDecl(type);
+        std::string name = NameQualified(decl->name);
+        switch (decl->kind) {
+        case flat::Decl::Kind::kBits:
+        case flat::Decl::Kind::kEnum:
+        case flat::Decl::Kind::kTable:
+            return name;
+        case flat::Decl::Kind::kInterface:
+            return Optional(type, "::fidl::InterfaceHandle<" + name + ">");
+        case flat::Decl::Kind::kStruct:
+        case flat::Decl::Kind::kUnion:
+            // Nullable structs and unions are out of line.
+            if (IsNullable(type))
+                return "std::unique_ptr<" + name + ">";
+            return name;
+        case flat::Decl::Kind::kXUnion:
+            return Optional(type, name);
+        case flat::Decl::Kind::kConst:
+            break;
+        }
+        break;
+    }
+    }
+    assert(false && "unknown type");
+    return "";
+}
+
+// How a parameter of a given type is passed to a method that encodes it.
+enum class ParamStyle {
+    // Numbers, enums and bits by value; handles, and anything else with
+    // handles in it, by value as well, moved into the message.
+    kValue,
+    // Strings as std::string_view.
+    kStringView,
+    // Vectors of numbers, enums and bits as fidl::Span.
+    kVectorView,
+    // Anything else without handles by const reference, except for
+    kConstRef,
+    // nullable structs and unions, by a pointer that may be null.
+    kConstPointer,
+};
+
+ParamStyle GetParamStyle(const flat::Type* type) {
+    switch (type->kind) {
+    case flat::Type::Kind::kString:
+        return ParamStyle::kStringView;
+    case flat::Type::Kind::kVector:
+        if (IsViewElement(static_cast<const flat::VectorType*>(type)->element_type))
+            return ParamStyle::kVectorView;
+        break;
+    case flat::Type::Kind::kPrimitive:
+        return ParamStyle::kValue;
+    case flat::Type::Kind::kIdentifier: {
+        const flat::TypeDecl* decl = IdentifierDecl(type);
+        if (decl->kind == flat::Decl::Kind::kEnum || decl->kind == flat::Decl::Kind::kBits)
+            return ParamStyle::kValue;
+        if (type->shape.MaxHandles() == 0u && IsNullable(type) &&
+            (decl->kind == flat::Decl::Kind::kStruct || decl->kind == flat::Decl::Kind::kUnion))
+            return ParamStyle::kConstPointer;
+        break;
+    }
+    default:
+        break;
+    }
+    if (type->shape.MaxHandles() > 0u)
+        return ParamStyle::kValue;
+    return ParamStyle::kConstRef;
+}
+
+// The type of a string or a vector of numbers that views a message.
+std::string ViewType(const flat::Type* type) {
+    if (type->kind == flat::Type::Kind::kString)
+        return Optional(type, "std::string_view");
+    auto vector_type = static_cast<const flat::VectorType*>(type);
+    return Optional(type, "::fidl::Span<const " + NaturalType(vector_type->element_type) + ">");
+}
+
+// The type that a parameter decodes into: a view for strings and vectors of
+// numbers, and the natural type for anything else.
+std::string DecodedType(const flat::Type* type) {
+    switch (GetParamStyle(type)) {
+    case ParamStyle::kStringView:
+    case ParamStyle::kVectorView:
+        return ViewType(type);
+    default:
+        return NaturalType(type);
+    }
+}
+
+std::string EncodedParamType(const flat::Type* type) {
+    switch (GetParamStyle(type)) {
+    case ParamStyle::kValue:
+        return NaturalType(type);
+    case ParamStyle::kStringView:
+    case ParamStyle::kVectorView:
+        return ViewType(type);
+    case ParamStyle::kConstRef:
+        return "const " + NaturalType(type) + "&";
+    case ParamStyle::kConstPointer:
+        return "const " + NameQualified(IdentifierDecl(type)->name) + "*";
+    }
+    assert(false && "unknown parameter style");
+    return "";
+}
+
+std::string Offset(const std::string& base, uint32_t offset) {
+    return base + " + " + std::to_string(offset) + "u";
+}
+
+// Returns the call that encodes the parameter |name| at |offset|.
+std::string EncodeParam(const flat::Type* type, const std::string& name, uint32_t offset) {
+    std::string at = std::to_string(offset) + "u";
+    switch (GetParamStyle(type)) {
+    case ParamStyle::kValue:
+        return "::fidl::Encode(&_encoder, &" + name + ", " + at + ")";
+    case ParamStyle::kStringView:
+        return "::fidl::EncodeStringView(&_encoder, " + name + ", " +
+               std::to_string(static_cast<const flat::StringType*>(type)->max_size->value) +
+               "u, " + at + ")";
+    case ParamStyle::kVectorView: {
+        auto vector_type = static_cast<const flat::VectorType*>(type);
+        return "::fidl::EncodeVectorView<" + NaturalType(vector_type->element_type) +
+               ">(&_encoder, " + name + ", " + std::to_string(vector_type->element_count->value) +
+               "u, " + at + ")";
+    }
+    // Encoding only moves handles out of a value, so one without handles is
+    // left as it was.
+    case ParamStyle::kConstRef:
+        return "::fidl::Encode(&_encoder, const_cast<" + NaturalType(type) + "*>(&" + name +
+               "), " + at + ")";
+    case ParamStyle::kConstPointer:
+        return "::fidl::EncodeNullable(&_encoder, const_cast<" +
+               NameQualified(IdentifierDecl(type)->name) + "*>(" + name + "), " + at + ")";
+    }
+    assert(false && "unknown parameter style");
+    return "";
+}
+
+// Returns the call that decodes the parameter at |offset| into |*target|.
+std::string DecodeParam(const flat::Type* type, const std::string& target, uint32_t offset) {
+    std::string at = std::to_string(offset) + "u";
+    switch (GetParamStyle(type)) {
+    case ParamStyle::kStringView:
+        return "::fidl::DecodeStringView(&_decoder, " + target + ", " +
+               std::to_string(static_cast<const flat::StringType*>(type)->max_size->value) +
+               "u, " + at + ")";
+    case ParamStyle::kVectorView: {
+        auto vector_type = static_cast<const flat::VectorType*>(type);
+        return "::fidl::DecodeVectorView<" + NaturalType(vector_type->element_type) +
+               ">(&_decoder, " + target + ", " +
+               std::to_string(vector_type->element_count->value) + "u, " + at + ")";
+    }
+    default:
+        return "::fidl::Decode(&_decoder, " + target + ", " + at + ")";
+    }
+}
+
+// Emits |checks| joined by ||, each negated, as the condition of an if
+// statement that runs |on_failure|.
+void EmitChecks(OutputSink* file, size_t depth, const std::vector<std::string>& checks,
+                const std::string& on_failure) {
+    EmitIndent(file, depth);
+    *file << "if (";
+    for (size_t i = 0; i < checks.size(); i++) {
+        if (i > 0u) {
+            *file << " ||\n";
+            EmitIndent(file, depth);
+            *file << "    ";
+        }
+        *file << "!" << checks[i];
+    }
+    *file << ")\n";
+    EmitIndent(file, depth + 1u);
+    *file << on_failure << "\n";
+}
+
+std::vector<std::string> EncodeMessage(const std::string& ordinal, const flat::Struct& message) {
+    std::vector<std::string> checks;
+    checks.push_back("_encoder.BeginMessage(" + ordinal + ", " +
+                     std::to_string(MessageInlineSize(message)) + "u)");
+    for (const auto& member : message.members) {
+        checks.push_back(EncodeParam(member.type_ctor->type, NameIdentifier(member.name),
+                                     kMessageHeaderSize + member.fieldshape.Offset()));
+    }
+    return checks;
+}
+
+// Returns the checks that decode |message| into the variables that
+// |target_prefix| followed by each parameter's name point to.
+std::vector<std::string> DecodeMessage(const std::string& ordinal, const flat::Struct& message,
+                                       const std::string& target_prefix) {
+    std::vector<std::string> checks;
+    checks.push_back("_decoder.BeginMessage(" + ordinal + ", " +
+                     std::to_string(MessageInlineSize(message)) + "u)");
+    for (const auto& member : message.members) {
+        checks.push_back(DecodeParam(member.type_ctor->type,
+                                     target_prefix + NameIdentifier(member.name),
+                                     kMessageHeaderSize + member.fieldshape.Offset()));
+    }
+    return checks;
+}
+
+// Emits the parameters that encode |message|, as a comma-separated list
+// that starts with |separator| unless the message has no parameters.
+void EmitEncodedParams(OutputSink* file, const flat::Struct& message, StringView separator) {
+    for (const auto& member : message.members) {
+        *file << separator << EncodedParamType(member.type_ctor->type) << " "
+              << NameIdentifier(member.name);
+        separator = ", ";
+    }
+}
+
+void EmitDecodedParams(OutputSink* file, const flat::Struct& message, StringView separator,
+                       StringView prefix, StringView suffix) {
+    for (const auto& member : message.members) {
+        *file << separator << DecodedType(member.type_ctor->type) << suffix << " " << prefix
+              << NameIdentifier(member.name);
+        separator = ", ";
+    }
+}
+
+// Emits the local variables that a message's parameters decode into.
+void EmitDecodedLocals(OutputSink* file, size_t depth, const flat::Struct& message) {
+    for (const auto& member : message.members) {
+        EmitIndent(file, depth);
+        *file << DecodedType(member.type_ctor->type) << " " << NameIdentifier(member.name)
+              << ";\n";
+    }
+}
+
+void EmitMovedArgs(OutputSink* file, const flat::Struct& message) {
+    StringView separator = "";
+    for (const auto& member : message.members) {
+        *file << separator << "std::move(" << NameIdentifier(member.name) << ")";
+        separator = ", ";
+    }
+}
+
+std::string OrdinalName(const flat::Interface::Method& method) {
+    return "k" + NameIdentifier(method.name) + "Ordinal";
+}
+
+bool IsEvent(const flat::Interface::Method& method) {
+    return method.maybe_request == nullptr;
+}
+
+bool UsesChannel(const flat::Interface& interface_decl) {
+    return interface_decl.GetAttribute("Transport") != "SocketControl";
+}
+
+bool HasEvents(const flat::Interface& interface_decl) {
+    for (const auto* method : interface_decl.all_methods) {
+        if (IsEvent(*method))
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+std::vector<const flat::Decl*> CppGenerator::LibraryDecls() const {
+    std::vector<const flat::Decl*> decls;
+    for (const auto* decl : library_->declaration_order_) {
+        if (decl->name.library() != library_)
+            continue;
+        if (decl->kind == flat::Decl::Kind::kStruct &&
+            static_cast<const flat::Struct*>(decl)->anonymous)
+            continue;
+        decls.push_back(decl);
+    }
+    return decls;
+}
+
+void CppGenerator::GenerateCodingConstants(const TypeShape& typeshape) {
+    *file_ << kIndent << "static constexpr uint32_t kInlineSize = " << typeshape.Size()
+           << "u;\n";
+    *file_ << kIndent << "static constexpr uint32_t kMaxOutOfLine = " << typeshape.MaxOutOfLine()
+           << "u;\n";
+    *file_ << kIndent << "static constexpr uint32_t kMaxHandles = " << typeshape.MaxHandles()
+           << "u;\n";
+}
+
+void CppGenerator::ProduceForwardDeclaration(const flat::Decl& decl) {
+    switch (decl.kind) {
+    case flat::Decl::Kind::kStruct:
+    case flat::Decl::Kind::kTable:
+        *file_ << "struct " << decl.name.name_part() << ";\n";
+        break;
+    case flat::Decl::Kind::kUnion:
+    case flat::Decl::Kind::kXUnion:
+    case flat::Decl::Kind::kInterface:
+        *file_ << "class " << decl.name.name_part() << ";\n";
+        break;
+    case flat::Decl::Kind::kBits:
+    case flat::Decl::Kind::kConst:
+    case flat::Decl::Kind::kEnum:
+        break;
+    }
+}
+
+void CppGenerator::ProduceConstDeclaration(const flat::Const& const_decl) {
+    const flat::Type* type = const_decl.type_ctor->type;
+    std::string type_name;
+    switch (type->kind) {
+    case flat::Type::Kind::kPrimitive:
+        type_name = NaturalType(type);
+        break;
+    case flat::Type::Kind::kString:
+        type_name = "std::string_view";
+        break;
+    default:
+        // Like the C bindings, only numbers, bools and strings.
+        return;
+    }
+    *file_ << "constexpr " << type_name << " " << const_decl.name.name_part() << " = "
+           << ConstantValueLiteral(const_decl.value->Value()) << ";\n\n";
+}
+
+void CppGenerator::ProduceBitsDeclaration(const flat::Bits& bits_decl) {
+    std::string name = bits_decl.name.name_part();
+    std::string subtype = NaturalType(bits_decl.subtype_ctor->type);
+    *file_ << "enum class " << name << " : " << subtype << " {\n";
+    for (const auto& member : bits_decl.members) {
+        *file_ << kIndent << NameIdentifier(member.name) << " = "
+               << ConstantValueLiteral(member.value->Value()) << ",\n";
+    }
+    *file_ << "};\n\n";
+
+    *file_ << "// All of the bits of " << name << ".\n";
+    *file_ << "constexpr " << name << " k" << name << "Mask = static_cast<" << name << ">("
+           << bits_decl.mask << "u);\n\n";
+
+    for (const char* op : {"|", "&", "^"}) {
+        *file_ << "constexpr " << name << " operator" << op << "(" << name << " a, " << name
+               << " b) {\n";
+        *file_ << kIndent << "return static_cast<" << name << ">(static_cast<" << subtype
+               << ">(a) " << op << " static_cast<" << subtype << ">(b));\n";
+        *file_ << "}\n\n";
+        *file_ << "constexpr " << name << "& operator" << op << "=(" << name << "& a, " << name
+               << " b) {\n";
+        *file_ << kIndent << "return a = a " << op << " b;\n";
+        *file_ << "}\n\n";
+    }
+    *file_ << "// Only flips the bits that " << name << " has.\n";
+    *file_ << "constexpr " << name << " operator~(" << name << " a) {\n";
+    *file_ << kIndent << "return static_cast<" << name << ">(~static_cast<" << subtype
+           << ">(a) & static_cast<" << subtype << ">(k" << name << "Mask));\n";
+    *file_ << "}\n\n";
+}
+
+void CppGenerator::ProduceEnumDeclaration(const flat::Enum& enum_decl) {
+    *file_ << "enum class " << enum_decl.name.name_part() << " : "
+           << NaturalType(enum_decl.subtype_ctor->type) << " {\n";
+    for (const auto& member : enum_decl.members) {
+        *file_ << kIndent << NameIdentifier(member.name) << " = "
+               << ConstantValueLiteral(member.value->Value()) << ",\n";
+    }
+    *file_ << "};\n\n";
+}
+
+void CppGenerator::ProduceStructDeclaration(const flat::Struct& struct_decl) {
+    std::string name = struct_decl.name.name_part();
+    *file_ << "struct " << name << " {\n";
+    GenerateCodingConstants(struct_decl.typeshape);
+    EmitBlank(file_);
+    for (const auto& member : struct_decl.members) {
+        *file_ << kIndent << NaturalType(member.type_ctor->type) << " "
+               << NameIdentifier(member.name) << "{};\n";
+    }
+    if (!struct_decl.members.empty())
+        EmitBlank(file_);
+    *file_ << kIndent << "// Moves any handles into the message.\n";
+    *file_ << kIndent << "bool Encode(::fidl::Encoder* encoder, uint32_t offset);\n";
+    *file_ << kIndent << "static bool Decode(::fidl::Decoder* decoder, " << name
+           << "* value, uint32_t offset);\n";
+    *file_ << "};\n\n";
+}
+
+void CppGenerator::ProduceUnionDeclaration(const flat::Union& union_decl) {
+    std::string name = union_decl.name.name_part();
+    *file_ << "class " << name << " {\n";
+    *file_ << "public:\n";
+    *file_ << kIndent << "enum class Tag : uint32_t {\n";
+    for (size_t i = 0; i < union_decl.members.size(); i++) {
+        *file_ << kIndent << kIndent << NameTag(union_decl.members[i].name) << " = " << i
+               << "u,\n";
+    }
+    *file_ << kIndent << "};\n\n";
+    GenerateCodingConstants(union_decl.typeshape);
+    EmitBlank(file_);
+    *file_ << kIndent << "Tag Which() const { return static_cast<Tag>(value_.index()); }\n";
+    for (size_t i = 0; i < union_decl.members.size(); i++) {
+        const auto& member = union_decl.members[i];
+        std::string member_name = NameIdentifier(member.name);
+        std::string type = NaturalType(member.type_ctor->type);
+        EmitBlank(file_);
+        *file_ << kIndent << "bool is_" << member_name << "() const { return value_.index() == "
+               << i << "u; }\n";
+        *file_ << kIndent << type << "& " << member_name << "() { return std::get<" << i
+               << ">(value_); }\n";
+        *file_ << kIndent << "const " << type << "& " << member_name
+               << "() const { return std::get<" << i << ">(value_); }\n";
+        *file_ << kIndent << "void set_" << member_name << "(" << type
+               << " value) { value_.emplace<" << i << ">(std::move(value)); }\n";
+    }
+    EmitBlank(file_);
+    *file_ << kIndent << "// Moves any handles into the message.\n";
+    *file_ << kIndent << "bool Encode(::fidl::Encoder* encoder, uint32_t offset);\n";
+    *file_ << kIndent << "static bool Decode(::fidl::Decoder* decoder, " << name
+           << "* value, uint32_t offset);\n\n";
+    *file_ << "private:\n";
+    *file_ << kIndent << "std::variant<";
+    StringView separator = "";
+    for (const auto& member : union_decl.members) {
+        *file_ << separator << NaturalType(member.type_ctor->type);
+        separator = ", ";
+    }
+    *file_ << "> value_;\n";
+    *file_ << "};\n\n";
+}
+
+void CppGenerator::ProduceTableDeclaration(const flat::Table& table_decl) {
+    std::string name = table_decl.name.name_part();
+    *file_ << "struct " << name << " {\n";
+    GenerateCodingConstants(table_decl.typeshape);
+    EmitBlank(file_);
+    for (const auto& member : table_decl.members) {
+        if (!member.maybe_used)
+            continue;
+        *file_ << kIndent << "std::optional<" << NaturalType(member.maybe_used->type_ctor->type)
+               << "> " << NameIdentifier(member.maybe_used->name) << ";\n";
+    }
+    EmitBlank(file_);
+    *file_ << kIndent << "// Moves any handles into the message.\n";
+    *file_ << kIndent << "bool Encode(::fidl::Encoder* encoder, uint32_t offset);\n";
+    *file_ << kIndent << "// Skips fields that this library does not know.\n";
+    *file_ << kIndent << "static bool Decode(::fidl::Decoder* decoder, " << name
+           << "* value, uint32_t offset);\n";
+    *file_ << "};\n\n";
+}
+
+void CppGenerator::ProduceXUnionDeclaration(const flat::XUnion& xunion_decl) {
+    std::string name = xunion_decl.name.name_part();
+    *file_ << "class " << name << " {\n";
+    *file_ << "public:\n";
+    *file_ << kIndent << "// An xunion starts out as Invalid, which cannot be encoded, and\n";
+    *file_ << kIndent << "// decodes as Invalid when it holds a member this library does\n";
+    *file_ << kIndent << "// not know.\n";
+    *file_ << kIndent << "enum class Tag : uint32_t {\n";
+    *file_ << kIndent << kIndent << "Invalid = 0u,\n";
+    for (const auto& member : xunion_decl.members) {
+        *file_ << kIndent << kIndent << NameTag(member.name) << " = 0x"
+               << Hex(member.ordinal->value) << "u,\n";
+    }
+    *file_ << kIndent << "};\n\n";
+    GenerateCodingConstants(xunion_decl.typeshape);
+    EmitBlank(file_);
+    *file_ << kIndent << "Tag Which() const;\n";
+    for (size_t i = 0; i < xunion_decl.members.size(); i++) {
+        const auto& member = xunion_decl.members[i];
+        std::string member_name = NameIdentifier(member.name);
+        std::string type = NaturalType(member.type_ctor->type);
+        EmitBlank(file_);
+        *file_ << kIndent << "bool is_" << member_name << "() const { return value_.index() == "
+               << i + 1u << "u; }\n";
+        *file_ << kIndent << type << "& " << member_name << "() { return std::get<" << i + 1u
+               << ">(value_); }\n";
+        *file_ << kIndent << "const " << type << "& " << member_name
+               << "() const { return std::get<" << i + 1u << ">(value_); }\n";
+        *file_ << kIndent << "void set_" << member_name << "(" << type
+               << " value) { value_.emplace<" << i + 1u << ">(std::move(value)); }\n";
+    }
+    EmitBlank(file_);
+    *file_ << kIndent << "// Moves any handles into the message.\n";
+    *file_ << kIndent << "bool Encode(::fidl::Encoder* encoder, uint32_t offset);\n";
+    *file_ << kIndent << "static bool Decode(::fidl::Decoder* decoder, " << name
+           << "* value, uint32_t offset);\n\n";
+    *file_ << kIndent << "// For the std::optional of a nullable " << name << ".\n";
+    *file_ << kIndent << "static bool IsAbsent(const ::fidl::Decoder& decoder, uint32_t offset) {\n";
+    *file_ << kIndent << kIndent << "return decoder.Read<uint32_t>(offset) == 0u;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "static bool DecodeAbsent(::fidl::Decoder* decoder, uint32_t offset) {\n";
+    *file_ << kIndent << kIndent << "if (!::fidl::IsAbsentEnvelope(*decoder, offset + 8u))\n";
+    *file_ << kIndent << kIndent << kIndent << "return decoder->Fail(ZX_ERR_INVALID_ARGS);\n";
+    *file_ << kIndent << kIndent << "return ::fidl::DecodeAbsentEnvelope(decoder, offset + 8u);\n";
+    *file_ << kIndent << "}\n\n";
+    *file_ << "private:\n";
+    *file_ << kIndent << "std::variant<std::monostate";
+    for (const auto& member : xunion_decl.members) {
+        *file_ << ", " << NaturalType(member.type_ctor->type);
+    }
+    *file_ << "> value_;\n";
+    *file_ << "};\n\n";
+}
+
+void CppGenerator::ProduceInterfaceDeclaration(const flat::Interface& interface_decl) {
+    std::string name = interface_decl.name.name_part();
+    *file_ << "class " << name << " final {\n";
+    *file_ << "public:\n";
+    for (const auto* method : interface_decl.all_methods) {
+        *file_ << kIndent << "static constexpr uint32_t " << OrdinalName(*method) << " = 0x"
+               << Hex(method->ordinal->value) << "u;\n";
+    }
+    if (!UsesChannel(interface_decl)) {
+        // Only channels have generated clients and servers so far.
+        *file_ << "};\n\n";
+        return;
+    }
+
+    uint32_t max_num_bytes = kMessageHeaderSize;
+    uint32_t max_num_handles = 0u;
+    for (const auto* method : interface_decl.all_methods) {
+        for (const flat::Struct* message : {method->maybe_request, method->maybe_response}) {
+            if (message == nullptr)
+                continue;
+            max_num_bytes = std::max(max_num_bytes, MessageMaxNumBytes(*message));
+            max_num_handles = std::max(
+                max_num_handles, std::min(ZX_CHANNEL_MAX_MSG_HANDLES, message->typeshape.MaxHandles()));
+        }
+    }
+    if (!interface_decl.all_methods.empty())
+        EmitBlank(file_);
+    *file_ << kIndent << "// The most bytes and handles that any message of " << name
+           << " takes up,\n";
+    *file_ << kIndent << "// and a buffer that fits them.\n";
+    *file_ << kIndent << "static constexpr uint32_t kMaxMessageBytes = " << max_num_bytes
+           << "u;\n";
+    *file_ << kIndent << "static constexpr uint32_t kMaxMessageHandles = " << max_num_handles
+           << "u;\n";
+    *file_ << kIndent
+           << "using Buffer = ::fidl::MessageBuffer<kMaxMessageBytes, kMaxMessageHandles>;\n\n";
+
+    bool has_events = HasEvents(interface_decl);
+    if (has_events) {
+        *file_ << kIndent << "class EventHandler {\n";
+        *file_ << kIndent << "public:\n";
+        *file_ << kIndent << kIndent << "virtual ~EventHandler() = default;\n";
+        for (const auto* method : interface_decl.all_methods) {
+            if (!IsEvent(*method))
+                continue;
+            *file_ << kIndent << kIndent << "virtual void " << NameIdentifier(method->name) << "(";
+            EmitDecodedParams(file_, *method->maybe_response, "", "", "");
+            *file_ << ") = 0;\n";
+        }
+        *file_ << kIndent << "};\n\n";
+    }
+
+    *file_ << kIndent << "// Makes synchronous calls on a channel. Requests are encoded into\n";
+    *file_ << kIndent << "// the buffer, and responses read into it, so the strings and\n";
+    *file_ << kIndent << "// vectors that a response returns as views point into the buffer\n";
+    *file_ << kIndent << "// until the next call.\n";
+    *file_ << kIndent << "class SyncClient final {\n";
+    *file_ << kIndent << "public:\n";
+    *file_ << kIndent << kIndent
+           << "SyncClient(::fidl::Handle channel, ::fidl::BufferRef buffer)\n";
+    *file_ << kIndent << kIndent << kIndent
+           << ": channel_(std::move(channel)), buffer_(buffer) {}\n\n";
+    *file_ << kIndent << kIndent
+           << "const ::fidl::Handle& channel() const { return channel_; }\n";
+    for (const auto* method : interface_decl.all_methods) {
+        if (IsEvent(*method))
+            continue;
+        EmitBlank(file_);
+        *file_ << kIndent << kIndent << "zx_status_t " << NameIdentifier(method->name) << "(";
+        EmitEncodedParams(file_, *method->maybe_request, "");
+        if (method->maybe_response != nullptr) {
+            EmitDecodedParams(file_, *method->maybe_response,
+                              method->maybe_request->members.empty() ? "" : ", ", "out_", "*");
+        }
+        *file_ << ");\n";
+    }
+    if (has_events) {
+        EmitBlank(file_);
+        *file_ << kIndent << kIndent << "// Reads an event, without waiting for one, and passes\n";
+        *file_ << kIndent << kIndent << "// it to |handler|.\n";
+        *file_ << kIndent << kIndent << "zx_status_t HandleEvent(EventHandler* handler);\n";
+    }
+    *file_ << "\n";
+    *file_ << kIndent << "private:\n";
+    *file_ << kIndent << kIndent << "::fidl::Handle channel_;\n";
+    *file_ << kIndent << kIndent << "::fidl::BufferRef buffer_;\n";
+    *file_ << kIndent << "};\n\n";
+
+    *file_ << kIndent << "// What a server implements. Strings and vectors of numbers in a\n";
+    *file_ << kIndent << "// request view the request's buffer until the handler returns.\n";
+    *file_ << kIndent << "// Handlers of two-way methods reply through |txn| before returning.\n";
+    *file_ << kIndent << "class Interface {\n";
+    *file_ << kIndent << "public:\n";
+    *file_ << kIndent << kIndent << "virtual ~Interface() = default;\n";
+    for (const auto* method : interface_decl.all_methods) {
+        if (IsEvent(*method))
+            continue;
+        *file_ << kIndent << kIndent << "virtual void " << NameIdentifier(method->name) << "(";
+        EmitDecodedParams(file_, *method->maybe_request, "", "", "");
+        if (method->maybe_response != nullptr) {
+            *file_ << (method->maybe_request->members.empty() ? "" : ", ")
+                   << "::fidl::Transaction* txn";
+        }
+        *file_ << ") = 0;\n";
+    }
+    *file_ << kIndent << "};\n\n";
+
+    *file_ << kIndent << "// Decodes |message| and passes it to |impl|. Leaves the handles of\n";
+    *file_ << kIndent << "// a message with an unknown ordinal alone, and returns\n";
+    *file_ << kIndent << "// ZX_ERR_NOT_SUPPORTED.\n";
+    *file_ << kIndent << "static zx_status_t TryDispatch(Interface* impl, ::fidl::Transaction* txn, "
+                         "fidl_msg_t* message);\n";
+    *file_ << kIndent << "// Like TryDispatch, but closes the handles of a message with an\n";
+    *file_ << kIndent << "// unknown ordinal.\n";
+    *file_ << kIndent << "static zx_status_t Dispatch(Interface* impl, ::fidl::Transaction* txn, "
+                         "fidl_msg_t* message);\n";
+    for (const auto* method : interface_decl.all_methods) {
+        if (method->maybe_response == nullptr)
+            continue;
+        std::string method_name = NameIdentifier(method->name);
+        if (IsEvent(*method)) {
+            *file_ << kIndent << "static zx_status_t Send" << method_name
+                   << "Event(zx_handle_t channel, ::fidl::BufferRef buffer";
+        } else {
+            *file_ << kIndent << "static zx_status_t Reply" << method_name
+                   << "(::fidl::Transaction* txn";
+        }
+        EmitEncodedParams(file_, *method->maybe_response, ", ");
+        *file_ << ");\n";
+    }
+    *file_ << "};\n\n";
+}
+
+void CppGenerator::ProduceStructDefinition(const flat::Struct& struct_decl) {
+    std::string name = struct_decl.name.name_part();
+    *file_ << "bool " << name << "::Encode(::fidl::Encoder* encoder, uint32_t offset) {\n";
+    if (struct_decl.members.empty()) {
+        *file_ << kIndent << "return true;\n";
+    } else {
+        *file_ << kIndent;
+        StringView separator = "return ";
+        for (const auto& member : struct_decl.members) {
+            *file_ << separator << "::fidl::Encode(encoder, &" << NameIdentifier(member.name)
+                   << ", " << Offset("offset", member.fieldshape.Offset()) << ")";
+            separator = " &&\n           ";
+        }
+        *file_ << ";\n";
+    }
+    *file_ << "}\n\n";
+
+    *file_ << "bool " << name << "::Decode(::fidl::Decoder* decoder, " << name
+           << "* value, uint32_t offset) {\n";
+    if (struct_decl.members.empty()) {
+        *file_ << kIndent << "return true;\n";
+    } else {
+        *file_ << kIndent;
+        StringView separator = "return ";
+        for (const auto& member : struct_decl.members) {
+            *file_ << separator << "::fidl::Decode(decoder, &value->"
+                   << NameIdentifier(member.name) << ", "
+                   << Offset("offset", member.fieldshape.Offset()) << ")";
+            separator = " &&\n           ";
+        }
+        *file_ << ";\n";
+    }
+    *file_ << "}\n\n";
+}
+
+void CppGenerator::ProduceUnionDefinition(const flat::Union& union_decl) {
+    std::string name = union_decl.name.name_part();
+    uint32_t data_offset = union_decl.membershape.Offset();
+    *file_ << "bool " << name << "::Encode(::fidl::Encoder* encoder, uint32_t offset) {\n";
+    *file_ << kIndent << "encoder->Write<uint32_t>(offset, static_cast<uint32_t>(value_.index()));\n";
+    *file_ << kIndent << "switch (value_.index()) {\n";
+    for (size_t i = 0; i < union_decl.members.size(); i++) {
+        *file_ << kIndent << "case " << i << "u:\n";
+        *file_ << kIndent << kIndent << "return ::fidl::Encode(encoder, &std::get<" << i
+               << ">(value_), " << Offset("offset", data_offset) << ");\n";
+    }
+    *file_ << kIndent << "default:\n";
+    *file_ << kIndent << kIndent << "return encoder->Fail(ZX_ERR_INVALID_ARGS);\n";
+    *file_ << kIndent << "}\n";
+    *file_ << "}\n\n";
+
+    *file_ << "bool " << name << "::Decode(::fidl::Decoder* decoder, " << name
+           << "* value, uint32_t offset) {\n";
+    *file_ << kIndent << "switch (decoder->Read<uint32_t>(offset)) {\n";
+    for (size_t i = 0; i < union_decl.members.size(); i++) {
+        *file_ << kIndent << "case " << i << "u:\n";
+        *file_ << kIndent << kIndent << "return ::fidl::Decode(decoder, &value->value_.emplace<"
+               << i << ">(), " << Offset("offset", data_offset) << ");\n";
+    }
+    *file_ << kIndent << "default:\n";
+    *file_ << kIndent << kIndent << "return decoder->Fail(ZX_ERR_INVALID_ARGS);\n";
+    *file_ << kIndent << "}\n";
+    *file_ << "}\n\n";
+}
+
+void CppGenerator::ProduceTableDefinition(const flat::Table& table_decl) {
+    std::string name = table_decl.name.name_part();
+    std::vector<const flat::Table::Member*> used_members;
+    uint32_t max_ordinal = 0u;
+    for (const auto& member : table_decl.members) {
+        max_ordinal = std::max(max_ordinal, member.ordinal->value);
+        if (member.maybe_used)
+            used_members.push_back(&member);
+    }
+    std::sort(used_members.begin(), used_members.end(),
+              [](const flat::Table::Member* a, const flat::Table::Member* b) {
+                  return a->ordinal->value < b->ordinal->value;
+              });
+
+    *file_ << "bool " << name << "::Encode(::fidl::Encoder* encoder, uint32_t offset) {\n";
+    *file_ << kIndent << "// Envelopes up to the highest ordinal that is set.\n";
+    *file_ << kIndent << "uint64_t count = 0u;\n";
+    StringView keyword = "if";
+    for (auto it = used_members.rbegin(); it != used_members.rend(); ++it) {
+        *file_ << kIndent << keyword << " (" << NameIdentifier((*it)->maybe_used->name) << ")\n";
+        *file_ << kIndent << kIndent << "count = " << (*it)->ordinal->value << "u;\n";
+        keyword = "else if";
+    }
+    *file_ << kIndent << "uint32_t envelopes;\n";
+    *file_ << kIndent << "if (!::fidl::EncodeVectorHeader(encoder, count, " << max_ordinal
+           << "u, ::fidl::kEnvelopeSize, offset, &envelopes))\n";
+    *file_ << kIndent << kIndent << "return false;\n";
+    for (const auto* member : used_members) {
+        std::string member_name = NameIdentifier(member->maybe_used->name);
+        *file_ << kIndent << "if (" << member_name << " && !::fidl::EncodeEnvelope(encoder, &*"
+               << member_name << ", "
+               << Offset("envelopes", (member->ordinal->value - 1u) * 16u) << "))\n";
+        *file_ << kIndent << kIndent << "return false;\n";
+    }
+    *file_ << kIndent << "return true;\n";
+    *file_ << "}\n\n";
+
+    *file_ << "bool " << name << "::Decode(::fidl::Decoder* decoder, " << name
+           << "* value, uint32_t offset) {\n";
+    *file_ << kIndent << "uint64_t count;\n";
+    *file_ << kIndent << "uint32_t envelopes;\n";
+    *file_ << kIndent << "if (!::fidl::DecodeVectorHeader(decoder, UINT32_MAX, ::fidl::kEnvelopeSize, "
+                         "offset, &count, &envelopes))\n";
+    *file_ << kIndent << kIndent << "return false;\n";
+    for (const auto* member : used_members) {
+        *file_ << kIndent << "value->" << NameIdentifier(member->maybe_used->name)
+               << ".reset();\n";
+    }
+    *file_ << kIndent << "for (uint64_t i = 0u; i < count; i++) {\n";
+    *file_ << kIndent << kIndent
+           << "uint32_t envelope = envelopes + static_cast<uint32_t>(i) * ::fidl::kEnvelopeSize;\n";
+    *file_ << kIndent << kIndent << "bool ok;\n";
+    *file_ << kIndent << kIndent << "switch (i + 1u) {\n";
+    for (const auto* member : used_members) {
+        *file_ << kIndent << kIndent << "case " << member->ordinal->value << "u:\n";
+        *file_ << kIndent << kIndent << kIndent << "ok = ::fidl::DecodeEnvelope(decoder, &value->"
+               << NameIdentifier(member->maybe_used->name) << ", envelope);\n";
+        *file_ << kIndent << kIndent << kIndent << "break;\n";
+    }
+    *file_ << kIndent << kIndent << "default:\n";
+    *file_ << kIndent << kIndent << kIndent << "ok = ::fidl::SkipEnvelope(decoder, envelope);\n";
+    *file_ << kIndent << kIndent << kIndent << "break;\n";
+    *file_ << kIndent << kIndent << "}\n";
+    *file_ << kIndent << kIndent << "if (!ok)\n";
+    *file_ << kIndent << kIndent << kIndent << "return false;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "return true;\n";
+    *file_ << "}\n\n";
+}
+
+void CppGenerator::ProduceXUnionDefinition(const flat::XUnion& xunion_decl) {
+    std::string name = xunion_decl.name.name_part();
+    *file_ << name << "::Tag " << name << "::Which() const {\n";
+    *file_ << kIndent << "switch (value_.index()) {\n";
+    for (size_t i = 0; i < xunion_decl.members.size(); i++) {
+        *file_ << kIndent << "case " << i + 1u << "u:\n";
+        *file_ << kIndent << kIndent << "return Tag::" << NameTag(xunion_decl.members[i].name)
+               << ";\n";
+    }
+    *file_ << kIndent << "default:\n";
+    *file_ << kIndent << kIndent << "return Tag::Invalid;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << "}\n\n";
+
+    *file_ << "bool " << name << "::Encode(::fidl::Encoder* encoder, uint32_t offset) {\n";
+    *file_ << kIndent << "switch (value_.index()) {\n";
+    for (size_t i = 0; i < xunion_decl.members.size(); i++) {
+        *file_ << kIndent << "case " << i + 1u << "u:\n";
+        *file_ << kIndent << kIndent << "encoder->Write<uint32_t>(offset, 0x"
+               << Hex(xunion_decl.members[i].ordinal->value) << "u);\n";
+        *file_ << kIndent << kIndent << "return ::fidl::EncodeEnvelope(encoder, &std::get<"
+               << i + 1u << ">(value_), offset + 8u);\n";
+    }
+    *file_ << kIndent << "default:\n";
+    *file_ << kIndent << kIndent << "return encoder->Fail(ZX_ERR_INVALID_ARGS);\n";
+    *file_ << kIndent << "}\n";
+    *file_ << "}\n\n";
+
+    *file_ << "bool " << name << "::Decode(::fidl::Decoder* decoder, " << name
+           << "* value, uint32_t offset) {\n";
+    *file_ << kIndent << "switch (decoder->Read<uint32_t>(offset)) {\n";
+    for (size_t i = 0; i < xunion_decl.members.size(); i++) {
+        *file_ << kIndent << "case 0x" << Hex(xunion_decl.members[i].ordinal->value) << "u:\n";
+        *file_ << kIndent << kIndent
+               << "return ::fidl::DecodeEnvelope(decoder, &value->value_.emplace<" << i + 1u
+               << ">(), offset + 8u);\n";
+    }
+    *file_ << kIndent << "case 0u:\n";
+    *file_ << kIndent << kIndent << "return decoder->Fail(ZX_ERR_INVALID_ARGS);\n";
+    *file_ << kIndent << "default:\n";
+    *file_ << kIndent << kIndent << "value->value_.emplace<0>();\n";
+    *file_ << kIndent << kIndent << "return ::fidl::SkipEnvelope(decoder, offset + 8u);\n";
+    *file_ << kIndent << "}\n";
+    *file_ << "}\n\n";
+}
+
+void CppGenerator::ProduceInterfaceDefinition(const flat::Interface& interface_decl) {
+    if (!UsesChannel(interface_decl))
+        return;
+    std::string name = interface_decl.name.name_part();
+
+    for (const auto* method : interface_decl.all_methods) {
+        if (IsEvent(*method))
+            continue;
+        std::string method_name = NameIdentifier(method->name);
+        std::string ordinal = OrdinalName(*method);
+        *file_ << "zx_status_t " << name << "::SyncClient::" << method_name << "(";
+        EmitEncodedParams(file_, *method->maybe_request, "");
+        if (method->maybe_response != nullptr) {
+            EmitDecodedParams(file_, *method->maybe_response,
+                              method->maybe_request->members.empty() ? "" : ", ", "out_", "*");
+        }
+        *file_ << ") {\n";
+        *file_ << kIndent << "::fidl::Encoder _encoder(buffer_);\n";
+        EmitChecks(file_, 1u, EncodeMessage(ordinal, *method->maybe_request),
+                   "return _encoder.status();");
+        if (method->maybe_response == nullptr) {
+            *file_ << kIndent << "return ::fidl::Write(channel_.get(), &_encoder);\n";
+            *file_ << "}\n\n";
+            continue;
+        }
+        *file_ << kIndent << "uint32_t _num_bytes;\n";
+        *file_ << kIndent << "uint32_t _num_handles;\n";
+        *file_ << kIndent << "zx_status_t _status = ::fidl::Call(channel_.get(), &_encoder, "
+                             "buffer_, &_num_bytes, &_num_handles);\n";
+        *file_ << kIndent << "if (_status != ZX_OK)\n";
+        *file_ << kIndent << kIndent << "return _status;\n";
+        *file_ << kIndent << "::fidl::Decoder _decoder(buffer_.bytes, _num_bytes, "
+                             "buffer_.handles, _num_handles);\n";
+        EmitChecks(file_, 1u, DecodeMessage(ordinal, *method->maybe_response, "out_"),
+                   "return _decoder.status();");
+        *file_ << kIndent << "return _decoder.Finish();\n";
+        *file_ << "}\n\n";
+    }
+
+    if (HasEvents(interface_decl)) {
+        *file_ << "zx_status_t " << name << "::SyncClient::HandleEvent(EventHandler* handler) {\n";
+        *file_ << kIndent << "fidl_msg_t _message;\n";
+        *file_ << kIndent << "zx_status_t _status = ::fidl::Read(channel_.get(), buffer_, &_message);\n";
+        *file_ << kIndent << "if (_status != ZX_OK)\n";
+        *file_ << kIndent << kIndent << "return _status;\n";
+        *file_ << kIndent << "::fidl::Decoder _decoder(_message);\n";
+        *file_ << kIndent << "if (_message.num_bytes < sizeof(fidl_message_header_t))\n";
+        *file_ << kIndent << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
+        *file_ << kIndent << "switch (static_cast<const fidl_message_header_t*>(_message.bytes)->ordinal) {\n";
+        for (const auto* method : interface_decl.all_methods) {
+            if (!IsEvent(*method))
+                continue;
+            std::string ordinal = OrdinalName(*method);
+            *file_ << kIndent << "case " << ordinal << ": {\n";
+            EmitDecodedLocals(file_, 2u, *method->maybe_response);
+            EmitChecks(file_, 2u, DecodeMessage(ordinal, *method->maybe_response, "&"),
+                       "return _decoder.status();");
+            *file_ << kIndent << kIndent << "_status = _decoder.Finish();\n";
+            *file_ << kIndent << kIndent << "if (_status != ZX_OK)\n";
+            *file_ << kIndent << kIndent << kIndent << "return _status;\n";
+            *file_ << kIndent << kIndent << "handler->" << NameIdentifier(method->name) << "(";
+            EmitMovedArgs(file_, *method->maybe_response);
+            *file_ << ");\n";
+            *file_ << kIndent << kIndent << "return ZX_OK;\n";
+            *file_ << kIndent << "}\n";
+        }
+        *file_ << kIndent << "default:\n";
+        *file_ << kIndent << kIndent << "return ZX_ERR_NOT_SUPPORTED;\n";
+        *file_ << kIndent << "}\n";
+        *file_ << "}\n\n";
+    }
+
+    *file_ << "zx_status_t " << name << "::TryDispatch(Interface* impl, ::fidl::Transaction* txn, "
+                                        "fidl_msg_t* message) {\n";
+    *file_ << kIndent << "if (message->num_bytes < sizeof(fidl_message_header_t)) {\n";
+    *file_ << kIndent << kIndent << "zx_handle_close_many(message->handles, message->num_handles);\n";
+    *file_ << kIndent << kIndent << "return ZX_ERR_INVALID_ARGS;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << kIndent << "switch (static_cast<const fidl_message_header_t*>(message->bytes)->ordinal) {\n";
+    for (const auto* method : interface_decl.all_methods) {
+        if (IsEvent(*method))
+            continue;
+        std::string ordinal = OrdinalName(*method);
+        *file_ << kIndent << "case " << ordinal << ": {\n";
+        *file_ << kIndent << kIndent << "::fidl::Decoder _decoder(*message);\n";
+        EmitDecodedLocals(file_, 2u, *method->maybe_request);
+        EmitChecks(file_, 2u, DecodeMessage(ordinal, *method->maybe_request, "&"),
+                   "return _decoder.status();");
+        *file_ << kIndent << kIndent << "zx_status_t _status = _decoder.Finish();\n";
+        *file_ << kIndent << kIndent << "if (_status != ZX_OK)\n";
+        *file_ << kIndent << kIndent << kIndent << "return _status;\n";
+        *file_ << kIndent << kIndent << "impl->" << NameIdentifier(method->name) << "(";
+        EmitMovedArgs(file_, *method->maybe_request);
+        if (method->maybe_response != nullptr)
+            *file_ << (method->maybe_request->members.empty() ? "" : ", ") << "txn";
+        *file_ << ");\n";
+        *file_ << kIndent << kIndent << "return ZX_OK;\n";
+        *file_ << kIndent << "}\n";
+    }
+    *file_ << kIndent << "default:\n";
+    *file_ << kIndent << kIndent << "return ZX_ERR_NOT_SUPPORTED;\n";
+    *file_ << kIndent << "}\n";
+    *file_ << "}\n\n";
+
+    *file_ << "zx_status_t " << name << "::Dispatch(Interface* impl, ::fidl::Transaction* txn, "
+                                        "fidl_msg_t* message) {\n";
+    *file_ << kIndent << "zx_status_t status = TryDispatch(impl, txn, message);\n";
+    *file_ << kIndent << "if (status == ZX_ERR_NOT_SUPPORTED)\n";
+    *file_ << kIndent << kIndent << "zx_handle_close_many(message->handles, message->num_handles);\n";
+    *file_ << kIndent << "return status;\n";
+    *file_ << "}\n\n";
+
+    for (const auto* method : interface_decl.all_methods) {
+        if (method->maybe_response == nullptr)
+            continue;
+        std::string method_name = NameIdentifier(method->name);
+        if (IsEvent(*method)) {
+            *file_ << "zx_status_t " << name << "::Send" << method_name
+                   << "Event(zx_handle_t channel, ::fidl::BufferRef buffer";
+        } else {
+            *file_ << "zx_status_t " << name << "::Reply" << method_name
+                   << "(::fidl::Transaction* txn";
+        }
+        EmitEncodedParams(file_, *method->maybe_response, ", ");
+        *file_ << ") {\n";
+        *file_ << kIndent << "::fidl::Encoder _encoder(" << (IsEvent(*method) ? "buffer" : "txn->buffer()")
+               << ");\n";
+        EmitChecks(file_, 1u, EncodeMessage(OrdinalName(*method), *method->maybe_response),
+                   "return _encoder.status();");
+        if (IsEvent(*method)) {
+            *file_ << kIndent << "return ::fidl::Write(channel, &_encoder);\n";
+        } else {
+            *file_ << kIndent << "fidl_msg_t _message = _encoder.TakeMessage();\n";
+            *file_ << kIndent << "return txn->Reply(&_message);\n";
+        }
+        *file_ << "}\n\n";
+    }
+}
+
+void CppGenerator::ProduceHeader(OutputSink* file) {
+    file_ = file;
+    std::vector<const flat::Decl*> decls = LibraryDecls();
+
+    EmitFileComment(file_);
+    *file_ << "#pragma once\n\n";
+    *file_ << "#include <lib/fidl/cpp/bindings.h>\n";
+    std::set<std::string> add_includes;
+    for (const auto& dep_library : library_->dependencies()) {
+        if (dep_library == library_)
+            continue;
+        if (dep_library->HasAttribute("Internal"))
+            continue;
+        add_includes.insert(NameLibraryCppHeader(dep_library->name()));
+    }
+    for (const auto& include : add_includes) {
+        *file_ << "#include <" << include << ">\n";
+    }
+    EmitBlank(file_);
+
+    std::string namespace_name = NameNamespace(library_->name());
+    *file_ << "namespace " << namespace_name << " {\n";
+
+    *file_ << "\n// Forward declarations\n\n";
+    for (const auto* decl : decls) {
+        ProduceForwardDeclaration(*decl);
+    }
+
+    *file_ << "\n// Declarations\n\n";
+    for (const auto* decl : decls) {
+        switch (decl->kind) {
+        case flat::Decl::Kind::kConst:
+            ProduceConstDeclaration(*static_cast<const flat::Const*>(decl));
+            break;
+        case flat::Decl::Kind::kBits:
+            ProduceBitsDeclaration(*static_cast<const flat::Bits*>(decl));
+            break;
+        case flat::Decl::Kind::kEnum:
+            ProduceEnumDeclaration(*static_cast<const flat::Enum*>(decl));
+            break;
+        case flat::Decl::Kind::kStruct:
+            ProduceStructDeclaration(*static_cast<const flat::Struct*>(decl));
+            break;
+        case flat::Decl::Kind::kTable:
+            ProduceTableDeclaration(*static_cast<const flat::Table*>(decl));
+            break;
+        case flat::Decl::Kind::kUnion:
+            ProduceUnionDeclaration(*static_cast<const flat::Union*>(decl));
+            break;
+        case flat::Decl::Kind::kXUnion:
+            ProduceXUnionDeclaration(*static_cast<const flat::XUnion*>(decl));
+            break;
+        case flat::Decl::Kind::kInterface:
+            // After every type, which their methods refer to.
+            break;
+        }
+    }
+    for (const auto* decl : decls) {
+        if (decl->kind == flat::Decl::Kind::kInterface)
+            ProduceInterfaceDeclaration(*static_cast<const flat::Interface*>(decl));
+    }
+
+    *file_ << "} // namespace " << namespace_name << "\n";
+    file_ = nullptr;
+}
+
+void CppGenerator::ProduceSource(OutputSink* file) {
+    file_ = file;
+
+    EmitFileComment(file_);
+    *file_ << "#include <" << NameLibraryCppHeader(library_->name()) << ">\n\n";
+
+    std::string namespace_name = NameNamespace(library_->name());
+    *file_ << "namespace " << namespace_name << " {\n\n";
+    for (const auto* decl : LibraryDecls()) {
+        switch (decl->kind) {
+        case flat::Decl::Kind::kConst:
+        case flat::Decl::Kind::kBits:
+        case flat::Decl::Kind::kEnum:
+            break;
+        case flat::Decl::Kind::kStruct:
+            ProduceStructDefinition(*static_cast<const flat::Struct*>(decl));
+            break;
+        case flat::Decl::Kind::kTable:
+            ProduceTableDefinition(*static_cast<const flat::Table*>(decl));
+            break;
+        case flat::Decl::Kind::kUnion:
+            ProduceUnionDefinition(*static_cast<const flat::Union*>(decl));
+            break;
+        case flat::Decl::Kind::kXUnion:
+            ProduceXUnionDefinition(*static_cast<const flat::XUnion*>(decl));
+            break;
+        case flat::Decl::Kind::kInterface:
+            ProduceInterfaceDefinition(*static_cast<const flat::Interface*>(decl));
+            break;
+        }
+    }
+    *file_ << "} // namespace " << namespace_name << "\n";
+    file_ = nullptr;
+}
+
+} // namespace fidl
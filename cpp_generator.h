@@ -0,0 +1,62 @@
+#ifndef CPP_GENERATOR_H_
+#define CPP_GENERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "flat_ast.h"
+#include "output_sink.h"
+#include "string_view.h"
+
+namespace fidl {
+
+// Generates C++17 bindings for a library, on top of the runtime in
+// <lib/fidl/cpp/bindings.h>.
+//
+// Each declaration becomes a natural C++ type, with inline storage for
+// strings and vectors whose bound is small, and move-only handles. Structs,
+// unions, tables and xunions encode and decode themselves at the offsets in
+// their typeshapes. Each protocol gets a synchronous client and a server
+// interface, whose methods encode directly into a buffer the caller provides
+// and never allocate to do so; strings and vectors of numbers are passed as
+// std::string_view and fidl::Span, which on the receiving side view the
+// message in place.
+class CppGenerator {
+public:
+    explicit CppGenerator(const flat::Library* library) : library_(library) {}
+
+    ~CppGenerator() = default;
+
+    void ProduceHeader(OutputSink* file);
+    void ProduceSource(OutputSink* file);
+
+private:
+    // The declarations of this library, without those of its dependencies,
+    // in an order in which each one only refers to earlier ones.
+    std::vector<const flat::Decl*> LibraryDecls() const;
+
+    void ProduceForwardDeclaration(const flat::Decl& decl);
+    void ProduceConstDeclaration(const flat::Const& const_decl);
+    void ProduceBitsDeclaration(const flat::Bits& bits_decl);
+    void ProduceEnumDeclaration(const flat::Enum& enum_decl);
+    void ProduceStructDeclaration(const flat::Struct& struct_decl);
+    void ProduceUnionDeclaration(const flat::Union& union_decl);
+    void ProduceTableDeclaration(const flat::Table& table_decl);
+    void ProduceXUnionDeclaration(const flat::XUnion& xunion_decl);
+    void ProduceInterfaceDeclaration(const flat::Interface& interface_decl);
+
+    void ProduceStructDefinition(const flat::Struct& struct_decl);
+    void ProduceUnionDefinition(const flat::Union& union_decl);
+    void ProduceTableDefinition(const flat::Table& table_decl);
+    void ProduceXUnionDefinition(const flat::XUnion& xunion_decl);
+    void ProduceInterfaceDefinition(const flat::Interface& interface_decl);
+
+    void GenerateCodingConstants(const TypeShape& typeshape);
+
+    const flat::Library* library_;
+    OutputSink* file_ = nullptr;
+};
+
+} // namespace fidl
+
+#endif // CPP_GENERATOR_H_
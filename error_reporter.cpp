@@ -1,5 +1,7 @@
 #include "error_reporter.h"
 
+#include <assert.h>
+
 namespace fidl {
 
 std::string MakeSquiggle(const std::string& surrounding_line, int column) {
@@ -17,16 +19,60 @@ std::string MakeSquiggle(const std::string& surrounding_line, int column) {
     return squiggle;
 }
 
-std::string Format(std::string qualifier, const SourceLocation& location,
-                   StringView message, size_t squiggle_size = 0u) {
+const char* QualifierFor(Diagnostic::Kind kind) {
+    switch (kind) {
+    case Diagnostic::Kind::kError:
+        return "error";
+    case Diagnostic::Kind::kWarning:
+        return "warning";
+    }
+    assert(false && "unknown kind");
+    return "error";
+}
+
+void EmitJSONString(FILE* file, StringView value) {
+    fputc('"', file);
+    for (size_t i = 0; i < value.size(); i++) {
+        const char c = value[i];
+        switch (c) {
+        case '"':
+            fputs("\\\"", file);
+            break;
+        case '\\':
+            fputs("\\\\", file);
+            break;
+        case '\n':
+            fputs("\\n", file);
+            break;
+        case '\t':
+            fputs("\\t", file);
+            break;
+        default:
+            fputc(c, file);
+            break;
+        }
+    }
+    fputc('"', file);
+}
+
+std::string Diagnostic::Format() const {
+    std::string qualifier(QualifierFor(kind));
+    if (!location.valid()) {
+        std::string error(qualifier);
+        error.append(": ");
+        error.append(message);
+        return error;
+    }
+
     SourceFile::Position position;
     std::string surrounding_line = location.SourceLine(&position);
 
     std::string squiggle = MakeSquiggle(surrounding_line, position.column);
-    if (squiggle_size != 0u) {
-        --squiggle_size;
+    size_t tildes = squiggle_size;
+    if (tildes != 0u) {
+        --tildes;
     }
-    squiggle += std::string(squiggle_size, '~');
+    squiggle += std::string(tildes, '~');
     // Some tokens (like string literals) can span multiple
     // lines. Truncate the string to just one line at most. The
     // containing line contains a newline, so drop it when
@@ -50,19 +96,27 @@ std::string Format(std::string qualifier, const SourceLocation& location,
     return error;
 }
 
-// ReportError records an error with the location, message, source line, and
-// position indicator.
+void ErrorReporter::AddError(Diagnostic error) {
+    // Past the limit, errors are only counted, so that the checks on
+    // Checkpoint() still see them.
+    if (!LimitReached())
+        errors_.push_back(std::move(error));
+    ++num_errors_;
+}
+
+// ReportError records an error with the location and message, which are
+// printed with the source line and a position indicator.
 //
 //     filename:line:col: error: message
 //     sourceline
 //        ^
 void ErrorReporter::ReportError(const SourceLocation& location, StringView message) {
-    auto error = Format("error", location, message);
-    errors_.push_back(std::move(error));
+    AddError(Diagnostic(Diagnostic::Kind::kError, location, 0u, message));
 }
 
-// ReportError records an error with the location, message, source line,
-// position indicator, and tildes under the token reported.
+// ReportError records an error with the location and message, which are
+// printed with the source line, a position indicator, and tildes under the
+// token reported.
 //
 //     filename:line:col: error: message
 //     sourceline
@@ -70,19 +124,16 @@ void ErrorReporter::ReportError(const SourceLocation& location, StringView messa
 void ErrorReporter::ReportError(const Token& token, StringView message) {
     auto token_location = token.location();
     auto token_data = token_location.data();
-    auto error = Format("error", token_location, message, token_data.size());
-    errors_.push_back(std::move(error));
+    AddError(Diagnostic(Diagnostic::Kind::kError, token_location, token_data.size(), message));
 }
 
 // ReportError records the provided message.
 void ErrorReporter::ReportError(StringView message) {
-    std::string error("error: ");
-    error.append(message);
-    errors_.push_back(std::move(error));
+    AddError(Diagnostic(Diagnostic::Kind::kError, SourceLocation(), 0u, message));
 }
 
-// ReportWarning records a warning with the location, message, source line, and
-// position indicator.
+// ReportWarning records a warning with the location and message, which are
+// printed with the source line and a position indicator.
 //
 //     filename:line:col: warning: message
 //     sourceline
@@ -92,17 +143,56 @@ void ErrorReporter::ReportWarning(const SourceLocation& location, StringView mes
         ReportError(location, message);
         return;
     }
-    auto error = Format("warning", location, message);
-    warnings_.push_back(std::move(error));
+    warnings_.emplace_back(Diagnostic::Kind::kWarning, location, 0u, message);
 }
 
-void ErrorReporter::PrintReports() {
+void ErrorReporter::PrintReports(FILE* file) {
+    for (const auto& error : errors_) {
+        fprintf(file, "%s\n", error.Format().data());
+    }
+    if (num_errors_ > errors_.size()) {
+        fprintf(file, "error: too many errors, %zu more not shown\n",
+                num_errors_ - errors_.size());
+    }
+    for (const auto& warning : warnings_) {
+        fprintf(file, "%s\n", warning.Format().data());
+    }
+}
+
+// PrintReportsAsJSON prints one object per diagnostic, errors first:
+//
+//     [
+//       {"kind": "error", "path": "a.fidl", "line": 3, "column": 5, "length": 4,
+//        "message": "..."}
+//     ]
+//
+// Errors that do not refer to the source have no path, line, column or length.
+void ErrorReporter::PrintReportsAsJSON(FILE* file) {
+    fputs("[", file);
+    bool first = true;
+    auto print = [file, &first](const Diagnostic& diagnostic) {
+        fputs(first ? "\n  {" : ",\n  {", file);
+        first = false;
+        fprintf(file, "\"kind\": \"%s\"", QualifierFor(diagnostic.kind));
+        if (diagnostic.location.valid()) {
+            SourceFile::Position position;
+            diagnostic.location.SourceLine(&position);
+            fputs(", \"path\": ", file);
+            EmitJSONString(file, diagnostic.location.source_file().filename());
+            fprintf(file, ", \"line\": %d, \"column\": %d, \"length\": %zu",
+                    position.line, position.column, diagnostic.squiggle_size);
+        }
+        fputs(", \"message\": ", file);
+        EmitJSONString(file, diagnostic.message);
+        fputs("}", file);
+    };
     for (const auto& error : errors_) {
-        fprintf(stderr, "%s\n", error.data());
+        print(error);
     }
     for (const auto& warning : warnings_) {
-        fprintf(stderr, "%s\n", warning.data());
+        print(warning);
     }
+    fputs(first ? "]\n" : "\n]\n", file);
 }
 
 } // namespace fidl
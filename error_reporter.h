@@ -1,6 +1,8 @@
 #ifndef ERROR_REPORTER_H_
 #define ERROR_REPORTER_H_
 
+#include <stdio.h>
+
 #include <string>
 #include <vector>
 
@@ -10,19 +12,47 @@
 
 namespace fidl {
 
+// A single error or warning. Only the location and message are recorded when
+// it is reported; the source line and squiggle are looked up when it is
+// printed, so that reporting stays cheap for diagnostics that never are.
+struct Diagnostic {
+    enum class Kind {
+        kError,
+        kWarning,
+    };
+
+    Diagnostic(Kind kind, SourceLocation location, size_t squiggle_size, StringView message)
+        : kind(kind), location(location), squiggle_size(squiggle_size), message(message) {}
+
+    // Renders the diagnostic for a terminal or editor:
+    //
+    //     filename:line:col: error: message
+    //     sourceline
+    //        ^~~~
+    std::string Format() const;
+
+    Kind kind;
+    // Not valid for errors that do not refer to the source.
+    SourceLocation location;
+    size_t squiggle_size;
+    std::string message;
+};
+
 class ErrorReporter {
 public:
-    ErrorReporter(bool warnings_as_errors = false)
-        : warnings_as_errors_(warnings_as_errors) {}
+    // A |max_errors| of 0 means that there is no limit on the number of
+    // errors that are recorded.
+    ErrorReporter(bool warnings_as_errors = false, size_t max_errors = 0u)
+        : warnings_as_errors_(warnings_as_errors), max_errors_(max_errors) {}
 
     class Counts {
     public:
         Counts(const ErrorReporter* reporter)
             : reporter_(reporter),
-              num_errors_(reporter->errors().size()),
-              num_warnings_(reporter->warnings().size()) {}
-        bool NoNewErrors() { return num_errors_ == reporter_->errors().size(); }
-        bool NoNewWarnings() { return num_warnings_ == reporter_->warnings().size(); }
+              num_errors_(reporter->num_errors()),
+              num_warnings_(reporter->num_warnings()) {}
+        bool NoNewErrors() const { return num_errors_ == reporter_->num_errors(); }
+        bool NoNewWarnings() const { return num_warnings_ == reporter_->num_warnings(); }
     private:
         const ErrorReporter* reporter_;
         const size_t num_errors_;
@@ -34,14 +64,28 @@ public:
     void ReportError(StringView message);
     void ReportWarning(const SourceLocation& location, StringView message);
     Counts Checkpoint() const { return Counts(this); }
-    const std::vector<std::string>& errors() const { return errors_; }
-    const std::vector<std::string>& warnings() const { return warnings_; }
+    const std::vector<Diagnostic>& errors() const { return errors_; }
+    const std::vector<Diagnostic>& warnings() const { return warnings_; }
+
+    // These include the errors that were dropped once the limit was reached.
+    size_t num_errors() const { return num_errors_; }
+    size_t num_warnings() const { return warnings_.size(); }
 
-    void PrintReports();
+    // Whether |max_errors| errors have been reported, after which compilation
+    // should stop as soon as possible.
+    bool LimitReached() const { return max_errors_ != 0u && num_errors_ >= max_errors_; }
+
+    void PrintReports(FILE* file = stderr);
+    // Prints the diagnostics as a JSON array, for tools.
+    void PrintReportsAsJSON(FILE* file = stderr);
 private:
+    void AddError(Diagnostic error);
+
     bool warnings_as_errors_;
-    std::vector<std::string> errors_;
-    std::vector<std::string> warnings_;
+    size_t max_errors_;
+    size_t num_errors_ = 0u;
+    std::vector<Diagnostic> errors_;
+    std::vector<Diagnostic> warnings_;
 };
 
 } // namespace fidl
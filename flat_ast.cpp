@@ -1,4 +1,8 @@
+#include <string.h>
+
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <regex>
 #include <sstream>
 
@@ -146,7 +150,7 @@ TypeShape PointerTypeShape(const TypeShape& element, uint32_t max_element_count
     uint32_t elements_out_of_line = ClampedMultiply(element.MaxOutOfLine(), max_element_count);
     uint32_t max_out_of_line = ClampedAdd(elements_size, elements_out_of_line);
 
-    uint32_t max_handles = ClampedAdd(element.MaxHandles(), max_element_count);
+    uint32_t max_handles = ClampedMultiply(element.MaxHandles(), max_element_count);
 
     return TypeShape(8u, 8u, depth, max_handles, max_out_of_line, element.HasPadding());
 }
@@ -315,6 +319,15 @@ bool IsSimple(const Type* type, const FieldShape& fieldshape) {
         return fieldshape.Depth() == 0u;
     case Type::Kind::kIdentifier: {
         auto identifier_type = static_cast<const IdentifierType*>(type);
+        // Tables and extensible unions are always out-of-line, so only their
+        // members count.
+        switch (identifier_type->type_decl->kind) {
+        case Decl::Kind::kTable:
+        case Decl::Kind::kXUnion:
+            return HasSimpleEnvelopes(identifier_type->type_decl);
+        default:
+            break;
+        }
         switch (identifier_type->nullability) {
         case types::Nullability::kNullable:
             // If the identifier is nullable, then we can handle a depth of 1
@@ -500,6 +513,12 @@ public:
 
         auto typeshape = type_decl_->typeshape;
         switch (type_decl_->kind) {
+        case Decl::Kind::kXUnion:
+            // An absent extensible union is still inline, with a tag of 0.
+            break;
+        case Decl::Kind::kInterface:
+            // A nullable protocol is a channel handle that may be invalid.
+            break;
         default:
             if (nullability == types::Nullability::kNullable)
                 typeshape = PointerTypeShape(typeshape);
@@ -1580,6 +1599,531 @@ bool Library::ConsumeFile(std::unique_ptr<raw::File> file) {
     return true;
 }
 
+namespace {
+
+// Splits a library name like "fidl.examples.echo" into views of |name|.
+std::vector<StringView> SplitLibraryName(const std::string& name) {
+    std::vector<StringView> components;
+    size_t start = 0u;
+    for (;;) {
+        size_t end = name.find('.', start);
+        if (end == std::string::npos) {
+            components.emplace_back(name.data() + start, name.size() - start);
+            return components;
+        }
+        components.emplace_back(name.data() + start, end - start);
+        start = end + 1u;
+    }
+}
+
+template <typename ValueType>
+std::unique_ptr<ConstantValue> IRNumericValue(uint64_t value) {
+    if constexpr (std::is_floating_point<ValueType>::value) {
+        double as_double;
+        memcpy(&as_double, &value, sizeof(as_double));
+        return std::make_unique<NumericConstantValue<ValueType>>(static_cast<ValueType>(as_double));
+    } else {
+        return std::make_unique<NumericConstantValue<ValueType>>(static_cast<ValueType>(value));
+    }
+}
+
+TypeShape IRTypeShape(const ir::TypeShape& typeshape) {
+    return TypeShape(typeshape.size, typeshape.alignment, typeshape.depth,
+                     typeshape.max_handles, typeshape.max_out_of_line,
+                     typeshape.has_padding != 0u);
+}
+
+FieldShape IRFieldShape(const ir::FieldShape& fieldshape) {
+    FieldShape result(IRTypeShape(fieldshape.typeshape), fieldshape.offset);
+    result.SetPadding(fieldshape.padding);
+    return result;
+}
+
+// Puts |declarations| back in the order of their source, by the source
+// indices that the binary IR records for them.
+template <typename DeclType>
+void SortBySourceIndex(std::vector<std::unique_ptr<DeclType>>* declarations,
+                       const std::map<const Decl*, uint32_t>& source_indices) {
+    std::stable_sort(declarations->begin(), declarations->end(),
+                     [&source_indices](const std::unique_ptr<DeclType>& a,
+                                       const std::unique_ptr<DeclType>& b) {
+                         return source_indices.at(a.get()) < source_indices.at(b.get());
+                     });
+}
+
+} // namespace
+
+raw::SourceElement Library::GeneratedSourceElement(const std::string& text) {
+    SourceLocation location = GeneratedSimpleName(text);
+    Token token(location, location, Token::Kind::kIdentifier, Token::Subkind::kNone);
+    return raw::SourceElement(token, token);
+}
+
+bool Library::ConsumeIRName(StringView qualified_name, Name* out_name) {
+    std::string name(qualified_name);
+    size_t separator = name.rfind('/');
+    if (separator == std::string::npos)
+        return Fail("Malformed name in binary IR: " + name);
+    std::string library_name = name.substr(0, separator);
+
+    const Library* library = this;
+    if (library_name != NameLibrary(library_name_)) {
+        Library* dep_library = nullptr;
+        if (!all_libraries_->Lookup(SplitLibraryName(library_name), &dep_library))
+            return Fail("Could not find library named " + library_name);
+        library = dep_library;
+    }
+    *out_name = Name(library, GeneratedSimpleName(name.substr(separator + 1u)));
+    return true;
+}
+
+std::unique_ptr<raw::AttributeList> Library::ConsumeIRAttributes(const ir::Reader& reader,
+                                                                 ir::Span<ir::Attribute> attributes) {
+    if (attributes.empty())
+        return nullptr;
+    std::vector<std::unique_ptr<raw::Attribute>> attribute_list;
+    for (const auto& attribute : attributes) {
+        std::string name(reader.GetString(attribute.name));
+        attribute_list.push_back(std::make_unique<raw::Attribute>(
+            GeneratedSourceElement(name), name, std::string(reader.GetString(attribute.value))));
+    }
+    return std::make_unique<raw::AttributeList>(
+        raw::SourceElement(attribute_list.front()->start_, attribute_list.back()->end_),
+        std::move(attribute_list));
+}
+
+bool Library::ConsumeIRConstant(const ir::Reader& reader, const ir::Constant& ir_constant,
+                                std::unique_ptr<Constant>* out_constant) {
+    if (static_cast<ir::ConstantKind>(ir_constant.kind) == ir::ConstantKind::kNone) {
+        *out_constant = nullptr;
+        return true;
+    }
+
+    std::unique_ptr<ConstantValue> value;
+    switch (static_cast<ir::ValueKind>(ir_constant.value_kind)) {
+    case ir::ValueKind::kInt8:
+        value = IRNumericValue<int8_t>(ir_constant.value);
+        break;
+    case ir::ValueKind::kInt16:
+        value = IRNumericValue<int16_t>(ir_constant.value);
+        break;
+    case ir::ValueKind::kInt32:
+        value = IRNumericValue<int32_t>(ir_constant.value);
+        break;
+    case ir::ValueKind::kInt64:
+        value = IRNumericValue<int64_t>(ir_constant.value);
+        break;
+    case ir::ValueKind::kUint8:
+        value = IRNumericValue<uint8_t>(ir_constant.value);
+        break;
+    case ir::ValueKind::kUint16:
+        value = IRNumericValue<uint16_t>(ir_constant.value);
+        break;
+    case ir::ValueKind::kUint32:
+        value = IRNumericValue<uint32_t>(ir_constant.value);
+        break;
+    case ir::ValueKind::kUint64:
+        value = IRNumericValue<uint64_t>(ir_constant.value);
+        break;
+    case ir::ValueKind::kFloat32:
+        value = IRNumericValue<float>(ir_constant.value);
+        break;
+    case ir::ValueKind::kFloat64:
+        value = IRNumericValue<double>(ir_constant.value);
+        break;
+    case ir::ValueKind::kBool:
+        value = std::make_unique<BoolConstantValue>(ir_constant.value != 0u);
+        break;
+    case ir::ValueKind::kString:
+        value = std::make_unique<StringConstantValue>(
+            GeneratedSimpleName(std::string(reader.GetString(ir_constant.string))).data());
+        break;
+    default:
+        return Fail("Unknown constant value in binary IR");
+    }
+
+    std::string expression(reader.GetString(ir_constant.expression));
+    switch (static_cast<ir::ConstantKind>(ir_constant.kind)) {
+    case ir::ConstantKind::kIdentifier: {
+        Name name;
+        if (!ConsumeIRName(expression, &name))
+            return false;
+        *out_constant = std::make_unique<IdentifierConstant>(std::move(name));
+        break;
+    }
+    case ir::ConstantKind::kLiteral: {
+        auto element = GeneratedSourceElement(expression);
+        std::unique_ptr<raw::Literal> literal;
+        switch (static_cast<raw::Literal::Kind>(ir_constant.literal_kind)) {
+        case raw::Literal::Kind::kString:
+            literal = std::make_unique<raw::StringLiteral>(element);
+            break;
+        case raw::Literal::Kind::kNumeric:
+            literal = std::make_unique<raw::NumericLiteral>(element);
+            break;
+        case raw::Literal::Kind::kTrue:
+            literal = std::make_unique<raw::TrueLiteral>(element);
+            break;
+        case raw::Literal::Kind::kFalse:
+            literal = std::make_unique<raw::FalseLiteral>(element);
+            break;
+        default:
+            return Fail("Unknown literal in binary IR");
+        }
+        *out_constant = std::make_unique<LiteralConstant>(std::move(literal));
+        break;
+    }
+    case ir::ConstantKind::kSynthesized:
+        *out_constant = std::make_unique<SynthesizedConstant>(std::move(value));
+        return true;
+    default:
+        return Fail("Unknown constant in binary IR");
+    }
+    (*out_constant)->ResolveTo(std::move(value));
+    return true;
+}
+
+bool Library::ConsumeIRTypeConstructor(const ir::Reader& reader, uint32_t index,
+                                       std::unique_ptr<TypeConstructor>* out_type_ctor) {
+    const ir::Type* type = reader.GetType(index);
+    if (type == nullptr)
+        return Fail("Type out of bounds in binary IR");
+
+    Name name;
+    std::unique_ptr<TypeConstructor> maybe_arg_type_ctor;
+    uint32_t maybe_size = ir::kNone;
+    switch (static_cast<ir::TypeKind>(type->kind)) {
+    case ir::TypeKind::kArray:
+    case ir::TypeKind::kVector:
+        name = Name(nullptr, GeneratedSimpleName(
+                                 static_cast<ir::TypeKind>(type->kind) == ir::TypeKind::kArray
+                                     ? "array" : "vector"));
+        if (!ConsumeIRTypeConstructor(reader, type->element_type, &maybe_arg_type_ctor))
+            return false;
+        maybe_size = type->element_count;
+        break;
+    case ir::TypeKind::kString:
+        name = Name(nullptr, GeneratedSimpleName("string"));
+        maybe_size = type->element_count;
+        break;
+    case ir::TypeKind::kPrimitive:
+        name = Name(nullptr, GeneratedSimpleName(
+            NamePrimitiveSubtype(static_cast<types::PrimitiveSubtype>(type->subtype))));
+        break;
+    case ir::TypeKind::kIdentifier:
+        if (!ConsumeIRName(reader.GetString(type->identifier), &name))
+            return false;
+        break;
+    default:
+        // Handles, which no type constructor creates.
+        return Fail("Unsupported type in binary IR");
+    }
+
+    // Unbounded vectors and strings have no size, as in the source.
+    std::unique_ptr<Constant> size;
+    if (maybe_size != ir::kNone)
+        size = std::make_unique<SynthesizedConstant>(std::make_unique<Size>(maybe_size));
+    *out_type_ctor = std::make_unique<TypeConstructor>(
+        std::move(name), std::move(maybe_arg_type_ctor), std::move(size),
+        type->nullable ? types::Nullability::kNullable : types::Nullability::kNonnullable);
+    return true;
+}
+
+bool Library::ConsumeIRMembers(const ir::Reader& reader, const ir::Decl& ir_decl, Decl* decl) {
+    auto type_ctor = [&](uint32_t index, std::unique_ptr<TypeConstructor>* out_type_ctor) {
+        return ConsumeIRTypeConstructor(reader, index, out_type_ctor) &&
+               CompileTypeConstructor(out_type_ctor->get(), nullptr);
+    };
+    auto name = [&](const ir::Member& member) {
+        return GeneratedSimpleName(std::string(reader.GetString(member.name)));
+    };
+
+    switch (decl->kind) {
+    case Decl::Kind::kConst: {
+        auto const_decl = static_cast<Const*>(decl);
+        return type_ctor(ir_decl.type, &const_decl->type_ctor) &&
+               ConsumeIRConstant(reader, ir_decl.value, &const_decl->value);
+    }
+    case Decl::Kind::kBits: {
+        auto bits_decl = static_cast<Bits*>(decl);
+        if (!type_ctor(ir_decl.type, &bits_decl->subtype_ctor))
+            return false;
+        for (const auto& member : reader.GetMembers(ir_decl)) {
+            std::unique_ptr<Constant> value;
+            if (!ConsumeIRConstant(reader, member.value, &value))
+                return false;
+            bits_decl->members.emplace_back(
+                ConsumeIRAttributes(reader, reader.GetAttributes(member.attributes)),
+                name(member), std::move(value));
+        }
+        return true;
+    }
+    case Decl::Kind::kEnum: {
+        auto enum_decl = static_cast<Enum*>(decl);
+        if (!type_ctor(ir_decl.type, &enum_decl->subtype_ctor))
+            return false;
+        if (enum_decl->subtype_ctor->type->kind != Type::Kind::kPrimitive)
+            return Fail(*enum_decl, "enum of a non-primitive type in binary IR");
+        enum_decl->type = static_cast<const PrimitiveType*>(enum_decl->subtype_ctor->type);
+        for (const auto& member : reader.GetMembers(ir_decl)) {
+            std::unique_ptr<Constant> value;
+            if (!ConsumeIRConstant(reader, member.value, &value))
+                return false;
+            enum_decl->members.emplace_back(
+                ConsumeIRAttributes(reader, reader.GetAttributes(member.attributes)),
+                name(member), std::move(value));
+        }
+        return true;
+    }
+    case Decl::Kind::kStruct: {
+        auto struct_decl = static_cast<Struct*>(decl);
+        for (const auto& member : reader.GetMembers(ir_decl)) {
+            std::unique_ptr<TypeConstructor> member_type_ctor;
+            std::unique_ptr<Constant> maybe_default_value;
+            if (!type_ctor(member.type, &member_type_ctor) ||
+                !ConsumeIRConstant(reader, member.value, &maybe_default_value))
+                return false;
+            struct_decl->members.emplace_back(
+                ConsumeIRAttributes(reader, reader.GetAttributes(member.attributes)),
+                std::move(member_type_ctor), name(member), std::move(maybe_default_value));
+            struct_decl->members.back().fieldshape = IRFieldShape(member.fieldshape);
+        }
+        return true;
+    }
+    case Decl::Kind::kTable: {
+        auto table_decl = static_cast<Table*>(decl);
+        for (const auto& member : reader.GetMembers(ir_decl)) {
+            auto ordinal = std::make_unique<raw::Ordinal>(
+                GeneratedSourceElement(std::to_string(member.ordinal)), member.ordinal);
+            if (member.reserved) {
+                SourceLocation location = ordinal->location();
+                table_decl->members.emplace_back(std::move(ordinal), location);
+                continue;
+            }
+            std::unique_ptr<TypeConstructor> member_type_ctor;
+            std::unique_ptr<Constant> maybe_default_value;
+            if (!type_ctor(member.type, &member_type_ctor) ||
+                !ConsumeIRConstant(reader, member.value, &maybe_default_value))
+                return false;
+            table_decl->members.emplace_back(
+                ConsumeIRAttributes(reader, reader.GetAttributes(member.attributes)),
+                std::move(ordinal), std::move(member_type_ctor), name(member),
+                std::move(maybe_default_value));
+            table_decl->members.back().maybe_used->typeshape =
+                IRTypeShape(member.fieldshape.typeshape);
+        }
+        return true;
+    }
+    case Decl::Kind::kUnion: {
+        auto union_decl = static_cast<Union*>(decl);
+        for (const auto& member : reader.GetMembers(ir_decl)) {
+            std::unique_ptr<TypeConstructor> member_type_ctor;
+            if (!type_ctor(member.type, &member_type_ctor))
+                return false;
+            union_decl->members.emplace_back(
+                ConsumeIRAttributes(reader, reader.GetAttributes(member.attributes)),
+                std::move(member_type_ctor), name(member));
+            union_decl->members.back().fieldshape = IRFieldShape(member.fieldshape);
+        }
+        return true;
+    }
+    case Decl::Kind::kXUnion: {
+        auto xunion_decl = static_cast<XUnion*>(decl);
+        for (const auto& member : reader.GetMembers(ir_decl)) {
+            std::unique_ptr<TypeConstructor> member_type_ctor;
+            if (!type_ctor(member.type, &member_type_ctor))
+                return false;
+            xunion_decl->members.emplace_back(
+                std::make_unique<raw::Ordinal>(
+                    GeneratedSourceElement(std::to_string(member.ordinal)), member.ordinal),
+                ConsumeIRAttributes(reader, reader.GetAttributes(member.attributes)),
+                std::move(member_type_ctor), name(member));
+            xunion_decl->members.back().fieldshape = IRFieldShape(member.fieldshape);
+        }
+        return true;
+    }
+    case Decl::Kind::kInterface: {
+        // The methods, in the order that the protocol was compiled with, point
+        // at those of the protocols that declare them.
+        auto interface_decl = static_cast<Interface*>(decl);
+        for (const auto& method : reader.GetMethods(ir_decl)) {
+            Name owner_name;
+            if (!ConsumeIRName(reader.GetString(method.owner), &owner_name))
+                return false;
+            Decl* owner = LookupDeclByName(owner_name);
+            if (owner == nullptr || owner->kind != Decl::Kind::kInterface)
+                return Fail(*interface_decl, "unknown composed protocol in binary IR");
+            StringView method_name = reader.GetString(method.name);
+            const auto& owner_methods = static_cast<Interface*>(owner)->methods;
+            auto iter = std::find_if(owner_methods.begin(), owner_methods.end(),
+                                     [&method_name](const Interface::Method& owner_method) {
+                                         return owner_method.name.data() == method_name;
+                                     });
+            if (iter == owner_methods.end())
+                return Fail(*interface_decl, "unknown composed method in binary IR");
+            interface_decl->all_methods.push_back(&*iter);
+        }
+        return true;
+    }
+    }
+    assert(false && "unknown decl kind in binary IR");
+    return false;
+}
+
+bool Library::ConsumeBinaryIR(const ir::Reader& reader) {
+    auto checkpoint = error_reporter_->Checkpoint();
+    std::string library_name(reader.library_name());
+    for (StringView component : SplitLibraryName(library_name))
+        library_name_.push_back(GeneratedSimpleName(component).data());
+    if (!CompileLibraryName())
+        return false;
+    attributes_ = ConsumeIRAttributes(reader, reader.library_attributes());
+
+    for (const ir::String& dependency : reader.dependencies()) {
+        std::string dependency_name(reader.GetString(dependency));
+        Library* dep_library = nullptr;
+        if (!all_libraries_->Lookup(SplitLibraryName(dependency_name), &dep_library)) {
+            return Fail("Could not find library named " + dependency_name +
+                        ". Did you include its sources with --files, or load its binary IR first?");
+        }
+        dependencies_.Register(generated_source_file_.filename(), dep_library, nullptr);
+        declarations_.insert(dep_library->declarations_.begin(), dep_library->declarations_.end());
+        constants_.insert(dep_library->constants_.begin(), dep_library->constants_.end());
+    }
+
+    // The declarations are created and registered, already compiled, before
+    // any of their members, so that types can name any of them. Protocols
+    // come last, since their methods point at the structs of their messages.
+    auto ir_decls = reader.decls();
+    declaration_order_.assign(ir_decls.size(), nullptr);
+    std::map<const Decl*, uint32_t> source_indices;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint32_t index = 0u; index < ir_decls.size(); ++index) {
+            const ir::Decl& ir_decl = ir_decls[index];
+            bool is_interface = static_cast<ir::DeclKind>(ir_decl.kind) == ir::DeclKind::kInterface;
+            if (is_interface != (pass == 1))
+                continue;
+
+            Name name(this, GeneratedSimpleName(std::string(reader.GetString(ir_decl.name))));
+            auto attributes = ConsumeIRAttributes(reader, reader.GetAttributes(ir_decl.attributes));
+            Decl* decl = nullptr;
+            switch (static_cast<ir::DeclKind>(ir_decl.kind)) {
+            case ir::DeclKind::kConst:
+                const_declarations_.push_back(std::make_unique<Const>(
+                    std::move(name), std::move(attributes), nullptr, nullptr));
+                decl = const_declarations_.back().get();
+                RegisterConst(const_declarations_.back().get());
+                break;
+            case ir::DeclKind::kBits:
+                bits_declarations_.push_back(std::make_unique<Bits>(
+                    std::move(attributes), std::move(name), nullptr, std::vector<Bits::Member>()));
+                bits_declarations_.back()->mask = ir_decl.mask;
+                decl = bits_declarations_.back().get();
+                break;
+            case ir::DeclKind::kEnum:
+                enum_declarations_.push_back(std::make_unique<Enum>(
+                    std::move(attributes), std::move(name), nullptr, std::vector<Enum::Member>()));
+                decl = enum_declarations_.back().get();
+                break;
+            case ir::DeclKind::kInterface: {
+                std::set<Name> superinterfaces;
+                for (const ir::String& superinterface : reader.GetNames(ir_decl.superinterfaces)) {
+                    Name superinterface_name;
+                    if (!ConsumeIRName(reader.GetString(superinterface), &superinterface_name))
+                        return false;
+                    superinterfaces.insert(std::move(superinterface_name));
+                }
+                // Only the protocol's own methods; ConsumeIRMembers() adds
+                // those it composes.
+                std::string qualified_name = library_name + "/" + std::string(name.name_part());
+                std::vector<Interface::Method> methods;
+                for (const auto& method : reader.GetMethods(ir_decl)) {
+                    if (reader.GetString(method.owner) != qualified_name)
+                        continue;
+                    auto message = [&](uint32_t flag, uint32_t message_index) -> Struct* {
+                        if (!(method.flags & flag) || message_index >= declaration_order_.size())
+                            return nullptr;
+                        Decl* message_decl = declaration_order_[message_index];
+                        if (message_decl == nullptr || message_decl->kind != Decl::Kind::kStruct)
+                            return nullptr;
+                        return static_cast<Struct*>(message_decl);
+                    };
+                    Struct* maybe_request = message(ir::kMethodHasRequest, method.request);
+                    Struct* maybe_response = message(ir::kMethodHasResponse, method.response);
+                    if ((method.flags & ir::kMethodHasRequest) && maybe_request == nullptr)
+                        return Fail("Method without its request in binary IR");
+                    if ((method.flags & ir::kMethodHasResponse) && maybe_response == nullptr)
+                        return Fail("Method without its response in binary IR");
+                    methods.emplace_back(
+                        ConsumeIRAttributes(reader, reader.GetAttributes(method.attributes)),
+                        std::make_unique<raw::Ordinal>(
+                            GeneratedSourceElement(std::to_string(method.ordinal)), method.ordinal),
+                        std::make_unique<raw::Ordinal>(
+                            GeneratedSourceElement(std::to_string(method.generated_ordinal)),
+                            method.generated_ordinal),
+                        GeneratedSimpleName(std::string(reader.GetString(method.name))),
+                        maybe_request, maybe_response);
+                }
+                interface_declarations_.push_back(std::make_unique<Interface>(
+                    std::move(attributes), std::move(name), std::move(superinterfaces),
+                    std::move(methods)));
+                decl = interface_declarations_.back().get();
+                break;
+            }
+            case ir::DeclKind::kStruct:
+                struct_declarations_.push_back(std::make_unique<Struct>(
+                    std::move(name), std::move(attributes), std::vector<Struct::Member>(),
+                    (ir_decl.flags & ir::kDeclAnonymous) != 0u));
+                decl = struct_declarations_.back().get();
+                break;
+            case ir::DeclKind::kTable:
+                table_declarations_.push_back(std::make_unique<Table>(
+                    std::move(attributes), std::move(name), std::vector<Table::Member>()));
+                decl = table_declarations_.back().get();
+                break;
+            case ir::DeclKind::kUnion:
+                union_declarations_.push_back(std::make_unique<Union>(
+                    std::move(attributes), std::move(name), std::vector<Union::Member>()));
+                union_declarations_.back()->membershape = IRFieldShape(ir_decl.membershape);
+                decl = union_declarations_.back().get();
+                break;
+            case ir::DeclKind::kXUnion:
+                xunion_declarations_.push_back(std::make_unique<XUnion>(
+                    std::move(attributes), std::move(name), std::vector<XUnion::Member>()));
+                decl = xunion_declarations_.back().get();
+                break;
+            default:
+                return Fail("Unknown declaration in binary IR");
+            }
+
+            if (decl->kind != Decl::Kind::kConst) {
+                auto type_decl = static_cast<TypeDecl*>(decl);
+                type_decl->typeshape = IRTypeShape(ir_decl.typeshape);
+                type_decl->recursive = (ir_decl.flags & ir::kDeclRecursive) != 0u;
+            }
+            decl->compiled = true;
+            declaration_order_[index] = decl;
+            source_indices.emplace(decl, ir_decl.source_index);
+            if (!RegisterDecl(decl))
+                return false;
+        }
+    }
+
+    for (uint32_t index = 0u; index < ir_decls.size(); ++index) {
+        if (!ConsumeIRMembers(reader, ir_decls[index], declaration_order_[index]))
+            return false;
+    }
+    SortBySourceIndex(&bits_declarations_, source_indices);
+    SortBySourceIndex(&const_declarations_, source_indices);
+    SortBySourceIndex(&enum_declarations_, source_indices);
+    SortBySourceIndex(&interface_declarations_, source_indices);
+    SortBySourceIndex(&struct_declarations_, source_indices);
+    SortBySourceIndex(&table_declarations_, source_indices);
+    SortBySourceIndex(&union_declarations_, source_indices);
+    SortBySourceIndex(&xunion_declarations_, source_indices);
+    return checkpoint.NoNewErrors();
+}
+
 bool Library::ResolveConstant(Constant* constant, const Type* type) {
     assert(constant != nullptr);
 
@@ -1932,18 +2476,31 @@ bool Library::ParseNumericLiteral(const raw::NumericLiteral* literal,
     return result == utils::ParseNumericResult::kSuccess;
 }
 
-bool Library::DeclDependencies(Decl* decl, std::set<Decl*>* out_edges) {
+bool Library::DeclDependencies(Decl* decl, std::set<Decl*>* out_edges, DependencyEdges which) {
     std::set<Decl*> edges;
 
-    auto maybe_add_decl = [this, &edges](const TypeConstructor* type_ctor) {
+    auto maybe_add_size = [this, &edges, which](const TypeConstructor* type_ctor) {
+        if (which != DependencyEdges::kReferences || !type_ctor->maybe_size ||
+            type_ctor->maybe_size->kind != Constant::Kind::kIdentifier)
+            return;
+        auto identifier = static_cast<const flat::IdentifierConstant*>(type_ctor->maybe_size.get());
+        if (auto decl = LookupConstant(type_ctor, identifier->name); decl)
+            edges.insert(decl);
+    };
+
+    auto maybe_add_decl = [this, &edges, which, &maybe_add_size](const TypeConstructor* type_ctor) {
         for (;;) {
             const auto& name = type_ctor->name;
+            maybe_add_size(type_ctor);
             if (name.name_part() == "request") {
-                return;
+                if (which != DependencyEdges::kReferences || !type_ctor->maybe_arg_type_ctor)
+                    return;
+                type_ctor = type_ctor->maybe_arg_type_ctor.get();
             } else if (type_ctor->maybe_arg_type_ctor) {
                 // I think this is assuming that no user defined types have arg types?
                 type_ctor = type_ctor->maybe_arg_type_ctor.get();
-            } else if (type_ctor->nullability == types::Nullability::kNullable) {
+            } else if (type_ctor->nullability == types::Nullability::kNullable &&
+                       which == DependencyEdges::kLayout) {
                 return;
             } else {
                 if (auto decl = LookupDeclByName(name); decl) {
@@ -1979,6 +2536,8 @@ bool Library::DeclDependencies(Decl* decl, std::set<Decl*>* out_edges) {
     switch (decl->kind) {
     case Decl::Kind::kConst: {
         auto const_decl = static_cast<const Const*>(decl);
+        if (which == DependencyEdges::kReferences)
+            maybe_add_decl(const_decl->type_ctor.get());
         if (!maybe_add_constant(const_decl->type_ctor.get(), const_decl->value.get()))
             return false;
         break;
@@ -2068,6 +2627,65 @@ struct CmpDeclInLibrary {
 };
 } // namespace
 
+namespace {
+
+template <typename DeclType>
+void RetainDecls(std::vector<std::unique_ptr<DeclType>>* decls, const std::set<const Decl*>& reachable,
+                 std::vector<std::unique_ptr<Decl>>* out_unreachable) {
+    auto unreachable = std::stable_partition(
+        decls->begin(), decls->end(),
+        [&reachable](const std::unique_ptr<DeclType>& decl) { return reachable.count(decl.get()) != 0; });
+    for (auto iter = unreachable; iter != decls->end(); ++iter)
+        out_unreachable->push_back(std::move(*iter));
+    decls->erase(unreachable, decls->end());
+}
+
+} // namespace
+
+std::set<const Decl*> Library::DeclReferences(const Decl* decl) const {
+    std::set<Decl*> edges;
+    // DeclDependencies() only modifies the library to report names that do
+    // not resolve, and every name resolves once the library is compiled.
+    const_cast<Library*>(this)->DeclDependencies(const_cast<Decl*>(decl), &edges,
+                                                 DependencyEdges::kReferences);
+    std::set<const Decl*> references;
+    for (const Decl* edge : edges) {
+        if (edge->name.library() == this)
+            references.insert(edge);
+    }
+    return references;
+}
+
+void Library::RetainReachable(const std::vector<Decl*>& roots) {
+    std::set<const Decl*> reachable;
+    std::vector<const Decl*> pending;
+    for (const Decl* root : roots) {
+        if (root->name.library() == this && reachable.insert(root).second)
+            pending.push_back(root);
+    }
+    while (!pending.empty()) {
+        const Decl* decl = pending.back();
+        pending.pop_back();
+        for (const Decl* edge : DeclReferences(decl)) {
+            if (reachable.insert(edge).second)
+                pending.push_back(edge);
+        }
+    }
+
+    declaration_order_.erase(
+        std::remove_if(declaration_order_.begin(), declaration_order_.end(),
+                       [&reachable](const Decl* decl) { return reachable.count(decl) == 0; }),
+        declaration_order_.end());
+    RetainDecls(&const_declarations_, reachable, &unreachable_declarations_);
+    RetainDecls(&bits_declarations_, reachable, &unreachable_declarations_);
+    RetainDecls(&enum_declarations_, reachable, &unreachable_declarations_);
+    RetainDecls(&interface_declarations_, reachable, &unreachable_declarations_);
+    RetainDecls(&struct_declarations_, reachable, &unreachable_declarations_);
+    RetainDecls(&table_declarations_, reachable, &unreachable_declarations_);
+    RetainDecls(&union_declarations_, reachable, &unreachable_declarations_);
+    RetainDecls(&xunion_declarations_, reachable, &unreachable_declarations_);
+}
+
 bool Library::SortDeclarations() {
     std::map<Decl*, uint32_t, CmpDeclInLibrary> degrees;
     for (auto& name_and_decl : declarations_) {
@@ -2524,7 +3142,31 @@ bool HasSimpleLayout(const Decl* decl) {
     return decl->GetAttribute("Layout") == "Simple";
 }
 
+bool HasSimpleEnvelopes(const Decl* decl) {
+    switch (decl->kind) {
+    case Decl::Kind::kTable:
+        for (const auto& member : static_cast<const Table*>(decl)->members) {
+            if (member.ordinal->value > 64u)
+                return false;
+            if (member.maybe_used && member.maybe_used->typeshape.Depth() > 0u)
+                return false;
+        }
+        return true;
+    case Decl::Kind::kXUnion:
+        for (const auto& member : static_cast<const XUnion*>(decl)->members) {
+            if (member.fieldshape.Depth() > 0u)
+                return false;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
 bool Library::CompileInterface(Interface* interface_declaration) {
+    // A protocol that an earlier declaration names is compiled again in
+    // order, once the types of its messages are.
+    interface_declaration->all_methods.clear();
     MethodScope method_scope;
     auto CheckScopes = [this, &interface_declaration, &method_scope](const Interface* interface, auto Visitor) -> bool {
         for (const auto& name : interface->superinterfaces) {
@@ -2868,6 +3510,9 @@ bool Library::ValidateBitsMembersAndCalcMask(Bits* bits_decl, MemberType* out_ma
 }
 
 bool Library::Compile() {
+    // Errors about other libraries, which are reported to the same reporter
+    // when one process compiles several, do not fail this one.
+    auto checkpoint = error_reporter_->Checkpoint();
     for (const auto& dep_library : dependencies_.dependencies()) {
         constants_.insert(dep_library->constants_.begin(), dep_library->constants_.end());
     }
@@ -2878,17 +3523,28 @@ bool Library::Compile() {
     if (!SortDeclarations())
         return false;
 
+    // The declarations of dependencies are in the order too, but were
+    // compiled with their own library, which may yet generate outputs from
+    // them.
     for (Decl* decl : declaration_order_) {
+        if (decl->name.library() != this)
+            continue;
         if (!CompileDecl(decl))
             return false;
+        if (error_reporter_->LimitReached())
+            return false;
     }
 
     for (Decl* decl : declaration_order_) {
+        if (decl->name.library() != this)
+            continue;
         if (!VerifyDeclAttributes(decl))
             return false;
+        if (error_reporter_->LimitReached())
+            return false;
     }
 
-    return error_reporter_->errors().size() == 0;
+    return checkpoint.NoNewErrors();
 }
 
 bool Library::HasAttribute(StringView name) const {
@@ -11,6 +11,7 @@
 #include <set>
 #include <vector>
 
+#include "binary_ir_reader.h"
 #include "error_reporter.h"
 #include "raw_ast.h"
 #include "typeshape.h"
@@ -30,6 +31,11 @@ struct Decl;
 class Library;
 
 bool HasSimpleLayout(const Decl* decl);
+// Whether the simple C bindings can carry the table or extensible union
+// |decl|: none of its members has out-of-line objects of its own, and the
+// ordinals of a table fit the 64-bit bitmap in which its C struct tracks
+// which members are present.
+bool HasSimpleEnvelopes(const Decl* decl);
 
 std::string LibraryName(const Library* library, StringView separator);
 
@@ -1087,6 +1093,12 @@ public:
         : all_libraries_(all_libraries), error_reporter_(error_reporter), typespace_(typespace) {}
 
     bool ConsumeFile(std::unique_ptr<raw::File> File);
+    // Rebuilds the library as it was compiled from the binary IR that
+    // |reader| reads, which an earlier fidlc wrote with --binary-ir: its
+    // declarations, resolved constants, types and typeshapes. The libraries
+    // that it depends on must already be in |all_libraries|. The library is
+    // then frozen: it is only depended on, and never compiled.
+    bool ConsumeBinaryIR(const ir::Reader& reader);
     bool Compile();
     bool CompileDecl(Decl* decl);
 
@@ -1096,11 +1108,23 @@ public:
     bool ParseNumericLiteral(const raw::NumericLiteral* literal, NumericType* out_value) const;
 
     bool HasAttribute(StringView name) const;
+    const raw::AttributeList* attributes() const { return attributes_.get(); }
 
     const std::set<Library*>& dependencies() const;
 
+    // Returns the declarations of this library that |decl| names, through its
+    // types and constants, including nullable types, request<> and sizes, and
+    // for a protocol, its messages and composed protocols.
+    std::set<const Decl*> DeclReferences(const Decl* decl) const;
+
+    // Removes from the library's declarations those that cannot be reached
+    // from |roots| by following the declarations that each one names, so
+    // that generators leave them out. The removed declarations are kept alive,
+    // since the library's names and constants still refer to them.
+    void RetainReachable(const std::vector<Decl*>& roots);
+
     const std::vector<StringView>& name() const { return library_name_; }
-    const std::vector<std::string>& errors() const { return error_reporter_->errors(); }
+    const std::vector<Diagnostic>& errors() const { return error_reporter_->errors(); }
 
     std::vector<StringView> library_name_;
 
@@ -1168,6 +1192,18 @@ private:
     bool ConsumeUnionDeclaration(std::unique_ptr<raw::UnionDeclaration> union_declaration);
     bool ConsumeXUnionDeclaration(std::unique_ptr<raw::XUnionDeclaration> xunion_declaration);
 
+    // For ConsumeBinaryIR(), which keeps everything that it reads from the
+    // binary IR in |generated_source_file_|, as if it had been generated.
+    raw::SourceElement GeneratedSourceElement(const std::string& text);
+    bool ConsumeIRName(StringView qualified_name, Name* out_name);
+    std::unique_ptr<raw::AttributeList> ConsumeIRAttributes(const ir::Reader& reader,
+                                                            ir::Span<ir::Attribute> attributes);
+    bool ConsumeIRConstant(const ir::Reader& reader, const ir::Constant& ir_constant,
+                           std::unique_ptr<Constant>* out_constant);
+    bool ConsumeIRTypeConstructor(const ir::Reader& reader, uint32_t index,
+                                  std::unique_ptr<TypeConstructor>* out_type_ctor);
+    bool ConsumeIRMembers(const ir::Reader& reader, const ir::Decl& ir_decl, Decl* decl);
+
     bool TypeCanBeConst(const Type* type);
     const Type* TypeResolve(const Type* type);
     bool TypeIsConvertibleTo(const Type* from_type, const Type* to_type);
@@ -1176,7 +1212,17 @@ private:
     // return the declaration corresponding to name.
     Decl* LookupConstant(const TypeConstructor* type_ctor, const Name& name);
 
-    bool DeclDependencies(Decl* decl, std::set<Decl*>* out_edges);
+    // Which declarations DeclDependencies() reports a declaration as using.
+    enum class DependencyEdges {
+        // Those it must be compiled after, i.e. that it holds inline.
+        kLayout,
+        // All those that it names, including through nullable types,
+        // request<> and the sizes of vectors, strings and arrays.
+        kReferences,
+    };
+
+    bool DeclDependencies(Decl* decl, std::set<Decl*>* out_edges,
+                          DependencyEdges which = DependencyEdges::kLayout);
 
     bool SortDeclarations();
 
@@ -1218,6 +1264,8 @@ private:
 
     std::map<const Name*, Decl*, PtrCompare<Name>> declarations_;
     std::map<const Name*, Const*, PtrCompare<Name>> constants_;
+    // The declarations that RetainReachable() removed.
+    std::vector<std::unique_ptr<Decl>> unreachable_declarations_;
 
     ErrorReporter* error_reporter_;
     Typespace* typespace_;
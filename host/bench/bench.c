@@ -0,0 +1,313 @@
+// Measures round trips through the C client and server generated for
+// bench.fidl, over the host runtime.
+//
+// For each method, reports the latency of a synchronous call and the
+// throughput of calls pipelined with _begin and _dispatch_responses. The
+// server runs on its own thread and echoes every request.
+//
+// Usage: bench [iterations]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fidl/bench/c/fidl.h>
+#include <zircon/syscalls.h>
+
+// The number of requests that the pipelined client keeps in flight.
+#define PIPELINE_DEPTH 16u
+
+static FIDL_ALIGNDECL char server_bytes[ZX_CHANNEL_MAX_MSG_BYTES];
+static zx_handle_t server_handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+static FIDL_ALIGNDECL char client_bytes[ZX_CHANNEL_MAX_MSG_BYTES];
+static zx_handle_t client_handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+
+static uint8_t payload[fidl_bench_MAX_PAYLOAD];
+static char text[fidl_bench_MAX_TEXT];
+static fidl_bench_Settings settings;
+
+// A transaction remembers the txid of its request, which its reply carries.
+typedef struct server_txn {
+    fidl_txn_t txn;
+    zx_handle_t channel;
+    zx_txid_t txid;
+} server_txn_t;
+
+static zx_status_t Reply(fidl_txn_t* txn, const fidl_msg_t* msg) {
+    server_txn_t* server_txn = (server_txn_t*)txn;
+    ((fidl_message_header_t*)msg->bytes)->txid = server_txn->txid;
+    return zx_channel_write(server_txn->channel, 0u, msg->bytes, msg->num_bytes,
+                            msg->handles, msg->num_handles);
+}
+
+static zx_status_t EchoPod(void* ctx, uint64_t a, uint64_t b, fidl_txn_t* txn) {
+    return fidl_bench_EchoPod_reply(txn, a, b);
+}
+
+static zx_status_t EchoBytes(void* ctx, const uint8_t* data_data, size_t data_count,
+                             fidl_txn_t* txn) {
+    return fidl_bench_EchoBytes_reply(txn, data_data, data_count);
+}
+
+static zx_status_t EchoText(void* ctx, const char* text_data, size_t text_size,
+                            fidl_txn_t* txn) {
+    return fidl_bench_EchoText_reply(txn, text_data, text_size);
+}
+
+static zx_status_t EchoHandles(void* ctx, zx_handle_t first, zx_handle_t second,
+                               fidl_txn_t* txn) {
+    return fidl_bench_EchoHandles_reply(txn, first, second);
+}
+
+static zx_status_t EchoOptional(void* ctx, zx_handle_t first, zx_handle_t second,
+                                fidl_txn_t* txn) {
+    return fidl_bench_EchoOptional_reply(txn, second, first);
+}
+
+static zx_status_t EchoTable(void* ctx, const fidl_bench_Settings* settings, fidl_txn_t* txn) {
+    return fidl_bench_EchoTable_reply(txn, settings);
+}
+
+static const fidl_bench_Echo_ops_t kEchoOps = {
+    .Pod = EchoPod,
+    .Bytes = EchoBytes,
+    .Text = EchoText,
+    .Handles = EchoHandles,
+    .Optional = EchoOptional,
+    .Table = EchoTable,
+};
+
+static void* Serve(void* arg) {
+    zx_handle_t channel = (zx_handle_t)(uintptr_t)arg;
+    for (;;) {
+        zx_status_t status = zx_object_wait_one(
+            channel, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED, ZX_TIME_INFINITE, NULL);
+        if (status != ZX_OK)
+            break;
+        fidl_msg_t msg = {
+            .bytes = server_bytes,
+            .handles = server_handles,
+            .num_bytes = 0u,
+            .num_handles = 0u,
+        };
+        status = zx_channel_read(channel, 0u, msg.bytes, msg.handles, sizeof(server_bytes),
+                                 ZX_CHANNEL_MAX_MSG_HANDLES, &msg.num_bytes, &msg.num_handles);
+        if (status == ZX_ERR_SHOULD_WAIT)
+            continue;
+        if (status != ZX_OK)
+            break;
+        server_txn_t txn = {
+            .txn = {.reply = Reply},
+            .channel = channel,
+            .txid = ((fidl_message_header_t*)msg.bytes)->txid,
+        };
+        status = fidl_bench_Echo_dispatch(NULL, &txn.txn, &msg, &kEchoOps);
+        if (status != ZX_OK) {
+            fprintf(stderr, "bench: dispatch failed: %d\n", status);
+            break;
+        }
+    }
+    zx_handle_close(channel);
+    return NULL;
+}
+
+// The two peers whose handles the Handles and Optional methods carry back and
+// forth.
+static zx_handle_t peers[2];
+
+static zx_status_t CallPod(zx_handle_t channel) {
+    uint64_t a, b;
+    return fidl_bench_EchoPod(channel, 1u, 2u, &a, &b);
+}
+
+static zx_status_t CallBytes(zx_handle_t channel) {
+    static uint8_t buffer[fidl_bench_MAX_PAYLOAD];
+    size_t count;
+    return fidl_bench_EchoBytes(channel, payload, sizeof(payload), buffer, sizeof(buffer),
+                                &count);
+}
+
+static zx_status_t CallText(zx_handle_t channel) {
+    static char buffer[fidl_bench_MAX_TEXT];
+    size_t size;
+    return fidl_bench_EchoText(channel, text, sizeof(text), buffer, sizeof(buffer), &size);
+}
+
+static zx_status_t CallHandles(zx_handle_t channel) {
+    return fidl_bench_EchoHandles(channel, peers[0], peers[1], &peers[0], &peers[1]);
+}
+
+static zx_status_t CallOptional(zx_handle_t channel) {
+    return fidl_bench_EchoOptional(channel, peers[0], peers[1], &peers[1], &peers[0]);
+}
+
+static zx_status_t CallTable(zx_handle_t channel) {
+    fidl_bench_Settings out_settings;
+    return fidl_bench_EchoTable(channel, &settings, &out_settings);
+}
+
+static zx_status_t BeginPod(zx_handle_t channel, zx_txid_t txid) {
+    return fidl_bench_EchoPod_begin(channel, txid, client_bytes, sizeof(client_bytes),
+                                    client_handles, ZX_CHANNEL_MAX_MSG_HANDLES, 1u, 2u);
+}
+
+static zx_status_t BeginBytes(zx_handle_t channel, zx_txid_t txid) {
+    return fidl_bench_EchoBytes_begin(channel, txid, client_bytes, sizeof(client_bytes),
+                                      client_handles, ZX_CHANNEL_MAX_MSG_HANDLES,
+                                      payload, sizeof(payload));
+}
+
+static zx_status_t BeginText(zx_handle_t channel, zx_txid_t txid) {
+    return fidl_bench_EchoText_begin(channel, txid, client_bytes, sizeof(client_bytes),
+                                     client_handles, ZX_CHANNEL_MAX_MSG_HANDLES,
+                                     text, sizeof(text));
+}
+
+static zx_status_t BeginTable(zx_handle_t channel, zx_txid_t txid) {
+    return fidl_bench_EchoTable_begin(channel, txid, client_bytes, sizeof(client_bytes),
+                                      client_handles, ZX_CHANNEL_MAX_MSG_HANDLES, &settings);
+}
+
+// Each callback counts its response in the size_t at |ctx|.
+
+static void OnPod(void* ctx, zx_txid_t txid, fidl_bench_EchoPodResponse* response) {
+    ++*(size_t*)ctx;
+}
+
+static void OnBytes(void* ctx, zx_txid_t txid, fidl_bench_EchoBytesResponse* response) {
+    ++*(size_t*)ctx;
+}
+
+static void OnText(void* ctx, zx_txid_t txid, fidl_bench_EchoTextResponse* response) {
+    ++*(size_t*)ctx;
+}
+
+static void OnTable(void* ctx, zx_txid_t txid, fidl_bench_EchoTableResponse* response) {
+    ++*(size_t*)ctx;
+}
+
+static const fidl_bench_Echo_callbacks_t kCallbacks = {
+    .Pod = OnPod,
+    .Bytes = OnBytes,
+    .Text = OnText,
+    .Table = OnTable,
+};
+
+static double ElapsedSeconds(zx_time_t start) {
+    return (double)(zx_clock_get_monotonic() - start) / 1e9;
+}
+
+// Returns the mean latency of |call| in nanoseconds, or a negative number
+// if a call fails.
+static double MeasureLatency(zx_handle_t channel, zx_status_t (*call)(zx_handle_t),
+                             size_t iterations) {
+    zx_time_t start = zx_clock_get_monotonic();
+    for (size_t i = 0; i < iterations; i++) {
+        zx_status_t status = call(channel);
+        if (status != ZX_OK) {
+            fprintf(stderr, "bench: call failed: %d\n", status);
+            return -1.0;
+        }
+    }
+    return ElapsedSeconds(start) * 1e9 / (double)iterations;
+}
+
+// Returns the number of calls per second that |begin| completes with up to
+// PIPELINE_DEPTH of them in flight, or a negative number if one fails.
+static double MeasureThroughput(zx_handle_t channel,
+                                zx_status_t (*begin)(zx_handle_t, zx_txid_t),
+                                size_t iterations) {
+    size_t sent = 0u;
+    size_t received = 0u;
+    zx_time_t start = zx_clock_get_monotonic();
+    while (received < iterations) {
+        while (sent < iterations && sent - received < PIPELINE_DEPTH) {
+            zx_status_t status = begin(channel, (zx_txid_t)(sent + 1u));
+            if (status != ZX_OK) {
+                fprintf(stderr, "bench: begin failed: %d\n", status);
+                return -1.0;
+            }
+            ++sent;
+        }
+        zx_status_t status = zx_object_wait_one(channel, ZX_CHANNEL_READABLE,
+                                                ZX_TIME_INFINITE, NULL);
+        if (status == ZX_OK) {
+            status = fidl_bench_Echo_dispatch_responses(
+                channel, client_bytes, sizeof(client_bytes), client_handles,
+                ZX_CHANNEL_MAX_MSG_HANDLES, sent - received, &kCallbacks, &received, NULL);
+        }
+        if (status != ZX_OK) {
+            fprintf(stderr, "bench: dispatch failed: %d\n", status);
+            return -1.0;
+        }
+    }
+    return (double)iterations / ElapsedSeconds(start);
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = 20000u;
+    if (argc > 1)
+        iterations = strtoul(argv[1], NULL, 10);
+    if (iterations == 0u) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    memset(payload, 0xa5, sizeof(payload));
+    memset(text, 'x', sizeof(text));
+    fidl_bench_Settings_set_volume(&settings, 11u);
+    fidl_bench_Settings_set_muted(&settings, true);
+
+    zx_handle_t client, server;
+    zx_handle_t peer_servers[2];
+    if (zx_channel_create(0u, &client, &server) != ZX_OK ||
+        zx_channel_create(0u, &peers[0], &peer_servers[0]) != ZX_OK ||
+        zx_channel_create(0u, &peers[1], &peer_servers[1]) != ZX_OK) {
+        fprintf(stderr, "bench: cannot create channels\n");
+        return 1;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, Serve, (void*)(uintptr_t)server) != 0) {
+        fprintf(stderr, "bench: cannot start the server\n");
+        return 1;
+    }
+
+    static const struct {
+        const char* name;
+        zx_status_t (*call)(zx_handle_t);
+        zx_status_t (*begin)(zx_handle_t, zx_txid_t);
+    } kMethods[] = {
+        {"Pod", CallPod, BeginPod},
+        {"Bytes", CallBytes, BeginBytes},
+        {"Text", CallText, BeginText},
+        // Only one request at a time can carry the peers, so they are not
+        // pipelined.
+        {"Handles", CallHandles, NULL},
+        {"Optional", CallOptional, NULL},
+        {"Table", CallTable, BeginTable},
+    };
+
+    int result = 0;
+    printf("%-8s %14s %18s\n", "method", "latency (ns)", "pipelined (calls/s)");
+    for (size_t i = 0; i < sizeof(kMethods) / sizeof(kMethods[0]); i++) {
+        double latency = MeasureLatency(client, kMethods[i].call, iterations);
+        double throughput = 0.0;
+        if (latency >= 0.0 && kMethods[i].begin)
+            throughput = MeasureThroughput(client, kMethods[i].begin, iterations);
+        if (latency < 0.0 || throughput < 0.0) {
+            result = 1;
+            break;
+        }
+        if (kMethods[i].begin)
+            printf("%-8s %14.0f %18.0f\n", kMethods[i].name, latency, throughput);
+        else
+            printf("%-8s %14.0f %18s\n", kMethods[i].name, latency, "-");
+    }
+
+    zx_handle_close(client);
+    pthread_join(thread, NULL);
+    zx_handle_close_many(peers, 2u);
+    zx_handle_close_many(peer_servers, 2u);
+    return result;
+}
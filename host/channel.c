@@ -0,0 +1,381 @@
+// Emulates Zircon channels and the control plane of sockets on Linux, so
+// that the generated C bindings can run on a host.
+//
+// Both ends of a channel are a SOCK_SEQPACKET socket pair, which preserves
+// message boundaries like a channel does. A handle is the file descriptor of
+// the object it refers to, plus one, and handles are transferred with
+// SCM_RIGHTS: writing a handle closes the writer's descriptor, and reading
+// it installs a new one in the reader.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lib/fidl/transport.h>
+#include <zircon/fidl.h>
+#include <zircon/syscalls.h>
+
+static int HandleToFd(zx_handle_t handle) {
+    return (int)handle - 1;
+}
+
+static zx_handle_t FdToHandle(int fd) {
+    return (zx_handle_t)fd + 1u;
+}
+
+static zx_status_t StatusFromErrno(int error) {
+    switch (error) {
+    case EAGAIN:
+        return ZX_ERR_SHOULD_WAIT;
+    case EPIPE:
+    case ECONNRESET:
+        return ZX_ERR_PEER_CLOSED;
+    case EBADF:
+    case ENOTSOCK:
+        return ZX_ERR_BAD_HANDLE;
+    case EMSGSIZE:
+        return ZX_ERR_OUT_OF_RANGE;
+    case ENOMEM:
+    case ENOBUFS:
+        return ZX_ERR_NO_MEMORY;
+    case EMFILE:
+    case ENFILE:
+        return ZX_ERR_NO_RESOURCES;
+    default:
+        return ZX_ERR_IO;
+    }
+}
+
+zx_time_t zx_clock_get_monotonic(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (zx_time_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+zx_time_t zx_deadline_after(zx_duration_t nanoseconds) {
+    zx_time_t now = zx_clock_get_monotonic();
+    if (nanoseconds > ZX_TIME_INFINITE - now)
+        return ZX_TIME_INFINITE;
+    return now + nanoseconds;
+}
+
+zx_status_t zx_handle_close(zx_handle_t handle) {
+    if (handle == ZX_HANDLE_INVALID)
+        return ZX_OK;
+    if (close(HandleToFd(handle)) < 0)
+        return ZX_ERR_BAD_HANDLE;
+    return ZX_OK;
+}
+
+zx_status_t zx_handle_close_many(const zx_handle_t* handles, size_t num_handles) {
+    zx_status_t status = ZX_OK;
+    for (size_t i = 0; i < num_handles; i++) {
+        zx_status_t close_status = zx_handle_close(handles[i]);
+        if (close_status != ZX_OK)
+            status = close_status;
+    }
+    return status;
+}
+
+// Waits until |fd| has one of |events| or |deadline| passes.
+static zx_status_t WaitFd(int fd, short events, zx_time_t deadline, short* out_revents) {
+    struct pollfd poll_fd = {.fd = fd, .events = events, .revents = 0};
+    for (;;) {
+        int timeout_ms = -1;
+        if (deadline != ZX_TIME_INFINITE) {
+            zx_time_t now = zx_clock_get_monotonic();
+            zx_time_t remaining = deadline > now ? deadline - now : 0;
+            // Rounded up, so that the wait does not end before the deadline.
+            zx_time_t remaining_ms = (remaining + 999999) / 1000000;
+            timeout_ms = remaining_ms > INT32_MAX ? INT32_MAX : (int)remaining_ms;
+        }
+        int ready = poll(&poll_fd, 1, timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            return StatusFromErrno(errno);
+        }
+        if (poll_fd.revents & POLLNVAL)
+            return ZX_ERR_BAD_HANDLE;
+        if (ready > 0) {
+            *out_revents = poll_fd.revents;
+            return ZX_OK;
+        }
+        if (deadline != ZX_TIME_INFINITE && zx_clock_get_monotonic() >= deadline)
+            return ZX_ERR_TIMED_OUT;
+    }
+}
+
+zx_status_t zx_object_wait_one(zx_handle_t handle, zx_signals_t signals,
+                               zx_time_t deadline, zx_signals_t* observed) {
+    short events = 0;
+    if (signals & ZX_CHANNEL_READABLE)
+        events |= POLLIN;
+    if (signals & ZX_CHANNEL_WRITABLE)
+        events |= POLLOUT;
+    if (signals & ZX_CHANNEL_PEER_CLOSED)
+        events |= POLLRDHUP;
+    short revents = 0;
+    zx_status_t status = WaitFd(HandleToFd(handle), events, deadline, &revents);
+    if (status != ZX_OK && status != ZX_ERR_TIMED_OUT)
+        return status;
+    if (observed) {
+        *observed = ZX_SIGNAL_NONE;
+        if (revents & POLLIN)
+            *observed |= ZX_CHANNEL_READABLE;
+        if (revents & POLLOUT)
+            *observed |= ZX_CHANNEL_WRITABLE;
+        if (revents & (POLLRDHUP | POLLHUP))
+            *observed |= ZX_CHANNEL_PEER_CLOSED;
+    }
+    return status;
+}
+
+static zx_status_t CreatePair(zx_handle_t* out0, zx_handle_t* out1) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+        return StatusFromErrno(errno);
+    *out0 = FdToHandle(fds[0]);
+    *out1 = FdToHandle(fds[1]);
+    return ZX_OK;
+}
+
+zx_status_t zx_channel_create(uint32_t options, zx_handle_t* out0, zx_handle_t* out1) {
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+    return CreatePair(out0, out1);
+}
+
+zx_status_t zx_socket_create(uint32_t options, zx_handle_t* out0, zx_handle_t* out1) {
+    // Only the control plane is emulated, and it works like a channel
+    // without handles.
+    if (options != ZX_SOCKET_HAS_CONTROL)
+        return ZX_ERR_NOT_SUPPORTED;
+    return CreatePair(out0, out1);
+}
+
+// Sends the bytes in |iov| as one message. |handles| are consumed, whether
+// or not sending succeeds, as they are by zx_channel_write().
+static zx_status_t SendMessage(int fd, struct iovec* iov, int iov_count,
+                               const zx_handle_t* handles, uint32_t num_handles) {
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int) * ZX_CHANNEL_MAX_MSG_HANDLES)];
+    } control;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = iov;
+    message.msg_iovlen = iov_count;
+
+    size_t num_bytes = 0;
+    for (int i = 0; i < iov_count; i++)
+        num_bytes += iov[i].iov_len;
+
+    zx_status_t status = ZX_OK;
+    if (num_bytes > ZX_CHANNEL_MAX_MSG_BYTES || num_handles > ZX_CHANNEL_MAX_MSG_HANDLES) {
+        status = ZX_ERR_OUT_OF_RANGE;
+        goto done;
+    }
+    if (num_handles > 0u) {
+        memset(&control, 0, sizeof(control));
+        message.msg_control = control.buffer;
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * num_handles);
+        struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int) * num_handles);
+        int* fds = (int*)CMSG_DATA(header);
+        for (uint32_t i = 0; i < num_handles; i++) {
+            if (handles[i] == ZX_HANDLE_INVALID) {
+                status = ZX_ERR_BAD_HANDLE;
+                goto done;
+            }
+            fds[i] = HandleToFd(handles[i]);
+        }
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0)
+        status = StatusFromErrno(errno);
+
+done:
+    zx_handle_close_many(handles, num_handles);
+    return status;
+}
+
+// Receives one message, or returns ZX_ERR_SHOULD_WAIT if |flags| has
+// MSG_DONTWAIT and there is none. A message that does not fit is discarded
+// with its handles, and reported as ZX_ERR_BUFFER_TOO_SMALL.
+static zx_status_t ReceiveMessage(int fd, int flags, void* bytes, uint32_t num_bytes,
+                                  zx_handle_t* handles, uint32_t num_handles,
+                                  uint32_t* actual_bytes, uint32_t* actual_handles) {
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int) * ZX_CHANNEL_MAX_MSG_HANDLES)];
+    } control;
+    struct iovec iov = {.iov_base = bytes, .iov_len = num_bytes};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t received;
+    do {
+        received = recvmsg(fd, &message, flags | MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received < 0)
+        return StatusFromErrno(errno);
+    // FIDL messages are never empty, so an empty read is the end of the
+    // stream.
+    if (received == 0)
+        return ZX_ERR_PEER_CLOSED;
+
+    int fds[ZX_CHANNEL_MAX_MSG_HANDLES];
+    uint32_t num_fds = 0u;
+    for (struct cmsghdr* header = CMSG_FIRSTHDR(&message); header != NULL;
+         header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(&fds[num_fds], CMSG_DATA(header), count * sizeof(int));
+        num_fds += (uint32_t)count;
+    }
+
+    if ((message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || num_fds > num_handles) {
+        for (uint32_t i = 0; i < num_fds; i++)
+            close(fds[i]);
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    for (uint32_t i = 0; i < num_fds; i++)
+        handles[i] = FdToHandle(fds[i]);
+    if (actual_bytes)
+        *actual_bytes = (uint32_t)received;
+    if (actual_handles)
+        *actual_handles = num_fds;
+    return ZX_OK;
+}
+
+zx_status_t zx_channel_write(zx_handle_t handle, uint32_t options,
+                             const void* bytes, uint32_t num_bytes,
+                             const zx_handle_t* handles, uint32_t num_handles) {
+    if (options != 0u) {
+        zx_handle_close_many(handles, num_handles);
+        return ZX_ERR_INVALID_ARGS;
+    }
+    struct iovec iov = {.iov_base = (void*)bytes, .iov_len = num_bytes};
+    return SendMessage(HandleToFd(handle), &iov, 1, handles, num_handles);
+}
+
+zx_status_t zx_channel_read(zx_handle_t handle, uint32_t options,
+                            void* bytes, zx_handle_t* handles,
+                            uint32_t num_bytes, uint32_t num_handles,
+                            uint32_t* actual_bytes, uint32_t* actual_handles) {
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+    return ReceiveMessage(HandleToFd(handle), MSG_DONTWAIT, bytes, num_bytes,
+                          handles, num_handles, actual_bytes, actual_handles);
+}
+
+// Transaction ids of calls, which have their high bit set like the ones
+// the kernel assigns, so that they do not collide with the ones the
+// callers of zx_channel_write() choose.
+static atomic_uint next_call_txid = 1u;
+
+static zx_txid_t NextCallTxid(void) {
+    return 0x80000000u | (atomic_fetch_add(&next_call_txid, 1u) & 0x7fffffffu);
+}
+
+zx_status_t zx_channel_call(zx_handle_t handle, uint32_t options, zx_time_t deadline,
+                            const zx_channel_call_args_t* args,
+                            uint32_t* actual_bytes, uint32_t* actual_handles) {
+    if (options != 0u || args->wr_num_bytes < sizeof(zx_txid_t)) {
+        zx_handle_close_many(args->wr_handles, args->wr_num_handles);
+        return ZX_ERR_INVALID_ARGS;
+    }
+    int fd = HandleToFd(handle);
+
+    // The caller's bytes are const, so the txid goes out separately.
+    zx_txid_t txid = NextCallTxid();
+    struct iovec iov[2] = {
+        {.iov_base = &txid, .iov_len = sizeof(txid)},
+        {.iov_base = (char*)args->wr_bytes + sizeof(txid),
+         .iov_len = args->wr_num_bytes - sizeof(txid)},
+    };
+    zx_status_t status = SendMessage(fd, iov, 2, args->wr_handles, args->wr_num_handles);
+    if (status != ZX_OK)
+        return status;
+
+    for (;;) {
+        short revents;
+        status = WaitFd(fd, POLLIN, deadline, &revents);
+        if (status != ZX_OK)
+            return status;
+        uint32_t num_bytes = 0u;
+        uint32_t num_handles = 0u;
+        status = ReceiveMessage(fd, MSG_DONTWAIT, args->rd_bytes, args->rd_num_bytes,
+                                args->rd_handles, args->rd_num_handles,
+                                &num_bytes, &num_handles);
+        if (status == ZX_ERR_SHOULD_WAIT)
+            continue;
+        if (status != ZX_OK)
+            return status;
+        zx_txid_t reply_txid;
+        if (num_bytes >= sizeof(reply_txid)) {
+            memcpy(&reply_txid, args->rd_bytes, sizeof(reply_txid));
+            if (reply_txid == txid) {
+                *actual_bytes = num_bytes;
+                *actual_handles = num_handles;
+                return ZX_OK;
+            }
+        }
+        // Unlike the kernel, which leaves other messages for readers of the
+        // channel, the host runtime drops them: a channel with a pending
+        // call has no other reader in the bindings.
+        zx_handle_close_many(args->rd_handles, num_handles);
+    }
+}
+
+zx_status_t fidl_socket_write_control(zx_handle_t socket, const void* buffer, size_t size) {
+    struct iovec iov = {.iov_base = (void*)buffer, .iov_len = size};
+    return SendMessage(HandleToFd(socket), &iov, 1, NULL, 0u);
+}
+
+zx_status_t fidl_socket_read_control(zx_handle_t socket, void* buffer, size_t capacity,
+                                     size_t* out_actual) {
+    uint32_t actual = 0u;
+    if (capacity > ZX_CHANNEL_MAX_MSG_BYTES)
+        capacity = ZX_CHANNEL_MAX_MSG_BYTES;
+    zx_status_t status = ReceiveMessage(HandleToFd(socket), MSG_DONTWAIT, buffer,
+                                        (uint32_t)capacity, NULL, 0u, &actual, NULL);
+    if (status == ZX_OK)
+        *out_actual = actual;
+    return status;
+}
+
+zx_status_t fidl_socket_call_control(zx_handle_t socket, const void* buffer, size_t size,
+                                     void* result, size_t capacity, size_t* out_actual) {
+    zx_status_t status = fidl_socket_write_control(socket, buffer, size);
+    if (status != ZX_OK)
+        return status;
+    for (;;) {
+        short revents;
+        status = WaitFd(HandleToFd(socket), POLLIN, ZX_TIME_INFINITE, &revents);
+        if (status != ZX_OK)
+            return status;
+        status = fidl_socket_read_control(socket, result, capacity, out_actual);
+        if (status != ZX_ERR_SHOULD_WAIT)
+            return status;
+    }
+}
@@ -0,0 +1,408 @@
+// fidl_encode() and fidl_decode() for the host runtime, which walk the
+// coding tables that the --tables output defines.
+//
+// Tables and extensible unions are supported as far as the C bindings send
+// them: the contents of each envelope must have no out-of-line objects of
+// their own. Envelopes of unknown members are skipped by their byte count,
+// and fidl_decode() closes their handles.
+
+#include <limits>
+#include <stdint.h>
+#include <string.h>
+
+#include <lib/fidl/coding.h>
+#include <lib/fidl/internal.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+class Walker {
+public:
+    enum class Mode {
+        kEncode,
+        kDecode,
+    };
+
+    Walker(Mode mode, uint8_t* bytes, uint32_t num_bytes, zx_handle_t* handles,
+           uint32_t num_handles)
+        : mode_(mode), bytes_(bytes), num_bytes_(num_bytes), handles_(handles),
+          num_handles_(num_handles) {}
+
+    zx_status_t Walk(const fidl_type_t* type) {
+        if (type == nullptr || type->type_tag != fidl::kFidlTypeStruct)
+            return Fail(ZX_ERR_INVALID_ARGS, "message is not a struct");
+        if (reinterpret_cast<uintptr_t>(bytes_) % FIDL_ALIGNMENT != 0u)
+            return Fail(ZX_ERR_INVALID_ARGS, "message is not aligned");
+        uint64_t inline_size = FIDL_ALIGN(uint64_t(type->coded_struct.size));
+        if (inline_size > num_bytes_)
+            return Fail(ZX_ERR_INVALID_ARGS, "message is too small for its type");
+        next_out_of_line_ = static_cast<uint32_t>(inline_size);
+        zx_status_t status = WalkStruct(&type->coded_struct, bytes_);
+        if (status != ZX_OK)
+            return status;
+        if (next_out_of_line_ != num_bytes_)
+            return Fail(ZX_ERR_INVALID_ARGS, "message has unused bytes");
+        if (mode_ == Mode::kDecode && handle_index_ != num_handles_)
+            return Fail(ZX_ERR_INVALID_ARGS, "message has unused handles");
+        return ZX_OK;
+    }
+
+    uint32_t handle_count() const { return handle_index_; }
+    // The handles of unknown envelopes, as a bit per index into the handles.
+    uint64_t unknown_handles() const { return unknown_handles_; }
+    const char* error() const { return error_; }
+
+private:
+    zx_status_t Fail(zx_status_t status, const char* error) {
+        error_ = error;
+        return status;
+    }
+
+    // Visits the pointer at |slot| to an out-of-line object of |size| bytes,
+    // which must be the next one in the message. Sets |*out_object| to the
+    // object, or to null if it is absent.
+    zx_status_t WalkPointer(void* slot, uint64_t size, fidl::FidlNullability nullable,
+                            uint8_t** out_object) {
+        uintptr_t value;
+        memcpy(&value, slot, sizeof(value));
+        bool present;
+        if (mode_ == Mode::kEncode) {
+            present = value != 0u;
+            if (present && value != reinterpret_cast<uintptr_t>(bytes_ + next_out_of_line_))
+                return Fail(ZX_ERR_INVALID_ARGS, "out-of-line object is not the next one");
+        } else {
+            if (value != FIDL_ALLOC_PRESENT && value != FIDL_ALLOC_ABSENT)
+                return Fail(ZX_ERR_INVALID_ARGS, "pointer is neither present nor absent");
+            present = value == FIDL_ALLOC_PRESENT;
+        }
+
+        if (!present) {
+            if (nullable == fidl::kNonnullable)
+                return Fail(ZX_ERR_INVALID_ARGS, "non-nullable pointer is absent");
+            value = FIDL_ALLOC_ABSENT;
+            memcpy(slot, &value, sizeof(value));
+            *out_object = nullptr;
+            return ZX_OK;
+        }
+
+        uint64_t aligned_size = FIDL_ALIGN(size);
+        if (size > num_bytes_ || aligned_size > num_bytes_ - next_out_of_line_)
+            return Fail(ZX_ERR_INVALID_ARGS, "out-of-line object exceeds the message");
+        *out_object = bytes_ + next_out_of_line_;
+        next_out_of_line_ += static_cast<uint32_t>(aligned_size);
+        value = mode_ == Mode::kEncode ? FIDL_ALLOC_PRESENT
+                                       : reinterpret_cast<uintptr_t>(*out_object);
+        memcpy(slot, &value, sizeof(value));
+        return ZX_OK;
+    }
+
+    zx_status_t WalkHandle(uint8_t* object, const fidl::FidlCodedHandle& coded_handle) {
+        zx_handle_t handle;
+        memcpy(&handle, object, sizeof(handle));
+        if (mode_ == Mode::kEncode) {
+            if (handle == ZX_HANDLE_INVALID) {
+                if (coded_handle.nullable == fidl::kNonnullable)
+                    return Fail(ZX_ERR_INVALID_ARGS, "non-nullable handle is absent");
+                return ZX_OK;
+            }
+            if (handle_index_ == num_handles_)
+                return Fail(ZX_ERR_INVALID_ARGS, "message has too many handles");
+            handles_[handle_index_++] = handle;
+            handle = FIDL_HANDLE_PRESENT;
+        } else {
+            if (handle == FIDL_HANDLE_ABSENT) {
+                if (coded_handle.nullable == fidl::kNonnullable)
+                    return Fail(ZX_ERR_INVALID_ARGS, "non-nullable handle is absent");
+                return ZX_OK;
+            }
+            if (handle != FIDL_HANDLE_PRESENT)
+                return Fail(ZX_ERR_INVALID_ARGS, "handle is neither present nor absent");
+            if (handle_index_ == num_handles_)
+                return Fail(ZX_ERR_INVALID_ARGS, "message has too few handles");
+            handle = handles_[handle_index_++];
+        }
+        memcpy(object, &handle, sizeof(handle));
+        return ZX_OK;
+    }
+
+    zx_status_t WalkStruct(const fidl::FidlCodedStruct* coded_struct, uint8_t* object) {
+        for (uint32_t i = 0; i < coded_struct->field_count; i++) {
+            const fidl::FidlStructField& field = coded_struct->fields[i];
+            zx_status_t status = WalkType(field.type, object + field.offset);
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
+
+    zx_status_t WalkUnion(const fidl::FidlCodedUnion* coded_union, uint8_t* object) {
+        fidl_union_tag_t tag;
+        memcpy(&tag, object, sizeof(tag));
+        if (tag >= coded_union->type_count)
+            return Fail(ZX_ERR_INVALID_ARGS, "union tag is out of range");
+        return WalkType(coded_union->types[tag], object + coded_union->data_offset);
+    }
+
+    // Visits the contents of |envelope|, which are of |type|. |known| is false
+    // for envelopes whose ordinal the coding table does not list, whose
+    // contents are skipped without being visited.
+    zx_status_t WalkEnvelope(fidl_envelope_t* envelope, const fidl_type_t* type, bool known) {
+        if (mode_ == Mode::kEncode) {
+            if (envelope->data == nullptr) {
+                envelope->num_bytes = 0u;
+                envelope->num_handles = 0u;
+                return ZX_OK;
+            }
+            if (!known)
+                return Fail(ZX_ERR_INVALID_ARGS, "envelope has an unknown ordinal");
+            if (envelope->data != bytes_ + next_out_of_line_)
+                return Fail(ZX_ERR_INVALID_ARGS, "out-of-line object is not the next one");
+        } else {
+            uintptr_t value = reinterpret_cast<uintptr_t>(envelope->data);
+            if (value == FIDL_ALLOC_ABSENT) {
+                if (envelope->num_bytes != 0u || envelope->num_handles != 0u)
+                    return Fail(ZX_ERR_INVALID_ARGS, "absent envelope has contents");
+                return ZX_OK;
+            }
+            if (value != FIDL_ALLOC_PRESENT)
+                return Fail(ZX_ERR_INVALID_ARGS, "envelope is neither present nor absent");
+            if (envelope->num_handles > num_handles_ - handle_index_)
+                return Fail(ZX_ERR_INVALID_ARGS, "message has too few handles");
+        }
+        if (envelope->num_bytes % FIDL_ALIGNMENT != 0u ||
+            envelope->num_bytes > num_bytes_ - next_out_of_line_)
+            return Fail(ZX_ERR_INVALID_ARGS, "envelope exceeds the message");
+
+        uint8_t* contents = bytes_ + next_out_of_line_;
+        next_out_of_line_ += envelope->num_bytes;
+        uint32_t first_handle = handle_index_;
+        if (!known) {
+            // The handles are tracked in a 64-bit mask, which is as many as a
+            // channel message can carry.
+            if (handle_index_ + envelope->num_handles > 64u)
+                return Fail(ZX_ERR_INVALID_ARGS, "message has too many handles");
+            if (envelope->num_handles != 0u)
+                unknown_handles_ |= (UINT64_MAX >> (64u - envelope->num_handles)) << handle_index_;
+            handle_index_ += envelope->num_handles;
+        } else {
+            uint32_t end = next_out_of_line_;
+            zx_status_t status = WalkType(type, contents);
+            if (status != ZX_OK)
+                return status;
+            if (next_out_of_line_ != end)
+                return Fail(ZX_ERR_NOT_SUPPORTED,
+                            "the host runtime does not support out-of-line objects in envelopes");
+            if (mode_ == Mode::kDecode && handle_index_ - first_handle != envelope->num_handles)
+                return Fail(ZX_ERR_INVALID_ARGS, "envelope has the wrong number of handles");
+        }
+
+        if (mode_ == Mode::kEncode) {
+            envelope->num_handles = handle_index_ - first_handle;
+            envelope->data = reinterpret_cast<void*>(FIDL_ALLOC_PRESENT);
+        } else {
+            envelope->data = contents;
+        }
+        return ZX_OK;
+    }
+
+    zx_status_t WalkTable(const fidl::FidlCodedTable* coded_table, uint8_t* object) {
+        fidl_table_t* table = reinterpret_cast<fidl_table_t*>(object);
+        if (table->count > (num_bytes_ - next_out_of_line_) / sizeof(fidl_envelope_t))
+            return Fail(ZX_ERR_INVALID_ARGS, "table exceeds the message");
+        uint8_t* envelopes;
+        zx_status_t status = WalkPointer(&table->envelopes,
+                                         table->count * sizeof(fidl_envelope_t),
+                                         fidl::kNonnullable, &envelopes);
+        if (status != ZX_OK)
+            return status;
+        fidl_envelope_t* envelope = reinterpret_cast<fidl_envelope_t*>(envelopes);
+        for (uint64_t i = 0; i < table->count; i++) {
+            const fidl::FidlTableField* field = nullptr;
+            for (uint32_t j = 0; j < coded_table->field_count; j++) {
+                if (coded_table->fields[j].ordinal == i + 1u) {
+                    field = &coded_table->fields[j];
+                    break;
+                }
+            }
+            status = WalkEnvelope(&envelope[i], field ? field->type : nullptr, field != nullptr);
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
+
+    zx_status_t WalkXUnion(const fidl::FidlCodedXUnion* coded_xunion, uint8_t* object) {
+        fidl_xunion_t* xunion = reinterpret_cast<fidl_xunion_t*>(object);
+        // An extensible union is absent when it has no tag, and only then.
+        bool absent = mode_ == Mode::kEncode
+                          ? xunion->envelope.data == nullptr
+                          : reinterpret_cast<uintptr_t>(xunion->envelope.data) == FIDL_ALLOC_ABSENT;
+        if ((xunion->tag == 0u) != absent)
+            return Fail(ZX_ERR_INVALID_ARGS, "extensible union tag does not match its envelope");
+        if (absent) {
+            if (coded_xunion->nullable == fidl::kNonnullable)
+                return Fail(ZX_ERR_INVALID_ARGS, "non-nullable extensible union is absent");
+            return WalkEnvelope(&xunion->envelope, nullptr, true);
+        }
+        const fidl::FidlXUnionField* field = nullptr;
+        for (uint32_t i = 0; i < coded_xunion->field_count; i++) {
+            if (coded_xunion->fields[i].ordinal == xunion->tag) {
+                field = &coded_xunion->fields[i];
+                break;
+            }
+        }
+        return WalkEnvelope(&xunion->envelope, field ? field->type : nullptr, field != nullptr);
+    }
+
+    // Visits the |count| elements of |element_size| bytes at |elements|.
+    zx_status_t WalkElements(const fidl_type_t* element, uint64_t count,
+                             uint32_t element_size, uint8_t* elements) {
+        if (element == nullptr)
+            return ZX_OK;
+        for (uint64_t i = 0; i < count; i++) {
+            zx_status_t status = WalkType(element, elements + i * element_size);
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
+
+    zx_status_t WalkType(const fidl_type_t* type, uint8_t* object) {
+        if (type == nullptr)
+            return ZX_OK;
+
+        switch (type->type_tag) {
+        case fidl::kFidlTypeStruct:
+            return WalkStruct(&type->coded_struct, object);
+        case fidl::kFidlTypeStructPointer: {
+            const fidl::FidlCodedStruct* coded_struct = type->coded_struct_pointer.struct_type;
+            uint8_t* pointee;
+            zx_status_t status = WalkPointer(object, coded_struct->size, fidl::kNullable,
+                                             &pointee);
+            if (status != ZX_OK || pointee == nullptr)
+                return status;
+            return WalkStruct(coded_struct, pointee);
+        }
+        case fidl::kFidlTypeUnion:
+            return WalkUnion(&type->coded_union, object);
+        case fidl::kFidlTypeUnionPointer: {
+            const fidl::FidlCodedUnion* coded_union = type->coded_union_pointer.union_type;
+            uint8_t* pointee;
+            zx_status_t status = WalkPointer(object, coded_union->size, fidl::kNullable,
+                                             &pointee);
+            if (status != ZX_OK || pointee == nullptr)
+                return status;
+            return WalkUnion(coded_union, pointee);
+        }
+        case fidl::kFidlTypeArray: {
+            const fidl::FidlCodedArray& coded_array = type->coded_array;
+            if (coded_array.element_size == 0u)
+                return ZX_OK;
+            return WalkElements(coded_array.element,
+                                coded_array.array_size / coded_array.element_size,
+                                coded_array.element_size, object);
+        }
+        case fidl::kFidlTypeString: {
+            const fidl::FidlCodedString& coded_string = type->coded_string;
+            fidl_string_t* string = reinterpret_cast<fidl_string_t*>(object);
+            if (string->size > coded_string.max_size)
+                return Fail(ZX_ERR_INVALID_ARGS, "string exceeds its bound");
+            uint8_t* data;
+            zx_status_t status = WalkPointer(&string->data, string->size,
+                                             coded_string.nullable, &data);
+            if (status != ZX_OK)
+                return status;
+            if (data == nullptr && string->size != 0u)
+                return Fail(ZX_ERR_INVALID_ARGS, "absent string has a size");
+            return ZX_OK;
+        }
+        case fidl::kFidlTypeVector: {
+            const fidl::FidlCodedVector& coded_vector = type->coded_vector;
+            fidl_vector_t* vector = reinterpret_cast<fidl_vector_t*>(object);
+            if (vector->count > coded_vector.max_count)
+                return Fail(ZX_ERR_INVALID_ARGS, "vector exceeds its bound");
+            if (coded_vector.element_size != 0u &&
+                vector->count > std::numeric_limits<uint32_t>::max() / coded_vector.element_size)
+                return Fail(ZX_ERR_INVALID_ARGS, "vector exceeds the message");
+            uint8_t* data;
+            zx_status_t status = WalkPointer(&vector->data,
+                                             vector->count * coded_vector.element_size,
+                                             coded_vector.nullable, &data);
+            if (status != ZX_OK)
+                return status;
+            if (data == nullptr) {
+                if (vector->count != 0u)
+                    return Fail(ZX_ERR_INVALID_ARGS, "absent vector has elements");
+                return ZX_OK;
+            }
+            return WalkElements(coded_vector.element, vector->count,
+                                coded_vector.element_size, data);
+        }
+        case fidl::kFidlTypeHandle:
+            return WalkHandle(object, type->coded_handle);
+        case fidl::kFidlTypeTable:
+            return WalkTable(&type->coded_table, object);
+        case fidl::kFidlTypeXUnion:
+            return WalkXUnion(&type->coded_xunion, object);
+        }
+        return Fail(ZX_ERR_INVALID_ARGS, "unknown coding table");
+    }
+
+    const Mode mode_;
+    uint8_t* const bytes_;
+    const uint32_t num_bytes_;
+    zx_handle_t* const handles_;
+    const uint32_t num_handles_;
+    uint32_t next_out_of_line_ = 0u;
+    uint32_t handle_index_ = 0u;
+    uint64_t unknown_handles_ = 0u;
+    const char* error_ = nullptr;
+};
+
+} // namespace
+
+zx_status_t fidl_encode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
+                        zx_handle_t* handles, uint32_t max_handles,
+                        uint32_t* out_actual_handles, const char** out_error_msg) {
+    Walker walker(Walker::Mode::kEncode, static_cast<uint8_t*>(bytes), num_bytes, handles,
+                  max_handles);
+    zx_status_t status = walker.Walk(type);
+    if (status != ZX_OK) {
+        zx_handle_close_many(handles, walker.handle_count());
+        if (out_error_msg)
+            *out_error_msg = walker.error();
+        return status;
+    }
+    *out_actual_handles = walker.handle_count();
+    return ZX_OK;
+}
+
+zx_status_t fidl_encode_msg(const fidl_type_t* type, fidl_msg_t* msg,
+                            uint32_t* out_actual_handles, const char** out_error_msg) {
+    return fidl_encode(type, msg->bytes, msg->num_bytes, msg->handles, msg->num_handles,
+                       out_actual_handles, out_error_msg);
+}
+
+zx_status_t fidl_decode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
+                        const zx_handle_t* handles, uint32_t num_handles,
+                        const char** out_error_msg) {
+    // Decoding only reads |handles|.
+    Walker walker(Walker::Mode::kDecode, static_cast<uint8_t*>(bytes), num_bytes,
+                  const_cast<zx_handle_t*>(handles), num_handles);
+    zx_status_t status = walker.Walk(type);
+    if (status != ZX_OK) {
+        zx_handle_close_many(handles, num_handles);
+        if (out_error_msg)
+            *out_error_msg = walker.error();
+        return status;
+    }
+    for (uint64_t unknown = walker.unknown_handles(); unknown != 0u; unknown &= unknown - 1u)
+        zx_handle_close(handles[__builtin_ctzll(unknown)]);
+    return ZX_OK;
+}
+
+zx_status_t fidl_decode_msg(const fidl_type_t* type, fidl_msg_t* msg,
+                            const char** out_error_msg) {
+    return fidl_decode(type, msg->bytes, msg->num_bytes, msg->handles, msg->num_handles,
+                       out_error_msg);
+}
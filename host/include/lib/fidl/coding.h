@@ -0,0 +1,37 @@
+#ifndef HOST_INCLUDE_LIB_FIDL_CODING_H_
+#define HOST_INCLUDE_LIB_FIDL_CODING_H_
+
+#include <zircon/fidl.h>
+#include <zircon/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Moves the handles of the message in |bytes| into |handles| and replaces
+// its pointers and handles with their presence markers. Out-of-line objects
+// must follow the inline object in traversal order, each aligned to
+// FIDL_ALIGNMENT, and end exactly at |num_bytes|. On failure, returns an
+// error and points |out_error_msg|, if given, at its description, and
+// closes the handles already moved.
+zx_status_t fidl_encode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
+                        zx_handle_t* handles, uint32_t max_handles,
+                        uint32_t* out_actual_handles, const char** out_error_msg);
+zx_status_t fidl_encode_msg(const fidl_type_t* type, fidl_msg_t* msg,
+                            uint32_t* out_actual_handles, const char** out_error_msg);
+
+// Replaces the presence markers of the message in |bytes| with pointers into
+// |bytes| and the handles in |handles|, checking the bounds of every object
+// and that the message uses all of its bytes and handles. On failure,
+// closes all of |handles|.
+zx_status_t fidl_decode(const fidl_type_t* type, void* bytes, uint32_t num_bytes,
+                        const zx_handle_t* handles, uint32_t num_handles,
+                        const char** out_error_msg);
+zx_status_t fidl_decode_msg(const fidl_type_t* type, fidl_msg_t* msg,
+                            const char** out_error_msg);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // HOST_INCLUDE_LIB_FIDL_CODING_H_
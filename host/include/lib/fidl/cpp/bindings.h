@@ -0,0 +1,978 @@
+// Runtime support for the C++ bindings that fidlc generates with
+// --cpp-header and --cpp-source.
+//
+// The generated code knows the offset of every field from the typeshapes that
+// fidlc computed, and calls into the CodingTraits below with those offsets.
+// Encoding writes into a buffer the caller provides and never allocates;
+// decoding validates the message as it goes, and allocates only for the
+// natural types that own heap storage (Vector, String, and the std::unique_ptr
+// of a nullable struct or union).
+
+#ifndef LIB_FIDL_CPP_BINDINGS_H_
+#define LIB_FIDL_CPP_BINDINGS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <zircon/fidl.h>
+#include <zircon/syscalls.h>
+#include <zircon/types.h>
+
+namespace fidl {
+
+// Handles ------------------------------------------------------------------
+
+// Owns a handle, and closes it when destroyed.
+class Handle {
+public:
+    Handle() = default;
+    explicit Handle(zx_handle_t value) : value_(value) {}
+    Handle(Handle&& other) : value_(other.release()) {}
+    Handle& operator=(Handle&& other) {
+        reset(other.release());
+        return *this;
+    }
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+    ~Handle() { reset(); }
+
+    zx_handle_t get() const { return value_; }
+    bool is_valid() const { return value_ != ZX_HANDLE_INVALID; }
+    explicit operator bool() const { return is_valid(); }
+
+    // Gives up ownership of the handle without closing it.
+    zx_handle_t release() {
+        zx_handle_t value = value_;
+        value_ = ZX_HANDLE_INVALID;
+        return value;
+    }
+
+    void reset(zx_handle_t value = ZX_HANDLE_INVALID) {
+        if (value_ != ZX_HANDLE_INVALID)
+            zx_handle_close(value_);
+        value_ = value;
+    }
+
+private:
+    zx_handle_t value_ = ZX_HANDLE_INVALID;
+};
+
+// The client end of a channel that speaks |Protocol|.
+template <typename Protocol>
+class InterfaceHandle {
+public:
+    InterfaceHandle() = default;
+    explicit InterfaceHandle(Handle channel) : channel_(std::move(channel)) {}
+
+    const Handle& channel() const { return channel_; }
+    Handle TakeChannel() { return std::move(channel_); }
+    bool is_valid() const { return channel_.is_valid(); }
+    explicit operator bool() const { return is_valid(); }
+
+private:
+    Handle channel_;
+};
+
+// Views and containers -------------------------------------------------------
+
+// A view of |size| contiguous elements that the span does not own.
+template <typename T>
+class Span {
+public:
+    constexpr Span() = default;
+    constexpr Span(T* data, size_t size) : data_(data), size_(size) {}
+    template <size_t N>
+    constexpr Span(T (&array)[N]) : data_(array), size_(N) {}
+    template <typename Container,
+              typename = decltype(std::declval<Container&>().data()),
+              typename = decltype(std::declval<Container&>().size())>
+    constexpr Span(Container& container) : data_(container.data()), size_(container.size()) {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U (*)[], T (*)[]>::value>>
+    constexpr Span(const Span<U>& other) : data_(other.data()), size_(other.size()) {}
+
+    constexpr T* data() const { return data_; }
+    constexpr size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0u; }
+    constexpr T* begin() const { return data_; }
+    constexpr T* end() const { return data_ + size_; }
+    constexpr T& operator[](size_t index) const { return data_[index]; }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0u;
+};
+
+// A string of at most |N| bytes, stored inline. fidlc uses it for bounded
+// strings whose bound is small enough to store in place.
+template <uint32_t N>
+class InlineString {
+public:
+    static constexpr uint32_t kMaxSize = N;
+
+    InlineString() = default;
+
+    // Returns false, and leaves the string as it is, if |value| does not fit.
+    bool assign(std::string_view value) {
+        if (value.size() > N)
+            return false;
+        memcpy(storage_.data(), value.data(), value.size());
+        size_ = static_cast<uint32_t>(value.size());
+        return true;
+    }
+
+    bool resize(size_t size) {
+        if (size > N)
+            return false;
+        size_ = static_cast<uint32_t>(size);
+        return true;
+    }
+
+    char* data() { return storage_.data(); }
+    const char* data() const { return storage_.data(); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0u; }
+    std::string_view view() const { return std::string_view(storage_.data(), size_); }
+    operator std::string_view() const { return view(); }
+
+private:
+    std::array<char, N> storage_{};
+    uint32_t size_ = 0u;
+};
+
+// A vector of at most |N| elements, stored inline. fidlc uses it for bounded
+// vectors whose bound is small enough to store in place.
+template <typename T, uint32_t N>
+class InlineVector {
+public:
+    static constexpr uint32_t kMaxSize = N;
+
+    InlineVector() = default;
+
+    // Returns false, and leaves the vector as it is, if the vector is full.
+    bool push_back(T value) {
+        if (size_ == N)
+            return false;
+        storage_[size_++] = std::move(value);
+        return true;
+    }
+
+    // Elements that a shrinking resize drops are reset, which closes any
+    // handles they own.
+    bool resize(size_t size) {
+        if (size > N)
+            return false;
+        for (size_t i = size; i < size_; i++)
+            storage_[i] = T();
+        size_ = static_cast<uint32_t>(size);
+        return true;
+    }
+
+    void clear() { resize(0u); }
+
+    T* data() { return storage_.data(); }
+    const T* data() const { return storage_.data(); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0u; }
+    T* begin() { return storage_.data(); }
+    T* end() { return storage_.data() + size_; }
+    const T* begin() const { return storage_.data(); }
+    const T* end() const { return storage_.data() + size_; }
+    T& operator[](size_t index) { return storage_[index]; }
+    const T& operator[](size_t index) const { return storage_[index]; }
+
+private:
+    std::array<T, N> storage_{};
+    uint32_t size_ = 0u;
+};
+
+// A string of at most |N| bytes on the heap, for unbounded strings and bounds
+// too large to store inline. Encoding fails if the string outgrows |N|.
+template <uint32_t N = UINT32_MAX>
+class String : public std::string {
+public:
+    static constexpr uint32_t kMaxSize = N;
+    using std::string::string;
+    String() = default;
+    String(std::string value) : std::string(std::move(value)) {}
+};
+
+// A vector of at most |N| elements on the heap, for unbounded vectors and
+// bounds too large to store inline. Encoding fails if the vector outgrows |N|.
+template <typename T, uint32_t N = UINT32_MAX>
+class Vector : public std::vector<T> {
+public:
+    static constexpr uint32_t kMaxSize = N;
+    using std::vector<T>::vector;
+    Vector() = default;
+    Vector(std::vector<T> value) : std::vector<T>(std::move(value)) {}
+};
+
+// Buffers --------------------------------------------------------------------
+
+// The bytes and handles that a message is encoded into or read into, owned
+// by someone else.
+struct BufferRef {
+    uint8_t* bytes;
+    uint32_t capacity;
+    zx_handle_t* handles;
+    uint32_t handle_capacity;
+};
+
+// A buffer with room for |kBytes| bytes and |kHandles| handles. The generated
+// protocol classes name the one that fits any of their messages as Buffer.
+template <uint32_t kBytes, uint32_t kHandles>
+class MessageBuffer {
+public:
+    BufferRef ref() { return BufferRef{bytes_, kBytes, handles_, kHandles}; }
+
+private:
+    alignas(FIDL_ALIGNMENT) uint8_t bytes_[kBytes];
+    zx_handle_t handles_[kHandles > 0u ? kHandles : 1u];
+};
+
+// The encoder -----------------------------------------------------------------
+
+// Encodes a message into a caller-provided buffer. Every object that the
+// encoder hands out is zeroed, so the generated code writes only the fields
+// and leaves padding alone. The encoder owns the handles it has been given
+// until the message is taken, and closes them if it never is.
+class Encoder {
+public:
+    explicit Encoder(BufferRef buffer) : buffer_(buffer) {}
+    Encoder(const Encoder&) = delete;
+    Encoder& operator=(const Encoder&) = delete;
+    ~Encoder() {
+        if (!taken_)
+            zx_handle_close_many(buffer_.handles, num_handles_);
+    }
+
+    // Starts a message with a header for |ordinal| and |inline_size| bytes of
+    // header and parameters.
+    bool BeginMessage(uint32_t ordinal, uint32_t inline_size) {
+        uint32_t offset;
+        if (!Alloc(inline_size, &offset))
+            return false;
+        fidl_message_header_t header = {};
+        header.ordinal = ordinal;
+        memcpy(buffer_.bytes + offset, &header, sizeof(header));
+        return true;
+    }
+
+    // Claims the next zeroed, 8-byte aligned |size| bytes.
+    bool Alloc(uint64_t size, uint32_t* out_offset) {
+        uint64_t aligned = FIDL_ALIGN(size);
+        if (aligned > buffer_.capacity - num_bytes_)
+            return Fail(ZX_ERR_BUFFER_TOO_SMALL);
+        *out_offset = num_bytes_;
+        memset(buffer_.bytes + num_bytes_, 0, static_cast<size_t>(aligned));
+        num_bytes_ += static_cast<uint32_t>(aligned);
+        return true;
+    }
+
+    // Takes ownership of |handle|, and records it as the next handle of the
+    // message, whose slot is at |offset|.
+    bool EncodeHandle(zx_handle_t handle, uint32_t offset) {
+        if (num_handles_ == buffer_.handle_capacity) {
+            zx_handle_close(handle);
+            return Fail(ZX_ERR_BUFFER_TOO_SMALL);
+        }
+        buffer_.handles[num_handles_++] = handle;
+        Write<zx_handle_t>(offset, FIDL_HANDLE_PRESENT);
+        return true;
+    }
+
+    template <typename T>
+    void Write(uint32_t offset, T value) {
+        memcpy(buffer_.bytes + offset, &value, sizeof(T));
+    }
+
+    uint8_t* At(uint32_t offset) { return buffer_.bytes + offset; }
+
+    // Records the first failure, and returns false.
+    bool Fail(zx_status_t status) {
+        if (status_ == ZX_OK)
+            status_ = status;
+        return false;
+    }
+
+    zx_status_t status() const { return status_; }
+    uint32_t num_bytes() const { return num_bytes_; }
+    uint32_t num_handles() const { return num_handles_; }
+
+    // Hands the encoded message, and the handles in it, over to the caller.
+    fidl_msg_t TakeMessage() {
+        taken_ = true;
+        fidl_msg_t message = {};
+        message.bytes = buffer_.bytes;
+        message.handles = buffer_.handles;
+        message.num_bytes = num_bytes_;
+        message.num_handles = num_handles_;
+        return message;
+    }
+
+private:
+    BufferRef buffer_;
+    uint32_t num_bytes_ = 0u;
+    uint32_t num_handles_ = 0u;
+    zx_status_t status_ = ZX_OK;
+    bool taken_ = false;
+};
+
+// The decoder -----------------------------------------------------------------
+
+// Decodes a message in place. The generated code claims each out-of-line
+// object in the order the wire format lays them out, and the decoder checks
+// that the message holds exactly what the code claimed. Handles that the
+// decoder never hands out are closed with it.
+class Decoder {
+public:
+    Decoder(uint8_t* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t num_handles)
+        : bytes_(bytes), num_bytes_(num_bytes), handles_(handles), num_handles_(num_handles) {}
+    explicit Decoder(const fidl_msg_t& message)
+        : Decoder(static_cast<uint8_t*>(message.bytes), message.num_bytes, message.handles,
+                  message.num_handles) {}
+    Decoder(const Decoder&) = delete;
+    Decoder& operator=(const Decoder&) = delete;
+    ~Decoder() {
+        zx_handle_close_many(handles_ + next_handle_, num_handles_ - next_handle_);
+    }
+
+    // Claims the header and parameters of a message, which take up
+    // |inline_size| bytes, and checks that the header is for |ordinal|.
+    bool BeginMessage(uint32_t ordinal, uint32_t inline_size) {
+        uint32_t offset;
+        if (!Claim(inline_size, &offset))
+            return false;
+        if (Read<fidl_message_header_t>(offset).ordinal != ordinal)
+            return Fail(ZX_ERR_INVALID_ARGS);
+        return true;
+    }
+
+    // Claims the next 8-byte aligned |size| bytes.
+    bool Claim(uint64_t size, uint32_t* out_offset) {
+        uint64_t aligned = FIDL_ALIGN(size);
+        if (aligned > num_bytes_ - next_byte_)
+            return Fail(ZX_ERR_INVALID_ARGS);
+        *out_offset = next_byte_;
+        next_byte_ += static_cast<uint32_t>(aligned);
+        return true;
+    }
+
+    // Takes the next handle of the message, if the slot at |offset| says it
+    // is present. Absent handles come out as ZX_HANDLE_INVALID.
+    bool DecodeHandle(uint32_t offset, bool nullable, zx_handle_t* out_handle) {
+        zx_handle_t marker = Read<zx_handle_t>(offset);
+        if (marker == FIDL_HANDLE_ABSENT && nullable) {
+            *out_handle = ZX_HANDLE_INVALID;
+            return true;
+        }
+        if (marker != FIDL_HANDLE_PRESENT || next_handle_ == num_handles_)
+            return Fail(ZX_ERR_INVALID_ARGS);
+        *out_handle = handles_[next_handle_++];
+        return true;
+    }
+
+    // Skips the |num_bytes| bytes and closes the |num_handles| handles that an
+    // envelope of unknown content carries.
+    bool Skip(uint32_t num_bytes, uint32_t num_handles) {
+        uint32_t offset;
+        if (num_bytes % FIDL_ALIGNMENT != 0u || !Claim(num_bytes, &offset))
+            return Fail(ZX_ERR_INVALID_ARGS);
+        if (num_handles > num_handles_ - next_handle_)
+            return Fail(ZX_ERR_INVALID_ARGS);
+        zx_handle_close_many(handles_ + next_handle_, num_handles);
+        next_handle_ += num_handles;
+        return true;
+    }
+
+    template <typename T>
+    T Read(uint32_t offset) const {
+        T value;
+        memcpy(&value, bytes_ + offset, sizeof(T));
+        return value;
+    }
+
+    uint8_t* At(uint32_t offset) const { return bytes_ + offset; }
+
+    // Records the first failure, and returns false.
+    bool Fail(zx_status_t status) {
+        if (status_ == ZX_OK)
+            status_ = status;
+        return false;
+    }
+
+    // Checks that every byte and handle of the message has been claimed.
+    zx_status_t Finish() {
+        if (status_ == ZX_OK && (next_byte_ != num_bytes_ || next_handle_ != num_handles_))
+            status_ = ZX_ERR_INVALID_ARGS;
+        return status_;
+    }
+
+    zx_status_t status() const { return status_; }
+    uint32_t num_bytes_claimed() const { return next_byte_; }
+    uint32_t num_handles_claimed() const { return next_handle_; }
+
+private:
+    uint8_t* bytes_;
+    uint32_t num_bytes_;
+    zx_handle_t* handles_;
+    uint32_t num_handles_;
+    uint32_t next_byte_ = 0u;
+    uint32_t next_handle_ = 0u;
+    zx_status_t status_ = ZX_OK;
+};
+
+// Coding traits --------------------------------------------------------------
+
+// CodingTraits<T> gives the inline size of T on the wire, and encodes and
+// decodes a T whose inline part is at |offset|. Types that can be absent on
+// the wire also say whether the inline part at |offset| is absent, and
+// validate it if so, for the std::optional that holds them.
+template <typename T, typename Enable = void>
+struct CodingTraits;
+
+template <typename T>
+bool Encode(Encoder* encoder, T* value, uint32_t offset) {
+    return CodingTraits<T>::Encode(encoder, value, offset);
+}
+
+template <typename T>
+bool Decode(Decoder* decoder, T* value, uint32_t offset) {
+    return CodingTraits<T>::Decode(decoder, value, offset);
+}
+
+// Whether a T has the same bytes in memory as on the wire, and needs no
+// validation when decoded, so that arrays and vectors of them are copied
+// whole.
+template <typename T>
+struct IsMemcpyCompatible
+    : std::integral_constant<bool, (std::is_arithmetic<T>::value || std::is_enum<T>::value) &&
+                                       !std::is_same<T, bool>::value> {};
+
+template <typename T>
+struct CodingTraits<T, std::enable_if_t<std::is_arithmetic<T>::value || std::is_enum<T>::value>> {
+    static constexpr uint32_t kInlineSize = sizeof(T);
+    static bool Encode(Encoder* encoder, T* value, uint32_t offset) {
+        encoder->Write<T>(offset, *value);
+        return true;
+    }
+    static bool Decode(Decoder* decoder, T* value, uint32_t offset) {
+        *value = decoder->Read<T>(offset);
+        return true;
+    }
+};
+
+template <>
+struct CodingTraits<bool> {
+    static constexpr uint32_t kInlineSize = 1u;
+    static bool Encode(Encoder* encoder, bool* value, uint32_t offset) {
+        encoder->Write<uint8_t>(offset, *value ? 1u : 0u);
+        return true;
+    }
+    static bool Decode(Decoder* decoder, bool* value, uint32_t offset) {
+        uint8_t byte = decoder->Read<uint8_t>(offset);
+        if (byte > 1u)
+            return decoder->Fail(ZX_ERR_INVALID_ARGS);
+        *value = byte != 0u;
+        return true;
+    }
+};
+
+// Generated structs, unions, tables and xunions.
+template <typename T>
+struct CodingTraits<T, std::void_t<decltype(T::kInlineSize)>> {
+    static constexpr uint32_t kInlineSize = T::kInlineSize;
+    static bool Encode(Encoder* encoder, T* value, uint32_t offset) {
+        return value->Encode(encoder, offset);
+    }
+    static bool Decode(Decoder* decoder, T* value, uint32_t offset) {
+        return T::Decode(decoder, value, offset);
+    }
+    static bool IsAbsent(const Decoder& decoder, uint32_t offset) {
+        return T::IsAbsent(decoder, offset);
+    }
+    static bool DecodeAbsent(Decoder* decoder, uint32_t offset) {
+        return T::DecodeAbsent(decoder, offset);
+    }
+};
+
+template <typename T, size_t N>
+struct CodingTraits<std::array<T, N>> {
+    static constexpr uint32_t kInlineSize = CodingTraits<T>::kInlineSize * static_cast<uint32_t>(N);
+    static bool Encode(Encoder* encoder, std::array<T, N>* value, uint32_t offset) {
+        if constexpr (IsMemcpyCompatible<T>::value) {
+            memcpy(encoder->At(offset), value->data(), sizeof(T) * N);
+        } else {
+            for (size_t i = 0; i < N; i++) {
+                if (!CodingTraits<T>::Encode(encoder, &(*value)[i],
+                                             offset + static_cast<uint32_t>(i) *
+                                                          CodingTraits<T>::kInlineSize))
+                    return false;
+            }
+        }
+        return true;
+    }
+    static bool Decode(Decoder* decoder, std::array<T, N>* value, uint32_t offset) {
+        if constexpr (IsMemcpyCompatible<T>::value) {
+            memcpy(value->data(), decoder->At(offset), sizeof(T) * N);
+        } else {
+            for (size_t i = 0; i < N; i++) {
+                if (!CodingTraits<T>::Decode(decoder, &(*value)[i],
+                                             offset + static_cast<uint32_t>(i) *
+                                                          CodingTraits<T>::kInlineSize))
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+template <>
+struct CodingTraits<Handle> {
+    static constexpr uint32_t kInlineSize = sizeof(zx_handle_t);
+    static bool Encode(Encoder* encoder, Handle* value, uint32_t offset) {
+        if (!value->is_valid())
+            return encoder->Fail(ZX_ERR_INVALID_ARGS);
+        return encoder->EncodeHandle(value->release(), offset);
+    }
+    static bool Decode(Decoder* decoder, Handle* value, uint32_t offset) {
+        zx_handle_t handle;
+        if (!decoder->DecodeHandle(offset, false, &handle))
+            return false;
+        value->reset(handle);
+        return true;
+    }
+    static bool IsAbsent(const Decoder& decoder, uint32_t offset) {
+        return decoder.Read<zx_handle_t>(offset) == FIDL_HANDLE_ABSENT;
+    }
+    static bool DecodeAbsent(Decoder* decoder, uint32_t offset) { return true; }
+};
+
+template <typename Protocol>
+struct CodingTraits<InterfaceHandle<Protocol>> {
+    static constexpr uint32_t kInlineSize = sizeof(zx_handle_t);
+    static bool Encode(Encoder* encoder, InterfaceHandle<Protocol>* value, uint32_t offset) {
+        Handle channel = value->TakeChannel();
+        return CodingTraits<Handle>::Encode(encoder, &channel, offset);
+    }
+    static bool Decode(Decoder* decoder, InterfaceHandle<Protocol>* value, uint32_t offset) {
+        Handle channel;
+        if (!CodingTraits<Handle>::Decode(decoder, &channel, offset))
+            return false;
+        *value = InterfaceHandle<Protocol>(std::move(channel));
+        return true;
+    }
+    static bool IsAbsent(const Decoder& decoder, uint32_t offset) {
+        return CodingTraits<Handle>::IsAbsent(decoder, offset);
+    }
+    static bool DecodeAbsent(Decoder* decoder, uint32_t offset) { return true; }
+};
+
+// Strings and vectors share their inline part: a count, then a presence
+// marker for the out-of-line elements.
+inline bool IsAbsentVector(const Decoder& decoder, uint32_t offset) {
+    return decoder.Read<uintptr_t>(offset + 8u) == FIDL_ALLOC_ABSENT;
+}
+
+inline bool DecodeAbsentVector(Decoder* decoder, uint32_t offset) {
+    if (decoder->Read<uint64_t>(offset) != 0u)
+        return decoder->Fail(ZX_ERR_INVALID_ARGS);
+    return true;
+}
+
+// Writes the inline part of a vector of |count| elements of |element_size|
+// bytes, and claims their out-of-line object.
+inline bool EncodeVectorHeader(Encoder* encoder, size_t count, uint32_t max_count,
+                               uint32_t element_size, uint32_t offset,
+                               uint32_t* out_elements) {
+    if (count > max_count)
+        return encoder->Fail(ZX_ERR_INVALID_ARGS);
+    encoder->Write<uint64_t>(offset, count);
+    encoder->Write<uintptr_t>(offset + 8u, FIDL_ALLOC_PRESENT);
+    return encoder->Alloc(static_cast<uint64_t>(count) * element_size, out_elements);
+}
+
+// Validates the inline part of a present vector, and claims its out-of-line
+// object.
+inline bool DecodeVectorHeader(Decoder* decoder, uint32_t max_count, uint32_t element_size,
+                               uint32_t offset, uint64_t* out_count, uint32_t* out_elements) {
+    uint64_t count = decoder->Read<uint64_t>(offset);
+    if (decoder->Read<uintptr_t>(offset + 8u) != FIDL_ALLOC_PRESENT || count > max_count)
+        return decoder->Fail(ZX_ERR_INVALID_ARGS);
+    *out_count = count;
+    return decoder->Claim(count * element_size, out_elements);
+}
+
+inline bool EncodeStringView(Encoder* encoder, std::string_view value, uint32_t max_size,
+                             uint32_t offset) {
+    uint32_t data;
+    if (!EncodeVectorHeader(encoder, value.size(), max_size, 1u, offset, &data))
+        return false;
+    memcpy(encoder->At(data), value.data(), value.size());
+    return true;
+}
+
+inline bool EncodeStringView(Encoder* encoder, std::optional<std::string_view> value,
+                             uint32_t max_size, uint32_t offset) {
+    return !value || EncodeStringView(encoder, *value, max_size, offset);
+}
+
+// Points |out_value| at the bytes of the string in the message.
+inline bool DecodeStringView(Decoder* decoder, std::string_view* out_value, uint32_t max_size,
+                             uint32_t offset) {
+    uint64_t size;
+    uint32_t data;
+    if (!DecodeVectorHeader(decoder, max_size, 1u, offset, &size, &data))
+        return false;
+    *out_value = std::string_view(reinterpret_cast<const char*>(decoder->At(data)),
+                                  static_cast<size_t>(size));
+    return true;
+}
+
+inline bool DecodeStringView(Decoder* decoder, std::optional<std::string_view>* out_value,
+                             uint32_t max_size, uint32_t offset) {
+    if (IsAbsentVector(*decoder, offset)) {
+        out_value->reset();
+        return DecodeAbsentVector(decoder, offset);
+    }
+    return DecodeStringView(decoder, &out_value->emplace(), max_size, offset);
+}
+
+template <typename T>
+bool EncodeVectorView(Encoder* encoder, Span<const T> value, uint32_t max_count,
+                      uint32_t offset) {
+    static_assert(IsMemcpyCompatible<T>::value, "views are of numbers, enums and bits only");
+    uint32_t elements;
+    if (!EncodeVectorHeader(encoder, value.size(), max_count, sizeof(T), offset, &elements))
+        return false;
+    memcpy(encoder->At(elements), value.data(), value.size() * sizeof(T));
+    return true;
+}
+
+template <typename T>
+bool EncodeVectorView(Encoder* encoder, std::optional<Span<const T>> value,
+                      uint32_t max_count, uint32_t offset) {
+    return !value || EncodeVectorView(encoder, *value, max_count, offset);
+}
+
+// Points |out_value| at the elements of the vector in the message, which are
+// 8-byte aligned.
+template <typename T>
+bool DecodeVectorView(Decoder* decoder, Span<const T>* out_value, uint32_t max_count,
+                      uint32_t offset) {
+    static_assert(IsMemcpyCompatible<T>::value, "views are of numbers, enums and bits only");
+    uint64_t count;
+    uint32_t elements;
+    if (!DecodeVectorHeader(decoder, max_count, sizeof(T), offset, &count, &elements))
+        return false;
+    *out_value = Span<const T>(reinterpret_cast<const T*>(decoder->At(elements)),
+                               static_cast<size_t>(count));
+    return true;
+}
+
+template <typename T>
+bool DecodeVectorView(Decoder* decoder, std::optional<Span<const T>>* out_value,
+                      uint32_t max_count, uint32_t offset) {
+    if (IsAbsentVector(*decoder, offset)) {
+        out_value->reset();
+        return DecodeAbsentVector(decoder, offset);
+    }
+    return DecodeVectorView(decoder, &out_value->emplace(), max_count, offset);
+}
+
+// The coding of InlineString, String, InlineVector and Vector, which differ
+// only in their storage.
+template <typename S>
+struct StringCodingTraits {
+    static constexpr uint32_t kInlineSize = 16u;
+    static bool Encode(Encoder* encoder, S* value, uint32_t offset) {
+        return EncodeStringView(encoder, std::string_view(value->data(), value->size()),
+                                S::kMaxSize, offset);
+    }
+    static bool Decode(Decoder* decoder, S* value, uint32_t offset) {
+        std::string_view view;
+        if (!DecodeStringView(decoder, &view, S::kMaxSize, offset))
+            return false;
+        value->resize(view.size());
+        memcpy(value->data(), view.data(), view.size());
+        return true;
+    }
+    static bool IsAbsent(const Decoder& decoder, uint32_t offset) {
+        return IsAbsentVector(decoder, offset);
+    }
+    static bool DecodeAbsent(Decoder* decoder, uint32_t offset) {
+        return DecodeAbsentVector(decoder, offset);
+    }
+};
+
+template <typename V, typename T>
+struct VectorCodingTraits {
+    static constexpr uint32_t kInlineSize = 16u;
+    static constexpr uint32_t kElementSize = CodingTraits<T>::kInlineSize;
+    static bool Encode(Encoder* encoder, V* value, uint32_t offset) {
+        uint32_t elements;
+        if (!EncodeVectorHeader(encoder, value->size(), V::kMaxSize, kElementSize, offset,
+                                &elements))
+            return false;
+        if constexpr (IsMemcpyCompatible<T>::value) {
+            memcpy(encoder->At(elements), value->data(), value->size() * sizeof(T));
+        } else {
+            for (size_t i = 0; i < value->size(); i++) {
+                if (!CodingTraits<T>::Encode(encoder, &(*value)[i],
+                                             elements + static_cast<uint32_t>(i) * kElementSize))
+                    return false;
+            }
+        }
+        return true;
+    }
+    static bool Decode(Decoder* decoder, V* value, uint32_t offset) {
+        uint64_t count;
+        uint32_t elements;
+        if (!DecodeVectorHeader(decoder, V::kMaxSize, kElementSize, offset, &count, &elements))
+            return false;
+        value->resize(static_cast<size_t>(count));
+        if constexpr (IsMemcpyCompatible<T>::value) {
+            memcpy(value->data(), decoder->At(elements), static_cast<size_t>(count) * sizeof(T));
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                if (!CodingTraits<T>::Decode(decoder, &(*value)[i],
+                                             elements + static_cast<uint32_t>(i) * kElementSize))
+                    return false;
+            }
+        }
+        return true;
+    }
+    static bool IsAbsent(const Decoder& decoder, uint32_t offset) {
+        return IsAbsentVector(decoder, offset);
+    }
+    static bool DecodeAbsent(Decoder* decoder, uint32_t offset) {
+        return DecodeAbsentVector(decoder, offset);
+    }
+};
+
+template <uint32_t N>
+struct CodingTraits<InlineString<N>> : StringCodingTraits<InlineString<N>> {};
+
+template <uint32_t N>
+struct CodingTraits<String<N>> : StringCodingTraits<String<N>> {};
+
+template <typename T, uint32_t N>
+struct CodingTraits<InlineVector<T, N>> : VectorCodingTraits<InlineVector<T, N>, T> {};
+
+template <typename T, uint32_t N>
+struct CodingTraits<Vector<T, N>> : VectorCodingTraits<Vector<T, N>, T> {};
+
+// Nullable strings, vectors, handles and xunions, whose absence is a
+// particular inline value.
+template <typename T>
+struct CodingTraits<std::optional<T>> {
+    static constexpr uint32_t kInlineSize = CodingTraits<T>::kInlineSize;
+    static bool Encode(Encoder* encoder, std::optional<T>* value, uint32_t offset) {
+        // The zeroed inline part reads as absent.
+        return !*value || CodingTraits<T>::Encode(encoder, &**value, offset);
+    }
+    static bool Decode(Decoder* decoder, std::optional<T>* value, uint32_t offset) {
+        if (CodingTraits<T>::IsAbsent(*decoder, offset)) {
+            value->reset();
+            return CodingTraits<T>::DecodeAbsent(decoder, offset);
+        }
+        return CodingTraits<T>::Decode(decoder, &value->emplace(), offset);
+    }
+};
+
+// Nullable structs and unions, which are out of line behind a presence
+// marker.
+template <typename T>
+struct CodingTraits<std::unique_ptr<T>> {
+    static constexpr uint32_t kInlineSize = sizeof(uintptr_t);
+    static bool Encode(Encoder* encoder, std::unique_ptr<T>* value, uint32_t offset) {
+        if (!*value)
+            return true;
+        uint32_t object;
+        if (!encoder->Alloc(CodingTraits<T>::kInlineSize, &object))
+            return false;
+        encoder->Write<uintptr_t>(offset, FIDL_ALLOC_PRESENT);
+        return CodingTraits<T>::Encode(encoder, value->get(), object);
+    }
+    static bool Decode(Decoder* decoder, std::unique_ptr<T>* value, uint32_t offset) {
+        uintptr_t marker = decoder->Read<uintptr_t>(offset);
+        if (marker == FIDL_ALLOC_ABSENT) {
+            value->reset();
+            return true;
+        }
+        uint32_t object;
+        if (marker != FIDL_ALLOC_PRESENT || !decoder->Claim(CodingTraits<T>::kInlineSize, &object))
+            return decoder->Fail(ZX_ERR_INVALID_ARGS);
+        *value = std::make_unique<T>();
+        return CodingTraits<T>::Decode(decoder, value->get(), object);
+    }
+};
+
+// Encodes a nullable struct or union parameter, which the caller keeps, in
+// place of the std::unique_ptr that its natural type holds it by.
+template <typename T>
+bool EncodeNullable(Encoder* encoder, T* value, uint32_t offset) {
+    if (value == nullptr)
+        return true;
+    uint32_t object;
+    if (!encoder->Alloc(CodingTraits<T>::kInlineSize, &object))
+        return false;
+    encoder->Write<uintptr_t>(offset, FIDL_ALLOC_PRESENT);
+    return CodingTraits<T>::Encode(encoder, value, object);
+}
+
+// Envelopes ------------------------------------------------------------------
+
+// The inline part of an envelope: the size of its content, the number of
+// handles in it, and a presence marker.
+constexpr uint32_t kEnvelopeSize = 16u;
+
+// Encodes |value| as the content of the envelope at |offset|.
+template <typename T>
+bool EncodeEnvelope(Encoder* encoder, T* value, uint32_t offset) {
+    uint32_t num_bytes = encoder->num_bytes();
+    uint32_t num_handles = encoder->num_handles();
+    uint32_t object;
+    if (!encoder->Alloc(CodingTraits<T>::kInlineSize, &object) ||
+        !CodingTraits<T>::Encode(encoder, value, object))
+        return false;
+    encoder->Write<uint32_t>(offset, encoder->num_bytes() - num_bytes);
+    encoder->Write<uint32_t>(offset + 4u, encoder->num_handles() - num_handles);
+    encoder->Write<uintptr_t>(offset + 8u, FIDL_ALLOC_PRESENT);
+    return true;
+}
+
+inline bool IsAbsentEnvelope(const Decoder& decoder, uint32_t offset) {
+    return decoder.Read<uintptr_t>(offset + 8u) == FIDL_ALLOC_ABSENT;
+}
+
+inline bool DecodeAbsentEnvelope(Decoder* decoder, uint32_t offset) {
+    if (decoder->Read<uint32_t>(offset) != 0u || decoder->Read<uint32_t>(offset + 4u) != 0u)
+        return decoder->Fail(ZX_ERR_INVALID_ARGS);
+    return true;
+}
+
+// Decodes the content of the envelope at |offset| into |value|, and checks
+// that the envelope's sizes match what the content took up.
+template <typename T>
+bool DecodeEnvelope(Decoder* decoder, T* value, uint32_t offset) {
+    uint32_t num_bytes = decoder->Read<uint32_t>(offset);
+    uint32_t num_handles = decoder->Read<uint32_t>(offset + 4u);
+    if (decoder->Read<uintptr_t>(offset + 8u) != FIDL_ALLOC_PRESENT)
+        return decoder->Fail(ZX_ERR_INVALID_ARGS);
+    uint32_t bytes_before = decoder->num_bytes_claimed();
+    uint32_t handles_before = decoder->num_handles_claimed();
+    uint32_t object;
+    if (!decoder->Claim(CodingTraits<T>::kInlineSize, &object) ||
+        !CodingTraits<T>::Decode(decoder, value, object))
+        return false;
+    if (decoder->num_bytes_claimed() - bytes_before != num_bytes ||
+        decoder->num_handles_claimed() - handles_before != num_handles)
+        return decoder->Fail(ZX_ERR_INVALID_ARGS);
+    return true;
+}
+
+// Decodes an optional table field from the envelope at |offset|.
+template <typename T>
+bool DecodeEnvelope(Decoder* decoder, std::optional<T>* value, uint32_t offset) {
+    if (IsAbsentEnvelope(*decoder, offset)) {
+        value->reset();
+        return DecodeAbsentEnvelope(decoder, offset);
+    }
+    return DecodeEnvelope(decoder, &value->emplace(), offset);
+}
+
+// Skips the envelope at |offset|, whose content is not known.
+inline bool SkipEnvelope(Decoder* decoder, uint32_t offset) {
+    if (IsAbsentEnvelope(*decoder, offset))
+        return DecodeAbsentEnvelope(decoder, offset);
+    if (decoder->Read<uintptr_t>(offset + 8u) != FIDL_ALLOC_PRESENT)
+        return decoder->Fail(ZX_ERR_INVALID_ARGS);
+    return decoder->Skip(decoder->Read<uint32_t>(offset), decoder->Read<uint32_t>(offset + 4u));
+}
+
+// Transport ------------------------------------------------------------------
+
+// Where a server sends the reply to a request. Replies are encoded into
+// buffer(), which must not be the buffer the request was read into, since
+// the request's views point into that one until the handler returns.
+class Transaction {
+public:
+    virtual ~Transaction() = default;
+    virtual BufferRef buffer() = 0;
+    virtual zx_status_t Reply(fidl_msg_t* message) = 0;
+};
+
+// A transaction that writes the reply to a channel with the txid of the
+// request it answers.
+class ChannelTransaction final : public Transaction {
+public:
+    ChannelTransaction(zx_handle_t channel, zx_txid_t txid, BufferRef buffer)
+        : channel_(channel), txid_(txid), buffer_(buffer) {}
+
+    BufferRef buffer() override { return buffer_; }
+
+    zx_status_t Reply(fidl_msg_t* message) override {
+        reinterpret_cast<fidl_message_header_t*>(message->bytes)->txid = txid_;
+        return zx_channel_write(channel_, 0u, message->bytes, message->num_bytes,
+                                message->handles, message->num_handles);
+    }
+
+private:
+    zx_handle_t channel_;
+    zx_txid_t txid_;
+    BufferRef buffer_;
+};
+
+// Writes the message that |encoder| holds to |channel|.
+inline zx_status_t Write(zx_handle_t channel, Encoder* encoder) {
+    if (encoder->status() != ZX_OK)
+        return encoder->status();
+    fidl_msg_t message = encoder->TakeMessage();
+    return zx_channel_write(channel, 0u, message.bytes, message.num_bytes, message.handles,
+                            message.num_handles);
+}
+
+// Sends the request that |encoder| holds on |channel|, and reads the reply
+// into |buffer|, which may be the buffer the request is in.
+inline zx_status_t Call(zx_handle_t channel, Encoder* encoder, BufferRef buffer,
+                        uint32_t* out_num_bytes, uint32_t* out_num_handles) {
+    if (encoder->status() != ZX_OK)
+        return encoder->status();
+    fidl_msg_t message = encoder->TakeMessage();
+    zx_channel_call_args_t args = {};
+    args.wr_bytes = message.bytes;
+    args.wr_handles = message.handles;
+    args.rd_bytes = buffer.bytes;
+    args.rd_handles = buffer.handles;
+    args.wr_num_bytes = message.num_bytes;
+    args.wr_num_handles = message.num_handles;
+    args.rd_num_bytes = buffer.capacity;
+    args.rd_num_handles = buffer.handle_capacity;
+    return zx_channel_call(channel, 0u, ZX_TIME_INFINITE, &args, out_num_bytes,
+                           out_num_handles);
+}
+
+// Reads the next message on |channel| into |buffer|, without waiting.
+inline zx_status_t Read(zx_handle_t channel, BufferRef buffer, fidl_msg_t* out_message) {
+    out_message->bytes = buffer.bytes;
+    out_message->handles = buffer.handles;
+    return zx_channel_read(channel, 0u, buffer.bytes, buffer.handles, buffer.capacity,
+                           buffer.handle_capacity, &out_message->num_bytes,
+                           &out_message->num_handles);
+}
+
+} // namespace fidl
+
+#endif // LIB_FIDL_CPP_BINDINGS_H_
@@ -0,0 +1,208 @@
+// The coding tables that the --tables output defines and that fidl_encode()
+// and fidl_decode() walk. Only C++ sources include this header.
+
+#ifndef HOST_INCLUDE_LIB_FIDL_INTERNAL_H_
+#define HOST_INCLUDE_LIB_FIDL_INTERNAL_H_
+
+#include <stdint.h>
+
+#include <zircon/fidl.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/types.h>
+
+namespace fidl {
+
+enum FidlNullability : uint32_t {
+    kNonnullable = 0u,
+    kNullable = 1u,
+};
+
+// A struct field that needs coding, at |offset| bytes from the start of the
+// struct.
+struct FidlStructField {
+    const fidl_type* type;
+    uint32_t offset;
+
+    constexpr FidlStructField(const fidl_type* type, uint32_t offset)
+        : type(type), offset(offset) {}
+};
+
+struct FidlTableField {
+    const fidl_type* type;
+    uint32_t ordinal;
+
+    constexpr FidlTableField(const fidl_type* type, uint32_t ordinal)
+        : type(type), ordinal(ordinal) {}
+};
+
+struct FidlXUnionField {
+    const fidl_type* type;
+    uint32_t ordinal;
+
+    constexpr FidlXUnionField(const fidl_type* type, uint32_t ordinal)
+        : type(type), ordinal(ordinal) {}
+};
+
+enum FidlTypeTag : uint32_t {
+    kFidlTypeStruct,
+    kFidlTypeStructPointer,
+    kFidlTypeTable,
+    kFidlTypeUnion,
+    kFidlTypeUnionPointer,
+    kFidlTypeXUnion,
+    kFidlTypeArray,
+    kFidlTypeString,
+    kFidlTypeHandle,
+    kFidlTypeVector,
+};
+
+struct FidlCodedStruct {
+    const FidlStructField* fields;
+    uint32_t field_count;
+    // Including the message header, for messages.
+    uint32_t size;
+    const char* name;
+
+    constexpr FidlCodedStruct(const FidlStructField* fields, uint32_t field_count,
+                              uint32_t size, const char* name)
+        : fields(fields), field_count(field_count), size(size), name(name) {}
+};
+
+struct FidlCodedStructPointer {
+    const FidlCodedStruct* struct_type;
+
+    constexpr explicit FidlCodedStructPointer(const FidlCodedStruct* struct_type)
+        : struct_type(struct_type) {}
+};
+
+struct FidlCodedTable {
+    const FidlTableField* fields;
+    uint32_t field_count;
+    const char* name;
+
+    constexpr FidlCodedTable(const FidlTableField* fields, uint32_t field_count,
+                             const char* name)
+        : fields(fields), field_count(field_count), name(name) {}
+};
+
+// |types| has one entry per member, in tag order, which is null for members
+// that need no coding.
+struct FidlCodedUnion {
+    const fidl_type* const* types;
+    uint32_t type_count;
+    uint32_t data_offset;
+    uint32_t size;
+    const char* name;
+
+    constexpr FidlCodedUnion(const fidl_type* const* types, uint32_t type_count,
+                             uint32_t data_offset, uint32_t size, const char* name)
+        : types(types), type_count(type_count), data_offset(data_offset), size(size),
+          name(name) {}
+};
+
+struct FidlCodedUnionPointer {
+    const FidlCodedUnion* union_type;
+
+    constexpr explicit FidlCodedUnionPointer(const FidlCodedUnion* union_type)
+        : union_type(union_type) {}
+};
+
+struct FidlCodedXUnion {
+    uint32_t field_count;
+    const FidlXUnionField* fields;
+    FidlNullability nullable;
+    const char* name;
+
+    constexpr FidlCodedXUnion(uint32_t field_count, const FidlXUnionField* fields,
+                              FidlNullability nullable, const char* name)
+        : field_count(field_count), fields(fields), nullable(nullable), name(name) {}
+};
+
+// |array_size| is the size of the whole array in bytes.
+struct FidlCodedArray {
+    const fidl_type* element;
+    uint32_t array_size;
+    uint32_t element_size;
+
+    constexpr FidlCodedArray(const fidl_type* element, uint32_t array_size,
+                             uint32_t element_size)
+        : element(element), array_size(array_size), element_size(element_size) {}
+};
+
+struct FidlCodedVector {
+    const fidl_type* element;
+    uint32_t max_count;
+    uint32_t element_size;
+    FidlNullability nullable;
+
+    constexpr FidlCodedVector(const fidl_type* element, uint32_t max_count,
+                              uint32_t element_size, FidlNullability nullable)
+        : element(element), max_count(max_count), element_size(element_size),
+          nullable(nullable) {}
+};
+
+struct FidlCodedString {
+    uint32_t max_size;
+    FidlNullability nullable;
+
+    constexpr FidlCodedString(uint32_t max_size, FidlNullability nullable)
+        : max_size(max_size), nullable(nullable) {}
+};
+
+struct FidlCodedHandle {
+    zx_obj_type_t handle_subtype;
+    FidlNullability nullable;
+
+    constexpr FidlCodedHandle(zx_obj_type_t handle_subtype, FidlNullability nullable)
+        : handle_subtype(handle_subtype), nullable(nullable) {}
+};
+
+} // namespace fidl
+
+struct fidl_type {
+    const fidl::FidlTypeTag type_tag;
+    const union {
+        const fidl::FidlCodedStruct coded_struct;
+        const fidl::FidlCodedStructPointer coded_struct_pointer;
+        const fidl::FidlCodedTable coded_table;
+        const fidl::FidlCodedUnion coded_union;
+        const fidl::FidlCodedUnionPointer coded_union_pointer;
+        const fidl::FidlCodedXUnion coded_xunion;
+        const fidl::FidlCodedHandle coded_handle;
+        const fidl::FidlCodedString coded_string;
+        const fidl::FidlCodedArray coded_array;
+        const fidl::FidlCodedVector coded_vector;
+    };
+
+    constexpr fidl_type(fidl::FidlCodedStruct coded_struct)
+        : type_tag(fidl::kFidlTypeStruct), coded_struct(coded_struct) {}
+
+    constexpr fidl_type(fidl::FidlCodedStructPointer coded_struct_pointer)
+        : type_tag(fidl::kFidlTypeStructPointer), coded_struct_pointer(coded_struct_pointer) {}
+
+    constexpr fidl_type(fidl::FidlCodedTable coded_table)
+        : type_tag(fidl::kFidlTypeTable), coded_table(coded_table) {}
+
+    constexpr fidl_type(fidl::FidlCodedUnion coded_union)
+        : type_tag(fidl::kFidlTypeUnion), coded_union(coded_union) {}
+
+    constexpr fidl_type(fidl::FidlCodedUnionPointer coded_union_pointer)
+        : type_tag(fidl::kFidlTypeUnionPointer), coded_union_pointer(coded_union_pointer) {}
+
+    constexpr fidl_type(fidl::FidlCodedXUnion coded_xunion)
+        : type_tag(fidl::kFidlTypeXUnion), coded_xunion(coded_xunion) {}
+
+    constexpr fidl_type(fidl::FidlCodedHandle coded_handle)
+        : type_tag(fidl::kFidlTypeHandle), coded_handle(coded_handle) {}
+
+    constexpr fidl_type(fidl::FidlCodedString coded_string)
+        : type_tag(fidl::kFidlTypeString), coded_string(coded_string) {}
+
+    constexpr fidl_type(fidl::FidlCodedArray coded_array)
+        : type_tag(fidl::kFidlTypeArray), coded_array(coded_array) {}
+
+    constexpr fidl_type(fidl::FidlCodedVector coded_vector)
+        : type_tag(fidl::kFidlTypeVector), coded_vector(coded_vector) {}
+};
+
+#endif // HOST_INCLUDE_LIB_FIDL_INTERNAL_H_
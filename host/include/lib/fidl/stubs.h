@@ -0,0 +1,93 @@
+#ifndef HOST_INCLUDE_LIB_FIDL_STUBS_H_
+#define HOST_INCLUDE_LIB_FIDL_STUBS_H_
+
+#include <stdint.h>
+
+#include <zircon/fidl.h>
+#include <zircon/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Descriptors of the messages of simple C bindings generated with
+// --c-codegen size, and the routines that their client methods and server
+// replies call to build, send, receive and copy out messages by walking the
+// descriptors, rather than with code generated for each method.
+
+// How a parameter is passed in C and stored in its message. The arguments of
+// a method are passed to the routines as an array of pointers, with one or
+// more entries per parameter, as listed for each kind.
+typedef enum fidl_c_param_kind {
+    // Stored inline in the message as |size| bytes: numbers, handles, enums,
+    // bits, arrays, and non-nullable structs and unions. In and out, one
+    // entry that points at the value.
+    FIDL_C_PARAM_INLINE = 0,
+    // A vector whose elements are |size| bytes, or a string, with at most
+    // |max_count| of them. In, the data and a pointer to the size_t count.
+    // Out, the buffer, a pointer to the size_t capacity of the buffer, and
+    // a pointer to the size_t count.
+    FIDL_C_PARAM_VECTOR = 1,
+    FIDL_C_PARAM_STRING = 2,
+    // A nullable struct or union of |size| bytes, stored out of line when
+    // present. In and out, one entry that points at the value, or is null.
+    FIDL_C_PARAM_POINTER = 3,
+} fidl_c_param_kind_t;
+
+typedef struct fidl_c_param {
+    uint8_t kind;
+    // Whether a null vector or string is absent, rather than empty.
+    uint8_t nullable;
+    uint16_t reserved;
+    // From the start of the message, including its header.
+    uint32_t offset;
+    uint32_t size;
+    uint32_t max_count;
+} fidl_c_param_t;
+
+typedef struct fidl_c_message {
+    // The coding table of the message, or null for messages that are sent as
+    // plain bytes.
+    const fidl_type_t* type;
+    const fidl_c_param_t* params;
+    uint32_t num_params;
+    // The size of the inline object, including the header.
+    uint32_t size;
+    uint32_t max_handles;
+} fidl_c_message_t;
+
+typedef struct fidl_c_method {
+    uint32_t ordinal;
+    const fidl_c_message_t* request;
+    // Null for one-way methods.
+    const fidl_c_message_t* response;
+} fidl_c_method_t;
+
+// Sends the request of |method| built from |in_args| on |channel| and, for a
+// two-way method, waits for its response. The request is built, and the
+// response received, in |bytes| and |handles|, or on the stack if |bytes| is
+// null. The response is copied out to |out_args|, or, if |out_response| is
+// not null, decoded in place and pointed to by it.
+zx_status_t fidl_c_call(zx_handle_t channel, const fidl_c_method_t* method,
+                        void* bytes, uint32_t bytes_capacity,
+                        zx_handle_t* handles, uint32_t handles_capacity,
+                        const void* const* in_args, void* const* out_args,
+                        void** out_response);
+
+// Sends the request of the two-way |method| with the transaction id |txid|,
+// without waiting for its response.
+zx_status_t fidl_c_begin(zx_handle_t channel, const fidl_c_method_t* method, zx_txid_t txid,
+                         void* bytes, uint32_t bytes_capacity,
+                         zx_handle_t* handles, uint32_t handles_capacity,
+                         const void* const* in_args);
+
+// Replies to the request of |txn| with the |response| of the method with
+// |ordinal|, built from |args|.
+zx_status_t fidl_c_reply(fidl_txn_t* txn, uint32_t ordinal, const fidl_c_message_t* response,
+                         const void* const* args);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // HOST_INCLUDE_LIB_FIDL_STUBS_H_
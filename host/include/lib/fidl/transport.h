@@ -0,0 +1,23 @@
+#ifndef HOST_INCLUDE_LIB_FIDL_TRANSPORT_H_
+#define HOST_INCLUDE_LIB_FIDL_TRANSPORT_H_
+
+#include <zircon/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Messages on the control plane of a socket, which carry no handles.
+
+zx_status_t fidl_socket_write_control(zx_handle_t socket, const void* buffer, size_t size);
+zx_status_t fidl_socket_read_control(zx_handle_t socket, void* buffer, size_t capacity,
+                                     size_t* out_actual);
+// Writes |buffer| and waits for the next message on |socket|.
+zx_status_t fidl_socket_call_control(zx_handle_t socket, const void* buffer, size_t size,
+                                     void* result, size_t capacity, size_t* out_actual);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // HOST_INCLUDE_LIB_FIDL_TRANSPORT_H_
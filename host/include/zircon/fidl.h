@@ -0,0 +1,87 @@
+// The FIDL wire format structures that the generated C bindings use.
+
+#ifndef HOST_INCLUDE_ZIRCON_FIDL_H_
+#define HOST_INCLUDE_ZIRCON_FIDL_H_
+
+#include <stdalign.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FIDL_ALIGNMENT ((uint32_t)8)
+#define FIDL_ALIGN(a) (((a) + 7u) & ~7u)
+#define FIDL_ALIGNDECL alignas(FIDL_ALIGNMENT)
+
+#define FIDL_ALLOC_PRESENT ((uintptr_t)UINTPTR_MAX)
+#define FIDL_ALLOC_ABSENT ((uintptr_t)0)
+
+#define FIDL_HANDLE_PRESENT ((zx_handle_t)UINT32_MAX)
+#define FIDL_HANDLE_ABSENT ((zx_handle_t)0)
+
+#define FIDL_MAX_SIZE UINT32_MAX
+
+typedef struct fidl_string {
+    uint64_t size;
+    char* data;
+} fidl_string_t;
+
+typedef struct fidl_vector {
+    uint64_t count;
+    void* data;
+} fidl_vector_t;
+
+typedef struct fidl_envelope {
+    uint32_t num_bytes;
+    uint32_t num_handles;
+    void* data;
+} fidl_envelope_t;
+
+typedef struct fidl_table {
+    uint64_t count;
+    fidl_envelope_t* envelopes;
+} fidl_table_t;
+
+typedef uint32_t fidl_union_tag_t;
+typedef uint32_t fidl_xunion_tag_t;
+
+typedef struct fidl_xunion {
+    fidl_xunion_tag_t tag;
+    uint32_t padding;
+    fidl_envelope_t envelope;
+} fidl_xunion_t;
+
+typedef struct fidl_message_header {
+    zx_txid_t txid;
+    uint32_t reserved0;
+    uint32_t flags;
+    uint32_t ordinal;
+} fidl_message_header_t;
+
+// A message, with its handles, as read from or written to a channel.
+typedef struct fidl_msg {
+    void* bytes;
+    zx_handle_t* handles;
+    uint32_t num_bytes;
+    uint32_t num_handles;
+} fidl_msg_t;
+
+// A transaction that a server replies to, which carries whatever the
+// dispatcher needs to route the reply, such as the txid of the request.
+typedef struct fidl_txn fidl_txn_t;
+struct fidl_txn {
+    zx_status_t (*reply)(fidl_txn_t* txn, const fidl_msg_t* msg);
+};
+
+// The coding tables are defined in <lib/fidl/internal.h>, which only the
+// C++ table sources include.
+typedef struct fidl_type fidl_type_t;
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // HOST_INCLUDE_ZIRCON_FIDL_H_
@@ -0,0 +1,40 @@
+// The subset of the Zircon system calls that the generated C bindings and
+// the benchmark call, implemented over Unix domain sockets by host/channel.c.
+
+#ifndef HOST_INCLUDE_ZIRCON_SYSCALLS_H_
+#define HOST_INCLUDE_ZIRCON_SYSCALLS_H_
+
+#include <zircon/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+zx_time_t zx_clock_get_monotonic(void);
+zx_time_t zx_deadline_after(zx_duration_t nanoseconds);
+
+zx_status_t zx_handle_close(zx_handle_t handle);
+zx_status_t zx_handle_close_many(const zx_handle_t* handles, size_t num_handles);
+
+zx_status_t zx_object_wait_one(zx_handle_t handle, zx_signals_t signals,
+                               zx_time_t deadline, zx_signals_t* observed);
+
+zx_status_t zx_channel_create(uint32_t options, zx_handle_t* out0, zx_handle_t* out1);
+zx_status_t zx_channel_write(zx_handle_t handle, uint32_t options,
+                             const void* bytes, uint32_t num_bytes,
+                             const zx_handle_t* handles, uint32_t num_handles);
+zx_status_t zx_channel_read(zx_handle_t handle, uint32_t options,
+                            void* bytes, zx_handle_t* handles,
+                            uint32_t num_bytes, uint32_t num_handles,
+                            uint32_t* actual_bytes, uint32_t* actual_handles);
+zx_status_t zx_channel_call(zx_handle_t handle, uint32_t options, zx_time_t deadline,
+                            const zx_channel_call_args_t* args,
+                            uint32_t* actual_bytes, uint32_t* actual_handles);
+
+zx_status_t zx_socket_create(uint32_t options, zx_handle_t* out0, zx_handle_t* out1);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // HOST_INCLUDE_ZIRCON_SYSCALLS_H_
@@ -0,0 +1,17 @@
+#ifndef HOST_INCLUDE_ZIRCON_SYSCALLS_OBJECT_H_
+#define HOST_INCLUDE_ZIRCON_SYSCALLS_OBJECT_H_
+
+#include <zircon/types.h>
+
+// Object types, which the coding tables record for handles. The host
+// runtime does not check them.
+#define ZX_OBJ_TYPE_NONE ((zx_obj_type_t)0u)
+#define ZX_OBJ_TYPE_PROCESS ((zx_obj_type_t)1u)
+#define ZX_OBJ_TYPE_THREAD ((zx_obj_type_t)2u)
+#define ZX_OBJ_TYPE_VMO ((zx_obj_type_t)3u)
+#define ZX_OBJ_TYPE_CHANNEL ((zx_obj_type_t)4u)
+#define ZX_OBJ_TYPE_EVENT ((zx_obj_type_t)5u)
+#define ZX_OBJ_TYPE_PORT ((zx_obj_type_t)6u)
+#define ZX_OBJ_TYPE_SOCKET ((zx_obj_type_t)14u)
+
+#endif // HOST_INCLUDE_ZIRCON_SYSCALLS_OBJECT_H_
@@ -0,0 +1,76 @@
+// Host stand-in for the Zircon types that the generated C bindings use.
+// Handles are file descriptors offset by one, so that ZX_HANDLE_INVALID
+// stays zero; see host/channel.c.
+
+#ifndef HOST_INCLUDE_ZIRCON_TYPES_H_
+#define HOST_INCLUDE_ZIRCON_TYPES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int32_t zx_status_t;
+typedef uint32_t zx_handle_t;
+typedef uint32_t zx_signals_t;
+typedef uint32_t zx_obj_type_t;
+typedef uint32_t zx_txid_t;
+typedef int64_t zx_time_t;
+typedef int64_t zx_duration_t;
+
+typedef struct zx_channel_call_args {
+    const void* wr_bytes;
+    const zx_handle_t* wr_handles;
+    void* rd_bytes;
+    zx_handle_t* rd_handles;
+    uint32_t wr_num_bytes;
+    uint32_t wr_num_handles;
+    uint32_t rd_num_bytes;
+    uint32_t rd_num_handles;
+} zx_channel_call_args_t;
+
+#define ZX_OK ((zx_status_t)0)
+#define ZX_ERR_INTERNAL ((zx_status_t)-1)
+#define ZX_ERR_NOT_SUPPORTED ((zx_status_t)-2)
+#define ZX_ERR_NO_RESOURCES ((zx_status_t)-3)
+#define ZX_ERR_NO_MEMORY ((zx_status_t)-4)
+#define ZX_ERR_INVALID_ARGS ((zx_status_t)-10)
+#define ZX_ERR_BAD_HANDLE ((zx_status_t)-11)
+#define ZX_ERR_WRONG_TYPE ((zx_status_t)-12)
+#define ZX_ERR_OUT_OF_RANGE ((zx_status_t)-14)
+#define ZX_ERR_BUFFER_TOO_SMALL ((zx_status_t)-15)
+#define ZX_ERR_BAD_STATE ((zx_status_t)-20)
+#define ZX_ERR_TIMED_OUT ((zx_status_t)-21)
+#define ZX_ERR_SHOULD_WAIT ((zx_status_t)-22)
+#define ZX_ERR_PEER_CLOSED ((zx_status_t)-24)
+#define ZX_ERR_IO ((zx_status_t)-40)
+#define ZX_ERR_STOP ((zx_status_t)-61)
+#define ZX_ERR_NEXT ((zx_status_t)-62)
+#define ZX_ERR_ASYNC ((zx_status_t)-63)
+
+#define ZX_HANDLE_INVALID ((zx_handle_t)0)
+
+#define ZX_TIME_INFINITE INT64_MAX
+
+#define ZX_CHANNEL_MAX_MSG_BYTES ((uint32_t)65536u)
+#define ZX_CHANNEL_MAX_MSG_HANDLES ((uint32_t)64u)
+
+#define ZX_SIGNAL_NONE ((zx_signals_t)0u)
+#define ZX_CHANNEL_READABLE ((zx_signals_t)1u << 0)
+#define ZX_CHANNEL_WRITABLE ((zx_signals_t)1u << 1)
+#define ZX_CHANNEL_PEER_CLOSED ((zx_signals_t)1u << 2)
+#define ZX_SOCKET_READABLE ZX_CHANNEL_READABLE
+#define ZX_SOCKET_WRITABLE ZX_CHANNEL_WRITABLE
+#define ZX_SOCKET_PEER_CLOSED ZX_CHANNEL_PEER_CLOSED
+#define ZX_SOCKET_CONTROL_READABLE ZX_CHANNEL_READABLE
+#define ZX_SOCKET_CONTROL_WRITABLE ZX_CHANNEL_WRITABLE
+
+#define ZX_SOCKET_HAS_CONTROL ((uint32_t)1u << 2)
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // HOST_INCLUDE_ZIRCON_TYPES_H_
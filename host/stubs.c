@@ -0,0 +1,301 @@
+// The routines that the simple C bindings generated with --c-codegen size
+// call, instead of per-method code, to build, send, receive and copy out
+// messages. They walk the descriptors in <lib/fidl/stubs.h> and otherwise
+// do what the inlined bindings of --c-codegen speed do.
+
+#include <string.h>
+
+#include <lib/fidl/coding.h>
+#include <lib/fidl/stubs.h>
+#include <zircon/syscalls.h>
+
+// The number of entries that a parameter of |kind| takes in the arguments of
+// a client method: in, or out of it.
+static size_t InArgCount(uint8_t kind) {
+    return kind == FIDL_C_PARAM_VECTOR || kind == FIDL_C_PARAM_STRING ? 2u : 1u;
+}
+
+static size_t OutArgCount(uint8_t kind) {
+    return kind == FIDL_C_PARAM_VECTOR || kind == FIDL_C_PARAM_STRING ? 3u : 1u;
+}
+
+// Checks |args| against the bounds of |message| and computes the size of the
+// message that they make.
+static zx_status_t Measure(const fidl_c_message_t* message, const void* const* args,
+                           uint32_t* out_num_bytes) {
+    uint64_t num_bytes = message->size;
+    for (uint32_t i = 0; i < message->num_params; ++i) {
+        const fidl_c_param_t* param = &message->params[i];
+        switch (param->kind) {
+        case FIDL_C_PARAM_VECTOR:
+        case FIDL_C_PARAM_STRING: {
+            size_t count = *(const size_t*)args[1];
+            if (count > param->max_count || (args[0] == NULL && count != 0u))
+                return ZX_ERR_INVALID_ARGS;
+            num_bytes += FIDL_ALIGN((uint64_t)param->size * count);
+            break;
+        }
+        case FIDL_C_PARAM_POINTER:
+            if (args[0] != NULL)
+                num_bytes += FIDL_ALIGN(param->size);
+            break;
+        }
+        args += InArgCount(param->kind);
+    }
+    if (num_bytes > ZX_CHANNEL_MAX_MSG_BYTES)
+        return ZX_ERR_INVALID_ARGS;
+    *out_num_bytes = (uint32_t)num_bytes;
+    return ZX_OK;
+}
+
+// The size of the largest response that |out_args| have room for.
+static uint32_t MeasureCapacity(const fidl_c_message_t* message, void* const* out_args) {
+    uint64_t num_bytes = message->size;
+    for (uint32_t i = 0; i < message->num_params; ++i) {
+        const fidl_c_param_t* param = &message->params[i];
+        switch (param->kind) {
+        case FIDL_C_PARAM_VECTOR:
+        case FIDL_C_PARAM_STRING:
+            num_bytes += FIDL_ALIGN((uint64_t)param->size * *(const size_t*)out_args[1]);
+            break;
+        case FIDL_C_PARAM_POINTER:
+            if (out_args[0] != NULL)
+                num_bytes += FIDL_ALIGN(param->size);
+            break;
+        }
+        out_args += OutArgCount(param->kind);
+    }
+    return num_bytes > ZX_CHANNEL_MAX_MSG_BYTES ? ZX_CHANNEL_MAX_MSG_BYTES : (uint32_t)num_bytes;
+}
+
+// Copies |count| bytes from |data| to the out-of-line object at |*next| in
+// |bytes|, zeroes its padding, and returns where it starts.
+static char* CopyOutOfLine(char* bytes, uint32_t* next, const void* data, uint64_t count) {
+    char* object = &bytes[*next];
+    memcpy(object, data, count);
+    memset(object + count, 0, FIDL_ALIGN(count) - count);
+    *next += (uint32_t)FIDL_ALIGN(count);
+    return object;
+}
+
+// Builds the message that |args| make in |bytes|, which Measure() sized, and
+// encodes it.
+static zx_status_t Linearize(const fidl_c_message_t* message, uint32_t ordinal,
+                             const void* const* args, char* bytes, uint32_t num_bytes,
+                             zx_handle_t* handles, uint32_t* out_num_handles) {
+    memset(bytes, 0, message->size);
+    ((fidl_message_header_t*)bytes)->ordinal = ordinal;
+    uint32_t next = message->size;
+    for (uint32_t i = 0; i < message->num_params; ++i) {
+        const fidl_c_param_t* param = &message->params[i];
+        char* field = &bytes[param->offset];
+        switch (param->kind) {
+        case FIDL_C_PARAM_INLINE:
+            memcpy(field, args[0], param->size);
+            break;
+        case FIDL_C_PARAM_VECTOR:
+        case FIDL_C_PARAM_STRING: {
+            // Strings and vectors have the same layout.
+            fidl_vector_t* vector = (fidl_vector_t*)field;
+            size_t count = *(const size_t*)args[1];
+            vector->count = count;
+            if (args[0] == NULL && param->nullable) {
+                vector->data = NULL;
+            } else {
+                vector->data = CopyOutOfLine(bytes, &next, args[0], (uint64_t)param->size * count);
+            }
+            break;
+        }
+        case FIDL_C_PARAM_POINTER:
+            *(void**)field = args[0] == NULL
+                ? NULL : CopyOutOfLine(bytes, &next, args[0], param->size);
+            break;
+        }
+        args += InArgCount(param->kind);
+    }
+    *out_num_handles = 0u;
+    if (message->type == NULL)
+        return ZX_OK;
+    return fidl_encode(message->type, bytes, num_bytes, handles, message->max_handles,
+                       out_num_handles, NULL);
+}
+
+// Checks that |out_args| have room for the members of the response in
+// |bytes|, which is not decoded yet.
+static zx_status_t CheckCapacity(const fidl_c_message_t* message, const char* bytes,
+                                 void* const* out_args) {
+    for (uint32_t i = 0; i < message->num_params; ++i) {
+        const fidl_c_param_t* param = &message->params[i];
+        const char* field = &bytes[param->offset];
+        switch (param->kind) {
+        case FIDL_C_PARAM_VECTOR:
+        case FIDL_C_PARAM_STRING:
+            if (((const fidl_vector_t*)field)->count > *(const size_t*)out_args[1])
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            break;
+        case FIDL_C_PARAM_POINTER:
+            if (*(const uintptr_t*)field == FIDL_ALLOC_PRESENT && out_args[0] == NULL)
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            break;
+        }
+        out_args += OutArgCount(param->kind);
+    }
+    return ZX_OK;
+}
+
+// Copies the members of the decoded response in |bytes| out to |out_args|.
+static void CopyOut(const fidl_c_message_t* message, const char* bytes, void* const* out_args) {
+    for (uint32_t i = 0; i < message->num_params; ++i) {
+        const fidl_c_param_t* param = &message->params[i];
+        const char* field = &bytes[param->offset];
+        switch (param->kind) {
+        case FIDL_C_PARAM_INLINE:
+            memcpy(out_args[0], field, param->size);
+            break;
+        case FIDL_C_PARAM_VECTOR:
+        case FIDL_C_PARAM_STRING: {
+            const fidl_vector_t* vector = (const fidl_vector_t*)field;
+            if (vector->count > 0u)
+                memcpy(out_args[0], vector->data, (size_t)param->size * vector->count);
+            *(size_t*)out_args[2] = vector->count;
+            break;
+        }
+        case FIDL_C_PARAM_POINTER: {
+            const void* object = *(const void* const*)field;
+            // As in the inlined bindings, an absent struct is copied out as
+            // zeroes.
+            if (object != NULL) {
+                memcpy(out_args[0], object, param->size);
+            } else if (out_args[0] != NULL) {
+                memset(out_args[0], 0, param->size);
+            }
+            break;
+        }
+        }
+        out_args += OutArgCount(param->kind);
+    }
+}
+
+static uint32_t MaxHandles(const fidl_c_method_t* method) {
+    uint32_t max_handles = method->request->max_handles;
+    if (method->response != NULL && method->response->max_handles > max_handles)
+        max_handles = method->response->max_handles;
+    return max_handles;
+}
+
+zx_status_t fidl_c_call(zx_handle_t channel, const fidl_c_method_t* method,
+                        void* bytes, uint32_t bytes_capacity,
+                        zx_handle_t* handles, uint32_t handles_capacity,
+                        const void* const* in_args, void* const* out_args,
+                        void** out_response) {
+    uint32_t wr_num_bytes;
+    zx_status_t status = Measure(method->request, in_args, &wr_num_bytes);
+    if (status != ZX_OK)
+        return status;
+    uint32_t max_handles = MaxHandles(method);
+    if (bytes == NULL) {
+        uint32_t num_bytes = wr_num_bytes;
+        if (method->response != NULL) {
+            uint32_t rd_num_bytes = MeasureCapacity(method->response, out_args);
+            if (rd_num_bytes > num_bytes)
+                num_bytes = rd_num_bytes;
+        }
+        FIDL_ALIGNDECL char stack_bytes[num_bytes];
+        zx_handle_t stack_handles[max_handles > 0u ? max_handles : 1u];
+        return fidl_c_call(channel, method, stack_bytes, num_bytes, stack_handles, max_handles,
+                           in_args, out_args, out_response);
+    }
+    if (wr_num_bytes > bytes_capacity || handles_capacity < max_handles)
+        return ZX_ERR_BUFFER_TOO_SMALL;
+
+    uint32_t wr_num_handles;
+    status = Linearize(method->request, method->ordinal, in_args, bytes, wr_num_bytes,
+                       handles, &wr_num_handles);
+    if (status != ZX_OK)
+        return status;
+    if (method->response == NULL)
+        return zx_channel_write(channel, 0u, bytes, wr_num_bytes, handles, wr_num_handles);
+
+    const fidl_c_message_t* response = method->response;
+    zx_channel_call_args_t args = {
+        .wr_bytes = bytes,
+        .wr_handles = handles,
+        .rd_bytes = bytes,
+        .rd_handles = handles,
+        .wr_num_bytes = wr_num_bytes,
+        .wr_num_handles = wr_num_handles,
+        .rd_num_bytes = bytes_capacity,
+        .rd_num_handles = response->max_handles,
+    };
+    uint32_t actual_num_bytes = 0u;
+    uint32_t actual_num_handles = 0u;
+    status = zx_channel_call(channel, 0u, ZX_TIME_INFINITE, &args, &actual_num_bytes,
+                             &actual_num_handles);
+    if (status != ZX_OK)
+        return status;
+    if (out_response == NULL) {
+        if (actual_num_bytes < response->size) {
+            zx_handle_close_many(handles, actual_num_handles);
+            return ZX_ERR_INVALID_ARGS;
+        }
+        // The capacity is checked before decoding, so that the handles can
+        // still be closed from |handles|.
+        status = CheckCapacity(response, bytes, out_args);
+        if (status != ZX_OK) {
+            zx_handle_close_many(handles, actual_num_handles);
+            return status;
+        }
+    }
+    if (response->type != NULL) {
+        status = fidl_decode(response->type, bytes, actual_num_bytes, handles,
+                             actual_num_handles, NULL);
+        if (status != ZX_OK)
+            return status;
+    }
+    if (out_response != NULL) {
+        *out_response = bytes;
+    } else {
+        CopyOut(response, bytes, out_args);
+    }
+    return ZX_OK;
+}
+
+zx_status_t fidl_c_begin(zx_handle_t channel, const fidl_c_method_t* method, zx_txid_t txid,
+                         void* bytes, uint32_t bytes_capacity,
+                         zx_handle_t* handles, uint32_t handles_capacity,
+                         const void* const* in_args) {
+    uint32_t num_bytes;
+    zx_status_t status = Measure(method->request, in_args, &num_bytes);
+    if (status != ZX_OK)
+        return status;
+    if (num_bytes > bytes_capacity || handles_capacity < MaxHandles(method))
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    uint32_t num_handles;
+    status = Linearize(method->request, method->ordinal, in_args, bytes, num_bytes,
+                       handles, &num_handles);
+    if (status != ZX_OK)
+        return status;
+    ((fidl_message_header_t*)bytes)->txid = txid;
+    return zx_channel_write(channel, 0u, bytes, num_bytes, handles, num_handles);
+}
+
+zx_status_t fidl_c_reply(fidl_txn_t* txn, uint32_t ordinal, const fidl_c_message_t* response,
+                         const void* const* args) {
+    uint32_t num_bytes;
+    zx_status_t status = Measure(response, args, &num_bytes);
+    if (status != ZX_OK)
+        return status;
+    FIDL_ALIGNDECL char bytes[num_bytes];
+    zx_handle_t handles[response->max_handles > 0u ? response->max_handles : 1u];
+    fidl_msg_t msg = {
+        .bytes = bytes,
+        .handles = handles,
+        .num_bytes = num_bytes,
+        .num_handles = 0u,
+    };
+    status = Linearize(response, ordinal, args, bytes, num_bytes, handles,
+                       &msg.num_handles);
+    if (status != ZX_OK)
+        return status;
+    return txn->reply(txn, &msg);
+}
@@ -0,0 +1,259 @@
+// Compares the time it takes to load a library's JSON IR and find each of its
+// declarations, as a backend would, with the time it takes to do the same
+// with its binary IR.
+//
+// usage: ir_bench LIBRARY.json LIBRARY.fidlir [ITERATIONS]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "binary_ir_reader.h"
+
+namespace {
+
+// Just enough of a JSON DOM to hold the JSON IR: strings are kept with
+// their escapes, and numbers, booleans and null as their text.
+struct Value {
+    enum class Kind {
+        kObject,
+        kArray,
+        kString,
+        kLiteral,
+    };
+
+    Kind kind = Kind::kLiteral;
+    std::string text;
+    std::vector<std::pair<std::string, std::unique_ptr<Value>>> members;
+    std::vector<std::unique_ptr<Value>> elements;
+
+    const Value* Get(const std::string& key) const {
+        for (const auto& member : members) {
+            if (member.first == key)
+                return member.second.get();
+        }
+        return nullptr;
+    }
+};
+
+class Parser {
+public:
+    explicit Parser(const std::string& text)
+        : text_(text) {}
+
+    std::unique_ptr<Value> Parse() {
+        auto value = ParseValue();
+        SkipSpace();
+        if (pos_ != text_.size())
+            return nullptr;
+        return value;
+    }
+
+private:
+    void SkipSpace() {
+        while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\n' ||
+                                       text_[pos_] == '\r' || text_[pos_] == '\t'))
+            ++pos_;
+    }
+
+    bool Consume(char c) {
+        SkipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool ParseString(std::string* out_string) {
+        if (!Consume('"'))
+            return false;
+        size_t start = pos_;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            if (text_[pos_] == '\\')
+                ++pos_;
+            ++pos_;
+        }
+        if (pos_ >= text_.size())
+            return false;
+        out_string->assign(text_, start, pos_ - start);
+        ++pos_;
+        return true;
+    }
+
+    std::unique_ptr<Value> ParseValue() {
+        auto value = std::make_unique<Value>();
+        SkipSpace();
+        if (pos_ >= text_.size())
+            return nullptr;
+        switch (text_[pos_]) {
+        case '{':
+            ++pos_;
+            value->kind = Value::Kind::kObject;
+            if (Consume('}'))
+                return value;
+            do {
+                std::string key;
+                if (!ParseString(&key) || !Consume(':'))
+                    return nullptr;
+                auto member = ParseValue();
+                if (member == nullptr)
+                    return nullptr;
+                value->members.emplace_back(std::move(key), std::move(member));
+            } while (Consume(','));
+            if (!Consume('}'))
+                return nullptr;
+            return value;
+        case '[':
+            ++pos_;
+            value->kind = Value::Kind::kArray;
+            if (Consume(']'))
+                return value;
+            do {
+                auto element = ParseValue();
+                if (element == nullptr)
+                    return nullptr;
+                value->elements.push_back(std::move(element));
+            } while (Consume(','));
+            if (!Consume(']'))
+                return nullptr;
+            return value;
+        case '"':
+            value->kind = Value::Kind::kString;
+            if (!ParseString(&value->text))
+                return nullptr;
+            return value;
+        default: {
+            size_t start = pos_;
+            while (pos_ < text_.size() && text_[pos_] != ',' && text_[pos_] != '}' &&
+                   text_[pos_] != ']' && text_[pos_] != ' ' && text_[pos_] != '\n')
+                ++pos_;
+            if (pos_ == start)
+                return nullptr;
+            value->text.assign(text_, start, pos_ - start);
+            return value;
+        }
+        }
+    }
+
+    const std::string& text_;
+    size_t pos_ = 0u;
+};
+
+const char* const kDeclarationArrays[] = {
+    "bits_declarations",
+    "const_declarations",
+    "enum_declarations",
+    "interface_declarations",
+    "struct_declarations",
+    "table_declarations",
+    "union_declarations",
+    "xunion_declarations",
+};
+
+// Loads the JSON IR at |path| and looks up each of |names|, as
+// "library.name/Name", in its declarations. Returns how many it found, or
+// -1 if the IR cannot be loaded.
+int LoadJSON(const char* path, const std::vector<std::string>& names) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+    auto root = Parser(text).Parse();
+    if (root == nullptr || root->kind != Value::Kind::kObject)
+        return -1;
+
+    std::map<std::string, const Value*> decls;
+    for (const char* array : kDeclarationArrays) {
+        const Value* declarations = root->Get(array);
+        if (declarations == nullptr)
+            continue;
+        for (const auto& decl : declarations->elements) {
+            const Value* name = decl->Get("name");
+            if (name != nullptr)
+                decls.emplace(name->text, decl.get());
+        }
+    }
+    int found = 0;
+    for (const auto& name : names)
+        found += decls.count(name) != 0u ? 1 : 0;
+    return found;
+}
+
+// As LoadJSON(), for the binary IR at |path|, with |names| not qualified.
+int LoadBinary(const char* path, const std::vector<std::string>& names) {
+    fidl::ir::Reader reader;
+    std::string error;
+    if (!reader.Open(path, &error))
+        return -1;
+    int found = 0;
+    for (const auto& name : names)
+        found += reader.FindDecl(name) != nullptr ? 1 : 0;
+    return found;
+}
+
+template <typename Load>
+double Time(Load load, int iterations, int expected) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        if (load() != expected) {
+            fprintf(stderr, "Failed to load the IR\n");
+            exit(1);
+        }
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "usage: ir_bench LIBRARY.json LIBRARY.fidlir [ITERATIONS]\n");
+        return 1;
+    }
+    const char* json_path = argv[1];
+    const char* binary_path = argv[2];
+    int iterations = argc == 4 ? atoi(argv[3]) : 1000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Invalid iteration count %s\n", argv[3]);
+        return 1;
+    }
+
+    // Look up the declarations that the JSON IR lists, i.e. all of them but
+    // the messages of methods.
+    fidl::ir::Reader reader;
+    std::string error;
+    if (!reader.Open(binary_path, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::string library_name(reader.library_name());
+    std::vector<std::string> names;
+    std::vector<std::string> qualified_names;
+    for (const auto& decl : reader.decls()) {
+        if (decl.flags & fidl::ir::kDeclAnonymous)
+            continue;
+        names.emplace_back(reader.GetString(decl.name));
+        qualified_names.push_back(library_name + "/" + names.back());
+    }
+    int expected = static_cast<int>(names.size());
+
+    double json_us = Time([&]() { return LoadJSON(json_path, qualified_names); },
+                          iterations, expected);
+    double binary_us = Time([&]() { return LoadBinary(binary_path, names); },
+                            iterations, expected);
+    printf("%s: %d declarations, %d iterations\n", library_name.c_str(), expected, iterations);
+    printf("json:   %10.2f us per load\n", json_us);
+    printf("binary: %10.2f us per load\n", binary_us);
+    printf("speedup: %.1fx\n", json_us / binary_us);
+    return 0;
+}
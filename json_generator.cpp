@@ -15,7 +15,7 @@ enum ConstantStyle {
     kAsString,
 };
 
-void EmitBoolean(std::ostream* file, bool value, ConstantStyle style = kAsConstant) {
+void EmitBoolean(OutputSink* file, bool value, ConstantStyle style = kAsConstant) {
     if (style == kAsString)
         *file << "\"";
     if (value)
@@ -26,7 +26,7 @@ void EmitBoolean(std::ostream* file, bool value, ConstantStyle style = kAsConsta
         *file << "\"";
 }
 
-void EmitString(std::ostream* file, StringView value) {
+void EmitString(OutputSink* file, StringView value) {
     *file << "\"";
 
     for (size_t i = 0; i < value.size(); i++) {
@@ -49,12 +49,12 @@ void EmitString(std::ostream* file, StringView value) {
     *file << "\"";
 }
 
-void EmitLiteral(std::ostream* file, StringView value) {
-    file->rdbuf()->sputn(value.data(), value.size());
+void EmitLiteral(OutputSink* file, StringView value) {
+    file->Append(value.data(), value.size());
 }
 
 template <typename ValueType>
-void EmitNumeric(std::ostream* file, ValueType value, ConstantStyle style = kAsConstant) {
+void EmitNumeric(OutputSink* file, ValueType value, ConstantStyle style = kAsConstant) {
     static_assert(std::is_arithmetic<ValueType>::value && !std::is_same<ValueType, bool>::value,
                   "EmitNumeric can only be used with a numeric ValueType!");
     static_assert(std::is_arithmetic<ValueType>::value && !std::is_same<ValueType, uint8_t>::value,
@@ -72,99 +72,99 @@ void EmitNumeric(std::ostream* file, ValueType value, ConstantStyle style = kAsC
     }
 }
 
-void EmitUint32(std::ostream* file, uint32_t value) {
+void EmitUint32(OutputSink* file, uint32_t value) {
     *file << value;
 }
 
-void EmitNewLine(std::ostream* file) {
+void EmitNewLine(OutputSink* file) {
     *file << "\n";
 }
 
-void EmitNewlineAndIdent(std::ostream* file, int indent_level) {
+void EmitNewlineAndIdent(OutputSink* file, int indent_level) {
     *file << "\n";
     while (indent_level--)
         *file << kIndent;
 }
 
-void EmitObjectBegin(std::ostream* file) {
+void EmitObjectBegin(OutputSink* file) {
     *file << "{";
 }
 
-void EmitObjectEnd(std::ostream* file) {
+void EmitObjectEnd(OutputSink* file) {
     *file << "}";
 }
 
-void EmitObjectSeparator(std::ostream* file, int indent_level) {
+void EmitObjectSeparator(OutputSink* file, int indent_level) {
     *file << ",";
     EmitNewlineAndIdent(file, indent_level);
 }
 
-void EmitObjectKey(std::ostream* file, int indent_level, StringView key) {
+void EmitObjectKey(OutputSink* file, int indent_level, StringView key) {
     EmitString(file, key);
     *file << ": ";
 }
 
-void EmitArrayBegin(std::ostream* file) {
+void EmitArrayBegin(OutputSink* file) {
     *file << "[";
 }
 
-void EmitArraySeparator(std::ostream* file, int indent_level) {
+void EmitArraySeparator(OutputSink* file, int indent_level) {
     *file << ",";
     EmitNewlineAndIdent(file, indent_level);
 }
 
-void EmitArrayEnd(std::ostream* file) {
+void EmitArrayEnd(OutputSink* file) {
     *file << "]";
 }
 
 } // namespace
 
 void JSONGenerator::GenerateEOF() {
-    EmitNewLine(&json_file_);
+    EmitNewLine(json_file_);
 }
 
 template <typename Iterator>
 void JSONGenerator::GenerateArray(Iterator begin, Iterator end) {
-    EmitArrayBegin(&json_file_);
+    EmitArrayBegin(json_file_);
 
     if (begin != end)
-        EmitNewlineAndIdent(&json_file_, ++indent_level_);
+        EmitNewlineAndIdent(json_file_, ++indent_level_);
 
     for (Iterator it = begin; it != end; ++it) {
         if (it != begin)
-            EmitArraySeparator(&json_file_, indent_level_);
+            EmitArraySeparator(json_file_, indent_level_);
         Generate(*it);
     }
 
     // when would this ever be true?
     if (begin != end)
-        EmitNewlineAndIdent(&json_file_, --indent_level_);
+        EmitNewlineAndIdent(json_file_, --indent_level_);
 
-    EmitArrayEnd(&json_file_);
+    EmitArrayEnd(json_file_);
 }
 
 template<>
 void JSONGenerator::GenerateArray(
     std::vector<std::unique_ptr<flat::Struct>>::const_iterator begin,
     std::vector<std::unique_ptr<flat::Struct>>::const_iterator end) {
-    EmitArrayBegin(&json_file_);
+    EmitArrayBegin(json_file_);
 
     bool is_first = true;
     for (std::vector<std::unique_ptr<flat::Struct>>::const_iterator it = begin; it != end; ++it) {
         if ((*it)->anonymous)
             continue;
         if (is_first) {
-            EmitNewlineAndIdent(&json_file_, ++indent_level_);
+            EmitNewlineAndIdent(json_file_, ++indent_level_);
             is_first = false;
         } else {
-            EmitArraySeparator(&json_file_, indent_level_);
+            EmitArraySeparator(json_file_, indent_level_);
         }
         Generate(*it);
     }
     if (!is_first)
-        EmitNewlineAndIdent(&json_file_, --indent_level_);
+        EmitNewlineAndIdent(json_file_, --indent_level_);
 
-    EmitArrayEnd(&json_file_);
+    EmitArrayEnd(json_file_);
 }
 
 template <typename Collection>
@@ -175,10 +175,10 @@ void JSONGenerator::GenerateArray(const Collection& collection) {
 void JSONGenerator::GenerateObjectPunctuation(Position position) {
     switch (position) {
     case Position::kFirst:
-        EmitNewlineAndIdent(&json_file_, ++indent_level_);
+        EmitNewlineAndIdent(json_file_, ++indent_level_);
         break;
     case Position::kSubsequent:
-        EmitObjectSeparator(&json_file_, indent_level_);
+        EmitObjectSeparator(json_file_, indent_level_);
         break;
     }
 }
@@ -194,15 +194,15 @@ void JSONGenerator::Generate(const std::vector<T>& value) {
 }
 
 void JSONGenerator::Generate(bool value) {
-    EmitBoolean(&json_file_, value);
+    EmitBoolean(json_file_, value);
 }
 
 void JSONGenerator::Generate(StringView value) {
-    EmitString(&json_file_, value);
+    EmitString(json_file_, value);
 }
 
 void JSONGenerator::Generate(SourceLocation value) {
-    EmitString(&json_file_, value.data());
+    EmitString(json_file_, value.data());
 }
 
 void JSONGenerator::Generate(NameLocation value) {
@@ -214,26 +214,26 @@ void JSONGenerator::Generate(NameLocation value) {
 }
 
 void JSONGenerator::Generate(uint32_t value) {
-    EmitUint32(&json_file_, value);
+    EmitUint32(json_file_, value);
 }
 
 void JSONGenerator::Generate(types::Nullability value) {
     switch(value) {
     case types::Nullability::kNullable:
-        EmitBoolean(&json_file_, true);
+        EmitBoolean(json_file_, true);
         break;
     case types::Nullability::kNonnullable:
-        EmitBoolean(&json_file_, false);
+        EmitBoolean(json_file_, false);
         break;
     }
 }
 
 void JSONGenerator::Generate(types::PrimitiveSubtype value) {
-    EmitString(&json_file_, NamePrimitiveSubtype(value));
+    EmitString(json_file_, NamePrimitiveSubtype(value));
 }
 
 void JSONGenerator::Generate(const raw::Identifier& value) {
-    EmitString(&json_file_, value.location().data());
+    EmitString(json_file_, value.location().data());
 }
 
 void JSONGenerator::Generate(const raw::Literal& value) {
@@ -243,9 +243,9 @@ void JSONGenerator::Generate(const raw::Literal& value) {
         switch (value.kind) {
         case raw::Literal::Kind::kString: {
             auto type = static_cast<const raw::StringLiteral*>(&value);
-            EmitObjectSeparator(&json_file_, indent_level_);
-            EmitObjectKey(&json_file_, indent_level_, "value");
-            EmitLiteral(&json_file_, type->location().data());
+            EmitObjectSeparator(json_file_, indent_level_);
+            EmitObjectKey(json_file_, indent_level_, "value");
+            EmitLiteral(json_file_, type->location().data());
             break;
         }
         case raw::Literal::Kind::kNumeric: {
@@ -279,7 +279,7 @@ void JSONGenerator::Generate(const raw::AttributeList& value) {
 }
 
 void JSONGenerator::Generate(const raw::Ordinal& value) {
-    EmitNumeric(&json_file_, value.value);
+    EmitNumeric(json_file_, value.value);
 }
 
 void JSONGenerator::Generate(const flat::Constant& value) {
@@ -361,8 +361,8 @@ void JSONGenerator::Generate(const flat::Bits& value) {
         GenerateObjectMember("type", value.subtype_ctor->type);
 
         GenerateObjectPunctuation(Position::kSubsequent);
-        EmitObjectKey(&json_file_, indent_level_, "mask");
-        EmitNumeric(&json_file_, value.mask, kAsString);
+        EmitObjectKey(json_file_, indent_level_, "mask");
+        EmitNumeric(json_file_, value.mask, kAsString);
         GenerateObjectMember("members", value.members);
     });
 }
@@ -583,16 +583,16 @@ void JSONGenerator::Generate(const flat::Library* library) {
 
 void JSONGenerator::GenerateDeclarationsEntry(int count, const flat::Name& name, StringView decl) {
     if (count == 0)
-        EmitNewlineAndIdent(&json_file_, ++indent_level_);
+        EmitNewlineAndIdent(json_file_, ++indent_level_);
     else
-        EmitObjectSeparator(&json_file_, indent_level_);
-    EmitObjectKey(&json_file_, indent_level_, NameName(name, ".", "/"));
-    EmitString(&json_file_, decl);
+        EmitObjectSeparator(json_file_, indent_level_);
+    EmitObjectKey(json_file_, indent_level_, NameName(name, ".", "/"));
+    EmitString(json_file_, decl);
 }
 
 void JSONGenerator::GenerateDeclarationsMember(const flat::Library* library, Position position) {
     GenerateObjectPunctuation(position);
-    EmitObjectKey(&json_file_, indent_level_, "declarations");
+    EmitObjectKey(json_file_, indent_level_, "declarations");
     GenerateObject([&]() {
         int count = 0;
         for (const auto& decl : library->const_declarations_)
@@ -609,7 +609,7 @@ void JSONGenerator::GenerateDeclarationsMember(const flat::Library* library, Pos
 template <typename Type>
 void JSONGenerator::GenerateObjectMember(StringView key, const Type& value, Position position) {
     GenerateObjectPunctuation(position);
-    EmitObjectKey(&json_file_, indent_level_, key);
+    EmitObjectKey(json_file_, indent_level_, key);
     Generate(value);
 }
 
@@ -617,18 +617,19 @@ template <typename Callback>
 void JSONGenerator::GenerateObject(Callback callback) {
     int original_indent_level = indent_level_;
 
-    EmitObjectBegin(&json_file_);
+    EmitObjectBegin(json_file_);
 
     callback();
 
     // shouldn't this be an error?
     if (indent_level_ > original_indent_level)
-        EmitNewlineAndIdent(&json_file_, --indent_level_);
+        EmitNewlineAndIdent(json_file_, --indent_level_);
 
-    EmitObjectEnd(&json_file_);
+    EmitObjectEnd(json_file_);
 }
 
-std::ostringstream JSONGenerator::Produce() {
+void JSONGenerator::Produce(OutputSink* json_file) {
+    json_file_ = json_file;
     indent_level_ = 0;
     GenerateObject([&]() {
         GenerateObjectMember("version", StringView("0.0.1"), Position::kFirst);
@@ -664,7 +665,6 @@ std::ostringstream JSONGenerator::Produce() {
         GenerateDeclarationsMember(library_);
     });
     GenerateEOF();
-    return std::move(json_file_);
 } 
 
 } // namespace fidl
@@ -2,11 +2,11 @@
 #define JSON_GENERATOR_H_
 
 #include <memory>
-#include <sstream>
 #include <string>
 #include <vector>
 
 #include "flat_ast.h"
+#include "output_sink.h"
 #include "string_view.h"
 
 namespace fidl {
@@ -28,7 +28,7 @@ public:
 
     ~JSONGenerator() = default;
 
-    std::ostringstream Produce();
+    void Produce(OutputSink* json_file);
 
 private:
     enum class Position {
@@ -101,7 +101,7 @@ private:
 
     const flat::Library* library_;
     int indent_level_;
-    std::ostringstream json_file_;
+    OutputSink* json_file_ = nullptr;
 };
 
 } // namespace fidl
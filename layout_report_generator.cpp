@@ -0,0 +1,387 @@
+#include "layout_report_generator.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "c_generator.h"
+#include "names.h"
+
+namespace fidl {
+
+namespace {
+
+constexpr const char* kIndent = "  ";
+
+// Returns the bound of the [MaxBytes] attribute in |attributes|, or 0 if
+// there is none. The bound has already been validated during compilation.
+// This does not use utils::ParseNumeric(), which calls setlocale() and so
+// must not run alongside the other generators.
+uint32_t MaxBytesBudget(const raw::AttributeList* attributes) {
+    if (attributes == nullptr)
+        return 0u;
+    for (const auto& attribute : attributes->attributes) {
+        if (attribute->name != "MaxBytes")
+            continue;
+        return static_cast<uint32_t>(strtoul(attribute->value.data(), nullptr, 10));
+    }
+    return 0u;
+}
+
+// Tables store each present field out of line in an envelope, which is
+// padded to the next 8 byte boundary.
+uint32_t EnvelopePadding(uint64_t size) {
+    return static_cast<uint32_t>((8u - size % 8u) % 8u);
+}
+
+// The size of an fidl_envelope_t in a table's vector of envelopes.
+constexpr uint32_t kEnvelopeSize = 16u;
+
+enum class Alignment {
+    kLeft,
+    kRight,
+};
+
+// Pads |value| with spaces to |width| characters.
+void EmitColumn(OutputSink* file, StringView value, size_t width,
+                Alignment alignment = Alignment::kRight) {
+    std::string padding(value.size() < width ? width - value.size() : 0u, ' ');
+    if (alignment == Alignment::kRight)
+        *file << padding;
+    *file << value;
+    if (alignment == Alignment::kLeft)
+        *file << padding;
+}
+
+void EmitString(OutputSink* file, StringView value) {
+    *file << "\"";
+    for (size_t i = 0; i < value.size(); i++) {
+        const char c = value[i];
+        switch (c) {
+            case '"':
+                *file << "\\\"";
+                break;
+            case '\\':
+                *file << "\\\\";
+                break;
+            default:
+                *file << c;
+                break;
+        }
+    }
+    *file << "\"";
+}
+
+} // namespace
+
+uint64_t LayoutReportGenerator::Entry::MaxBytes() const {
+    return static_cast<uint64_t>(typeshape.Size()) + typeshape.MaxOutOfLine();
+}
+
+uint64_t LayoutReportGenerator::Entry::TotalPadding() const {
+    uint64_t total = 0u;
+    for (const auto& field : fields) {
+        total += field.padding;
+    }
+    return total;
+}
+
+void LayoutReportGenerator::AddEntry(std::string kind, const flat::TypeDecl& decl,
+                                     std::vector<Field> fields) {
+    Entry entry;
+    entry.kind = std::move(kind);
+    entry.name = NameName(decl.name, ".", "/");
+    entry.typeshape = decl.typeshape;
+    entry.fields = std::move(fields);
+    entry.c_fast_path = FastPath::kNotApplicable;
+    entry.max_bytes_budget = MaxBytesBudget(decl.attributes.get());
+    entries_.push_back(std::move(entry));
+}
+
+void LayoutReportGenerator::AddStruct(const flat::Struct& struct_decl) {
+    std::vector<Field> fields;
+    for (const auto& member : struct_decl.members) {
+        fields.push_back(Field{
+            NameIdentifier(member.name),
+            member.fieldshape.Offset(),
+            member.fieldshape.Size(),
+            member.fieldshape.Padding(),
+        });
+    }
+    AddEntry("struct", struct_decl, std::move(fields));
+}
+
+void LayoutReportGenerator::AddTable(const flat::Table& table_decl) {
+    std::vector<Field> fields;
+    for (const auto& member : table_decl.members) {
+        if (!member.maybe_used)
+            continue;
+        // A field is reported at the offset of its envelope in the table's
+        // vector of envelopes, with the size of the envelope's contents: the
+        // field itself and its out-of-line objects.
+        const auto& typeshape = member.maybe_used->typeshape;
+        uint64_t contents_size =
+            static_cast<uint64_t>(typeshape.Size()) + typeshape.MaxOutOfLine();
+        fields.push_back(Field{
+            NameIdentifier(member.maybe_used->name),
+            (member.ordinal->value - 1u) * kEnvelopeSize,
+            static_cast<uint32_t>(std::min<uint64_t>(contents_size,
+                                                     std::numeric_limits<uint32_t>::max())),
+            EnvelopePadding(contents_size),
+        });
+    }
+    AddEntry("table", table_decl, std::move(fields));
+}
+
+void LayoutReportGenerator::AddUnion(const flat::Union& union_decl) {
+    std::vector<Field> fields;
+    for (const auto& member : union_decl.members) {
+        fields.push_back(Field{
+            NameIdentifier(member.name),
+            member.fieldshape.Offset(),
+            member.fieldshape.Size(),
+            member.fieldshape.Padding(),
+        });
+    }
+    AddEntry("union", union_decl, std::move(fields));
+}
+
+void LayoutReportGenerator::AddXUnion(const flat::XUnion& xunion_decl) {
+    std::vector<Field> fields;
+    for (const auto& member : xunion_decl.members) {
+        fields.push_back(Field{
+            NameIdentifier(member.name),
+            member.fieldshape.Offset(),
+            member.fieldshape.Size(),
+            member.fieldshape.Padding(),
+        });
+    }
+    AddEntry("xunion", xunion_decl, std::move(fields));
+}
+
+void LayoutReportGenerator::AddInterface(const flat::Interface& interface_decl) {
+    // The C bindings are only generated for interfaces with a simple layout.
+    bool has_c_bindings = HasSimpleLayout(&interface_decl);
+    uint32_t interface_budget = MaxBytesBudget(interface_decl.attributes.get());
+    std::string interface_name = NameName(interface_decl.name, ".", "/");
+
+    auto add_message = [&](const flat::Interface::Method& method,
+                           const flat::Struct& message,
+                           std::string kind) {
+        Entry entry;
+        entry.kind = std::move(kind);
+        entry.name = interface_name + "." + NameIdentifier(method.name);
+        entry.typeshape = message.typeshape;
+        for (const auto& member : message.members) {
+            entry.fields.push_back(Field{
+                NameIdentifier(member.name),
+                member.fieldshape.Offset(),
+                member.fieldshape.Size(),
+                member.fieldshape.Padding(),
+            });
+        }
+        if (has_c_bindings) {
+            entry.c_fast_path = CGenerator::IsPODMessage(library_, interface_decl, message)
+                ? FastPath::kYes : FastPath::kNo;
+        } else {
+            entry.c_fast_path = FastPath::kNotApplicable;
+        }
+        entry.max_bytes_budget = MaxBytesBudget(method.attributes.get());
+        if (entry.max_bytes_budget == 0u)
+            entry.max_bytes_budget = interface_budget;
+        entries_.push_back(std::move(entry));
+    };
+
+    for (const auto method_pointer : interface_decl.all_methods) {
+        const auto& method = *method_pointer;
+        if (method.maybe_request != nullptr)
+            add_message(method, *method.maybe_request, "request");
+        if (method.maybe_response != nullptr)
+            add_message(method, *method.maybe_response,
+                        method.maybe_request != nullptr ? "response" : "event");
+    }
+}
+
+void LayoutReportGenerator::GenerateText() {
+    EmitColumn(report_file_, "kind", 10u, Alignment::kLeft);
+    EmitColumn(report_file_, "size", 12u);
+    EmitColumn(report_file_, "align", 7u);
+    EmitColumn(report_file_, "depth", 12u);
+    EmitColumn(report_file_, "handles", 12u);
+    EmitColumn(report_file_, "out_of_line", 12u);
+    EmitColumn(report_file_, "max_bytes", 12u);
+    EmitColumn(report_file_, "budget", 12u);
+    EmitColumn(report_file_, "padding", 9u);
+    EmitColumn(report_file_, "pod", 6u);
+    *report_file_ << "  name\n";
+    for (const auto& entry : entries_) {
+        EmitColumn(report_file_, entry.kind, 10u, Alignment::kLeft);
+        EmitColumn(report_file_, std::to_string(entry.typeshape.Size()), 12u);
+        EmitColumn(report_file_, std::to_string(entry.typeshape.Alignment()), 7u);
+        EmitColumn(report_file_, std::to_string(entry.typeshape.Depth()), 12u);
+        EmitColumn(report_file_, std::to_string(entry.typeshape.MaxHandles()), 12u);
+        EmitColumn(report_file_, std::to_string(entry.typeshape.MaxOutOfLine()), 12u);
+        EmitColumn(report_file_, std::to_string(entry.MaxBytes()), 12u);
+        if (entry.max_bytes_budget != 0u)
+            EmitColumn(report_file_, std::to_string(entry.max_bytes_budget), 12u);
+        else
+            EmitColumn(report_file_, "-", 12u);
+        EmitColumn(report_file_, std::to_string(entry.TotalPadding()), 9u);
+        switch (entry.c_fast_path) {
+        case FastPath::kNotApplicable:
+            EmitColumn(report_file_, "-", 6u);
+            break;
+        case FastPath::kYes:
+            EmitColumn(report_file_, "yes", 6u);
+            break;
+        case FastPath::kNo:
+            EmitColumn(report_file_, "no", 6u);
+            break;
+        }
+        *report_file_ << "  " << entry.name << "\n";
+        for (const auto& field : entry.fields) {
+            if (field.padding == 0u)
+                continue;
+            EmitColumn(report_file_, "", 10u);
+            *report_file_ << "  " << field.name << ": " << field.padding
+                          << " padding byte" << (field.padding == 1u ? "" : "s")
+                          << " after offset " << field.offset << " + " << field.size << "\n";
+        }
+    }
+}
+
+void LayoutReportGenerator::GenerateJSON() {
+    *report_file_ << "[";
+    bool first_entry = true;
+    for (const auto& entry : entries_) {
+        *report_file_ << (first_entry ? "\n" : ",\n");
+        first_entry = false;
+        *report_file_ << kIndent << "{\n";
+        *report_file_ << kIndent << kIndent << "\"kind\": ";
+        EmitString(report_file_, entry.kind);
+        *report_file_ << ",\n" << kIndent << kIndent << "\"name\": ";
+        EmitString(report_file_, entry.name);
+        *report_file_ << ",\n" << kIndent << kIndent << "\"size\": " << entry.typeshape.Size();
+        *report_file_ << ",\n" << kIndent << kIndent << "\"alignment\": " << entry.typeshape.Alignment();
+        *report_file_ << ",\n" << kIndent << kIndent << "\"depth\": " << entry.typeshape.Depth();
+        *report_file_ << ",\n" << kIndent << kIndent << "\"max_handles\": " << entry.typeshape.MaxHandles();
+        *report_file_ << ",\n" << kIndent << kIndent << "\"max_out_of_line\": " << entry.typeshape.MaxOutOfLine();
+        *report_file_ << ",\n" << kIndent << kIndent << "\"max_bytes\": " << entry.MaxBytes();
+        *report_file_ << ",\n" << kIndent << kIndent << "\"max_bytes_budget\": ";
+        if (entry.max_bytes_budget != 0u)
+            *report_file_ << entry.max_bytes_budget;
+        else
+            *report_file_ << "null";
+        *report_file_ << ",\n" << kIndent << kIndent << "\"padding\": " << entry.TotalPadding();
+        *report_file_ << ",\n" << kIndent << kIndent << "\"c_pod_message\": ";
+        switch (entry.c_fast_path) {
+        case FastPath::kNotApplicable:
+            *report_file_ << "null";
+            break;
+        case FastPath::kYes:
+            *report_file_ << "true";
+            break;
+        case FastPath::kNo:
+            *report_file_ << "false";
+            break;
+        }
+        *report_file_ << ",\n" << kIndent << kIndent << "\"fields\": [";
+        bool first_field = true;
+        for (const auto& field : entry.fields) {
+            *report_file_ << (first_field ? "\n" : ",\n");
+            first_field = false;
+            *report_file_ << kIndent << kIndent << kIndent << "{\"name\": ";
+            EmitString(report_file_, field.name);
+            *report_file_ << ", \"offset\": " << field.offset
+                          << ", \"size\": " << field.size
+                          << ", \"padding\": " << field.padding << "}";
+        }
+        if (!first_field)
+            *report_file_ << "\n" << kIndent << kIndent;
+        *report_file_ << "]\n" << kIndent << "}";
+    }
+    *report_file_ << "\n]\n";
+}
+
+void LayoutReportGenerator::GenerateCSV() {
+    *report_file_ << "kind,name,size,alignment,depth,max_handles,max_out_of_line,"
+                     "max_bytes,max_bytes_budget,padding,c_pod_message,field_padding\n";
+    for (const auto& entry : entries_) {
+        *report_file_ << entry.kind << ","
+                      << entry.name << ","
+                      << entry.typeshape.Size() << ","
+                      << entry.typeshape.Alignment() << ","
+                      << entry.typeshape.Depth() << ","
+                      << entry.typeshape.MaxHandles() << ","
+                      << entry.typeshape.MaxOutOfLine() << ","
+                      << entry.MaxBytes() << ",";
+        if (entry.max_bytes_budget != 0u)
+            *report_file_ << entry.max_bytes_budget;
+        *report_file_ << "," << entry.TotalPadding() << ",";
+        switch (entry.c_fast_path) {
+        case FastPath::kNotApplicable:
+            break;
+        case FastPath::kYes:
+            *report_file_ << "true";
+            break;
+        case FastPath::kNo:
+            *report_file_ << "false";
+            break;
+        }
+        *report_file_ << ",";
+        // Only fields followed by padding are listed, as name=bytes pairs.
+        bool first_field = true;
+        for (const auto& field : entry.fields) {
+            if (field.padding == 0u)
+                continue;
+            if (!first_field)
+                *report_file_ << ";";
+            first_field = false;
+            *report_file_ << field.name << "=" << field.padding;
+        }
+        *report_file_ << "\n";
+    }
+}
+
+void LayoutReportGenerator::Produce(OutputSink* report_file) {
+    report_file_ = report_file;
+    for (const auto& struct_decl : library_->struct_declarations_) {
+        // Method parameters are reported with their interface.
+        if (struct_decl->anonymous)
+            continue;
+        AddStruct(*struct_decl);
+    }
+    for (const auto& table_decl : library_->table_declarations_) {
+        AddTable(*table_decl);
+    }
+    for (const auto& union_decl : library_->union_declarations_) {
+        AddUnion(*union_decl);
+    }
+    for (const auto& xunion_decl : library_->xunion_declarations_) {
+        AddXUnion(*xunion_decl);
+    }
+    for (const auto& interface_decl : library_->interface_declarations_) {
+        AddInterface(*interface_decl);
+    }
+
+    std::stable_sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+        if (a.MaxBytes() != b.MaxBytes())
+            return a.MaxBytes() > b.MaxBytes();
+        return a.name < b.name;
+    });
+
+    switch (format_) {
+    case Format::kText:
+        GenerateText();
+        break;
+    case Format::kJSON:
+        GenerateJSON();
+        break;
+    case Format::kCSV:
+        GenerateCSV();
+        break;
+    }
+}
+
+} // namespace fidl
@@ -0,0 +1,79 @@
+#ifndef LAYOUT_REPORT_GENERATOR_H_
+#define LAYOUT_REPORT_GENERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "flat_ast.h"
+#include "output_sink.h"
+#include "string_view.h"
+
+namespace fidl {
+
+// Produces a report of the wire layout of every struct, table, union, xunion
+// and method message in a library: its typeshape, how many of its bytes are
+// padding, and whether the C bindings can skip encoding and decoding it.
+// Entries are sorted by their maximum size on the wire, largest first.
+class LayoutReportGenerator {
+public:
+    enum class Format {
+        kText,
+        kJSON,
+        kCSV,
+    };
+
+    LayoutReportGenerator(const flat::Library* library, Format format)
+        : library_(library), format_(format) {}
+
+    ~LayoutReportGenerator() = default;
+
+    void Produce(OutputSink* report_file);
+
+private:
+    struct Field {
+        std::string name;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t padding;
+    };
+
+    enum class FastPath {
+        kNotApplicable,
+        kYes,
+        kNo,
+    };
+
+    struct Entry {
+        std::string kind;
+        std::string name;
+        TypeShape typeshape;
+        std::vector<Field> fields;
+        // Set for method messages of interfaces that have C bindings.
+        FastPath c_fast_path;
+        // The bound from the [MaxBytes] attribute, or 0 if there is none.
+        uint32_t max_bytes_budget;
+
+        uint64_t MaxBytes() const;
+        uint64_t TotalPadding() const;
+    };
+
+    void AddEntry(std::string kind, const flat::TypeDecl& decl, std::vector<Field> fields);
+    void AddStruct(const flat::Struct& struct_decl);
+    void AddTable(const flat::Table& table_decl);
+    void AddUnion(const flat::Union& union_decl);
+    void AddXUnion(const flat::XUnion& xunion_decl);
+    void AddInterface(const flat::Interface& interface_decl);
+
+    void GenerateText();
+    void GenerateJSON();
+    void GenerateCSV();
+
+    const flat::Library* library_;
+    const Format format_;
+    std::vector<Entry> entries_;
+    OutputSink* report_file_ = nullptr;
+};
+
+} // namespace fidl
+
+#endif // LAYOUT_REPORT_GENERATOR_H_
@@ -289,6 +289,8 @@ Token Lexer::Lex() {
                 msg.append(location.data());
                 msg.append("'");
                 error_reporter_->ReportError(location, msg);
+                if (error_reporter_->LimitReached())
+                    return LexEndOfStream();
                 continue;
             }
             } // switch
@@ -331,6 +333,10 @@ Token Lexer::Lex() {
             msg.append(location.data());
             msg.append("'");
             error_reporter_->ReportError(location, msg);
+            // Past --max-errors, the rest of the file is treated as ended,
+            // so that the parser stops instead of reading more tokens.
+            if (error_reporter_->LimitReached())
+                return LexEndOfStream();
             continue;
         }
         } // switch
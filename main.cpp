@@ -1,6 +1,27 @@
-#include <fstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <map>
+#include <sstream>
+#include <thread>
 #include <vector>
 
 #include "flat_ast.h"
@@ -8,34 +29,175 @@
 #include "names.h"
 #include "parser.h"
 #include "source_manager.h"
+#include "utils.h"
+#include "abi_fingerprint_generator.h"
+#include "binary_ir_generator.h"
 #include "c_generator.h"
+#include "compile_server.h"
+#include "cpp_generator.h"
 #include "json_generator.h"
+#include "layout_report_generator.h"
+#include "output_cache.h"
+#include "output_sink.h"
+#include "sha256.h"
+#include "tables_generator.h"
 
 namespace {
 
 void Usage() {
     std::cout
         << "usage: fidlc [--c-header HEADER_PATH]\n"
+           "             [--c-header-dir HEADER_DIR]\n"
            "             [--json JSON_PATH]\n"
+           "             [--binary-ir BINARY_IR_PATH]\n"
+           "             [--abi-fingerprint FINGERPRINT_PATH]\n"
+           "             [--tables TABLES_PATH]\n"
+           "             [--c-coding tables|inline]\n"
+           "             [--c-codegen speed|size]\n"
+           "             [--c-bench BENCH_PATH]\n"
+           "             [--method-profile PROFILE_PATH]\n"
+           "             [--cpp-header HEADER_PATH]\n"
+           "             [--cpp-source SOURCE_PATH]\n"
+           "             [--layout-report REPORT_PATH]\n"
+           "             [--layout-report-format text|json|csv]\n"
+           "             [--roots protocols|NAME[,NAME...]]\n"
            "             [--name LIBRARY_NAME]\n"
            "             [--werror]\n"
+           "             [--max-errors N]\n"
+           "             [--diagnostics-format text|json]\n"
+           "             [--binary-ir-dep BINARY_IR_PATH]\n"
+           "             [--cache-dir CACHE_DIR]\n"
            "             [--files [FIDL_FILE...]...]\n"
            "             [--help]\n"
+           "       fidlc --batch MANIFEST_PATH [--werror] [--max-errors N]\n"
+           "             [--diagnostics-format text|json]\n"
+           "       fidlc --server SOCKET_PATH\n"
+           "       fidlc --connect SOCKET_PATH [ARGUMENTS...]\n"
            "\n"
            " * `--c-header HEADER_PATH`. If present, this flag instructs `fidlc` to output\n"
            "   a C header at the given path.\n"
            "\n"
+           " * `--c-header-dir HEADER_DIR`. If present, this flag instructs `fidlc` to\n"
+           "   output the C header split into several in the given directory, which is\n"
+           "   the one that <library/path/c/fidl.h> is found in: a header per protocol,\n"
+           "   named after it, with its messages and bindings and the types that only it\n"
+           "   uses; a `types_HASH.h` header for each group of types that the same\n"
+           "   protocols share; `types.h` for the types that no protocol uses; and\n"
+           "   `fidl.h`, which includes all of them. Translation units that include a\n"
+           "   protocol's header only parse the declarations that it uses.\n"
+           "\n"
            " * `--c-client CLIENT_PATH`. If present, this flag instructs `fidlc` to output\n"
-           "   the simple C client implementation at the given path.\n"
+           "   the simple C client implementation at the given path. Besides allocating\n"
+           "   its buffers on the stack, each method has a `_caller_alloc` flavor that\n"
+           "   takes an 8-byte aligned byte buffer and a handle buffer, which can be\n"
+           "   reused from call to call and sized with the `_MAX_NUM_BYTES` and\n"
+           "   `_MAX_NUM_HANDLES` constants that the C header defines for each message.\n"
+           "   Methods with a response also have a `_view` flavor, which decodes the\n"
+           "   response in place in that byte buffer and returns a pointer to it, rather\n"
+           "   than copying its members out, and a `_begin` flavor, which sends the\n"
+           "   request with a caller-assigned transaction id without waiting for the\n"
+           "   response. The responses of any number of outstanding `_begin` calls are\n"
+           "   read in batches and passed to per-method callbacks by the protocol's\n"
+           "   `_dispatch_responses` function.\n"
            "\n"
            " * `--c-server SERVER_PATH`. If present, this flag instructs `fidlc` to output\n"
-           "   the simple C server implementation at the given path.\n"
+           "   the simple C server implementation at the given path. Requests with no\n"
+           "   out-of-line objects, handles or padding are passed to the ops as received,\n"
+           "   once their size is checked, and requests with a few out-of-line objects\n"
+           "   are validated by a decoder generated for them rather than by fidl_decode().\n"
+           "\n"
+           " * `--c-bench BENCH_PATH`. If present, this flag instructs `fidlc` to output\n"
+           "   a C program that times building, encoding, decoding and copying out each\n"
+           "   request and response of the library's simple protocols, as the C client\n"
+           "   and server do, and prints the minimum, median, mean and 99th percentile\n"
+           "   of each phase. Vectors and strings are filled to their bounds, and\n"
+           "   nullable members are present on every other iteration. It is linked with\n"
+           "   the --tables output and the host runtime, and honors --c-coding.\n"
+           "\n"
+           " * `--c-coding tables|inline`. Selects how the C client and server encode\n"
+           "   and decode messages that they cannot send as plain bytes: by calling\n"
+           "   fidl_encode() and fidl_decode() with the coding tables from --tables\n"
+           "   (`tables`, the default), or by calling an encode and a decode function\n"
+           "   generated for each message, with the offsets of its members and the bounds\n"
+           "   of its vectors and strings written into the code (`inline`). With\n"
+           "   `tables` and `--c-codegen speed`, the server still decodes requests with\n"
+           "   up to 4 out-of-line objects with generated decoders rather than tables.\n"
+           "\n"
+           " * `--c-codegen speed|size`. Selects how the C client methods and server\n"
+           "   replies build, send and receive messages: with code generated for each\n"
+           "   method (`speed`, the default), or by passing pointers to their arguments,\n"
+           "   and a descriptor of each message's parameters, to the routines of\n"
+           "   <lib/fidl/stubs.h> (`size`), which makes each method a few instructions\n"
+           "   long. Methods of protocols over sockets, and methods whose messages carry\n"
+           "   tables or extensible unions, are still generated for speed. `size`\n"
+           "   requires `--c-coding tables`.\n"
+           "\n"
+           " * `--method-profile PROFILE_PATH`. If present, the C server is laid out\n"
+           "   according to the call counts in the given file, which has one\n"
+           "   `Protocol.Method count` line per method, with `#` starting a comment.\n"
+           "   Protocol names may be qualified as `library.name/Protocol`. Each protocol\n"
+           "   that the profile covers dispatches its methods hottest first, and the\n"
+           "   handlers of methods called less than once for every 100 calls of its\n"
+           "   hottest one, or not at all, are moved into separate cold functions. Error\n"
+           "   checks are marked unlikely, and replies are marked hot or cold.\n"
+           "\n"
+           " * `--cpp-header HEADER_PATH`. If present, this flag instructs `fidlc` to\n"
+           "   output a C++17 header at the given path, meant to be included as\n"
+           "   <library/path/cpp/fidl.h>. It declares a natural type for each declaration,\n"
+           "   which stores bounded strings and vectors inline when their bound is small\n"
+           "   and owns handles with the move-only fidl::Handle, and for each protocol a\n"
+           "   class with a synchronous client, a server interface, and functions that\n"
+           "   dispatch requests and send replies and events. Clients and servers encode\n"
+           "   messages straight into buffers that the caller provides, at the offsets\n"
+           "   that fidlc computed, without allocating, and pass strings and vectors of\n"
+           "   numbers as views of the message. The header depends on the runtime in\n"
+           "   <lib/fidl/cpp/bindings.h>.\n"
+           "\n"
+           " * `--cpp-source SOURCE_PATH`. If present, this flag instructs `fidlc` to\n"
+           "   output the implementation of the C++ header at the given path.\n"
            "\n"
            " * `--json JSON_PATH`. If present, this flag instructs `fidlc` to output the\n"
            "   library's intermediate representation at the given path. The intermediate\n"
            "   representation is JSON that conforms to the schema available via --json-schema.\n"
            "   The intermediate representation is used as input to the various backends.\n"
            "\n"
+           " * `--binary-ir BINARY_IR_PATH`. If present, this flag instructs `fidlc` to\n"
+           "   output the same intermediate representation as `--json` at the given path,\n"
+           "   in the versioned binary format of binary_ir.h: tables of little-endian\n"
+           "   records with offsets, an index of the declarations, and the typeshapes\n"
+           "   fidlc computed. It is meant to be mapped into memory and read in place\n"
+           "   with the reader in binary_ir_reader.h.\n"
+           "\n"
+           " * `--abi-fingerprint FINGERPRINT_PATH`. If present, this flag instructs `fidlc`\n"
+           "   to output the library's ABI fingerprint at the given path: a SHA-256 digest,\n"
+           "   in hexadecimal, of the names, types, shapes, ordinals, constant values and\n"
+           "   attributes of its declarations. Doc comments, formatting, and the order of\n"
+           "   declarations do not change it, so dependents can rebuild only when it does.\n"
+           "\n"
+           " * `--tables TABLES_PATH`. If present, this flag instructs `fidlc` to output\n"
+           "   the coding tables that the C client and server pass to fidl_encode() and\n"
+           "   fidl_decode() at the given path. Fields that need no encoding or decoding,\n"
+           "   such as integers, enums and arrays of them, are left out of the tables.\n"
+           "\n"
+           " * `--layout-report REPORT_PATH`. If present, this flag instructs `fidlc` to\n"
+           "   output a report of the wire layout of the library's structs, tables, unions,\n"
+           "   xunions and method messages at the given path: their size, alignment, depth,\n"
+           "   maximum handle and out-of-line counts, padding bytes by field, [MaxBytes]\n"
+           "   budget, and whether the simple C bindings send them without encoding. Entries\n"
+           "   are sorted by maximum size on the wire, largest first. Message sizes exclude\n"
+           "   the transactional message header.\n"
+           "\n"
+           " * `--layout-report-format text|json|csv`. Selects the format of the layout\n"
+           "   report. Defaults to `text`.\n"
+           "\n"
+           " * `--roots protocols|NAME[,NAME...]`. If present, the outputs only include\n"
+           "   the declarations that are reachable from the given roots, by following the\n"
+           "   types, constants and protocols that each declaration names: from every\n"
+           "   protocol of the library (`protocols`), or from the listed declarations.\n"
+           "   Names may be qualified with the library's, as in `fidl.examples.echo/Echo`.\n"
+           "   The other declarations are left out of the C and C++ bindings, the coding\n"
+           "   tables, the JSON IR and the layout report.\n"
+           "\n"
            " * `--name LIBRARY_NAME`. If present, this flag instructs `fidlc` to validate\n"
            "   that the library being compiled has the given name. This flag is useful to\n"
            "   cross-check between the library's declaration in a build system and the\n"
@@ -47,8 +209,50 @@ void Usage() {
            "   libraries able to use declarations from preceding libraries but not vice versa.\n"
            "   Output is only generated for the final library, not for each of its dependencies.\n"
            "\n"
+           " * `--binary-ir-dep BINARY_IR_PATH`. Loads a dependency from the binary IR that\n"
+           "   an earlier `fidlc --binary-ir` wrote at the given path, rather than compiling\n"
+           "   it from its sources with `--files`. May be repeated. The libraries are loaded\n"
+           "   in order, before those of `--files`, so each must follow its dependencies.\n"
+           "\n"
+           " * `--cache-dir CACHE_DIR`. Caches the outputs of successful runs in the given\n"
+           "   directory, which is created if it does not exist, under a digest of the\n"
+           "   compiler, the flags other than the paths of outputs, and the contents of\n"
+           "   every file read. A later run with the same digest writes the cached outputs\n"
+           "   and prints the cached warnings without compiling anything. Entries are\n"
+           "   written atomically, so one directory can be shared by concurrent runs, and\n"
+           "   are never removed.\n"
+           "\n"
+           " * `--batch MANIFEST_PATH`. Compiles every target of the manifest at the given\n"
+           "   path in one run. Each line of the manifest, but for blank ones and those\n"
+           "   starting with `#`, is a target, with the arguments of a run of `fidlc`: its\n"
+           "   outputs and their flags, and its `--binary-ir-dep` and `--files`. Each\n"
+           "   library, as named by the paths of its sources or of its binary IR, is\n"
+           "   compiled once, and shared by every target that lists it, so libraries must\n"
+           "   have a single set of sources. The outputs of all the targets are produced\n"
+           "   in parallel. A target that fails leaves the others to be output, and makes\n"
+           "   the run fail. `--roots` cannot be used in a manifest.\n"
+           "\n"
+           " * `--server SOCKET_PATH`. Instead of compiling anything, runs a server that\n"
+           "   listens on a Unix socket at the given path and compiles for `--connect`\n"
+           "   clients until it is killed. It keeps the libraries that each run depends\n"
+           "   on, in every `--files` group but the last, compiled in memory, and compiles\n"
+           "   them again only once their sources change.\n"
+           "\n"
+           " * `--connect SOCKET_PATH`. Must come first. Has the server at the given path\n"
+           "   run `fidlc` with the rest of the arguments, in the current directory, and\n"
+           "   exits as that run does. The outputs and diagnostics are the same as those of\n"
+           "   a run without a server, which is what happens if none is listening.\n"
+           "\n"
            " * `--werror`. Treats warnings as errors.\n"
            "\n"
+           " * `--max-errors N`. Stops compiling once N errors have been reported, and only\n"
+           "   prints those. Defaults to 0, meaning no limit.\n"
+           "\n"
+           " * `--diagnostics-format text|json`. Selects how errors and warnings are\n"
+           "   printed to stderr: as `file:line:col: error: message` followed by the\n"
+           "   source line (`text`, the default), or as a JSON array of objects with\n"
+           "   `kind`, `path`, `line`, `column`, `length` and `message` members (`json`).\n"
+           "\n"
            " * `--help`. Prints this help, and exit immediately.\n"
            "\n"
            "All of the arguments can also be provided via a response file, denoted as\n"
@@ -61,11 +265,32 @@ void Usage() {
     std::cout.flush();
 }
 
+// Settings of the generators, which apply to all the outputs that use them.
+struct GeneratorOptions {
+    fidl::CGenerator::Coding c_coding = fidl::CGenerator::Coding::kTables;
+    fidl::CGenerator::Codegen c_codegen = fidl::CGenerator::Codegen::kSpeed;
+    // Empty unless --method-profile was given.
+    fidl::CGenerator::MethodProfile method_profile;
+    fidl::LayoutReportGenerator::Format layout_report_format =
+        fidl::LayoutReportGenerator::Format::kText;
+    // Set by --roots. If |roots| is empty, every protocol is a root.
+    bool retain_reachable = false;
+    std::vector<std::string> roots;
+};
+
 enum class Behavior {
     kCHeader,
+    kCHeaderDir,
     kCClient,
     kCServer,
+    kCBench,
+    kCppHeader,
+    kCppSource,
     kJSON,
+    kBinaryIR,
+    kAbiFingerprint,
+    kTables,
+    kLayoutReport,
 };
 
 [[noreturn]] void FailWithUsage(const char* message, ...) {
@@ -85,14 +310,30 @@ enum class Behavior {
     exit(1);
 }
 
-std::fstream Open(std::string filename, std::ios::openmode mode) {
+// Creates |path|, and its parents, if they do not exist yet.
+int OpenDirectory(std::string path) {
+    for (size_t end = path.find('/', 1u);; end = path.find('/', end + 1u)) {
+        std::string prefix = path.substr(0u, end);
+        if (mkdir(prefix.data(), 0777) < 0 && errno != EEXIST) {
+            Fail("Could not create directory: %s\n", prefix.data());
+        }
+        if (end == std::string::npos)
+            break;
+    }
+    int fd = open(path.data(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        Fail("Could not open directory: %s\n", path.data());
+    }
+    return fd;
+}
+
+int Open(std::string filename) {
     // TODO: create parent dirs if they don't exist
-    std::fstream stream;
-    stream.open(filename, mode);
-    if (!stream.is_open()) {
+    int fd = open(filename.data(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
         Fail("Could not open file: %s\n", filename.data());
     }
-    return stream;
+    return fd;
 }
 
 class Arguments {
@@ -140,43 +381,401 @@ bool Parse(const fidl::SourceFile& source_file,
   return true;
 }
 
-void Write(std::ostringstream output, std::fstream file) {
-  file << output.str();
-  file.flush();
+// Writes |contents| to |fd|, and closes it. Returns 0, or the errno of the
+// write that failed.
+int WriteOutput(int fd, const std::string& contents) {
+  fidl::OutputSink output_file(fd);
+  output_file << contents;
+  int error = output_file.Flush() ? 0 : errno;
+  close(fd);
+  return error;
 }
 
-} // namespace
+// Writes the output for |behavior| to |fd|, and closes it. For outputs of
+// several files, |fd| is the directory they are written in. If |out_files| is
+// not null, the files are also added to it, for the cache. Returns 0, or the
+// errno of the write that failed.
+int Generate(Behavior behavior,
+             const fidl::flat::Library* library,
+             const fidl::CGenerator::Model* c_model,
+             const GeneratorOptions& options,
+             int fd,
+             std::vector<fidl::OutputCache::File>* out_files) {
+  // Output that is cached is kept in memory, and written out at the end.
+  std::unique_ptr<fidl::OutputSink> sink = out_files != nullptr
+      ? std::make_unique<fidl::OutputSink>()
+      : std::make_unique<fidl::OutputSink>(fd);
+  fidl::OutputSink& output_file = *sink;
 
-int compile(fidl::ErrorReporter* error_reporter,
-            fidl::flat::Typespace* typespace,
-            std::string library_name,
-            std::map<Behavior, std::fstream> outputs,
-            std::vector<fidl::SourceManager> source_managers) {
-  fidl::flat::Libraries all_libraries;
-  fidl::flat::Library* final_library = nullptr;
+  switch (behavior) {
+  case Behavior::kCHeader: {
+      fidl::CGenerator generator(library, c_model, options.c_coding, &options.method_profile,
+                                 options.c_codegen);
+      generator.ProduceHeader(&output_file);
+      break;
+  }
+  case Behavior::kCHeaderDir: {
+      fidl::CGenerator generator(library, c_model, options.c_coding, &options.method_profile,
+                                 options.c_codegen);
+      std::map<std::string, std::string> headers;
+      generator.ProduceSplitHeaders(&headers);
+      int error = 0;
+      for (const auto& header : headers) {
+          int header_fd = openat(fd, header.first.data(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+          if (header_fd < 0) {
+              error = errno;
+              break;
+          }
+          error = WriteOutput(header_fd, header.second);
+          if (error != 0)
+              break;
+          if (out_files != nullptr) {
+              out_files->push_back(fidl::OutputCache::File{
+                  static_cast<uint32_t>(behavior), header.first, header.second});
+          }
+      }
+      close(fd);
+      return error;
+  }
+  case Behavior::kCClient: {
+      fidl::CGenerator generator(library, c_model, options.c_coding, &options.method_profile,
+                                 options.c_codegen);
+      generator.ProduceClient(&output_file);
+      break;
+  }
+  case Behavior::kCServer: {
+      fidl::CGenerator generator(library, c_model, options.c_coding, &options.method_profile,
+                                 options.c_codegen);
+      generator.ProduceServer(&output_file);
+      break;
+  }
+  case Behavior::kCBench: {
+      fidl::CGenerator generator(library, c_model, options.c_coding, &options.method_profile,
+                                 options.c_codegen);
+      generator.ProduceBench(&output_file);
+      break;
+  }
+  case Behavior::kCppHeader: {
+    fidl::CppGenerator generator(library);
+    generator.ProduceHeader(&output_file);
+    break;
+  }
+  case Behavior::kCppSource: {
+    fidl::CppGenerator generator(library);
+    generator.ProduceSource(&output_file);
+    break;
+  }
+  case Behavior::kJSON: {
+    fidl::JSONGenerator generator(library);
+    generator.Produce(&output_file);
+    break;
+  }
+  case Behavior::kBinaryIR: {
+    fidl::BinaryIRGenerator generator(library);
+    generator.Produce(&output_file);
+    break;
+  }
+  case Behavior::kAbiFingerprint: {
+    fidl::AbiFingerprintGenerator generator(library);
+    generator.Produce(&output_file);
+    break;
+  }
+  case Behavior::kTables: {
+    fidl::TablesGenerator generator(library);
+    generator.Produce(&output_file);
+    break;
+  }
+  case Behavior::kLayoutReport: {
+    fidl::LayoutReportGenerator generator(library, options.layout_report_format);
+    generator.Produce(&output_file);
+    break;
+  }
+  }
+
+  if (out_files != nullptr) {
+    std::string contents = output_file.TakeContents();
+    int error = WriteOutput(fd, contents);
+    out_files->push_back(
+        fidl::OutputCache::File{static_cast<uint32_t>(behavior), std::string(), std::move(contents)});
+    return error;
+  }
+  int error = output_file.Flush() ? 0 : errno;
+  close(fd);
+  return error;
+}
+
+// The flags that name an output, whose path does not change its contents.
+const char* const kOutputFlags[] = {
+    "--c-header", "--c-header-dir", "--c-client", "--c-server", "--c-bench",
+    "--cpp-header", "--cpp-source", "--json", "--binary-ir", "--abi-fingerprint",
+    "--tables", "--layout-report", "--cache-dir",
+};
+
+// The flags that name a file that is read, whose contents are part of the key.
+const char* const kInputFlags[] = {
+    "--method-profile", "--binary-ir-dep",
+};
+
+// Returns the key of the cache entry of this run of fidlc: a digest of the
+// compiler, of its |arguments| but for the paths of its outputs, and of the
+// contents of the files that it reads. Returns an empty key, which is never
+// looked up, if any of them cannot be read.
+std::string CacheKey(const std::vector<std::string>& arguments,
+                     const std::vector<fidl::SourceManager>& source_managers) {
+  fidl::Sha256 hash;
+  auto add = [&hash](fidl::StringView data) {
+    uint64_t size = data.size();
+    hash.Update(&size, sizeof(size));
+    hash.Update(data);
+  };
+
+  // The compiler is told apart by its executable's size and modification
+  // time, which any new build of it changes.
+  struct stat compiler;
+  if (stat("/proc/self/exe", &compiler) != 0) {
+    return std::string();
+  }
+  add(std::to_string(compiler.st_size) + "." + std::to_string(compiler.st_mtim.tv_sec) + "." +
+      std::to_string(compiler.st_mtim.tv_nsec));
+
+  auto is_one_of = [](const std::string& flag, const auto& flags) {
+    return std::find(std::begin(flags), std::end(flags), flag) != std::end(flags);
+  };
+  bool in_files = false;
+  for (size_t i = 0u; i < arguments.size(); ++i) {
+    const std::string& argument = arguments[i];
+    add(argument);
+    in_files = in_files || argument == "--files";
+    if (in_files || i + 1u == arguments.size()) {
+      continue;
+    }
+    if (is_one_of(argument, kOutputFlags)) {
+      ++i;
+    } else if (is_one_of(argument, kInputFlags)) {
+      fidl::SourceManager input;
+      if (!input.CreateSource(arguments[++i].data())) {
+        return std::string();
+      }
+      add(arguments[i]);
+      add(input.sources()[0]->data());
+    }
+  }
+  for (const auto& source_manager : source_managers) {
+    for (const auto& source_file : source_manager.sources()) {
+      add(source_file->filename());
+      add(source_file->data());
+    }
+  }
+  return hash.HexDigest();
+}
+
+// Writes the files of |entry| to |outputs|, if it has all of them, and
+// returns whether it did.
+bool RestoreOutputs(const fidl::OutputCache::Entry& entry, const std::map<Behavior, int>& outputs) {
+  for (const auto& output : outputs) {
+    auto has_output = [&output](const fidl::OutputCache::File& file) {
+      return file.output == static_cast<uint32_t>(output.first);
+    };
+    if (std::none_of(entry.files.begin(), entry.files.end(), has_output)) {
+      return false;
+    }
+  }
+  for (const auto& file : entry.files) {
+    auto output = outputs.find(static_cast<Behavior>(file.output));
+    if (output == outputs.end()) {
+      continue;
+    }
+    int error = 0;
+    if (file.name.empty()) {
+      error = WriteOutput(output->second, file.contents);
+    } else {
+      int fd = openat(output->second, file.name.data(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      error = fd < 0 ? errno : WriteOutput(fd, file.contents);
+    }
+    if (error != 0) {
+      Fail("Could not write output: %s\n", strerror(error));
+    }
+  }
+  if (outputs.count(Behavior::kCHeaderDir)) {
+    close(outputs.at(Behavior::kCHeaderDir));
+  }
+  return true;
+}
+
+// Loads the binary IR at |path| into |library|. Returns false if it fails,
+// after reporting why to the library's error reporter, or in |out_error| if
+// it is not about its contents.
+bool LoadLibrary(const std::string& path, fidl::flat::Library* library, std::string* out_error) {
+  fidl::ir::Reader reader;
+  std::string error;
+  if (!reader.Open(path, &error)) {
+    *out_error = "Couldn't load " + error + "\n";
+    return false;
+  }
+  return library->ConsumeBinaryIR(reader);
+}
+
+// Parses and compiles the sources of |source_manager| into |library|.
+// Returns false if it fails, after reporting why to |error_reporter|.
+bool CompileLibrary(const fidl::SourceManager& source_manager,
+                    fidl::ErrorReporter* error_reporter,
+                    fidl::flat::Library* library) {
+  for (const auto& source_file : source_manager.sources()) {
+    if (!Parse(*source_file, error_reporter, library)) {
+      return false;
+    }
+  }
+  return library->Compile();
+}
+
+// Loads the libraries of |binary_ir_deps|, and then compiles those of
+// |source_managers|, into |all_libraries|, and sets |out_final_library| to
+// the last of them. Returns false if any of them fails, after reporting why
+// to |error_reporter|, or in |out_error| if it is not about their source.
+bool CompileLibraries(fidl::ErrorReporter* error_reporter,
+                      fidl::flat::Typespace* typespace,
+                      const std::vector<std::string>& binary_ir_deps,
+                      const std::vector<fidl::SourceManager>& source_managers,
+                      fidl::flat::Libraries* all_libraries,
+                      fidl::flat::Library** out_final_library,
+                      std::string* out_error) {
+  auto insert = [all_libraries, out_error](std::unique_ptr<fidl::flat::Library> library) {
+    std::string name = NameLibrary(library->name());
+    if (!all_libraries->Insert(std::move(library))) {
+      *out_error = "Mulitple libraries with the same name: '" + name + "'\n";
+      return false;
+    }
+    return true;
+  };
+
+  for (const auto& path : binary_ir_deps) {
+    auto library = std::make_unique<fidl::flat::Library>(all_libraries, error_reporter, typespace);
+    if (!LoadLibrary(path, library.get(), out_error)) {
+      return false;
+    }
+    if (!insert(std::move(library))) {
+      return false;
+    }
+  }
+
+  *out_final_library = nullptr;
   for (const auto& source_manager : source_managers) {
     if (source_manager.sources().empty()) {
       continue;
     }
 
-    auto library = std::make_unique<fidl::flat::Library>(&all_libraries, error_reporter, typespace);
-    for (const auto& source_file : source_manager.sources()) {
-      if (!Parse(*source_file, error_reporter, library.get())) {
-        return 1;
-      }
+    auto library = std::make_unique<fidl::flat::Library>(all_libraries, error_reporter, typespace);
+    if (!CompileLibrary(source_manager, error_reporter, library.get())) {
+      return false;
     }
 
-    if (!library->Compile()) {
-      return 1;
+    *out_final_library = library.get();
+    if (!insert(std::move(library))) {
+      return false;
     }
+  }
+  return true;
+}
+
+// The libraries that the library being compiled depends on, compiled, along
+// with everything that they refer to. A server keeps them for the runs that
+// depend on the same libraries, which each add theirs to a copy of them.
+struct CompiledDependencies {
+  CompiledDependencies(bool warnings_as_errors, uint32_t max_errors)
+      : error_reporter(warnings_as_errors, max_errors),
+        typespace(fidl::flat::Typespace::RootTypes(&error_reporter)) {}
+
+  // See DependenciesKey().
+  std::string key;
+  // Holds the warnings about the dependencies, which are printed by each
+  // run that uses them.
+  fidl::ErrorReporter error_reporter;
+  fidl::flat::Typespace typespace;
+  fidl::flat::Libraries all_libraries;
+  std::vector<fidl::SourceManager> source_managers;
+};
 
-    final_library = library.get();
-    if (!all_libraries.Insert(std::move(library))) {
-        const auto& name = library->name();
-        Fail("Mulitple libraries with the same name: '%s'\n",
-             NameLibrary(name).data());
+// Returns the index of the group of |source_managers| that holds the library
+// being compiled, which is the last one with sources, or their number if
+// none has any. Those before it hold its dependencies.
+size_t FinalGroup(const std::vector<fidl::SourceManager>& source_managers) {
+  for (size_t group = source_managers.size(); group > 0u; --group) {
+    if (!source_managers[group - 1u].sources().empty()) {
+      return group - 1u;
     }
   }
+  return source_managers.size();
+}
+
+// Returns |path| as seen from |directory|.
+std::string ResolvePath(const std::string& directory, const std::string& path) {
+  if (path.empty() || path[0] == '/') {
+    return path;
+  }
+  return directory + "/" + path;
+}
+
+// Returns a digest of everything that the dependencies of a run depend on:
+// the flags that change their diagnostics, and the names and contents of
+// their binary IR and sources, in the groups before |final_group|. Relative
+// binary IR paths are read from |working_directory|. Returns an empty key,
+// which matches no dependencies, if a binary IR cannot be read.
+std::string DependenciesKey(bool warnings_as_errors,
+                            uint32_t max_errors,
+                            const std::vector<std::string>& binary_ir_deps,
+                            const std::vector<fidl::SourceManager>& source_managers,
+                            size_t final_group,
+                            const std::string& working_directory) {
+  fidl::Sha256 hash;
+  auto add = [&hash](fidl::StringView data) {
+    uint64_t size = data.size();
+    hash.Update(&size, sizeof(size));
+    hash.Update(data);
+  };
+  add(warnings_as_errors ? "--werror" : "");
+  add(std::to_string(max_errors));
+  for (const auto& path : binary_ir_deps) {
+    fidl::SourceManager binary_ir;
+    if (!binary_ir.CreateSource(path, ResolvePath(working_directory, path))) {
+      return std::string();
+    }
+    add(path);
+    add(binary_ir.sources()[0]->data());
+  }
+  for (size_t group = 0u; group < final_group; ++group) {
+    add("--files");
+    for (const auto& source_file : source_managers[group].sources()) {
+      add(source_file->filename());
+      add(source_file->data());
+    }
+  }
+  return hash.HexDigest();
+}
+
+} // namespace
+
+// Diagnostics refer to the source files, including the ones libraries
+// generate, so |all_libraries| and |source_managers| must outlive
+// |error_reporter|'s reports. If |out_files| is not null, the files of the
+// outputs are also added to it, for the cache.
+int compile(fidl::ErrorReporter* error_reporter,
+            fidl::flat::Typespace* typespace,
+            std::string library_name,
+            std::map<Behavior, int> outputs,
+            const GeneratorOptions& options,
+            const std::vector<std::string>& binary_ir_deps,
+            const std::vector<fidl::SourceManager>& source_managers,
+            fidl::flat::Libraries* all_libraries,
+            std::vector<fidl::OutputCache::File>* out_files) {
+  fidl::flat::Library* final_library = nullptr;
+  std::string error;
+  if (!CompileLibraries(error_reporter, typespace, binary_ir_deps, source_managers, all_libraries,
+                        &final_library, &error)) {
+    if (!error.empty()) {
+      Fail("%s", error.data());
+    }
+    return 1;
+  }
 
   if (final_library == nullptr) {
     Fail("No library was produced.\n");
@@ -189,38 +788,478 @@ int compile(fidl::ErrorReporter* error_reporter,
            final_name.data(), library_name.data());
   }
 
-  for (auto& output : outputs) {
-    auto& behavior = output.first;
-    auto& output_file = output.second;
+  if (options.retain_reachable) {
+      std::vector<fidl::flat::Decl*> roots;
+      if (options.roots.empty()) {
+          for (const auto& interface_decl : final_library->interface_declarations_)
+              roots.push_back(interface_decl.get());
+      }
+      for (const auto& root : options.roots) {
+          auto iter = std::find_if(
+              final_library->declaration_order_.begin(), final_library->declaration_order_.end(),
+              [&root](const fidl::flat::Decl* decl) {
+                  return decl->name.name_part() == root || fidl::NameName(decl->name, ".", "/") == root;
+              });
+          if (iter == final_library->declaration_order_.end()) {
+              Fail("Unknown root declaration: %s\n", root.data());
+          }
+          roots.push_back(*iter);
+      }
+      final_library->RetainReachable(roots);
+  }
 
-    switch (behavior) {
-    case Behavior::kCHeader: {
-        fidl::CGenerator generator(final_library);
-        Write(generator.ProduceHeader(), std::move(output_file));
-        break;
+  // From here on the library is only read, so each output is produced on a
+  // thread of its own. The C outputs share one model of the library's names
+  // and members.
+  std::unique_ptr<const fidl::CGenerator::Model> c_model;
+  if (outputs.count(Behavior::kCHeader) || outputs.count(Behavior::kCHeaderDir) ||
+      outputs.count(Behavior::kCClient) ||
+      outputs.count(Behavior::kCServer) || outputs.count(Behavior::kCBench)) {
+    c_model = fidl::CGenerator::BuildModel(final_library);
+  }
+
+  std::vector<std::thread> threads;
+  std::vector<int> write_errors(outputs.size(), 0);
+  std::vector<std::vector<fidl::OutputCache::File>> files(outputs.size());
+  size_t index = 0u;
+  for (const auto& output : outputs) {
+    Behavior behavior = output.first;
+    int fd = output.second;
+    int* write_error = &write_errors[index];
+    std::vector<fidl::OutputCache::File>* output_files =
+        out_files != nullptr ? &files[index] : nullptr;
+    ++index;
+    threads.emplace_back([=, &c_model, &options]() {
+      *write_error = Generate(behavior, final_library, c_model.get(), options, fd, output_files);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (out_files != nullptr) {
+    for (auto& output_files : files) {
+      std::move(output_files.begin(), output_files.end(), std::back_inserter(*out_files));
     }
-    case Behavior::kCClient: {
-        fidl::CGenerator generator(final_library);
-        Write(generator.ProduceClient(), std::move(output_file));
-        break;
+  }
+  for (int write_error : write_errors) {
+    if (write_error != 0) {
+      Fail("Could not write output: %s\n", strerror(write_error));
     }
-    case Behavior::kCServer: {
-        fidl::CGenerator generator(final_library);
-        Write(generator.ProduceServer(), std::move(output_file));
-        break;
+  }
+
+  return 0;
+}
+
+namespace {
+
+// The flags of a run that choose what it compiles and outputs, of which each
+// target of a batch has its own.
+struct TargetFlags {
+    std::string library_name;
+    std::vector<std::string> binary_ir_deps;
+    // The path of each output.
+    std::map<Behavior, std::string> outputs;
+    GeneratorOptions options;
+};
+
+// If |flag| is one of the flags of TargetFlags, claims its value from |args|
+// and sets it in |target|, and returns true.
+bool ParseTargetFlag(const std::string& flag, Arguments* args, TargetFlags* target) {
+    if (flag == "--c-header") {
+        target->outputs.emplace(Behavior::kCHeader, args->Claim());
+    } else if (flag == "--c-header-dir") {
+        target->outputs.emplace(Behavior::kCHeaderDir, args->Claim());
+    } else if (flag == "--c-client") {
+        target->outputs.emplace(Behavior::kCClient, args->Claim());
+    } else if (flag == "--c-server") {
+        target->outputs.emplace(Behavior::kCServer, args->Claim());
+    } else if (flag == "--c-bench") {
+        target->outputs.emplace(Behavior::kCBench, args->Claim());
+    } else if (flag == "--c-coding") {
+        std::string coding = args->Claim();
+        if (coding == "tables") {
+            target->options.c_coding = fidl::CGenerator::Coding::kTables;
+        } else if (coding == "inline") {
+            target->options.c_coding = fidl::CGenerator::Coding::kInline;
+        } else {
+            FailWithUsage("Unknown C coding: %s\n", coding.data());
+        }
+    } else if (flag == "--c-codegen") {
+        std::string codegen = args->Claim();
+        if (codegen == "speed") {
+            target->options.c_codegen = fidl::CGenerator::Codegen::kSpeed;
+        } else if (codegen == "size") {
+            target->options.c_codegen = fidl::CGenerator::Codegen::kSize;
+        } else {
+            FailWithUsage("Unknown C codegen: %s\n", codegen.data());
+        }
+    } else if (flag == "--method-profile") {
+        std::string path = args->Claim();
+        fidl::SourceManager profile_source;
+        if (!profile_source.CreateSource(path.data())) {
+            Fail("Couldn't read in method profile from %s\n", path.data());
+        }
+        std::string error;
+        if (!fidl::CGenerator::ParseMethodProfile(profile_source.sources()[0]->data(),
+                                                  &target->options.method_profile, &error)) {
+            Fail("Invalid method profile %s: %s\n", path.data(), error.data());
+        }
+    } else if (flag == "--cpp-header") {
+        target->outputs.emplace(Behavior::kCppHeader, args->Claim());
+    } else if (flag == "--cpp-source") {
+        target->outputs.emplace(Behavior::kCppSource, args->Claim());
+    } else if (flag == "--json") {
+        target->outputs.emplace(Behavior::kJSON, args->Claim());
+    } else if (flag == "--binary-ir") {
+        target->outputs.emplace(Behavior::kBinaryIR, args->Claim());
+    } else if (flag == "--abi-fingerprint") {
+        target->outputs.emplace(Behavior::kAbiFingerprint, args->Claim());
+    } else if (flag == "--tables") {
+        target->outputs.emplace(Behavior::kTables, args->Claim());
+    } else if (flag == "--layout-report") {
+        target->outputs.emplace(Behavior::kLayoutReport, args->Claim());
+    } else if (flag == "--layout-report-format") {
+        std::string format = args->Claim();
+        if (format == "text") {
+            target->options.layout_report_format = fidl::LayoutReportGenerator::Format::kText;
+        } else if (format == "json") {
+            target->options.layout_report_format = fidl::LayoutReportGenerator::Format::kJSON;
+        } else if (format == "csv") {
+            target->options.layout_report_format = fidl::LayoutReportGenerator::Format::kCSV;
+        } else {
+            FailWithUsage("Unknown layout report format: %s\n", format.data());
+        }
+    } else if (flag == "--roots") {
+        std::string roots = args->Claim();
+        target->options.retain_reachable = true;
+        target->options.roots.clear();
+        if (roots != "protocols") {
+            size_t start = 0u;
+            for (;;) {
+                size_t comma = roots.find(',', start);
+                std::string root = roots.substr(start, comma - start);
+                if (root.empty()) {
+                    FailWithUsage("Invalid --roots: %s\n", roots.data());
+                }
+                target->options.roots.push_back(std::move(root));
+                if (comma == std::string::npos)
+                    break;
+                start = comma + 1u;
+            }
+        }
+    } else if (flag == "--name") {
+        target->library_name = args->Claim();
+    } else if (flag == "--binary-ir-dep") {
+        target->binary_ir_deps.push_back(args->Claim());
+    } else {
+        return false;
     }
-    case Behavior::kJSON: {
-      fidl::JSONGenerator generator(final_library);
-      Write(generator.Produce(), std::move(output_file));
-      break;
+    return true;
+}
+
+// Fails if the flags of |target| do not go together.
+void CheckTargetFlags(const TargetFlags& target) {
+    if (target.options.c_codegen == fidl::CGenerator::Codegen::kSize &&
+        target.options.c_coding != fidl::CGenerator::Coding::kTables) {
+        FailWithUsage("--c-codegen size requires --c-coding tables\n");
     }
+}
+
+// A target of a batch: the flags and the --files groups of a line of its
+// manifest.
+struct BatchTarget {
+    size_t line;
+    TargetFlags flags;
+    std::vector<std::vector<std::string>> groups;
+};
+
+// Reads the targets of the batch manifest at |path|. Each line that is not
+// blank, and does not start with `#`, has the arguments of a run of fidlc,
+// separated by whitespace, but for those of --batch itself.
+std::vector<BatchTarget> ReadBatchManifest(const std::string& path) {
+    fidl::SourceManager manifest;
+    if (!manifest.CreateSource(path.data())) {
+        Fail("Couldn't read in batch manifest from %s\n", path.data());
     }
-  }
+    std::istringstream lines(std::string(manifest.sources()[0]->data()));
+    std::vector<BatchTarget> targets;
+    std::string line;
+    for (size_t line_number = 1u; std::getline(lines, line); ++line_number) {
+        std::istringstream words(line);
+        std::vector<std::string> arguments{std::istream_iterator<std::string>(words),
+                                           std::istream_iterator<std::string>()};
+        if (arguments.empty() || arguments[0][0] == '#') {
+            continue;
+        }
+        std::vector<char*> argv;
+        for (auto& argument : arguments) {
+            argv.push_back(&argument[0]);
+        }
 
-  return 0;
+        BatchTarget target;
+        target.line = line_number;
+        ArgvArguments args(static_cast<int>(argv.size()), argv.data());
+        while (args.Remaining()) {
+            std::string flag = args.Claim();
+            if (flag == "--files") {
+                target.groups.emplace_back();
+            } else if (!target.groups.empty()) {
+                target.groups.back().push_back(std::move(flag));
+            } else if (!ParseTargetFlag(flag, &args, &target.flags)) {
+                Fail("%s:%zu: Unknown argument: %s\n", path.data(), line_number, flag.data());
+            }
+        }
+        CheckTargetFlags(target.flags);
+        if (target.flags.options.retain_reachable) {
+            Fail("%s:%zu: --roots cannot be used in a batch, whose targets share their libraries\n",
+                 path.data(), line_number);
+        }
+        target.groups.erase(
+            std::remove_if(target.groups.begin(), target.groups.end(),
+                           [](const std::vector<std::string>& group) { return group.empty(); }),
+            target.groups.end());
+        if (target.groups.empty()) {
+            Fail("%s:%zu: No library was produced.\n", path.data(), line_number);
+        }
+        targets.push_back(std::move(target));
+    }
+    return targets;
 }
 
-int main(int argc, char* argv[]) {
+// Returns |path| with its symbolic links and relative parts resolved, so that
+// a file named in two ways is recognized, or |path| if it does not exist.
+std::string CanonicalPath(const std::string& path) {
+    char* resolved = realpath(path.data(), nullptr);
+    if (resolved == nullptr) {
+        return path;
+    }
+    std::string canonical(resolved);
+    free(resolved);
+    return canonical;
+}
+
+// Calls |job| with each index below |count|, on as many threads as there are
+// processors.
+void ParallelFor(size_t count, const std::function<void(size_t)>& job) {
+    size_t num_threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<size_t> next_index(0u);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0u; thread < num_threads; ++thread) {
+        threads.emplace_back([&next_index, count, &job]() {
+            for (size_t index = next_index++; index < count; index = next_index++) {
+                job(index);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Compiles and outputs every target of the batch manifest at |manifest_path|.
+// Each library, as named by the canonical paths of its sources, or of its
+// binary IR, is compiled once, and shared by all the targets that list it.
+// The outputs of every target are then produced in parallel. Returns 1 if
+// any target fails, after producing the outputs of the others.
+int RunBatch(const std::string& manifest_path,
+             bool warnings_as_errors,
+             uint32_t max_errors,
+             bool json_diagnostics) {
+    std::vector<BatchTarget> targets = ReadBatchManifest(manifest_path);
+
+    fidl::ErrorReporter error_reporter(warnings_as_errors, max_errors);
+    fidl::flat::Typespace typespace = fidl::flat::Typespace::RootTypes(&error_reporter);
+    fidl::flat::Libraries all_libraries;
+    std::deque<fidl::SourceManager> source_managers;
+    // Libraries that failed, or whose name was taken, are kept, as the
+    // typespace may still refer to their declarations.
+    std::vector<std::unique_ptr<fidl::flat::Library>> rejected_libraries;
+    // By their canonical paths. Null for those that failed.
+    std::map<std::string, fidl::flat::Library*> libraries;
+    std::vector<fidl::flat::Library*> final_libraries(targets.size(), nullptr);
+    int status = 0;
+
+    for (size_t index = 0u; index < targets.size(); ++index) {
+        const BatchTarget& target = targets[index];
+        size_t num_libraries = target.flags.binary_ir_deps.size() + target.groups.size();
+        // The libraries of the target so far, which are all that the next may
+        // depend on.
+        std::vector<const fidl::flat::Library*> listed;
+        for (size_t position = 0u; position < num_libraries; ++position) {
+            bool is_binary_ir = position < target.flags.binary_ir_deps.size();
+            const std::string* binary_ir_dep = nullptr;
+            const std::vector<std::string>* group = nullptr;
+            std::string key;
+            if (is_binary_ir) {
+                binary_ir_dep = &target.flags.binary_ir_deps[position];
+                key = "--binary-ir-dep\n" + CanonicalPath(*binary_ir_dep);
+            } else {
+                group = &target.groups[position - target.flags.binary_ir_deps.size()];
+                key = "--files";
+                for (const auto& filename : *group) {
+                    key.append("\n" + CanonicalPath(filename));
+                }
+            }
+
+            auto iter = libraries.find(key);
+            if (iter == libraries.end()) {
+                auto library = std::make_unique<fidl::flat::Library>(&all_libraries, &error_reporter,
+                                                                     &typespace);
+                std::string error;
+                bool ok = false;
+                if (is_binary_ir) {
+                    ok = !error_reporter.LimitReached() &&
+                         LoadLibrary(*binary_ir_dep, library.get(), &error);
+                } else {
+                    source_managers.emplace_back();
+                    for (const auto& filename : *group) {
+                        if (!source_managers.back().CreateSource(filename.data())) {
+                            Fail("Couldn't read in source data from %s\n", filename.data());
+                        }
+                    }
+                    ok = !error_reporter.LimitReached() &&
+                         CompileLibrary(source_managers.back(), &error_reporter, library.get());
+                }
+                fidl::flat::Library* unused = nullptr;
+                if (ok && all_libraries.Lookup(library->name(), &unused)) {
+                    error = "Mulitple libraries with the same name: '" +
+                            NameLibrary(library->name()) + "'\n";
+                    ok = false;
+                }
+                if (!error.empty()) {
+                    fprintf(stderr, "%s:%zu: %s", manifest_path.data(), target.line, error.data());
+                }
+                fidl::flat::Library* compiled = library.get();
+                if (ok) {
+                    all_libraries.Insert(std::move(library));
+                } else {
+                    compiled = nullptr;
+                    rejected_libraries.push_back(std::move(library));
+                }
+                iter = libraries.emplace(std::move(key), compiled).first;
+            }
+
+            fidl::flat::Library* library = iter->second;
+            if (library == nullptr) {
+                break;
+            }
+            // A library that another target listed its dependencies for must
+            // only depend on those that this target lists before it too, as it
+            // would when this target is compiled on its own.
+            for (const fidl::flat::Library* dependency : library->dependencies()) {
+                if (std::find(listed.begin(), listed.end(), dependency) == listed.end()) {
+                    fprintf(stderr, "%s:%zu: Library '%s' depends on '%s', which is not listed before it\n",
+                            manifest_path.data(), target.line, NameLibrary(library->name()).data(),
+                            NameLibrary(dependency->name()).data());
+                    library = nullptr;
+                    break;
+                }
+            }
+            if (library == nullptr) {
+                break;
+            }
+            listed.push_back(library);
+            if (position + 1u == num_libraries) {
+                final_libraries[index] = library;
+            }
+        }
+        if (final_libraries[index] == nullptr) {
+            status = 1;
+            continue;
+        }
+
+        std::string final_name = NameLibrary(final_libraries[index]->name());
+        if (!target.flags.library_name.empty() && final_name != target.flags.library_name) {
+            fprintf(stderr, "%s:%zu: Generated library '%s' did not match --name argument: %s\n",
+                    manifest_path.data(), target.line, final_name.data(),
+                    target.flags.library_name.data());
+            final_libraries[index] = nullptr;
+            status = 1;
+        }
+    }
+
+    if (json_diagnostics) {
+        error_reporter.PrintReportsAsJSON();
+    } else {
+        error_reporter.PrintReports();
+    }
+
+    // From here on the libraries are only read. The C outputs of all the
+    // targets of a library share one model of it.
+    struct Output {
+        const BatchTarget* target;
+        const fidl::flat::Library* library;
+        Behavior behavior;
+        const std::string* path;
+        std::string error;
+    };
+    std::vector<Output> outputs;
+    std::map<const fidl::flat::Library*, std::unique_ptr<const fidl::CGenerator::Model>> c_models;
+    for (size_t index = 0u; index < targets.size(); ++index) {
+        if (final_libraries[index] == nullptr) {
+            continue;
+        }
+        for (const auto& output : targets[index].flags.outputs) {
+            switch (output.first) {
+            case Behavior::kCHeaderDir:
+                close(OpenDirectory(output.second));
+                [[fallthrough]];
+            case Behavior::kCHeader:
+            case Behavior::kCClient:
+            case Behavior::kCServer:
+            case Behavior::kCBench:
+                c_models[final_libraries[index]];
+                break;
+            default:
+                break;
+            }
+            outputs.push_back(Output{&targets[index], final_libraries[index], output.first,
+                                     &output.second, std::string()});
+        }
+    }
+
+    std::vector<decltype(c_models)::iterator> models;
+    for (auto iter = c_models.begin(); iter != c_models.end(); ++iter) {
+        models.push_back(iter);
+    }
+    ParallelFor(models.size(), [&models](size_t index) {
+        models[index]->second = fidl::CGenerator::BuildModel(models[index]->first);
+    });
+
+    // Each output is opened only when it is produced, so that there are never
+    // more open than there are threads.
+    ParallelFor(outputs.size(), [&outputs, &c_models](size_t index) {
+        Output& output = outputs[index];
+        int fd = output.behavior == Behavior::kCHeaderDir
+                     ? open(output.path->data(), O_RDONLY | O_DIRECTORY)
+                     : open(output.path->data(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) {
+            output.error = "Could not open file: " + *output.path;
+            return;
+        }
+        auto c_model = c_models.find(output.library);
+        int error = Generate(output.behavior, output.library,
+                             c_model != c_models.end() ? c_model->second.get() : nullptr,
+                             output.target->flags.options, fd, nullptr);
+        if (error != 0) {
+            output.error = "Could not write output " + *output.path + ": " + strerror(error);
+        }
+    });
+    for (const auto& output : outputs) {
+        if (!output.error.empty()) {
+            fprintf(stderr, "%s:%zu: %s\n", manifest_path.data(), output.target->line,
+                    output.error.data());
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// Runs fidlc with the arguments of |argv|. If |server_dependencies| is not
+// null, they are used in place of compiling the dependencies again, if they
+// are the same as this run's.
+int Run(int argc, char* argv[], CompiledDependencies* server_dependencies) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
     auto argv_args = std::make_unique<ArgvArguments>(argc, argv);
 
     // parse the program name
@@ -231,9 +1270,13 @@ int main(int argc, char* argv[]) {
         exit(0);
     }
 
-    std::string library_name;
+    TargetFlags target;
+    std::string cache_dir;
+    std::string batch_manifest;
+    bool has_target_flags = false;
     bool warnings_as_errors = false;
-    std::map<Behavior, std::fstream> outputs;
+    uint32_t max_errors = 0u;
+    bool json_diagnostics = false;
     while (argv_args->Remaining()) {
         std::string flag = argv_args->Claim();
         if (flag == "--help") {
@@ -241,22 +1284,53 @@ int main(int argc, char* argv[]) {
             exit(0);
         } else if (flag == "--werror") {
             warnings_as_errors = true;
-        } else if (flag == "--c-header") {
-            outputs.emplace(Behavior::kCHeader, Open(argv_args->Claim(), std::ios::out));
-        } else if (flag == "--c-client") {
-            outputs.emplace(Behavior::kCClient, Open(argv_args->Claim(), std::ios::out));
-        } else if (flag == "--c-server") {
-            outputs.emplace(Behavior::kCServer, Open(argv_args->Claim(), std::ios::out));
-        } else if (flag == "--json") {
-            outputs.emplace(Behavior::kJSON, Open(argv_args->Claim(), std::ios::out));
-        } else if (flag == "--name") {
-            library_name = argv_args->Claim();
+        } else if (flag == "--max-errors") {
+            std::string count = argv_args->Claim();
+            if (fidl::utils::ParseNumeric(count, &max_errors) !=
+                fidl::utils::ParseNumericResult::kSuccess) {
+                FailWithUsage("Invalid error limit: %s\n", count.data());
+            }
+        } else if (flag == "--diagnostics-format") {
+            std::string format = argv_args->Claim();
+            if (format == "text") {
+                json_diagnostics = false;
+            } else if (format == "json") {
+                json_diagnostics = true;
+            } else {
+                FailWithUsage("Unknown diagnostics format: %s\n", format.data());
+            }
+        } else if (flag == "--cache-dir") {
+            cache_dir = argv_args->Claim();
+            close(OpenDirectory(cache_dir));
+            has_target_flags = true;
+        } else if (flag == "--batch") {
+            batch_manifest = argv_args->Claim();
         } else if (flag == "--files") {
+            has_target_flags = true;
             break;
+        } else if (ParseTargetFlag(flag, argv_args.get(), &target)) {
+            has_target_flags = true;
         } else {
             FailWithUsage("Unknown argument: %s\n", flag.data());
         }
     }
+    if (!batch_manifest.empty()) {
+        if (has_target_flags) {
+            FailWithUsage("--batch only takes --werror, --max-errors and --diagnostics-format\n");
+        }
+        return RunBatch(batch_manifest, warnings_as_errors, max_errors, json_diagnostics);
+    }
+    CheckTargetFlags(target);
+
+    std::string library_name = std::move(target.library_name);
+    std::vector<std::string> binary_ir_deps = std::move(target.binary_ir_deps);
+    const GeneratorOptions& options = target.options;
+    std::map<Behavior, int> outputs;
+    for (const auto& output : target.outputs) {
+        outputs.emplace(output.first, output.first == Behavior::kCHeaderDir
+                                          ? OpenDirectory(output.second)
+                                          : Open(output.second));
+    }
 
     std::vector<fidl::SourceManager> source_managers;
     source_managers.push_back(fidl::SourceManager());
@@ -271,14 +1345,411 @@ int main(int argc, char* argv[]) {
       }
     }
 
-    fidl::ErrorReporter error_reporter(warnings_as_errors);
-    auto typespace = fidl::flat::Typespace::RootTypes(&error_reporter);
+    // On a hit, the outputs and diagnostics of an earlier run with the same
+    // key are replayed, without even lexing the sources.
+    std::unique_ptr<fidl::OutputCache> cache;
+    std::string cache_key;
+    if (!cache_dir.empty()) {
+        cache_key = CacheKey(arguments, source_managers);
+    }
+    if (!cache_key.empty()) {
+        cache = std::make_unique<fidl::OutputCache>(cache_dir);
+        fidl::OutputCache::Entry entry;
+        if (cache->Lookup(cache_key, &entry) && RestoreOutputs(entry, outputs)) {
+            fputs(entry.diagnostics.data(), stderr);
+            return 0;
+        }
+    }
+
+    size_t final_group = FinalGroup(source_managers);
+    CompiledDependencies* dependencies = server_dependencies;
+    std::unique_ptr<CompiledDependencies> own_dependencies;
+    std::vector<fidl::SourceManager> final_source_managers;
+    if (dependencies != nullptr && !dependencies->key.empty() &&
+        dependencies->key == DependenciesKey(warnings_as_errors, max_errors, binary_ir_deps,
+                                             source_managers, final_group, ".")) {
+        // Only the library itself is left to compile.
+        binary_ir_deps.clear();
+        if (final_group < source_managers.size()) {
+            final_source_managers.push_back(std::move(source_managers[final_group]));
+        }
+    } else {
+        own_dependencies = std::make_unique<CompiledDependencies>(warnings_as_errors, max_errors);
+        dependencies = own_dependencies.get();
+        final_source_managers = std::move(source_managers);
+    }
+
+    fidl::ErrorReporter& error_reporter = dependencies->error_reporter;
+    fidl::OutputCache::Entry entry;
     auto status = compile(&error_reporter,
-                          &typespace,
+                          &dependencies->typespace,
                           library_name,
                           std::move(outputs),
-                          std::move(source_managers));
-    error_reporter.PrintReports();
+                          options,
+                          binary_ir_deps,
+                          final_source_managers,
+                          &dependencies->all_libraries,
+                          cache != nullptr ? &entry.files : nullptr);
+
+    // Only runs that succeed are cached, so their diagnostics are captured
+    // to be stored with their outputs.
+    char* diagnostics = nullptr;
+    size_t diagnostics_size = 0u;
+    FILE* diagnostics_file = stderr;
+    if (cache != nullptr && status == 0) {
+        diagnostics_file = open_memstream(&diagnostics, &diagnostics_size);
+        if (diagnostics_file == nullptr) {
+            diagnostics_file = stderr;
+        }
+    }
+    if (json_diagnostics) {
+        error_reporter.PrintReportsAsJSON(diagnostics_file);
+    } else {
+        error_reporter.PrintReports(diagnostics_file);
+    }
+    if (diagnostics_file != stderr) {
+        fclose(diagnostics_file);
+        entry.diagnostics.assign(diagnostics, diagnostics_size);
+        free(diagnostics);
+        fputs(entry.diagnostics.data(), stderr);
+        // A cache that cannot be written to is only left unfilled.
+        cache->Store(cache_key, entry);
+    }
     return status;
 }
 
+// The dependencies that a server compiled, by the working directory and the
+// arguments of the runs they were compiled for. They are compiled again when
+// their sources change, and the least recently used are dropped once there
+// are too many.
+class DependencyCache {
+public:
+  // Returns the dependencies of a run with |arguments| in
+  // |working_directory|, compiling them if they are not cached yet, in which
+  // case |out_compiled| is set, or null if they cannot be compiled.
+  CompiledDependencies* Find(const std::string& working_directory,
+                             const std::vector<std::string>& arguments,
+                             bool* out_compiled);
+
+private:
+  static constexpr size_t kMaxEntries = 64u;
+
+  struct Entry {
+    std::unique_ptr<CompiledDependencies> dependencies;
+    uint64_t last_used;
+  };
+
+  std::map<std::string, Entry> entries_;
+  uint64_t uses_ = 0u;
+};
+
+CompiledDependencies* DependencyCache::Find(const std::string& working_directory,
+                                            const std::vector<std::string>& arguments,
+                                            bool* out_compiled) {
+  *out_compiled = false;
+  // Only the flags that matter to the dependencies are read; runs whose
+  // other flags are wrong fail on their own. Every flag but --werror and
+  // --help takes a value.
+  bool warnings_as_errors = false;
+  uint32_t max_errors = 0u;
+  std::vector<std::string> binary_ir_deps;
+  size_t index = 0u;
+  for (; index < arguments.size() && arguments[index] != "--files"; ++index) {
+    const std::string& flag = arguments[index];
+    if (flag == "--werror") {
+      warnings_as_errors = true;
+    } else if (flag == "--help" || index + 1u == arguments.size()) {
+      return nullptr;
+    } else if (flag == "--max-errors") {
+      if (fidl::utils::ParseNumeric(arguments[++index], &max_errors) !=
+          fidl::utils::ParseNumericResult::kSuccess) {
+        return nullptr;
+      }
+    } else if (flag == "--binary-ir-dep") {
+      binary_ir_deps.push_back(arguments[++index]);
+    } else {
+      ++index;
+    }
+  }
+  // As in Run(), the first --files starts the first group. The sources keep
+  // the names the run gives them, which its key and diagnostics use.
+  std::vector<fidl::SourceManager> source_managers(1u);
+  for (++index; index < arguments.size(); ++index) {
+    if (arguments[index] == "--files") {
+      source_managers.emplace_back();
+    } else if (!source_managers.back().CreateSource(
+                   arguments[index], ResolvePath(working_directory, arguments[index]))) {
+      return nullptr;
+    }
+  }
+  size_t final_group = FinalGroup(source_managers);
+  std::string key = DependenciesKey(warnings_as_errors, max_errors, binary_ir_deps,
+                                    source_managers, final_group, working_directory);
+  if (key.empty()) {
+    return nullptr;
+  }
+
+  std::string name = working_directory;
+  name.append(warnings_as_errors ? "\n--werror" : "\n");
+  name.append("\n" + std::to_string(max_errors));
+  for (const auto& path : binary_ir_deps) {
+    name.append("\n" + path);
+  }
+  for (size_t group = 0u; group < final_group; ++group) {
+    name.append("\n--files");
+    for (const auto& source_file : source_managers[group].sources()) {
+      name.append("\n");
+      name.append(source_file->filename());
+    }
+  }
+
+  auto iter = entries_.find(name);
+  if (iter != entries_.end()) {
+    if (iter->second.dependencies->key == key) {
+      iter->second.last_used = ++uses_;
+      return iter->second.dependencies.get();
+    }
+    // Their sources changed since they were compiled.
+    entries_.erase(iter);
+  }
+
+  for (auto& path : binary_ir_deps) {
+    path = ResolvePath(working_directory, path);
+  }
+  auto dependencies = std::make_unique<CompiledDependencies>(warnings_as_errors, max_errors);
+  dependencies->key = std::move(key);
+  source_managers.resize(final_group);
+  dependencies->source_managers = std::move(source_managers);
+  fidl::flat::Library* final_library = nullptr;
+  std::string error;
+  if (!CompileLibraries(&dependencies->error_reporter, &dependencies->typespace, binary_ir_deps,
+                        dependencies->source_managers, &dependencies->all_libraries,
+                        &final_library, &error)) {
+    return nullptr;
+  }
+
+  if (entries_.size() >= kMaxEntries) {
+    auto oldest = std::min_element(
+        entries_.begin(), entries_.end(),
+        [](const auto& a, const auto& b) { return a.second.last_used < b.second.last_used; });
+    entries_.erase(oldest);
+  }
+  CompiledDependencies* result = dependencies.get();
+  entries_.emplace(std::move(name), Entry{std::move(dependencies), ++uses_});
+  *out_compiled = true;
+  return result;
+}
+
+// How long a server waits for a client that connected to send its request.
+constexpr time_t kReceiveTimeoutSeconds = 10;
+
+// Runs the request that a client sent on |connection|, in a process of its
+// own, and sends back its exit status. The run is in a process of its own
+// too, so that it can exit however it fails, and so that it adds its library
+// to a copy of |dependencies| that is thrown away with it.
+[[noreturn]] void HandleRequest(int connection,
+                                const fidl::CompileRequest& request,
+                                CompiledDependencies* dependencies) {
+  signal(SIGCHLD, SIG_DFL);
+  pid_t worker = fork();
+  if (worker == 0) {
+    if (dup2(request.stdout_fd, STDOUT_FILENO) < 0 ||
+        dup2(request.stderr_fd, STDERR_FILENO) < 0) {
+      _exit(1);
+    }
+    if (chdir(request.working_directory.data()) != 0) {
+      Fail("Could not change to directory: %s\n", request.working_directory.data());
+    }
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>("fidlc"));
+    for (const auto& argument : request.arguments) {
+      argv.push_back(const_cast<char*>(argument.data()));
+    }
+    argv.push_back(nullptr);
+    exit(Run(static_cast<int>(argv.size() - 1u), argv.data(), dependencies));
+  }
+
+  int status = 1;
+  int wait_status;
+  if (worker > 0 && waitpid(worker, &wait_status, 0) == worker && WIFEXITED(wait_status)) {
+    status = WEXITSTATUS(wait_status);
+  }
+  fidl::SendStatus(connection, status);
+  _exit(0);
+}
+
+[[noreturn]] void ServeGeneration(int acceptor, DependencyCache* dependency_cache);
+
+// Receives the request of the client on |connection|, in a process of its
+// own, so that clients that are slow to send theirs, or whose dependencies
+// are slow to compile, hold up no other. A process whose dependencies were
+// not in |dependency_cache| yet compiles them into its copy of it, and then
+// takes over from the generation that forked it, by passing |acceptor| a
+// socket to itself, so that later runs find them compiled. When several
+// processes of a generation compile dependencies at once, only the first to
+// take over does: the listener closes |acceptor| once it receives the first
+// socket, which drops the others, so that their processes exit. Their
+// requests still run, but their dependencies are compiled again by a later
+// run.
+[[noreturn]] void HandleConnection(int acceptor, int connection,
+                                   DependencyCache* dependency_cache) {
+  struct timeval timeout = {kReceiveTimeoutSeconds, 0};
+  setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  fidl::CompileRequest request;
+  if (!fidl::ReceiveRequest(connection, &request)) {
+    _exit(0);
+  }
+  bool compiled = false;
+  CompiledDependencies* dependencies =
+      dependency_cache->Find(request.working_directory, request.arguments, &compiled);
+  if (compiled && fork() > 0) {
+    close(request.stdout_fd);
+    close(request.stderr_fd);
+    close(connection);
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0 ||
+        !fidl::SendDescriptor(acceptor, sockets[0])) {
+      _exit(0);
+    }
+    close(sockets[0]);
+    close(acceptor);
+    ServeGeneration(sockets[1], dependency_cache);
+  }
+  HandleRequest(connection, request, dependencies);
+}
+
+// Handles each connection that the process listening for them passes over
+// |acceptor|, until it passes them to a newer generation instead.
+[[noreturn]] void ServeGeneration(int acceptor, DependencyCache* dependency_cache) {
+  for (;;) {
+    int connection = fidl::ReceiveDescriptor(acceptor);
+    if (connection < 0) {
+      _exit(0);
+    }
+    if (fork() == 0) {
+      HandleConnection(acceptor, connection, dependency_cache);
+    }
+    close(connection);
+  }
+}
+
+// Forks a generation, with no dependencies compiled yet, and returns the
+// socket to pass it connections over.
+int StartGeneration(int listener) {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0) {
+    Fail("Could not create a socket: %s\n", strerror(errno));
+  }
+  pid_t generation = fork();
+  if (generation == 0) {
+    close(listener);
+    close(sockets[0]);
+    DependencyCache dependency_cache;
+    ServeGeneration(sockets[1], &dependency_cache);
+  }
+  if (generation < 0) {
+    Fail("Could not start serving: %s\n", strerror(errno));
+  }
+  close(sockets[1]);
+  return sockets[0];
+}
+
+// Serves the runs that clients request on the socket at |socket_path|,
+// forever. This process only accepts the connections, and passes each to the
+// current generation: the process that holds the dependencies compiled so
+// far, and that is replaced by one of its children whenever that child has
+// compiled more.
+[[noreturn]] void Serve(const std::string& socket_path) {
+  std::string error;
+  int listener = fidl::ListenOnSocket(socket_path, &error);
+  if (listener < 0) {
+    Fail("%s\n", error.data());
+  }
+  // Clients that go away only fail their own requests, and the processes
+  // that handle requests are reaped as they exit. Each generation outlives
+  // the one that forked it, so this process adopts it, rather than init.
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGCHLD, SIG_IGN);
+  prctl(PR_SET_CHILD_SUBREAPER, 1);
+
+  int generation = StartGeneration(listener);
+  for (;;) {
+    struct pollfd fds[2] = {{listener, POLLIN, 0}, {generation, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      Fail("Could not wait for a connection: %s\n", strerror(errno));
+    }
+    if (fds[1].revents != 0) {
+      // A newer generation takes over, or the current one is gone. Closing
+      // the socket to the old one is what makes it exit.
+      int next = fidl::ReceiveDescriptor(generation);
+      close(generation);
+      generation = next >= 0 ? next : StartGeneration(listener);
+    }
+    if (fds[0].revents != 0) {
+      int connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (connection < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+        Fail("Could not accept a connection: %s\n", strerror(errno));
+      }
+      // If the generation is gone, the client only sees its connection close.
+      fidl::SendDescriptor(generation, connection);
+      close(connection);
+    }
+  }
+}
+
+// Has the server listening on |socket_path| run fidlc with |arguments| on
+// behalf of this process, and returns its exit status. Returns -1 if there
+// is no server to do so.
+int Forward(const std::string& socket_path, const std::vector<std::string>& arguments) {
+  int connection = fidl::ConnectToSocket(socket_path);
+  if (connection < 0) {
+    return -1;
+  }
+  fidl::CompileRequest request;
+  char working_directory[PATH_MAX];
+  if (getcwd(working_directory, sizeof(working_directory)) == nullptr) {
+    Fail("Could not get the current directory: %s\n", strerror(errno));
+  }
+  request.working_directory = working_directory;
+  request.arguments = arguments;
+  request.stdout_fd = STDOUT_FILENO;
+  request.stderr_fd = STDERR_FILENO;
+  fflush(stdout);
+  fflush(stderr);
+  int status;
+  if (!fidl::SendRequest(connection, request) || !fidl::ReceiveStatus(connection, &status)) {
+    Fail("Lost the connection to the fidlc server on %s\n", socket_path.data());
+  }
+  close(connection);
+  return status;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "--server") == 0) {
+        if (argc != 3) {
+            FailWithUsage("--server takes a socket path, and nothing else\n");
+        }
+        Serve(argv[2]);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--connect") == 0) {
+        if (argc < 3) {
+            FailWithUsage("Missing part of an argument\n");
+        }
+        int status = Forward(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        if (status >= 0) {
+            return status;
+        }
+        // Without a server, the run is done here instead.
+        argv[2] = argv[0];
+        return Run(argc - 2, argv + 2, nullptr);
+    }
+    return Run(argc, argv, nullptr);
+}
@@ -341,6 +341,10 @@ std::string NameLibraryCHeader(const std::vector<StringView>& library_name) {
     return StringJoin(library_name, "/") + "/c/fidl.h";
 }
 
+std::string NameLibraryCppHeader(const std::vector<StringView>& library_name) {
+    return StringJoin(library_name, "/") + "/cpp/fidl.h";
+}
+
 std::string NameDiscoverable(const flat::Interface& interface) {
     return NameName(interface.name, "_", "_");
 }
@@ -350,7 +354,7 @@ std::string NameMethod(StringView interface_name, const flat::Interface::Method&
 }
 
 std::string NameInterface(const flat::Interface& interface) {
-    return NameName(interface.name, ".", ".");
+    return NameName(interface.name, "_", "_");
 }
 
 std::string NameOrdinal(StringView method_name) {
@@ -431,4 +435,17 @@ std::string NameCodedString(uint64_t max_size, types::Nullability nullability) {
     return name;
 }
 
+std::string NameCodedHandle(types::Nullability nullability) {
+    std::string name("Handle");
+    name += NameNullability(nullability);
+    return name;
+}
+
+std::string NameCodedInterfaceHandle(StringView interface_name, types::Nullability nullability) {
+    std::string name("Interface");
+    name += interface_name;
+    name += NameNullability(nullability);
+    return name;
+}
+
 } // namespace fidl
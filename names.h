@@ -18,6 +18,7 @@ std::string NameName(const flat::Name& name, StringView library_separator, Strin
 
 std::string NameLibrary(const std::vector<StringView>& library_name);
 std::string NameLibraryCHeader(const std::vector<StringView>& library_name);
+std::string NameLibraryCppHeader(const std::vector<StringView>& library_name);
 
 std::string NamePrimitiveCType(types::PrimitiveSubtype subtype);
 std::string NamePrimitiveSubtype(types::PrimitiveSubtype subtype);
@@ -50,6 +51,8 @@ std::string NameCodedArray(StringView element_name, uint64_t size);
 std::string NameCodedVector(StringView element_name, uint64_t max_size,
                             types::Nullability nullability);
 std::string NameCodedString(uint64_t max_size, types::Nullability nullability);
+std::string NameCodedHandle(types::Nullability nullability);
+std::string NameCodedInterfaceHandle(StringView interface_name, types::Nullability nullability);
 
 } // namespace fidl
 
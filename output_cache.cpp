@@ -0,0 +1,160 @@
+#include "output_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fidl {
+
+namespace {
+
+// Entries start with this, and change it whenever their layout does.
+constexpr char kMagic[] = "fidlc-output-cache-1\n";
+
+// The rest of an entry is, in the host's byte order:
+//
+//     uint32_t file count
+//     for each file: uint32_t output, uint32_t name size, uint64_t contents
+//                    size, name, contents
+//     uint64_t diagnostics size, diagnostics
+//
+// which is read back with bounds checks throughout, so that a damaged entry
+// is a miss rather than garbage.
+template <typename IntegerType>
+void AppendInteger(std::string* data, IntegerType value) {
+    data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+class EntryReader {
+public:
+    explicit EntryReader(const std::string& data)
+        : data_(data) {}
+
+    template <typename IntegerType>
+    bool ReadInteger(IntegerType* out_value) {
+        if (data_.size() - pos_ < sizeof(IntegerType))
+            return false;
+        memcpy(out_value, data_.data() + pos_, sizeof(IntegerType));
+        pos_ += sizeof(IntegerType);
+        return true;
+    }
+
+    bool ReadBytes(uint64_t size, std::string* out_bytes) {
+        if (data_.size() - pos_ < size)
+            return false;
+        out_bytes->assign(data_, pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool Done() const { return pos_ == data_.size(); }
+
+private:
+    const std::string& data_;
+    size_t pos_ = 0u;
+};
+
+bool ReadAll(int fd, std::string* out_data) {
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return false;
+    out_data->resize(static_cast<size_t>(st.st_size));
+    size_t done = 0u;
+    while (done < out_data->size()) {
+        ssize_t count = read(fd, &(*out_data)[done], out_data->size() - done);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        done += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool WriteAll(int fd, const std::string& data) {
+    size_t done = 0u;
+    while (done < data.size()) {
+        ssize_t count = write(fd, data.data() + done, data.size() - done);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        done += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+} // namespace
+
+bool OutputCache::Lookup(const std::string& key, Entry* out_entry) const {
+    std::string path = directory_ + "/" + key;
+    int fd = open(path.data(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    std::string data;
+    bool read_all = ReadAll(fd, &data);
+    close(fd);
+    if (!read_all)
+        return false;
+
+    EntryReader reader(data);
+    std::string magic;
+    if (!reader.ReadBytes(sizeof(kMagic) - 1u, &magic) || magic != kMagic)
+        return false;
+    Entry entry;
+    uint32_t file_count;
+    if (!reader.ReadInteger(&file_count))
+        return false;
+    for (uint32_t i = 0u; i < file_count; ++i) {
+        File file;
+        uint32_t name_size;
+        uint64_t contents_size;
+        if (!reader.ReadInteger(&file.output) || !reader.ReadInteger(&name_size) ||
+            !reader.ReadInteger(&contents_size) || !reader.ReadBytes(name_size, &file.name) ||
+            !reader.ReadBytes(contents_size, &file.contents))
+            return false;
+        entry.files.push_back(std::move(file));
+    }
+    uint64_t diagnostics_size;
+    if (!reader.ReadInteger(&diagnostics_size) ||
+        !reader.ReadBytes(diagnostics_size, &entry.diagnostics) || !reader.Done())
+        return false;
+    *out_entry = std::move(entry);
+    return true;
+}
+
+bool OutputCache::Store(const std::string& key, const Entry& entry) const {
+    std::string data(kMagic);
+    AppendInteger(&data, static_cast<uint32_t>(entry.files.size()));
+    for (const auto& file : entry.files) {
+        AppendInteger(&data, file.output);
+        AppendInteger(&data, static_cast<uint32_t>(file.name.size()));
+        AppendInteger(&data, static_cast<uint64_t>(file.contents.size()));
+        data.append(file.name);
+        data.append(file.contents);
+    }
+    AppendInteger(&data, static_cast<uint64_t>(entry.diagnostics.size()));
+    data.append(entry.diagnostics);
+
+    // The temporary file is in the cache directory itself, so that renaming
+    // it into place is atomic.
+    std::string path = directory_ + "/" + key;
+    std::string temporary_path = path + ".XXXXXX";
+    int fd = mkstemp(&temporary_path[0]);
+    if (fd < 0)
+        return false;
+    bool written = fchmod(fd, 0644) == 0 && WriteAll(fd, data);
+    if (close(fd) != 0)
+        written = false;
+    if (!written || rename(temporary_path.data(), path.data()) != 0) {
+        unlink(temporary_path.data());
+        return false;
+    }
+    return true;
+}
+
+} // namespace fidl
@@ -0,0 +1,52 @@
+#ifndef OUTPUT_CACHE_H_
+#define OUTPUT_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fidl {
+
+// A directory of the outputs of earlier runs of fidlc, each stored under a
+// key that is the digest of everything that determined them: the compiler,
+// its flags and its inputs. Each entry is one file, named after its key,
+// which is written to a temporary file first and then renamed into place, so
+// that any number of processes can fill and read the same cache at once and
+// only ever see whole entries. Entries are never removed.
+class OutputCache {
+public:
+    // A file of an output. Outputs of several files, such as a directory of
+    // headers, have one per file, told apart by |name|.
+    struct File {
+        uint32_t output;
+        std::string name;
+        std::string contents;
+    };
+
+    struct Entry {
+        std::vector<File> files;
+        // What the run printed about the library, such as its warnings.
+        std::string diagnostics;
+    };
+
+    explicit OutputCache(std::string directory)
+        : directory_(std::move(directory)) {}
+
+    // Reads the entry stored under |key| into |out_entry|. Returns false if
+    // there is none, or if it cannot be read.
+    bool Lookup(const std::string& key, Entry* out_entry) const;
+
+    // Stores |entry| under |key|, in place of any entry already there.
+    // Returns false if it cannot be written, in which case the cache is left
+    // as it was.
+    bool Store(const std::string& key, const Entry& entry) const;
+
+private:
+    std::string directory_;
+};
+
+} // namespace fidl
+
+#endif // OUTPUT_CACHE_H_
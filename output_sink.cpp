@@ -0,0 +1,123 @@
+#include "output_sink.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace fidl {
+
+namespace {
+
+// Writes all of |iov|, retrying on short writes and interruptions.
+bool WriteAll(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        size_t remaining = static_cast<size_t>(written);
+        while (count > 0 && remaining >= iov->iov_len) {
+            remaining -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+OutputSink::OutputSink()
+    : OutputSink(-1) {}
+
+OutputSink::OutputSink(int fd)
+    : fd_(fd), buffer_(new char[kBufferSize]) {}
+
+OutputSink::~OutputSink() {
+    Flush();
+}
+
+void OutputSink::Append(const char* data, size_t size) {
+    if (size <= kBufferSize - size_) {
+        memcpy(buffer_.get() + size_, data, size);
+        size_ += size;
+        return;
+    }
+    // Rather than copying |data| through the buffer, pass both along at once.
+    Drain(data, size);
+}
+
+void OutputSink::AppendSigned(int64_t value) {
+    if (value < 0) {
+        *this << '-';
+        // Negate in unsigned arithmetic, which is well defined for the
+        // smallest int64_t too.
+        AppendUnsigned(0u - static_cast<uint64_t>(value), 10u);
+    } else {
+        AppendUnsigned(static_cast<uint64_t>(value), 10u);
+    }
+}
+
+void OutputSink::AppendUnsigned(uint64_t value, unsigned base) {
+    static constexpr char kDigits[] = "0123456789ABCDEF";
+    if (kBufferSize - size_ < kMaxIntegerSize)
+        Drain(nullptr, 0u);
+    // Write the digits backwards into a scratch area, then move them into
+    // place.
+    char digits[kMaxIntegerSize];
+    char* end = digits + kMaxIntegerSize;
+    char* begin = end;
+    do {
+        *--begin = kDigits[value % base];
+        value /= base;
+    } while (value != 0u);
+    size_t count = static_cast<size_t>(end - begin);
+    memcpy(buffer_.get() + size_, begin, count);
+    size_ += count;
+}
+
+void OutputSink::Drain(const char* data, size_t size) {
+    if (fd_ < 0) {
+        contents_.append(buffer_.get(), size_);
+        if (data != nullptr)
+            contents_.append(data, size);
+        size_ = 0u;
+        return;
+    }
+    struct iovec iov[2];
+    int count = 0;
+    if (size_ > 0u) {
+        iov[count].iov_base = buffer_.get();
+        iov[count].iov_len = size_;
+        ++count;
+    }
+    if (size > 0u) {
+        iov[count].iov_base = const_cast<char*>(data);
+        iov[count].iov_len = size;
+        ++count;
+    }
+    if (ok_ && !WriteAll(fd_, iov, count))
+        ok_ = false;
+    size_ = 0u;
+}
+
+bool OutputSink::Flush() {
+    Drain(nullptr, 0u);
+    return ok_;
+}
+
+std::string OutputSink::TakeContents() {
+    Drain(nullptr, 0u);
+    std::string contents;
+    contents.swap(contents_);
+    return contents;
+}
+
+} // namespace fidl
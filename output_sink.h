@@ -0,0 +1,110 @@
+#ifndef OUTPUT_SINK_H_
+#define OUTPUT_SINK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "string_view.h"
+
+namespace fidl {
+
+// Formats |value| as upper case hexadecimal digits, without a prefix.
+struct Hex {
+    explicit Hex(uint64_t value) : value(value) {}
+    uint64_t value;
+};
+
+// OutputSink is what the code generators write their output into. Output is
+// collected in a large buffer, which is either written to a file descriptor
+// whenever it fills up, or kept in memory.
+//
+// Only strings, characters and integers can be appended. Unlike
+// std::ostream, a uint8_t or int8_t is not implicitly appended as a
+// character, and bool is not accepted at all.
+class OutputSink {
+public:
+    // Keeps the output in memory, to be retrieved with TakeContents().
+    OutputSink();
+    // Writes the output to |fd|, which remains owned by the caller.
+    explicit OutputSink(int fd);
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    OutputSink& operator<<(StringView value) {
+        Append(value.data(), value.size());
+        return *this;
+    }
+
+    OutputSink& operator<<(const std::string& value) {
+        Append(value.data(), value.size());
+        return *this;
+    }
+
+    OutputSink& operator<<(const char* value) {
+        return *this << StringView(value);
+    }
+
+    OutputSink& operator<<(char value) {
+        if (size_ == kBufferSize)
+            Drain(nullptr, 0u);
+        buffer_[size_++] = value;
+        return *this;
+    }
+
+    template <typename IntegerType,
+              typename = std::enable_if_t<std::is_integral<IntegerType>::value &&
+                                          !std::is_same<IntegerType, bool>::value &&
+                                          !std::is_same<IntegerType, char>::value &&
+                                          !std::is_same<IntegerType, signed char>::value &&
+                                          !std::is_same<IntegerType, unsigned char>::value>>
+    OutputSink& operator<<(IntegerType value) {
+        if (std::is_signed<IntegerType>::value) {
+            AppendSigned(static_cast<int64_t>(value));
+        } else {
+            AppendUnsigned(static_cast<uint64_t>(value), 10u);
+        }
+        return *this;
+    }
+
+    OutputSink& operator<<(Hex value) {
+        AppendUnsigned(value.value, 16u);
+        return *this;
+    }
+
+    void Append(const char* data, size_t size);
+
+    // Writes out any buffered output. Returns false if writing to the file
+    // descriptor failed, now or at any earlier point.
+    bool Flush();
+
+    // Returns the output collected by an in-memory sink, and empties it.
+    std::string TakeContents();
+
+private:
+    static constexpr size_t kBufferSize = 256u * 1024u;
+    // Enough digits for any uint64_t.
+    static constexpr size_t kMaxIntegerSize = 20u;
+
+    void AppendSigned(int64_t value);
+    void AppendUnsigned(uint64_t value, unsigned base);
+
+    // Moves the buffered output, followed by |size| bytes at |data|, to the
+    // file descriptor or to |contents_|, and empties the buffer.
+    void Drain(const char* data, size_t size);
+
+    const int fd_;
+    bool ok_ = true;
+    std::unique_ptr<char[]> buffer_;
+    size_t size_ = 0u;
+    std::string contents_;
+};
+
+} // namespace fidl
+
+#endif // OUTPUT_SINK_H_
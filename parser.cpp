@@ -19,7 +19,7 @@ enum {
 } // namespace
 
 Parser::Parser(Lexer* lexer, ErrorReporter* error_reporter)
-    : lexer_(lexer), error_reporter_(error_reporter) {
+    : lexer_(lexer), error_reporter_(error_reporter), checkpoint_(error_reporter->Checkpoint()) {
     last_token_ = Lex();
 }
 
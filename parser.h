@@ -13,7 +13,9 @@ public:
 
     std::unique_ptr<raw::File> Parse() { return ParseFile(); }
 
-    bool Ok() const { return error_reporter_->errors().size() == 0; }
+    // Whether no errors were reported since the parser was created, so that
+    // errors about other files do not fail this one.
+    bool Ok() const { return checkpoint_.NoNewErrors(); }
 
 private:
     Token Lex() { return lexer_->LexNoComments(); }
@@ -217,6 +219,7 @@ private:
 
     Lexer* lexer_;
     ErrorReporter* error_reporter_;
+    const ErrorReporter::Counts checkpoint_;
 
     std::vector<raw::SourceElement> active_ast_scopes_;
     SourceLocation gap_start_;
@@ -0,0 +1,128 @@
+#include "sha256.h"
+
+#include <string.h>
+
+namespace fidl {
+
+namespace {
+
+// FIPS 180-4, section 4.2.2.
+constexpr uint32_t kRoundConstants[64] = {
+    0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u,
+    0xab1c5ed5u, 0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu,
+    0x9bdc06a7u, 0xc19bf174u, 0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu,
+    0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau, 0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u,
+    0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u, 0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu,
+    0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u, 0xa2bfe8a1u, 0xa81a664bu,
+    0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u, 0x19a4c116u,
+    0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+    0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u,
+    0xc67178f2u,
+};
+
+uint32_t RotateRight(uint32_t value, unsigned bits) {
+    return (value >> bits) | (value << (32u - bits));
+}
+
+} // namespace
+
+Sha256::Sha256()
+    : state_{0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+             0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u} {}
+
+void Sha256::Compress(const uint8_t block[64]) {
+    uint32_t schedule[64];
+    for (int i = 0; i < 16; ++i) {
+        schedule[i] = static_cast<uint32_t>(block[i * 4]) << 24 |
+                      static_cast<uint32_t>(block[i * 4 + 1]) << 16 |
+                      static_cast<uint32_t>(block[i * 4 + 2]) << 8 |
+                      static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = RotateRight(schedule[i - 15], 7) ^ RotateRight(schedule[i - 15], 18) ^
+                      (schedule[i - 15] >> 3);
+        uint32_t s1 = RotateRight(schedule[i - 2], 17) ^ RotateRight(schedule[i - 2], 19) ^
+                      (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + s1 + choice + kRoundConstants[i] + schedule[i];
+        uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+}
+
+void Sha256::Update(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    total_size_ += size;
+    if (block_size_ != 0u) {
+        size_t fill = sizeof(block_) - block_size_;
+        if (size < fill) {
+            memcpy(block_ + block_size_, bytes, size);
+            block_size_ += size;
+            return;
+        }
+        memcpy(block_ + block_size_, bytes, fill);
+        Compress(block_);
+        bytes += fill;
+        size -= fill;
+        block_size_ = 0u;
+    }
+    for (; size >= sizeof(block_); bytes += sizeof(block_), size -= sizeof(block_))
+        Compress(bytes);
+    memcpy(block_, bytes, size);
+    block_size_ = size;
+}
+
+void Sha256::Finish(uint8_t digest[kDigestSize]) {
+    uint64_t total_bits = total_size_ * 8u;
+    uint8_t padding[72] = {0x80u};
+    // Pad to 56 bytes past a block boundary, which leaves room for the size.
+    size_t padding_size = block_size_ < 56u ? 56u - block_size_ : 120u - block_size_;
+    for (int i = 0; i < 8; ++i)
+        padding[padding_size + i] = static_cast<uint8_t>(total_bits >> (56 - i * 8));
+    Update(padding, padding_size + 8u);
+    for (int i = 0; i < 8; ++i) {
+        digest[i * 4] = static_cast<uint8_t>(state_[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+    }
+}
+
+std::string Sha256::HexDigest() {
+    uint8_t digest[kDigestSize];
+    Finish(digest);
+    static const char kDigits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(kDigestSize * 2u);
+    for (uint8_t byte : digest) {
+        hex.push_back(kDigits[byte >> 4]);
+        hex.push_back(kDigits[byte & 0xfu]);
+    }
+    return hex;
+}
+
+} // namespace fidl
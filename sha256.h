@@ -0,0 +1,39 @@
+#ifndef SHA256_H_
+#define SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "string_view.h"
+
+namespace fidl {
+
+// Computes the SHA-256 digest of the data given to Update(), in pieces.
+class Sha256 {
+public:
+    static constexpr size_t kDigestSize = 32u;
+
+    Sha256();
+
+    void Update(const void* data, size_t size);
+    void Update(StringView data) { Update(data.data(), data.size()); }
+
+    // Returns the digest as lower case hexadecimal digits. No more data can be
+    // given afterwards.
+    std::string HexDigest();
+
+private:
+    void Finish(uint8_t digest[kDigestSize]);
+    void Compress(const uint8_t block[64]);
+
+    uint32_t state_[8];
+    uint8_t block_[64];
+    size_t block_size_ = 0u;
+    uint64_t total_size_ = 0u;
+};
+
+} // namespace fidl
+
+#endif // SHA256_H_
@@ -6,14 +6,18 @@
 namespace fidl {
 
 bool SourceManager::CreateSource(StringView filename) {
+    return CreateSource(filename, filename);
+}
+
+bool SourceManager::CreateSource(StringView filename, StringView path) {
     struct stat s;
-    if (stat(filename.data(), &s) != 0)
+    if (stat(path.data(), &s) != 0)
         return false;
 
     if ((s.st_mode & S_IFREG) != S_IFREG)
         return false;
 
-    FILE* file = fopen(filename.data(), "rb");
+    FILE* file = fopen(path.data(), "rb");
     if (!file)
         return false;
 
@@ -12,6 +12,9 @@ namespace fidl {
 class SourceManager {
 public:
     bool CreateSource(StringView filename);
+    // Reads the file at |path|, but names it |filename|, for a |filename|
+    // that is relative to another directory than the current one.
+    bool CreateSource(StringView filename, StringView path);
     void AddSourceFile(std::unique_ptr<SourceFile> file);
 
     const std::vector<std::unique_ptr<SourceFile>>& sources() const { return sources_; }
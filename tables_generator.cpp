@@ -0,0 +1,428 @@
+#include "tables_generator.h"
+
+#include <assert.h>
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "names.h"
+
+namespace fidl {
+
+namespace {
+
+constexpr const char* kIndent = "    ";
+
+// The offsets in a message's coding table include the transactional message
+// header, which the message's typeshape leaves out.
+constexpr uint32_t kMessageHeaderSize = 16u;
+
+// Returns |count|, a bound on the number of elements in a string or vector,
+// in the form the names of coding tables expect.
+uint64_t NameableCount(uint32_t count) {
+    if (count == std::numeric_limits<uint32_t>::max())
+        return std::numeric_limits<uint64_t>::max();
+    return count;
+}
+
+void EmitCount(OutputSink* file, uint32_t count) {
+    if (count == std::numeric_limits<uint32_t>::max()) {
+        *file << "FIDL_MAX_SIZE";
+    } else {
+        *file << count;
+    }
+}
+
+void EmitNullability(OutputSink* file, types::Nullability nullability) {
+    switch (nullability) {
+    case types::Nullability::kNullable:
+        *file << "::fidl::kNullable";
+        break;
+    case types::Nullability::kNonnullable:
+        *file << "::fidl::kNonnullable";
+        break;
+    }
+}
+
+void EmitPrettyName(OutputSink* file, StringView pretty_name) {
+    *file << '"' << pretty_name << '"';
+}
+
+} // namespace
+
+bool TablesGenerator::StructNeedsCoding(const flat::Struct* struct_decl) {
+    auto iter = struct_needs_coding_.find(struct_decl);
+    if (iter != struct_needs_coding_.end())
+        return iter->second;
+    bool needs_coding = false;
+    for (const auto& member : struct_decl->members) {
+        if (NeedsCoding(member.type_ctor->type)) {
+            needs_coding = true;
+            break;
+        }
+    }
+    struct_needs_coding_.emplace(struct_decl, needs_coding);
+    return needs_coding;
+}
+
+bool TablesGenerator::NeedsCoding(const flat::Type* type) {
+    if (type->nullability == types::Nullability::kNullable)
+        return true;
+    switch (type->kind) {
+    case flat::Type::Kind::kPrimitive:
+        return false;
+    case flat::Type::Kind::kArray:
+        return NeedsCoding(static_cast<const flat::ArrayType*>(type)->element_type);
+    case flat::Type::Kind::kVector:
+    case flat::Type::Kind::kString:
+    case flat::Type::Kind::kHandle:
+        return true;
+    case flat::Type::Kind::kIdentifier: {
+        auto decl = static_cast<const flat::IdentifierType*>(type)->type_decl;
+        switch (decl->kind) {
+        case flat::Decl::Kind::kBits:
+        case flat::Decl::Kind::kConst:
+        case flat::Decl::Kind::kEnum:
+            return false;
+        case flat::Decl::Kind::kStruct:
+            return StructNeedsCoding(static_cast<const flat::Struct*>(decl));
+        case flat::Decl::Kind::kInterface:
+        case flat::Decl::Kind::kTable:
+        case flat::Decl::Kind::kUnion:
+        case flat::Decl::Kind::kXUnion:
+            return true;
+        }
+    }
+    }
+    assert(false && "unknown type kind");
+    return true;
+}
+
+std::string TablesGenerator::DeclTableName(const flat::Decl* decl) {
+    std::string table_name = NameTable(NameName(decl->name, "_", "_"));
+    declared_tables_.insert(table_name);
+    return table_name;
+}
+
+std::string TablesGenerator::TypeName(const flat::Type* type) {
+    switch (type->kind) {
+    case flat::Type::Kind::kArray: {
+        auto array_type = static_cast<const flat::ArrayType*>(type);
+        return NameCodedArray(TypeName(array_type->element_type),
+                              array_type->element_count->value);
+    }
+    case flat::Type::Kind::kVector: {
+        auto vector_type = static_cast<const flat::VectorType*>(type);
+        return NameCodedVector(TypeName(vector_type->element_type),
+                               NameableCount(vector_type->element_count->value),
+                               vector_type->nullability);
+    }
+    case flat::Type::Kind::kString: {
+        auto string_type = static_cast<const flat::StringType*>(type);
+        return NameCodedString(NameableCount(string_type->max_size->value),
+                               string_type->nullability);
+    }
+    case flat::Type::Kind::kHandle:
+        return NameCodedHandle(type->nullability);
+    case flat::Type::Kind::kPrimitive:
+        return NamePrimitiveSubtype(static_cast<const flat::PrimitiveType*>(type)->subtype);
+    case flat::Type::Kind::kIdentifier: {
+        auto identifier_type = static_cast<const flat::IdentifierType*>(type);
+        std::string name = NameName(identifier_type->name, "_", "_");
+        if (identifier_type->type_decl->kind == flat::Decl::Kind::kInterface)
+            return NameCodedInterfaceHandle(name, type->nullability);
+        if (type->nullability == types::Nullability::kNonnullable)
+            return name;
+        // Nullable xunions are inline, like non-nullable ones.
+        if (identifier_type->type_decl->kind == flat::Decl::Kind::kXUnion)
+            return name + "Nullable";
+        return NamePointer(name);
+    }
+    }
+    assert(false && "unknown type kind");
+    return std::string();
+}
+
+void TablesGenerator::EmitReference(OutputSink* file, StringView coded_name) {
+    if (coded_name.size() == 0u) {
+        *file << "nullptr";
+    } else {
+        *file << '&' << coded_name;
+    }
+}
+
+std::string TablesGenerator::CodedName(const flat::Type* type) {
+    if (!NeedsCoding(type))
+        return std::string();
+
+    if (type->kind == flat::Type::Kind::kIdentifier &&
+        type->nullability == types::Nullability::kNonnullable) {
+        auto decl = static_cast<const flat::IdentifierType*>(type)->type_decl;
+        if (decl->kind != flat::Decl::Kind::kInterface)
+            return DeclTableName(decl);
+    }
+
+    std::string table_name = NameTable(TypeName(type));
+    if (!anonymous_tables_.insert(table_name).second)
+        return table_name;
+
+    // Tables the new one refers to are emitted first, and so precede it.
+    OutputSink* file = &anonymous_file_;
+    switch (type->kind) {
+    case flat::Type::Kind::kArray: {
+        auto array_type = static_cast<const flat::ArrayType*>(type);
+        std::string element_name = CodedName(array_type->element_type);
+        *file << "static const fidl_type_t " << table_name
+              << " = fidl_type_t(::fidl::FidlCodedArray(&" << element_name << ", "
+              << array_type->shape.Size() << ", " << array_type->element_type->shape.Size()
+              << "));\n";
+        break;
+    }
+    case flat::Type::Kind::kVector: {
+        auto vector_type = static_cast<const flat::VectorType*>(type);
+        std::string element_name = CodedName(vector_type->element_type);
+        *file << "static const fidl_type_t " << table_name << " = fidl_type_t(::fidl::FidlCodedVector(";
+        EmitReference(file, element_name);
+        *file << ", ";
+        EmitCount(file, vector_type->element_count->value);
+        *file << ", " << vector_type->element_type->shape.Size() << ", ";
+        EmitNullability(file, vector_type->nullability);
+        *file << "));\n";
+        break;
+    }
+    case flat::Type::Kind::kString: {
+        auto string_type = static_cast<const flat::StringType*>(type);
+        *file << "static const fidl_type_t " << table_name << " = fidl_type_t(::fidl::FidlCodedString(";
+        EmitCount(file, string_type->max_size->value);
+        *file << ", ";
+        EmitNullability(file, string_type->nullability);
+        *file << "));\n";
+        break;
+    }
+    case flat::Type::Kind::kHandle: {
+        *file << "static const fidl_type_t " << table_name
+              << " = fidl_type_t(::fidl::FidlCodedHandle(ZX_OBJ_TYPE_NONE, ";
+        EmitNullability(file, type->nullability);
+        *file << "));\n";
+        break;
+    }
+    case flat::Type::Kind::kPrimitive:
+        assert(false && "primitives need no coding");
+        break;
+    case flat::Type::Kind::kIdentifier: {
+        auto decl = static_cast<const flat::IdentifierType*>(type)->type_decl;
+        switch (decl->kind) {
+        case flat::Decl::Kind::kInterface:
+            *file << "static const fidl_type_t " << table_name
+                  << " = fidl_type_t(::fidl::FidlCodedHandle(ZX_OBJ_TYPE_CHANNEL, ";
+            EmitNullability(file, type->nullability);
+            *file << "));\n";
+            break;
+        case flat::Decl::Kind::kStruct:
+            *file << "static const fidl_type_t " << table_name
+                  << " = fidl_type_t(::fidl::FidlCodedStructPointer(&"
+                  << DeclTableName(decl) << ".coded_struct));\n";
+            break;
+        case flat::Decl::Kind::kUnion:
+            *file << "static const fidl_type_t " << table_name
+                  << " = fidl_type_t(::fidl::FidlCodedUnionPointer(&"
+                  << DeclTableName(decl) << ".coded_union));\n";
+            break;
+        case flat::Decl::Kind::kXUnion:
+            // A nullable xunion is laid out like a non-nullable one, so its
+            // table is a copy that only differs in its nullability.
+            GenerateXUnion(*static_cast<const flat::XUnion*>(decl), table_name,
+                           types::Nullability::kNullable, true);
+            break;
+        case flat::Decl::Kind::kBits:
+        case flat::Decl::Kind::kConst:
+        case flat::Decl::Kind::kEnum:
+        case flat::Decl::Kind::kTable:
+            assert(false && "declaration cannot be nullable");
+            break;
+        }
+        break;
+    }
+    }
+    return table_name;
+}
+
+void TablesGenerator::GenerateStruct(const flat::Struct& struct_decl, StringView table_name,
+                                     StringView pretty_name, uint32_t header_size) {
+    std::vector<std::pair<std::string, uint32_t>> fields;
+    for (const auto& member : struct_decl.members) {
+        std::string coded_name = CodedName(member.type_ctor->type);
+        if (coded_name.empty())
+            continue;
+        fields.emplace_back(std::move(coded_name), header_size + member.fieldshape.Offset());
+    }
+
+    std::string fields_name = NameFields(table_name);
+    if (!fields.empty()) {
+        named_file_ << "static const ::fidl::FidlStructField " << fields_name << "[] = {\n";
+        for (const auto& field : fields) {
+            named_file_ << kIndent << "::fidl::FidlStructField(&" << field.first << ", "
+                        << field.second << "),\n";
+        }
+        named_file_ << "};\n";
+    }
+    named_file_ << "const fidl_type_t " << table_name << " = fidl_type_t(::fidl::FidlCodedStruct("
+                << (fields.empty() ? "nullptr" : fields_name) << ", "
+                << static_cast<uint32_t>(fields.size()) << ", " << header_size + struct_decl.typeshape.Size() << ", ";
+    EmitPrettyName(&named_file_, pretty_name);
+    named_file_ << "));\n\n";
+}
+
+void TablesGenerator::GenerateTable(const flat::Table& table_decl) {
+    std::vector<std::pair<std::string, uint32_t>> fields;
+    for (const auto& member : table_decl.members) {
+        if (!member.maybe_used)
+            continue;
+        fields.emplace_back(CodedName(member.maybe_used->type_ctor->type), member.ordinal->value);
+    }
+
+    std::string table_name = DeclTableName(&table_decl);
+    std::string fields_name = NameFields(table_name);
+    if (!fields.empty()) {
+        named_file_ << "static const ::fidl::FidlTableField " << fields_name << "[] = {\n";
+        for (const auto& field : fields) {
+            named_file_ << kIndent << "::fidl::FidlTableField(";
+            EmitReference(&named_file_, field.first);
+            named_file_ << ", " << field.second << "),\n";
+        }
+        named_file_ << "};\n";
+    }
+    named_file_ << "const fidl_type_t " << table_name << " = fidl_type_t(::fidl::FidlCodedTable("
+                << (fields.empty() ? "nullptr" : fields_name) << ", "
+                << static_cast<uint32_t>(fields.size()) << ", ";
+    EmitPrettyName(&named_file_, NameName(table_decl.name, ".", "/"));
+    named_file_ << "));\n\n";
+}
+
+void TablesGenerator::GenerateUnion(const flat::Union& union_decl) {
+    std::string table_name = DeclTableName(&union_decl);
+    std::string members_name = NameMembers(table_name);
+    named_file_ << "static const fidl_type_t* " << members_name << "[] = {\n";
+    for (const auto& member : union_decl.members) {
+        named_file_ << kIndent;
+        EmitReference(&named_file_, CodedName(member.type_ctor->type));
+        named_file_ << ",\n";
+    }
+    named_file_ << "};\n";
+    named_file_ << "const fidl_type_t " << table_name << " = fidl_type_t(::fidl::FidlCodedUnion("
+                << members_name << ", " << static_cast<uint32_t>(union_decl.members.size())
+                << ", " << union_decl.membershape.Offset() << ", "
+                << union_decl.typeshape.Size() << ", ";
+    EmitPrettyName(&named_file_, NameName(union_decl.name, ".", "/"));
+    named_file_ << "));\n\n";
+}
+
+void TablesGenerator::GenerateXUnion(const flat::XUnion& xunion_decl, StringView table_name,
+                                     types::Nullability nullability, bool is_static) {
+    // The tables of the members are emitted before the fields refer to them.
+    std::vector<std::string> coded_names;
+    for (const auto& member : xunion_decl.members) {
+        coded_names.push_back(CodedName(member.type_ctor->type));
+    }
+
+    OutputSink* file = is_static ? &anonymous_file_ : &named_file_;
+    std::string fields_name = NameFields(table_name);
+    *file << "static const ::fidl::FidlXUnionField " << fields_name << "[] = {\n";
+    for (size_t i = 0; i < xunion_decl.members.size(); ++i) {
+        *file << kIndent << "::fidl::FidlXUnionField(";
+        EmitReference(file, coded_names[i]);
+        *file << ", " << xunion_decl.members[i].ordinal->value << "),\n";
+    }
+    *file << "};\n";
+    *file << (is_static ? "static const fidl_type_t " : "const fidl_type_t ") << table_name
+          << " = fidl_type_t(::fidl::FidlCodedXUnion("
+          << static_cast<uint32_t>(xunion_decl.members.size()) << ", " << fields_name << ", ";
+    EmitNullability(file, nullability);
+    *file << ", ";
+    EmitPrettyName(file, NameName(xunion_decl.name, ".", "/"));
+    *file << "));\n";
+    if (!is_static)
+        *file << "\n";
+}
+
+void TablesGenerator::GenerateInterface(const flat::Interface& interface_decl) {
+    std::string c_name = NameInterface(interface_decl);
+    std::string pretty_interface_name = NameName(interface_decl.name, ".", "/");
+    for (const auto& method_pointer : interface_decl.all_methods) {
+        assert(method_pointer != nullptr);
+        const auto& method = *method_pointer;
+        std::string method_name = NameMethod(c_name, method);
+        std::string pretty_method_name = NameMethod(pretty_interface_name, method);
+        if (method.maybe_request != nullptr) {
+            std::string table_name = NameTable(NameMessage(method_name, types::MessageKind::kRequest));
+            declared_tables_.insert(table_name);
+            GenerateStruct(*method.maybe_request, table_name,
+                           NameMessage(pretty_method_name, types::MessageKind::kRequest),
+                           kMessageHeaderSize);
+        }
+        if (method.maybe_response != nullptr) {
+            auto kind = method.maybe_request == nullptr ? types::MessageKind::kEvent
+                                                        : types::MessageKind::kResponse;
+            std::string table_name = NameTable(NameMessage(method_name, kind));
+            declared_tables_.insert(table_name);
+            GenerateStruct(*method.maybe_response, table_name,
+                           NameMessage(pretty_method_name, kind), kMessageHeaderSize);
+        }
+    }
+}
+
+void TablesGenerator::Produce(OutputSink* tables_file) {
+    for (const flat::Decl* decl : library_->declaration_order_) {
+        // Tables of dependencies are defined with their own library's.
+        if (decl->name.library() != library_)
+            continue;
+        switch (decl->kind) {
+        case flat::Decl::Kind::kBits:
+        case flat::Decl::Kind::kConst:
+        case flat::Decl::Kind::kEnum:
+            break;
+        case flat::Decl::Kind::kInterface:
+            GenerateInterface(*static_cast<const flat::Interface*>(decl));
+            break;
+        case flat::Decl::Kind::kStruct: {
+            auto struct_decl = static_cast<const flat::Struct*>(decl);
+            // Method messages are generated with their interface.
+            if (struct_decl->anonymous)
+                break;
+            GenerateStruct(*struct_decl, DeclTableName(struct_decl),
+                           NameName(struct_decl->name, ".", "/"), 0u);
+            break;
+        }
+        case flat::Decl::Kind::kTable:
+            GenerateTable(*static_cast<const flat::Table*>(decl));
+            break;
+        case flat::Decl::Kind::kUnion:
+            GenerateUnion(*static_cast<const flat::Union*>(decl));
+            break;
+        case flat::Decl::Kind::kXUnion: {
+            auto xunion_decl = static_cast<const flat::XUnion*>(decl);
+            GenerateXUnion(*xunion_decl, DeclTableName(xunion_decl),
+                           types::Nullability::kNonnullable, false);
+            break;
+        }
+        }
+    }
+
+    *tables_file << "// WARNING: This file is machine generated by fidlc.\n\n";
+    *tables_file << "#include <lib/fidl/internal.h>\n\n";
+    *tables_file << "extern \"C\" {\n\n";
+    for (const auto& table_name : declared_tables_) {
+        *tables_file << "extern const fidl_type_t " << table_name << ";\n";
+    }
+    if (!declared_tables_.empty())
+        *tables_file << "\n";
+    std::string anonymous_tables = anonymous_file_.TakeContents();
+    *tables_file << anonymous_tables;
+    if (!anonymous_tables.empty())
+        *tables_file << "\n";
+    *tables_file << named_file_.TakeContents();
+    *tables_file << "} // extern \"C\"\n";
+}
+
+} // namespace fidl
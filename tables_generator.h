@@ -0,0 +1,74 @@
+#ifndef TABLES_GENERATOR_H_
+#define TABLES_GENERATOR_H_
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "flat_ast.h"
+#include "output_sink.h"
+#include "string_view.h"
+
+namespace fidl {
+
+// Produces the fidl_type_t coding tables that fidl_encode() and fidl_decode()
+// walk for a library's structs, tables, unions, xunions and method messages,
+// which the C client and server refer to by their coded names.
+//
+// Tables are only emitted for types that need encoding or decoding: a struct
+// field of plain bytes, such as an integer, an enum or an array of them, has
+// no entry in its struct's table, and an array of them has no table at all.
+// Tables for anonymous types, such as vector<string:16>:8, are emitted once,
+// however many fields use them.
+class TablesGenerator {
+public:
+    explicit TablesGenerator(const flat::Library* library)
+        : library_(library) {}
+
+    ~TablesGenerator() = default;
+
+    void Produce(OutputSink* tables_file);
+
+private:
+    // Whether values of |type| contain pointers or handles, which the encoder
+    // and decoder need a table to find.
+    bool NeedsCoding(const flat::Type* type);
+    bool StructNeedsCoding(const flat::Struct* struct_decl);
+
+    // Returns the name of the table for |type|, emitting it first if it is
+    // the table of an anonymous type seen for the first time, or an empty
+    // string if |type| needs no coding.
+    std::string CodedName(const flat::Type* type);
+    // Returns the name of |type| as part of the name of an anonymous table.
+    std::string TypeName(const flat::Type* type);
+    // Returns the name of the table of |decl|, which is defined either below
+    // or with the tables of another library.
+    std::string DeclTableName(const flat::Decl* decl);
+
+    // Emits the pointer to |coded_name| that an anonymous table refers to,
+    // or nullptr for an empty |coded_name|.
+    void EmitReference(OutputSink* file, StringView coded_name);
+
+    void GenerateStruct(const flat::Struct& struct_decl, StringView table_name,
+                        StringView pretty_name, uint32_t header_size);
+    void GenerateTable(const flat::Table& table_decl);
+    void GenerateUnion(const flat::Union& union_decl);
+    void GenerateXUnion(const flat::XUnion& xunion_decl, StringView table_name,
+                        types::Nullability nullability, bool is_static);
+    void GenerateInterface(const flat::Interface& interface_decl);
+
+    const flat::Library* library_;
+    std::map<const flat::Struct*, bool> struct_needs_coding_;
+    // Every named table referred to or defined, which are all declared up
+    // front so that definitions can refer to each other in any order.
+    std::set<std::string> declared_tables_;
+    std::set<std::string> anonymous_tables_;
+    // Anonymous tables are collected separately from the named ones, so that
+    // they are all defined before anything refers to them.
+    OutputSink anonymous_file_;
+    OutputSink named_file_;
+};
+
+} // namespace fidl
+
+#endif // TABLES_GENERATOR_H_
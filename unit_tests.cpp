@@ -1,7 +1,16 @@
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include "gtest/gtest.h"
+#include "compile_server.h"
+#include "flat_ast.h"
+#include "layout_report_generator.h"
 #include "lexer.h"
+#include "output_sink.h"
 #include "parser.h"
 #include "source_file.h"
+#include "tables_generator.h"
 
 TEST(SourceFileTest, ReadsLines) {
     auto src = fidl::SourceFile("myfile.txt", "line1\nline2\nlonger line3");
@@ -42,3 +51,243 @@ TEST(ParserTest, Const) {
     auto ast = parser.Parse();
     ASSERT_TRUE(parser.Ok());
 }
+
+TEST(ErrorReporterTest, MaxErrors) {
+    std::string data = "library textures;\nconst int8 offset = -33;";
+    fidl::SourceFile src("myfile.txt", std::move(data));
+    fidl::ErrorReporter error_reporter(false, 2u);
+    fidl::Lexer lexer(src, &error_reporter);
+
+    auto checkpoint = error_reporter.Checkpoint();
+    error_reporter.ReportError(lexer.Lex(), "first");
+    error_reporter.ReportError(lexer.Lex(), "second");
+    ASSERT_TRUE(error_reporter.LimitReached());
+    error_reporter.ReportError("third");
+
+    ASSERT_FALSE(checkpoint.NoNewErrors());
+    ASSERT_EQ(error_reporter.num_errors(), 3u);
+    ASSERT_EQ(error_reporter.errors().size(), 2u);
+    ASSERT_EQ(error_reporter.errors()[1].Format(),
+              "myfile.txt:1:8: error: second\nlibrary textures;\n        ^~~~~~~~");
+}
+
+TEST(ErrorReporterTest, MaxErrorsStopsParsing) {
+    std::string data = "library textures;\nconst int8 offset = -33 $ $ $ $;\nstruct S { $ };";
+    fidl::SourceFile src("myfile.txt", std::move(data));
+    fidl::ErrorReporter error_reporter(false, 2u);
+    fidl::Lexer lexer(src, &error_reporter);
+    fidl::Parser parser(&lexer, &error_reporter);
+
+    auto ast = parser.Parse();
+    ASSERT_FALSE(parser.Ok());
+    ASSERT_TRUE(error_reporter.LimitReached());
+    ASSERT_EQ(error_reporter.num_errors(), 2u);
+    ASSERT_EQ(error_reporter.errors().size(), 2u);
+}
+
+TEST(CompileServerTest, ClientDisconnectsBeforeRequest) {
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    close(sockets[0]);
+
+    fidl::CompileRequest request;
+    ASSERT_FALSE(fidl::ReceiveRequest(sockets[1], &request));
+    ASSERT_EQ(request.stdout_fd, -1);
+    ASSERT_EQ(request.stderr_fd, -1);
+    close(sockets[1]);
+}
+
+TEST(CompileServerTest, ClientDisconnectsWithinRequestHeader) {
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    // Half of the size of the payload, with the client's stdout and stderr.
+    uint16_t partial_size = 0u;
+    struct iovec iov = {&partial_size, sizeof(partial_size)};
+    int fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+    struct msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+    ASSERT_EQ(sendmsg(sockets[0], &message, 0), static_cast<ssize_t>(sizeof(partial_size)));
+    close(sockets[0]);
+
+    fidl::CompileRequest request;
+    ASSERT_FALSE(fidl::ReceiveRequest(sockets[1], &request));
+    ASSERT_EQ(request.stdout_fd, -1);
+    ASSERT_EQ(request.stderr_fd, -1);
+    close(sockets[1]);
+}
+
+TEST(OutputSinkTest, Formats) {
+    fidl::OutputSink sink;
+    sink << "size " << std::string("is") << ' ' << uint32_t(42u) << ", "
+         << int64_t(-9223372036854775807 - 1) << ", 0x" << fidl::Hex(0xbeefu);
+    ASSERT_EQ(sink.TakeContents(), "size is 42, -9223372036854775808, 0xBEEF");
+
+    // Output much larger than the buffer is passed through in order.
+    std::string large(1024u * 1024u, 'x');
+    sink << uint64_t(18446744073709551615u) << large << 'y';
+    ASSERT_EQ(sink.TakeContents(), "18446744073709551615" + large + "y");
+}
+
+TEST(LayoutReportTest, TableFields) {
+    std::string data = "library example;\n"
+                       "table Settings {\n"
+                       "    1: string:5 name;\n"
+                       "    2: reserved;\n"
+                       "    3: uint8 flag;\n"
+                       "    4: vector<uint32>:3 values;\n"
+                       "};\n";
+    fidl::SourceFile src("example.fidl", std::move(data));
+    fidl::ErrorReporter error_reporter(false);
+    fidl::Lexer lexer(src, &error_reporter);
+    fidl::Parser parser(&lexer, &error_reporter);
+    auto ast = parser.Parse();
+    ASSERT_TRUE(parser.Ok());
+
+    fidl::flat::Typespace typespace = fidl::flat::Typespace::RootTypes(&error_reporter);
+    fidl::flat::Libraries all_libraries;
+    fidl::flat::Library library(&all_libraries, &error_reporter, &typespace);
+    ASSERT_TRUE(library.ConsumeFile(std::move(ast)));
+    ASSERT_TRUE(library.Compile());
+
+    fidl::OutputSink report;
+    fidl::LayoutReportGenerator generator(&library, fidl::LayoutReportGenerator::Format::kJSON);
+    generator.Produce(&report);
+    std::string contents = report.TakeContents();
+
+    // Each field is at its envelope, and is as large as its contents.
+    EXPECT_NE(contents.find(
+                  "{\"name\": \"name\", \"offset\": 0, \"size\": 24, \"padding\": 0}"),
+              std::string::npos);
+    EXPECT_NE(contents.find(
+                  "{\"name\": \"flag\", \"offset\": 32, \"size\": 1, \"padding\": 7}"),
+              std::string::npos);
+    EXPECT_NE(contents.find(
+                  "{\"name\": \"values\", \"offset\": 48, \"size\": 32, \"padding\": 0}"),
+              std::string::npos);
+}
+
+TEST(LayoutReportTest, NullableProtocolParameters) {
+    std::string data = "library example;\n"
+                       "protocol Peer {\n"
+                       "    Close();\n"
+                       "};\n"
+                       "protocol Pair {\n"
+                       "    H(Peer hh, Peer? gg);\n"
+                       "};\n";
+    fidl::SourceFile src("example.fidl", std::move(data));
+    fidl::ErrorReporter error_reporter(false);
+    fidl::Lexer lexer(src, &error_reporter);
+    fidl::Parser parser(&lexer, &error_reporter);
+    auto ast = parser.Parse();
+    ASSERT_TRUE(parser.Ok());
+
+    fidl::flat::Typespace typespace = fidl::flat::Typespace::RootTypes(&error_reporter);
+    fidl::flat::Libraries all_libraries;
+    fidl::flat::Library library(&all_libraries, &error_reporter, &typespace);
+    ASSERT_TRUE(library.ConsumeFile(std::move(ast)));
+    ASSERT_TRUE(library.Compile());
+
+    fidl::OutputSink report;
+    fidl::LayoutReportGenerator generator(&library, fidl::LayoutReportGenerator::Format::kJSON);
+    generator.Produce(&report);
+    std::string contents = report.TakeContents();
+
+    // A nullable protocol is a handle in place, not a pointer.
+    EXPECT_NE(contents.find(
+                  "{\"name\": \"gg\", \"offset\": 4, \"size\": 4, \"padding\": 0}"),
+              std::string::npos);
+    EXPECT_EQ(contents.find("\"max_out_of_line\": 8"), std::string::npos);
+}
+
+TEST(TablesGeneratorTest, NullableProtocolParameters) {
+    std::string data = "library example;\n"
+                       "protocol Peer {\n"
+                       "    Close();\n"
+                       "};\n"
+                       "protocol Pair {\n"
+                       "    H(Peer hh, Peer? gg) -> (Peer? gg, uint64 x);\n"
+                       "};\n";
+    fidl::SourceFile src("example.fidl", std::move(data));
+    fidl::ErrorReporter error_reporter(false);
+    fidl::Lexer lexer(src, &error_reporter);
+    fidl::Parser parser(&lexer, &error_reporter);
+    auto ast = parser.Parse();
+    ASSERT_TRUE(parser.Ok());
+
+    fidl::flat::Typespace typespace = fidl::flat::Typespace::RootTypes(&error_reporter);
+    fidl::flat::Libraries all_libraries;
+    fidl::flat::Library library(&all_libraries, &error_reporter, &typespace);
+    ASSERT_TRUE(library.ConsumeFile(std::move(ast)));
+    ASSERT_TRUE(library.Compile());
+
+    fidl::OutputSink tables;
+    fidl::TablesGenerator generator(&library);
+    generator.Produce(&tables);
+    std::string contents = tables.TakeContents();
+
+    // Each handle is at its offset after the message header, and both fit in
+    // the request.
+    EXPECT_NE(contents.find("FidlStructField(&Interfaceexample_PeernonnullableTable, 16)"),
+              std::string::npos);
+    EXPECT_NE(contents.find("FidlStructField(&Interfaceexample_PeernullableTable, 20)"),
+              std::string::npos);
+    EXPECT_NE(contents.find("FidlCodedStruct(example_PairHRequestTableFields, 2, 24, "),
+              std::string::npos);
+    EXPECT_NE(contents.find("FidlCodedStruct(example_PairHResponseTableFields, 1, 32, "),
+              std::string::npos);
+}
+
+TEST(LibraryTest, SharedDependency) {
+    // As in a --batch run, a dependency is output after a library that uses
+    // it is compiled.
+    fidl::SourceFile dep_src("dep.fidl", "library dep;\n"
+                                         "protocol Base {\n"
+                                         "    Ping();\n"
+                                         "};\n");
+    fidl::SourceFile top_src("top.fidl", "library top;\n"
+                                         "using dep;\n"
+                                         "protocol Top {\n"
+                                         "    Link(dep.Base base);\n"
+                                         "};\n");
+    fidl::ErrorReporter error_reporter(false);
+    fidl::flat::Typespace typespace = fidl::flat::Typespace::RootTypes(&error_reporter);
+    fidl::flat::Libraries all_libraries;
+
+    fidl::Lexer dep_lexer(dep_src, &error_reporter);
+    fidl::Parser dep_parser(&dep_lexer, &error_reporter);
+    auto dep_ast = dep_parser.Parse();
+    ASSERT_TRUE(dep_parser.Ok());
+    auto dep = std::make_unique<fidl::flat::Library>(&all_libraries, &error_reporter, &typespace);
+    ASSERT_TRUE(dep->ConsumeFile(std::move(dep_ast)));
+    ASSERT_TRUE(dep->Compile());
+    const fidl::flat::Library* dep_library = dep.get();
+    ASSERT_TRUE(all_libraries.Insert(std::move(dep)));
+
+    fidl::Lexer top_lexer(top_src, &error_reporter);
+    fidl::Parser top_parser(&top_lexer, &error_reporter);
+    auto top_ast = top_parser.Parse();
+    ASSERT_TRUE(top_parser.Ok());
+    fidl::flat::Library top(&all_libraries, &error_reporter, &typespace);
+    ASSERT_TRUE(top.ConsumeFile(std::move(top_ast)));
+    ASSERT_TRUE(top.Compile());
+
+    fidl::OutputSink tables;
+    fidl::TablesGenerator generator(dep_library);
+    generator.Produce(&tables);
+    std::string contents = tables.TakeContents();
+
+    // The dependency's protocol still has a single method.
+    const std::string ping_table = "fidl_type_t dep_BasePingRequestTable =";
+    auto first = contents.find(ping_table);
+    ASSERT_NE(first, std::string::npos);
+    EXPECT_EQ(contents.find(ping_table, first + 1), std::string::npos);
+}